@@ -6,25 +6,22 @@
 #include "imgui_impl_opengl3.h"
 #include <GLFW/glfw3.h>
 #include "scanner_l/scanner_l_api.h"
+#include "scanner_l/organized_index.h"
+#include "scanner_l/metrics.h"
+#include "decimated_plot.h"
+#include "log_ring.h"
+#include "scanner_command_executor.h"
+#include "scan_snapshot.h"
+#include "scan_history.h"
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <memory>
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
-// 扫描器状态
-enum class ScannerState {
-    IDLE,           // 空闲
-    INITIALIZING,   // 初始化中
-    CONNECTING,     // 连接中
-    CONNECTED,      // 已连接
-    SCANNING,       // 扫描中
-    STOPPING,       // 停止中
-    ERROR_STATE     // 错误
-};
-
 class CameraScannerUI {
 public:
     CameraScannerUI();
@@ -61,6 +58,39 @@ private:
     // 显示数据信息
     void ShowDataPanel();
     
+    // 扫描中的实时预览（最新轮廓 + 滚动高度图）
+    void ShowLivePreview();
+    
+    // 取出新的预览行并以 glTexSubImage2D 增量写入纹理
+    void UpdateLivePreviewTexture();
+
+    // 从降采样金字塔最粗一层重建整幅扫描的缩略高度图（限频，不读全分辨率数据）
+    void UpdateOverviewTexture();
+    
+    // 清空预览（开始扫描时调用，UI 线程）
+    void ClearLivePreview();
+    
+    // 释放预览纹理（OpenGL 上下文仍有效时调用）
+    void ReleaseLivePreviewTexture();
+    
+    // 历史扫描：表格（结果查询）和缩略图网格（图标查询），都只画可见的行
+    void ShowHistoryToolbar();
+    void ShowHistoryTable();
+    void ShowHistoryIcons();
+    void ShowHistoryTooltip(const ScanIndexEntry& entry);
+    
+    // 记录的缩略图纹理，没有或本帧加载名额已用完时返回 0
+    GLuint GetHistoryThumbnail(const ScanIndexEntry& entry);
+    
+    // 释放全部缩略图纹理（OpenGL 上下文仍有效时调用）
+    void ReleaseHistoryThumbnails();
+    
+    // 性能面板：采集、处理、保存、队列和进程的实时指标
+    void ShowPerfHud();
+    
+    // 从指标注册表取一次快照，更新面板用的速率和区间分位数
+    void SamplePerfMetrics();
+    
     // 扫描器操作（异步）
     void InitScanner();
     void ConnectScanner();
@@ -68,17 +98,36 @@ private:
     void StopScan();
     void DisconnectScanner();
     
+    // 命令线程上执行的扫描器操作，返回 0 成功；异常由执行器转为错误状态
+    int RunInitScanner();
+    int RunConnectScanner();
+    int RunStartScan(int recipe_id);
+    int RunStopScan(const std::atomic<bool>& cancelled);
+    int RunDisconnectScanner();
+    
     // 保存扫描数据（内部方法）
-    void SaveScanData(const std::vector<std::vector<cv::Point3f>>& pc_vec,
-                      const std::vector<std::vector<uint8_t>>& gray_vec,
-                      const std::vector<std::vector<int32_t>>& encoder_vec,
-                      const std::vector<std::vector<uint32_t>>& framecnt_vec);
+    void SaveScanData(const ScanSnapshot& snapshot);
 
     // 更新状态文本
     const char* GetStateText() const;
     
-    // 添加日志消息（内部方法）
-    void AddLogMessage(const std::string& message);
+    // 添加日志消息（内部方法，任意线程可调用）
+    void AddLogMessage(const std::string& message, int severity = google::GLOG_INFO);
+    
+    // 把日志环形缓冲中的新记录搬到界面侧（每帧一次，只搬新增部分）
+    void PullLogRecords();
+    
+    // 画第 i 条显示中的日志
+    void DrawLogRow(uint64_t i);
+    
+    // 请求重绘，任意线程可调用，唤醒空闲等待中的主循环
+    void RequestRedraw();
+    
+    // 等待下一帧：空闲时阻塞等待事件，忙碌（扫描等）时限制帧率
+    void WaitForNextFrame();
+    
+    // 初始化、连接、扫描、停止中需要持续刷新
+    bool IsBusy() const;
 
 private:
     GLFWwindow* window_;
@@ -86,7 +135,6 @@ private:
     
     // 扫描器 API
     std::unique_ptr<ScannerLApi> scanner_api_;
-    ScannerState scanner_state_;
     std::string config_path_;
     std::string data_root_path_;  // 数据保存根路径
     
@@ -95,15 +143,16 @@ private:
     std::mutex status_mutex_;
     
     // 数据信息
-    std::vector<std::vector<cv::Point3f>> point_clouds_;
-    std::vector<std::vector<uint8_t>> gray_images_;
-    std::vector<std::vector<int32_t>> encoder_values_;
-    std::vector<std::vector<uint32_t>> frame_counts_;
-    std::mutex data_mutex_;
+    ScanSnapshotStore scan_store_;  // 最近几次扫描的不可变快照
+    uint64_t viewed_scan_id_ = 0;  // 数据面板显示的扫描，0 为最新一次
+    float pick_xy_[2] = { 0.0f, 0.0f };  // 高度拾取的查询位置
+    float pick_radius_ = 0.5f;  // 高度拾取的搜索半径
+    int recipe_id_;  // 当前配方 ID，用于选择基准扫描
+    int scan_recipe_id_ = 0;  // 正在进行的扫描所用的配方（仅命令线程访问）
+    std::atomic<uint64_t> live_feature_count_;  // 本次扫描已收到的轮廓边缘数（采集线程回调累加）
     
     // 线程控制
     std::atomic<bool> should_stop_;
-    std::thread scanner_thread_;
     
     // UI 状态
     bool show_demo_window_;
@@ -125,12 +174,91 @@ private:
     bool log_show_info_;
     bool log_show_warning_;
     bool log_show_error_;
-    std::vector<std::string> log_messages_;
-    std::mutex log_mutex_;
+    
+    // glog 与界面消息共用的无锁日志缓冲，级别过滤在写入时进行
+    LogRing log_ring_;
+    RealtimeLogSink log_sink_{ log_ring_ };
+    bool log_sink_added_ = false;
+    bool log_sink_async_ = false;  // 经异步日志后台转发，而不是直接注册到 glog
+    
+    // 界面侧的日志副本（只在界面线程访问），渲染时无需加锁
+    std::vector<LogRecord> log_view_;
+    uint64_t log_view_begin_ = 0;  // 显示范围 [begin, end)，按追加计数
+    uint64_t log_view_end_ = 0;
+    uint64_t log_read_pos_ = 0;  // 下一条要从 log_ring_ 读取的序号
+    int log_pending_frames_ = 0;  // 同一序号持续未写完的帧数
+    uint64_t log_lost_ = 0;  // 来不及显示就被覆盖的条数
+    std::vector<float> log_row_heights_;  // 自动换行时每条的高度，与 log_view_ 同下标
+    std::vector<float> log_row_offsets_;  // 自动换行时显示范围内各条的起始纵坐标
+    float log_wrap_width_ = 0.0f;  // log_row_heights_ 对应的换行宽度，0 表示未计算
     
     // 布局初始化标志
     bool nav_window_initialized_;
     bool content_window_initialized_;
+    
+    // 帧调度
+    std::atomic<bool> event_loop_running_{ false };  // 主循环运行中才投递唤醒事件
+    std::atomic<bool> redraw_requested_{ false };
+    int settle_frames_ = 3;  // 被事件唤醒后继续渲染的帧数，等悬停、动画等状态稳定
+    float busy_max_fps_ = 30.0f;  // 忙碌时的帧率上限，把 CPU/GPU 留给采集
+    float idle_timeout_s_ = 0.5f;  // 空闲时的最长等待，保证时间等显示仍会刷新
+    double last_frame_start_ = 0.0;
+    float frame_time_ms_ = 0.0f;  // 每帧 CPU 耗时（不含等待和交换缓冲），指数平均
+    float frame_interval_ms_ = 0.0f;  // 相邻两帧的间隔，指数平均
+    MetricHistogram* frame_time_metric_ = Metrics().Histogram(kMetricUiFrameMs);
+    
+    // 性能面板（仅 UI 线程访问），速率和分位数按相邻两次快照的差计算
+    bool show_perf_hud_ = false;
+    double perf_interval_s_ = 0.5;  // 采样间隔
+    MetricsSnapshot perf_prev_;
+    MetricsSnapshot perf_curr_;
+    double perf_line_rate_ = 0.0;  // 行/秒
+    double perf_batch_rate_ = 0.0;  // 批次/秒
+    HistogramSnapshot perf_callback_us_;  // 最近一个采样区间的回调耗时
+    HistogramSnapshot perf_frame_ms_;  // 最近一个采样区间的界面帧耗时
+    size_t perf_rss_bytes_ = 0;
+    std::vector<float> perf_line_rate_history_;  // 行速率曲线，最旧的在前
+    
+    // 实时预览（仅 UI 线程访问）
+    LiveProfile live_profile_;  // 最近一条轮廓
+    DecimatedPlot live_profile_plot_{ true };  // 按最新轮廓的行号缓存，无效点处断开
+    std::vector<float> live_rows_;  // 本帧取出的降采样行
+    std::vector<uint8_t> live_rgba_;  // 上传用的颜色缓冲
+    GLuint live_height_tex_ = 0;  // 环形滚动的高度图纹理
+    int live_tex_width_ = 0;
+    int live_tex_rows_ = 512;
+    int live_tex_head_ = 0;  // 下一行写入的纹理行
+    bool live_tex_wrapped_ = false;
+    float live_z_range_[2] = { -5.0f, 5.0f };  // 着色的高度范围
+    bool live_auto_range_ = true;  // 使用实时统计的高度范围
+    GLuint overview_tex_ = 0;  // 已扫描部分的整体缩略高度图（preview_pyramid_enable）
+    int overview_tex_width_ = 0;
+    int overview_tex_rows_ = 0;
+    int overview_level_ = 0;
+    double overview_last_update_ = 0.0;  // glfwGetTime()
+    
+    // 灰度直方图（按批次数缓存）
+    DecimatedPlot gray_hist_plot_;
+    std::vector<float> gray_hist_;
+    float gray_hist_max_ = 0.0f;
+    uint64_t gray_hist_version_ = 0;
+    
+    // 历史扫描索引（保存线程追加，界面只读可见行）
+    ScanHistoryIndex scan_history_;
+    bool history_opened_ = false;  // 界面已尝试打开过（初始化前用默认目录）
+    struct HistoryThumbnail {
+        GLuint tex = 0;
+        uint64_t last_used = 0;  // 最后一次绘制的帧号
+    };
+    std::unordered_map<uint64_t, HistoryThumbnail> history_thumbs_;  // 以缩略图偏移为键
+    std::string history_thumbs_dir_;  // history_thumbs_ 所属的目录，目录变化时全部释放
+    uint64_t history_frame_ = 0;
+    int history_loads_left_ = 0;  // 本帧还能读取的缩略图数，避免一帧里读太多
+    std::string history_selected_;  // 选中记录的文件名前缀
+    float history_icon_size_ = 128.0f;
+    
+    // 扫描器命令（放在最后：析构时最先停止命令线程，它还在使用上面的成员）
+    ScannerCommandExecutor command_executor_;
 };
 
 #endif // CAMERA_SCANNER_UI_H
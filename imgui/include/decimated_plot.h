@@ -0,0 +1,58 @@
+#ifndef DECIMATED_PLOT_H
+#define DECIMATED_PLOT_H
+
+#include "imgui.h"
+#include <cstdint>
+#include <vector>
+
+// 按像素列做最小/最大值抽取：第 k 列覆盖 [k * count / columns, (k + 1) * count / columns)
+// skip_invalid_z 为 true 时按高度数据处理，无效点（z <= kInvalidZThreshold）不参与，整列无效时 out_min[k] > out_max[k]；
+// 编码器、时间序列等其他数据传 false，所有值都参与
+// columns 需 <= count
+void DecimateMinMax(const float* values, int count, int columns, bool skip_invalid_z, float* out_min, float* out_max);
+
+// 轮廓 / 编码器 / 时间序列曲线
+// 每个像素列只画一段 min~max 竖线，3200 点的轮廓在几百像素宽的面板上只产生几百个顶点；
+// 抽取结果按数据版本缓存，数据不变时每帧只重用顶点
+class DecimatedPlot {
+public:
+    // skip_invalid_z：高度轮廓传 true，无效点处曲线断开（见 DecimateMinMax）
+    explicit DecimatedPlot(bool skip_invalid_z = false) : skip_invalid_z_(skip_invalid_z) {}
+
+    // 画边框和曲线，version 与上次相同且点数、尺寸、范围不变时直接重用缓存
+    // size.x <= 0 时与 ImGui 控件一致，取可用宽度加上 size.x
+    void Plot(const char* label, const float* values, int count, uint64_t version, float scale_min, float scale_max,
+              const ImVec2& size, const char* overlay = nullptr, ImU32 color = 0);
+
+    // 在上一个控件（通常是另一个 DecimatedPlot 的 Plot）的区域内叠加一条曲线
+    void Overlay(const float* values, int count, uint64_t version, float scale_min, float scale_max, ImU32 color);
+
+    // 下次绘制时强制重新抽取
+    void Invalidate();
+
+private:
+    void Update(const float* values, int count, uint64_t version, float scale_min, float scale_max,
+                const ImVec2& origin, const ImVec2& size);
+
+    void DrawTrace(ImDrawList* draw_list, ImU32 color) const;
+
+    bool skip_invalid_z_;
+
+    // 缓存键
+    bool cached_ = false;
+    uint64_t version_ = 0;
+    int count_ = 0;
+    float scale_[2] = { 0.0f, 0.0f };
+    ImVec2 size_;
+    ImVec2 origin_;
+
+    // 每列的抽取结果
+    std::vector<float> min_;
+    std::vector<float> max_;
+
+    // 屏幕坐标顶点，无效列处断开，segments_ 为各段起点（末尾附总数）
+    std::vector<ImVec2> points_;
+    std::vector<int> segments_;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <glog/logging.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+
+// 一条日志，定长，写入和读取都不分配内存
+struct LogRecord {
+    static constexpr size_t kMaxText = 240;
+
+    int severity = google::GLOG_INFO;
+    uint32_t length = 0;
+    char text[kMaxText];  // "[HH:MM:SS] 消息"，超长截断，以 '\0' 结尾
+};
+
+// 定长无锁日志环形缓冲，glog 和界面消息共用
+// 多个线程同时 Push()，界面线程按序号 Read()；写满后覆盖最旧的记录，写入方从不等待
+// 严重级别在写入时过滤，被关闭的级别不占用缓冲
+class LogRing {
+public:
+    enum ReadResult {
+        kReadOk,
+        kReadPending,  // 该序号尚未写完，稍后再读
+        kReadLost      // 已被覆盖或写入时被放弃
+    };
+
+    // capacity 取整到 2 的幂
+    explicit LogRing(size_t capacity = 4096);
+
+    // tm_time 为空时使用当前本地时间；被过滤返回 false
+    bool Push(int severity, const struct ::tm* tm_time, const char* message, size_t length);
+
+    // 下一条记录的序号，[0, WritePosition()) 为已分配的序号
+    uint64_t WritePosition() const { return write_pos_.load(std::memory_order_acquire); }
+
+    ReadResult Read(uint64_t pos, LogRecord& out) const;
+
+    size_t Capacity() const { return capacity_; }
+
+    // 是否接收某个级别的日志
+    void SetSeverityEnabled(int severity, bool enabled);
+    bool IsSeverityEnabled(int severity) const;
+
+    // 被级别过滤掉的条数
+    uint64_t FilteredCount() const { return filtered_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        // 0 空，2 * pos + 1 正在写入，2 * pos + 2 写入完成
+        std::atomic<uint64_t> stamp{ 0 };
+        LogRecord record;
+    };
+
+    size_t capacity_;
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> write_pos_{ 0 };
+    std::atomic<uint32_t> accept_mask_{ ~0u };
+    std::atomic<uint64_t> filtered_{ 0 };
+};
+
+// glog 输出转入 LogRing，不加锁、不分配内存，扫描时大量 LOG(INFO) 也不会阻塞日志调用方
+class RealtimeLogSink : public google::LogSink {
+public:
+    explicit RealtimeLogSink(LogRing& ring) : ring_(ring) {}
+
+    void send(google::LogSeverity severity, const char* full_filename,
+        const char* base_filename, int line,
+        const struct ::tm* tm_time,
+        const char* message, size_t message_len) override {
+        ring_.Push(severity, tm_time, message, message_len);
+    }
+
+private:
+    LogRing& ring_;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef SCAN_HISTORY_H
+#define SCAN_HISTORY_H
+
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 缩略图尺寸（8 位归一化高度，0 为无效点，PNG 压缩后存入缩略图文件）
+constexpr int kScanThumbWidth = 128;
+constexpr int kScanThumbHeight = 96;
+constexpr uint64_t kNoScanThumb = ~0ull;
+constexpr uint32_t kScanThumbFailed = 1u;  // 找不到或读不出扫描文件，不再重试
+
+// 索引文件中的一条记录，定长 128 字节；改动布局时同时改 kScanIndexVersion
+struct ScanIndexEntry {
+    int64_t capture_time = 0;
+    int32_t recipe_id = -1;  // 导入的旧扫描没有配方信息，为 -1
+    int32_t scanner_count = 0;
+    uint64_t point_count = 0;
+    uint64_t line_count = 0;
+    float valid_ratio = 0.0f;
+    float min_z = 0.0f;
+    float max_z = 0.0f;
+    float mean_z = 0.0f;
+    uint64_t thumb_offset = kNoScanThumb;  // 在 scan_thumbs.bin 中的偏移
+    uint32_t thumb_bytes = 0;
+    uint16_t thumb_width = 0;
+    uint16_t thumb_height = 0;
+    uint32_t flags = 0;
+    char stem[60] = {};  // 保存文件名的公共前缀，如 pointclouds_loop_20250101_120000
+
+    std::string Stem() const;
+    void SetStem(const std::string& value);
+    bool HasThumbnail() const { return thumb_offset != kNoScanThumb; }
+};
+
+static_assert(sizeof(ScanIndexEntry) == 128, "ScanIndexEntry 是索引文件的记录格式");
+
+// data_root_path 下历史扫描的索引
+// scan_index.bin：文件头 + 定长记录，按加入顺序追加，缩略图生成后原地改写该条记录；
+// scan_thumbs.bin：缩略图 PNG 依次追加。
+// 打开时只读索引文件，几千条扫描也只是几百 KB，不碰点云等大文件；
+// 缩略图由后台线程从已保存的高度图 / 点云 tiff 生成，界面只读可见行的那一小段
+class ScanHistoryIndex {
+public:
+    explicit ScanHistoryIndex(int worker_count = 2);
+    ~ScanHistoryIndex();
+
+    // 打开目录下的索引，没有则新建并导入目录中已有的扫描；缺缩略图的记录排队生成
+    bool Open(const std::string& data_dir);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    std::string Directory() const;
+
+    // 保存一次扫描后追加记录并排队生成缩略图（任意线程）
+    bool Add(const ScanIndexEntry& entry);
+
+    // 后台查找目录中索引里没有的扫描（以 *_stats.json 为准）并补进索引
+    void Rescan();
+
+    size_t Size() const;
+
+    // 按扫描时间排序的第 i 条，0 为最新
+    bool Get(size_t i, ScanIndexEntry& out) const;
+
+    // 读取并着色一条记录的缩略图，只读缩略图文件中的一段
+    bool ReadThumbnail(const ScanIndexEntry& entry, cv::Mat& out_rgba) const;
+
+    // 排队和正在执行的后台任务数
+    size_t PendingTasks() const;
+
+    // 记录增加或缩略图生成后调用（后台线程上），用于请求重绘
+    void SetChangedListener(std::function<void()> listener);
+
+private:
+    void WorkerLoop();
+
+    // 任务自己比对 generation_，目录已换掉时直接返回；调用时持有 mutex_
+    void Post(std::function<void()> run);
+    bool WriteRecord(size_t position, const ScanIndexEntry& entry);
+    size_t AppendLocked(const ScanIndexEntry& entry);
+    void QueueThumbnail(size_t position, const std::string& stem);
+    void GenerateThumbnail(uint64_t generation, size_t position, const std::string& stem);
+    void ImportMissing(uint64_t generation);
+    void NotifyChanged();
+
+    // 索引（entries_、order_、文件）
+    mutable std::mutex mutex_;
+    std::string dir_;
+    bool open_ = false;
+    uint64_t generation_ = 0;  // 每次 Open/Close 加一，旧目录的后台任务结果作废
+    std::vector<ScanIndexEntry> entries_;  // 文件中的顺序
+    std::vector<uint32_t> order_;  // entries_ 的下标，按 capture_time 从新到旧
+    std::fstream index_file_;
+    std::fstream thumbs_file_;
+
+    // 只供 ReadThumbnail 使用的读句柄，界面读缩略图时不等后台写文件
+    mutable std::mutex read_mutex_;
+    mutable std::ifstream thumbs_reader_;
+
+    // 后台任务
+    mutable std::mutex task_mutex_;
+    std::condition_variable task_cv_;
+    std::deque<std::function<void()>> tasks_;
+    size_t running_tasks_ = 0;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+
+    std::mutex listener_mutex_;
+    std::function<void()> changed_listener_;
+};
+
+#endif
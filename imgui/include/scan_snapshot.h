@@ -0,0 +1,72 @@
+#ifndef SCAN_SNAPSHOT_H
+#define SCAN_SNAPSHOT_H
+
+#include "scanner_l/scanner_l_api.h"
+#include "scanner_l/organized_index.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 一次扫描的全部结果，发布后不再修改，界面和保存线程各自持有引用即可，不需要加锁
+struct ScanSnapshot {
+    uint64_t id = 0;             // 发布时分配，从 1 递增
+    time_t capture_time = 0;     // 扫描结束时间，也用作保存文件名
+    int recipe_id = 0;
+
+    std::vector<std::vector<cv::Point3f>> point_clouds;
+    std::vector<std::vector<uint8_t>> gray_images;
+    std::vector<std::vector<int32_t>> encoder_values;
+    std::vector<std::vector<uint32_t>> frame_counts;
+    ScanStatistics statistics;
+    GoldenCompareResult golden_result;
+    std::vector<MeasurementResult> measurements;
+    std::vector<std::vector<cv::Point3f>> preview_clouds;  // 体素降采样后的预览点云（每个相机一份）
+    std::vector<std::vector<uint8_t>> preview_grays;
+    std::vector<std::vector<uint32_t>> packed_normals;     // 八面体编码的法向量（每点 4 字节，无序点云为空）
+    std::vector<OrganizedIndex> point_indices;             // 引用本快照 point_clouds 的 XY 索引（无序点云为空）
+
+    size_t PointCount() const;
+};
+
+using ScanSnapshotPtr = std::shared_ptr<const ScanSnapshot>;
+
+// 最近几次扫描，新的在前；整体不可变，发布时复制指针列表后原子替换（RCU）
+struct ScanHistory {
+    std::vector<ScanSnapshotPtr> scans;
+};
+
+// 扫描快照的发布点
+// 发布者（命令线程）构造好新快照后原子地替换历史；读者每帧取一次引用，只增加引用计数。
+// 超出容量的旧扫描在最后一个读者放手后释放；一次全长扫描约 1 GB，容量由 all_path_config.json 的
+// scan_history_capacity 设置
+class ScanSnapshotStore {
+public:
+    explicit ScanSnapshotStore(size_t capacity = 2);
+
+    // 分配 id 并发布为最新一次扫描
+    ScanSnapshotPtr Publish(std::shared_ptr<ScanSnapshot> snapshot);
+
+    // 最近一次扫描，没有时为空
+    ScanSnapshotPtr Latest() const;
+
+    // 按 id 查找仍在历史中的扫描
+    ScanSnapshotPtr Find(uint64_t id) const;
+
+    std::shared_ptr<const ScanHistory> History() const;
+
+    // 保留的扫描数（至少 1），立即生效
+    void SetCapacity(size_t capacity);
+    size_t Capacity() const;
+
+private:
+    std::shared_ptr<const ScanHistory> history_;  // 只通过 std::atomic_load / std::atomic_store 访问
+    std::atomic<size_t> capacity_;
+    std::atomic<uint64_t> next_id_{ 1 };
+    std::mutex publish_mutex_;  // 只在发布者之间互斥，读者不用
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef SCANNER_COMMAND_EXECUTOR_H
+#define SCANNER_COMMAND_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// 扫描器状态
+enum class ScannerState {
+    IDLE,           // 空闲
+    INITIALIZING,   // 初始化中
+    CONNECTING,     // 连接中
+    CONNECTED,      // 已连接
+    SCANNING,       // 扫描中
+    STOPPING,       // 停止中
+    ERROR_STATE     // 错误
+};
+
+// 扫描器命令
+enum class ScannerCommand {
+    INIT,        // IDLE -> INITIALIZING -> IDLE
+    CONNECT,     // IDLE -> CONNECTING -> CONNECTED
+    START,       // CONNECTED -> SCANNING
+    STOP,        // SCANNING -> STOPPING -> CONNECTED
+    DISCONNECT,  // 除 IDLE 外 -> IDLE
+    TASK         // 不改变状态的任务（PostTask）
+};
+
+// 命令的 future 结果，处理函数自身返回 0 表示成功
+constexpr int kCommandRejected = -1000;   // 执行时的状态不允许该命令
+constexpr int kCommandCancelled = -1001;  // 排队中被取消，或执行器已关闭
+constexpr int kCommandException = -1002;  // 处理函数抛出异常，状态置为 ERROR_STATE
+
+// 扫描器命令执行器
+// 所有扫描器操作在同一个工作线程上按投递顺序执行，互不重叠；状态机也在这里：
+// 命令执行时检查起始状态，执行中和结束后的状态由执行器设置，失败进入 ERROR_STATE。
+// 界面只投递命令并读取原子的状态快照，连续快速地开始/停止也只是依次排队。
+class ScannerCommandExecutor {
+public:
+    // 处理函数：返回 0 成功；cancelled 在 CancelAll()/Shutdown() 后为 true，耗时的处理可据此提前结束
+    using Handler = std::function<int(const std::atomic<bool>& cancelled)>;
+
+    ScannerCommandExecutor();
+    ~ScannerCommandExecutor();
+
+    // 状态变化时在工作线程上调用
+    void SetStateListener(std::function<void(ScannerState)> listener);
+
+    // 投递命令；队列为空且当前状态不允许时立即返回 kCommandRejected
+    std::future<int> Post(ScannerCommand command, Handler handler);
+
+    // 投递一个不改变状态的任务，执行时状态为 required 才运行，否则 kCommandRejected
+    std::future<int> PostTask(ScannerState required, Handler task);
+
+    // 取消所有排队中的命令，并通知正在执行的命令
+    void CancelAll();
+
+    // 取消排队中的命令，等待当前命令结束并退出工作线程；之后的投递都得到 kCommandCancelled
+    void Shutdown();
+
+    ScannerState State() const { return state_.load(std::memory_order_acquire); }
+
+    // 有命令正在执行或排队
+    bool IsBusy() const;
+
+    // 排队中（未开始执行）的命令数
+    size_t QueueDepth() const;
+
+    // command 能否从 state 开始执行
+    static bool IsAllowed(ScannerCommand command, ScannerState state);
+
+private:
+    struct Item {
+        ScannerCommand command;
+        ScannerState required;  // 仅 TASK
+        Handler handler;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        std::promise<int> result;
+    };
+
+    void Run();
+    int Execute(Item& item);
+    void SetState(ScannerState state);
+
+    std::atomic<ScannerState> state_{ ScannerState::IDLE };
+    std::function<void(ScannerState)> state_listener_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Item> queue_;
+    std::shared_ptr<std::atomic<bool>> running_cancelled_;  // 正在执行命令的取消标志，空闲时为空
+    bool stop_ = false;
+    std::thread worker_;
+};
+
+#endif
@@ -14,6 +14,7 @@
 #include <string>
 #include <mutex>
 #include <glog/logging.h>
+#include "log_ring.h"
 #include <condition_variable>
 #include <atomic>
 #include <thread>
@@ -43,39 +44,4 @@ namespace utility
 
 }
 
-class RealtimeLogSink : public google::LogSink {
-public:
-    void send(google::LogSeverity severity, const char* full_filename,
-        const char* base_filename, int line,
-        const struct ::tm* tm_time,
-        const char* message, size_t message_len) override {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        char time_buf[32];
-        strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_time);
-        log_buffer_.push_back({
-            severity,
-            std::string(message, message_len),
-            std::string(time_buf)
-            });
-        new_log_available_ = true;
-    }
-
-    bool CheckNewLogs() {
-        bool ret = new_log_available_;
-        new_log_available_ = false;
-        return ret;
-    }
-
-    std::vector<utility::LogEntry> GetLogs() {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        return log_buffer_;
-    }
-
-public:
-    std::mutex buffer_mutex_;
-    std::vector<utility::LogEntry> log_buffer_;
-private:
-    bool new_log_available_ = false;
-};
-
 #endif
\ No newline at end of file
@@ -1,19 +1,23 @@
 #include "CameraScannerUI.h"
 #include "glog/logging.h"
 #include "scanner_l/scan_io.h"
+#include "scanner_l/async_log.h"
 #include <iostream>
 #include <sstream>
 #include <filesystem>
 #include <ctime>
+#include <cfloat>
 #include <fstream>
+#include <chrono>
 #include <nlohmann/json.hpp>
 
 CameraScannerUI::CameraScannerUI()
     : window_(nullptr)
     , window_should_close_(false)
-    , scanner_state_(ScannerState::IDLE)
     , config_path_("../ScannerConfig/")
     , data_root_path_("./scan_data/")
+    , recipe_id_(0)
+    , live_feature_count_(0)
     , should_stop_(false)
     , show_demo_window_(false)
     , show_control_panel_(true)
@@ -34,6 +38,7 @@ CameraScannerUI::CameraScannerUI()
     strncpy(config_path_buffer_, "../ScannerConfig/", sizeof(config_path_buffer_) - 1);
 #endif
     config_path_buffer_[sizeof(config_path_buffer_) - 1] = '\0';
+    scan_history_.SetChangedListener([this]() { RequestRedraw(); });
 }
 
 CameraScannerUI::~CameraScannerUI() {
@@ -157,8 +162,17 @@ bool CameraScannerUI::Initialize(int width, int height, const char* title) {
     // 初始化扫描器 API
     scanner_api_ = std::make_unique<ScannerLApi>();
 
+    // glog 输出也显示在界面日志中；启用了异步日志时由其后台线程转发
+    log_sink_async_ = IsAsyncLoggingInstalled();
+    if (log_sink_async_) {
+        SetAsyncLogSink(&log_sink_);
+    } else {
+        google::AddLogSink(&log_sink_);
+    }
+    log_sink_added_ = true;
+
     status_message_ = "系统就绪";
-    scanner_state_ = ScannerState::IDLE;
+    command_executor_.SetStateListener([this](ScannerState) { RequestRedraw(); });
     AddLogMessage("系统初始化完成");
 
     return true;
@@ -167,8 +181,14 @@ bool CameraScannerUI::Initialize(int width, int height, const char* title) {
 void CameraScannerUI::Run() {
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
+    event_loop_running_ = true;
     while (!glfwWindowShouldClose(window_) && !window_should_close_) {
-        glfwPollEvents();
+        WaitForNextFrame();
+        const double frame_start = glfwGetTime();
+        if (last_frame_start_ > 0.0) {
+            frame_interval_ms_ += (static_cast<float>((frame_start - last_frame_start_) * 1000.0) - frame_interval_ms_) * 0.1f;
+        }
+        last_frame_start_ = frame_start;
 
         // 开始 IMGUI 帧
         ImGui_ImplOpenGL3_NewFrame();
@@ -187,17 +207,69 @@ void CameraScannerUI::Run() {
                      clear_color.z * clear_color.w, clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        const double frame_ms = (glfwGetTime() - frame_start) * 1000.0;
+        frame_time_ms_ += (static_cast<float>(frame_ms) - frame_time_ms_) * 0.1f;
+        frame_time_metric_->Record(frame_ms);
 
         glfwSwapBuffers(window_);
     }
+    event_loop_running_ = false;
     
     // 在窗口关闭前清理 ImGui（此时 OpenGL 上下文仍然有效）
     CleanupImGui();
 }
 
+bool CameraScannerUI::IsBusy() const {
+    const ScannerState scanner_state = command_executor_.State();
+    return scanner_state == ScannerState::INITIALIZING || scanner_state == ScannerState::CONNECTING
+        || scanner_state == ScannerState::SCANNING || scanner_state == ScannerState::STOPPING;
+}
+
+void CameraScannerUI::WaitForNextFrame() {
+    if (IsBusy()) {
+        // 实时预览需要持续刷新，但不超过帧率上限
+        const double wait = last_frame_start_ + 1.0 / busy_max_fps_ - glfwGetTime();
+        if (wait > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+        glfwPollEvents();
+        return;
+    }
+
+    // 正在输入文字（光标闪烁）、按住鼠标拖动或刚被唤醒时按 vsync 刷新
+    const ImGuiIO& io = ImGui::GetIO();
+    if (settle_frames_ > 0 || redraw_requested_.exchange(false) || io.WantTextInput || ImGui::IsAnyMouseDown()) {
+        if (settle_frames_ > 0) {
+            settle_frames_--;
+        }
+        glfwPollEvents();
+        return;
+    }
+
+    // 什么都没变：阻塞到有输入、其他线程 RequestRedraw() 或超时
+    const double wait_start = glfwGetTime();
+    glfwWaitEventsTimeout(idle_timeout_s_);
+    if (redraw_requested_.exchange(false) || glfwGetTime() - wait_start < idle_timeout_s_ * 0.9) {
+        settle_frames_ = 3;
+    }
+}
+
+void CameraScannerUI::RequestRedraw() {
+    redraw_requested_ = true;
+    if (event_loop_running_) {
+        glfwPostEmptyEvent();
+    }
+}
+
 void CameraScannerUI::CleanupImGui() {
     // 清理 IMGUI（在窗口关闭前，OpenGL 上下文仍然有效）
     if (!imgui_cleaned_up_ && ImGui::GetCurrentContext() != nullptr) {
+        ReleaseLivePreviewTexture();
+        if (overview_tex_ != 0) {
+            glDeleteTextures(1, &overview_tex_);
+            overview_tex_ = 0;
+        }
+        ReleaseHistoryThumbnails();
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
@@ -208,17 +280,30 @@ void CameraScannerUI::CleanupImGui() {
 void CameraScannerUI::Cleanup() {
     should_stop_ = true;
     
-    // 停止扫描器
-    if (scanner_api_ && scanner_state_ != ScannerState::IDLE) {
-        try {
-            if (scanner_state_ == ScannerState::SCANNING) {
-                StopScan();
-            }
-            DisconnectScanner();
-        } catch (...) {
-            // 忽略异常
+    // 停止扫描器：丢弃排队中的命令，再依次停止扫描、断开连接，等它们执行完才能销毁扫描器和界面数据。
+    // 投递时状态不允许的命令在执行时会被拒绝，所以两条都投递
+    command_executor_.CancelAll();
+    if (scanner_api_) {
+        command_executor_.Post(ScannerCommand::STOP, [this](const std::atomic<bool>& cancelled) { return RunStopScan(cancelled); });
+        std::future<int> disconnected =
+            command_executor_.Post(ScannerCommand::DISCONNECT, [this](const std::atomic<bool>&) { return RunDisconnectScanner(); });
+        if (disconnected.wait_for(std::chrono::seconds(30)) != std::future_status::ready) {
+            LOG(WARNING) << "等待扫描器断开连接超时";
+            command_executor_.CancelAll();
         }
     }
+    command_executor_.Shutdown();
+    scan_history_.SetChangedListener(nullptr);
+    scan_history_.Close();
+
+    if (log_sink_added_) {
+        if (log_sink_async_) {
+            SetAsyncLogSink(nullptr);
+        } else {
+            google::RemoveLogSink(&log_sink_);
+        }
+        log_sink_added_ = false;
+    }
 
     // 清理 IMGUI（如果还没有清理）
     CleanupImGui();
@@ -234,6 +319,8 @@ void CameraScannerUI::Cleanup() {
 }
 
 void CameraScannerUI::RenderUI() {
+    PullLogRecords();
+
     // 主窗口 - 使用 DockSpace
     static ImGuiDockNodeFlags dockspace_flags = ImGuiDockNodeFlags_None;
     ImGuiWindowFlags window_flags = ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoDocking;
@@ -263,6 +350,7 @@ void CameraScannerUI::RenderUI() {
             ImGui::MenuItem("控制面板", nullptr, &show_control_panel_);
             ImGui::MenuItem("状态面板", nullptr, &show_status_panel_);
             ImGui::MenuItem("数据面板", nullptr, &show_data_panel_);
+            ImGui::MenuItem("性能面板", nullptr, &show_perf_hud_);
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("帮助")) {
@@ -277,6 +365,9 @@ void CameraScannerUI::RenderUI() {
     // 显示导航面板和内容页面
     ShowTreeView();
     ShowMainView();
+    if (show_perf_hud_) {
+        ShowPerfHud();
+    }
 
     ImGui::End();
 }
@@ -352,13 +443,17 @@ void CameraScannerUI::ShowMainView() {
         case 0:  // 扫描功能
             ShowControlPanel();
             ImGui::Separator();
+            ShowLivePreview();
             ShowStatusPanel();
             break;
         case 1:  // 结果查询
-            ShowDataPanel();
+            if (ImGui::CollapsingHeader("当前扫描", ImGuiTreeNodeFlags_DefaultOpen)) {
+                ShowDataPanel();
+            }
+            ShowHistoryTable();
             break;
         case 2:  // 图标查询
-            ImGui::Text("图标查询功能待实现");
+            ShowHistoryIcons();
             break;
         default:
             ShowControlPanel();
@@ -386,47 +481,50 @@ void CameraScannerUI::ShowControlPanel() {
 
     ImGui::Separator();
 
-    // 状态显示
+    // 状态显示（本帧内按同一份快照判断）
+    const ScannerState scanner_state = command_executor_.State();
     ImGui::Text("当前状态:");
     ImGui::SameLine();
     ImGui::PushStyleColor(ImGuiCol_Text, 
-        scanner_state_ == ScannerState::ERROR_STATE ? ImVec4(1.0f, 0.0f, 0.0f, 1.0f) :
-        scanner_state_ == ScannerState::SCANNING ? ImVec4(0.0f, 1.0f, 0.0f, 1.0f) :
-        scanner_state_ == ScannerState::CONNECTED ? ImVec4(0.0f, 0.8f, 1.0f, 1.0f) :
+        scanner_state == ScannerState::ERROR_STATE ? ImVec4(1.0f, 0.0f, 0.0f, 1.0f) :
+        scanner_state == ScannerState::SCANNING ? ImVec4(0.0f, 1.0f, 0.0f, 1.0f) :
+        scanner_state == ScannerState::CONNECTED ? ImVec4(0.0f, 0.8f, 1.0f, 1.0f) :
         ImVec4(1.0f, 1.0f, 1.0f, 1.0f));
     ImGui::Text("%s", GetStateText());
     ImGui::PopStyleColor();
+    ImGui::TextDisabled("界面帧耗时: %.2f ms  帧间隔: %.1f ms%s", frame_time_ms_, frame_interval_ms_,
+                        IsBusy() ? "（限帧）" : "");
     
     ImGui::Separator();
 
     // 控制按钮 - 第一行
-    ImGui::BeginDisabled(scanner_state_ != ScannerState::IDLE);
+    ImGui::BeginDisabled(scanner_state != ScannerState::IDLE);
     if (ImGui::Button("初始化", ImVec2(-1, 35))) {
         InitScanner();
     }
     ImGui::EndDisabled();
 
-    ImGui::BeginDisabled(scanner_state_ != ScannerState::IDLE);
+    ImGui::BeginDisabled(scanner_state != ScannerState::IDLE);
     if (ImGui::Button("连接", ImVec2(-1, 35))) {
         ConnectScanner();
     }
     ImGui::EndDisabled();
 
     // 第二行
-    ImGui::BeginDisabled(scanner_state_ != ScannerState::CONNECTED);
+    ImGui::BeginDisabled(scanner_state != ScannerState::CONNECTED);
     if (ImGui::Button("开始扫描", ImVec2(-1, 35))) {
         StartScan();
     }
     ImGui::EndDisabled();
 
-    ImGui::BeginDisabled(scanner_state_ != ScannerState::SCANNING);
+    ImGui::BeginDisabled(scanner_state != ScannerState::SCANNING);
     if (ImGui::Button("停止扫描", ImVec2(-1, 35))) {
         StopScan();
     }
     ImGui::EndDisabled();
 
     // 第三行
-    ImGui::BeginDisabled(scanner_state_ == ScannerState::IDLE);
+    ImGui::BeginDisabled(scanner_state == ScannerState::IDLE);
     if (ImGui::Button("断开连接", ImVec2(-1, 35))) {
         DisconnectScanner();
     }
@@ -440,20 +538,37 @@ void CameraScannerUI::ShowStatusPanel() {
     ImGui::Checkbox("自动换行", &log_auto_wrap_);
     ImGui::SameLine();
     if (ImGui::Button("清除LOG")) {
-        std::lock_guard<std::mutex> lock(log_mutex_);
-        log_messages_.clear();
+        log_view_begin_ = log_view_end_;
     }
+    // 级别开关直接作用于写入端，关闭的级别不再进入缓冲
     ImGui::SameLine();
-    ImGui::Checkbox("Info", &log_show_info_);
+    if (ImGui::Checkbox("Info", &log_show_info_)) {
+        log_ring_.SetSeverityEnabled(google::GLOG_INFO, log_show_info_);
+    }
     ImGui::SameLine();
-    ImGui::Checkbox("Warning", &log_show_warning_);
+    if (ImGui::Checkbox("Warning", &log_show_warning_)) {
+        log_ring_.SetSeverityEnabled(google::GLOG_WARNING, log_show_warning_);
+    }
     ImGui::SameLine();
-    ImGui::Checkbox("Error", &log_show_error_);
+    if (ImGui::Checkbox("Error", &log_show_error_)) {
+        log_ring_.SetSeverityEnabled(google::GLOG_ERROR, log_show_error_);
+        log_ring_.SetSeverityEnabled(google::GLOG_FATAL, log_show_error_);
+    }
+    if (log_lost_ > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("丢弃: %llu", (unsigned long long)log_lost_);
+    }
+    if (log_sink_async_) {
+        const AsyncLogStats log_stats = GetAsyncLogStats();
+        if (log_stats.dropped > 0) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("日志队列溢出: %llu", (unsigned long long)log_stats.dropped);
+        }
+    }
     
     ImGui::Separator();
     
     // 显示日志消息
-    std::lock_guard<std::mutex> lock(log_mutex_);
     ImGui::BeginChild("LogMessages", ImVec2(0, 0), true, 
         log_auto_wrap_ ? ImGuiWindowFlags_HorizontalScrollbar : ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_AlwaysVerticalScrollbar);
     
@@ -465,8 +580,53 @@ void CameraScannerUI::ShowStatusPanel() {
         }
     }
     
-    for (const auto& msg : log_messages_) {
-        ImGui::TextWrapped("%s", msg.c_str());
+    // 只画可见的行
+    const uint64_t count = log_view_end_ - log_view_begin_;
+    if (!log_auto_wrap_) {
+        log_wrap_width_ = 0.0f;
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(count));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                DrawLogRow(static_cast<uint64_t>(i));
+            }
+        }
+        clipper.End();
+    } else {
+        // 换行后行高不一，按缓存的行高累加定位可见范围；宽度变化时整体重算
+        const size_t capacity = log_view_.size();
+        const float wrap_width = std::max(1.0f, ImGui::GetContentRegionAvail().x);
+        const float spacing = ImGui::GetStyle().ItemSpacing.y;
+        if (wrap_width != log_wrap_width_) {
+            log_wrap_width_ = wrap_width;
+            for (uint64_t i = log_view_begin_; i < log_view_end_; ++i) {
+                const LogRecord& record = log_view_[i % capacity];
+                log_row_heights_[i % capacity] =
+                    ImGui::CalcTextSize(record.text, record.text + record.length, false, wrap_width).y + spacing;
+            }
+        }
+        log_row_offsets_.resize(count + 1);
+        log_row_offsets_[0] = 0.0f;
+        for (uint64_t i = 0; i < count; ++i) {
+            log_row_offsets_[i + 1] = log_row_offsets_[i] + log_row_heights_[(log_view_begin_ + i) % capacity];
+        }
+        const float base_y = ImGui::GetCursorPosY();
+        const float view_top = ImGui::GetScrollY() - base_y;
+        const float view_bottom = view_top + ImGui::GetWindowHeight();
+        uint64_t first = static_cast<uint64_t>(
+            std::upper_bound(log_row_offsets_.begin(), log_row_offsets_.end(), view_top) - log_row_offsets_.begin());
+        first = first > 0 ? first - 1 : 0;
+        ImGui::SetCursorPosY(base_y + log_row_offsets_[first]);
+        ImGui::PushTextWrapPos(0.0f);
+        for (uint64_t i = first; i < count && log_row_offsets_[i] < view_bottom; ++i) {
+            DrawLogRow(i);
+        }
+        ImGui::PopTextWrapPos();
+        if (count > 0) {
+            // 占住整体高度，保证滚动条范围正确
+            ImGui::SetCursorPosY(base_y + log_row_offsets_[count] - spacing);
+            ImGui::Dummy(ImVec2(0.0f, 0.0f));
+        }
     }
     
     // 自动滚动到底部
@@ -477,245 +637,1043 @@ void CameraScannerUI::ShowStatusPanel() {
     ImGui::EndChild();
 }
 
-void CameraScannerUI::AddLogMessage(const std::string& message) {
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    // 获取当前时间
-    time_t rawtime;
-    struct tm* timeinfo;
-    char buffer[100];
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    strftime(buffer, sizeof(buffer), "[%H:%M:%S] ", timeinfo);
-    
-    log_messages_.push_back(std::string(buffer) + message);
-    
-    // 限制日志消息数量，避免内存过多占用
-    if (log_messages_.size() > 1000) {
-        log_messages_.erase(log_messages_.begin(), log_messages_.begin() + 500);
+void CameraScannerUI::DrawLogRow(uint64_t i) {
+    const LogRecord& record = log_view_[(log_view_begin_ + i) % log_view_.size()];
+    const bool colored = record.severity >= google::GLOG_WARNING;
+    if (colored) {
+        ImGui::PushStyleColor(ImGuiCol_Text, record.severity >= google::GLOG_ERROR ? ImVec4(1.0f, 0.35f, 0.35f, 1.0f)
+                                                                                   : ImVec4(1.0f, 0.8f, 0.2f, 1.0f));
+    }
+    ImGui::TextUnformatted(record.text, record.text + record.length);
+    if (colored) {
+        ImGui::PopStyleColor();
     }
 }
 
+void CameraScannerUI::PullLogRecords() {
+    const size_t capacity = log_ring_.Capacity();
+    if (log_view_.size() != capacity) {
+        log_view_.resize(capacity);
+        log_row_heights_.assign(capacity, 0.0f);
+    }
+    const uint64_t end = log_ring_.WritePosition();
+    if (end - log_read_pos_ > capacity) {
+        // 落后超过一整圈，直接跳到缓冲中最旧的记录
+        log_lost_ += end - capacity - log_read_pos_;
+        log_read_pos_ = end - capacity;
+    }
+    LogRecord record;
+    while (log_read_pos_ < end) {
+        LogRing::ReadResult result = log_ring_.Read(log_read_pos_, record);
+        if (result == LogRing::kReadPending) {
+            // 通常下一帧就写完了；写入被放弃的序号不会再完成，等一阵后跳过
+            if (++log_pending_frames_ < 30) {
+                break;
+            }
+            result = LogRing::kReadLost;
+        }
+        log_pending_frames_ = 0;
+        log_read_pos_++;
+        if (result == LogRing::kReadLost) {
+            log_lost_++;
+            continue;
+        }
+        const size_t slot = log_view_end_ % capacity;
+        log_view_[slot] = record;
+        if (log_wrap_width_ > 0.0f) {
+            log_row_heights_[slot] = ImGui::CalcTextSize(record.text, record.text + record.length, false, log_wrap_width_).y
+                + ImGui::GetStyle().ItemSpacing.y;
+        }
+        log_view_end_++;
+        if (log_view_end_ - log_view_begin_ > capacity) {
+            log_view_begin_++;
+        }
+    }
+}
+
+void CameraScannerUI::AddLogMessage(const std::string& message, int severity) {
+    log_ring_.Push(severity, nullptr, message.data(), message.size());
+    RequestRedraw();
+}
+
+// 扫描历史下拉框中的一项
+static std::string ScanLabel(const ScanSnapshot& scan) {
+    char time_text[32] = "";
+    const time_t capture_time = scan.capture_time;
+    const struct tm* timeinfo = localtime(&capture_time);
+    if (timeinfo != nullptr) {
+        strftime(time_text, sizeof(time_text), "%H:%M:%S", timeinfo);
+    }
+    char label[96];
+    snprintf(label, sizeof(label), "#%llu  %s  配方 %d  %.1f 万点", (unsigned long long)scan.id, time_text, scan.recipe_id,
+             scan.PointCount() / 10000.0);
+    return label;
+}
+
 void CameraScannerUI::ShowDataPanel() {
     ImGui::Text("扫描数据信息");
     ImGui::Separator();
 
-    std::lock_guard<std::mutex> lock(data_mutex_);
+    // 本帧只取一次快照引用，之后全部读取都不加锁；选中的扫描已被挤出历史时回到最新一次
+    ScanSnapshotPtr snapshot = viewed_scan_id_ != 0 ? scan_store_.Find(viewed_scan_id_) : nullptr;
+    if (!snapshot) {
+        viewed_scan_id_ = 0;
+        snapshot = scan_store_.Latest();
+    }
+    const std::shared_ptr<const ScanHistory> history = scan_store_.History();
+    if (snapshot && history->scans.size() > 1) {
+        const std::string current = ScanLabel(*snapshot) + (viewed_scan_id_ == 0 ? "（最新）" : "");
+        if (ImGui::BeginCombo("显示扫描", current.c_str())) {
+            for (size_t i = 0; i < history->scans.size(); ++i) {
+                const ScanSnapshot& scan = *history->scans[i];
+                const bool selected = scan.id == snapshot->id;
+                if (ImGui::Selectable(ScanLabel(scan).c_str(), selected)) {
+                    viewed_scan_id_ = i == 0 ? 0 : scan.id;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Separator();
+    }
+
+    // 扫描中显示实时统计，否则显示所选扫描的结果
+    ScanStatistics stats;
+    uint64_t stats_scan_id = 0;
+    if (command_executor_.State() == ScannerState::SCANNING && scanner_api_) {
+        scanner_api_->GetScanStatistics(stats);
+    } else if (snapshot) {
+        stats = snapshot->statistics;
+        stats_scan_id = snapshot->id;
+    }
+
+    if (stats.batch_count > 0) {
+        ImGui::Text("扫描统计%s", stats.finalized ? "" : "（实时）");
+        ImGui::Indent();
+        ImGui::Text("行数: %llu  批次: %llu", (unsigned long long)stats.line_count, (unsigned long long)stats.batch_count);
+        ImGui::Text("有效点: %llu / %llu (%.1f%%)", (unsigned long long)stats.valid_points,
+                    (unsigned long long)stats.total_points, stats.ValidRatio() * 100.0);
+        ImGui::Text("Z 范围: %.3f ~ %.3f  均值: %.3f", stats.min_z, stats.max_z, stats.MeanZ());
+        ImGui::Text("编码器: %d -> %d  跨度: %lld", stats.encoder_first, stats.encoder_last, (long long)stats.EncoderSpan());
+
+        // 同一次扫描的批次数不变时直方图不变，不重复转换和抽取
+        const uint64_t hist_version = ((stats_scan_id << 40) + stats.batch_count) * 2 + (stats.finalized ? 1 : 0);
+        if (gray_hist_.size() != 256 || hist_version != gray_hist_version_) {
+            gray_hist_.resize(256);
+            gray_hist_max_ = 0.0f;
+            for (int b = 0; b < 256; ++b) {
+                gray_hist_[b] = static_cast<float>(stats.gray_histogram[b]);
+                gray_hist_max_ = std::max(gray_hist_max_, gray_hist_[b]);
+            }
+            gray_hist_version_ = hist_version;
+        }
+        gray_hist_plot_.Plot("##gray_hist", gray_hist_.data(), 256, gray_hist_version_, 0.0f, gray_hist_max_,
+                             ImVec2(-1, 80), "灰度直方图");
+        if (scanner_api_ && scanner_api_->IsProfileFeatureEnabled()) {
+            ImGui::Text("轮廓边缘: %llu", (unsigned long long)live_feature_count_.load());
+        }
+        ImGui::Unindent();
+        ImGui::Separator();
+    }
+
+    if (scanner_api_ && scanner_api_->IsGoldenCompareEnabled()) {
+        ImGui::Text("基准比对");
+        ImGui::Indent();
+        ImGui::SetNextItemWidth(120);
+        ImGui::InputInt("配方 ID", &recipe_id_);
+        ImGui::BeginDisabled(command_executor_.State() != ScannerState::CONNECTED);
+        if (ImGui::Button("设为基准扫描")) {
+            // 栅格化整幅扫描较慢，放到命令线程，执行时仍须处于已连接状态
+            const int recipe_id = recipe_id_;
+            command_executor_.PostTask(ScannerState::CONNECTED, [this, recipe_id](const std::atomic<bool>&) {
+                scanner_api_->SetRecipeId(recipe_id);
+                int result = scanner_api_->CaptureGoldenReference();
+                AddLogMessage(result == 0 ? "配方 " + std::to_string(recipe_id) + " 基准扫描已保存"
+                                          : "基准扫描保存失败，错误代码: " + std::to_string(result),
+                              result == 0 ? google::GLOG_INFO : google::GLOG_ERROR);
+                return result;
+            });
+        }
+        ImGui::EndDisabled();
+        if (snapshot && snapshot->golden_result.valid) {
+            const GoldenCompareResult& golden_result = snapshot->golden_result;
+            ImGui::Text("配方 %d  偏移(行|列): %d | %d  耗时: %.1f ms", golden_result.recipe_id,
+                        golden_result.offset_row, golden_result.offset_col, golden_result.elapsed_ms);
+            ImGui::Text("偏差均值: %.4f  RMS: %.4f", golden_result.mean_deviation, golden_result.rms_deviation);
+            ImGui::Text("合格: %llu  警告: %llu  超差: %llu", (unsigned long long)golden_result.ok_cells,
+                        (unsigned long long)golden_result.warn_cells, (unsigned long long)golden_result.fail_cells);
+        } else {
+            ImGui::Text("无比对结果");
+        }
+        ImGui::Unindent();
+        ImGui::Separator();
+    }
+
+    if (!snapshot) {
+        ImGui::Text("暂无数据");
+        return;
+    }
+    const ScanSnapshot& scan = *snapshot;
+
+    if (scanner_api_ && scanner_api_->IsMeasurementEnabled() && !scan.measurements.empty()) {
+        ImGui::Text("体积/面积测量");
+        ImGui::Indent();
+        for (size_t i = 0; i < scan.measurements.size(); ++i) {
+            const MeasurementResult& measurement = scan.measurements[i];
+            if (!measurement.valid) {
+                continue;
+            }
+            ImGui::Text("相机 %zu  耗时: %.1f ms", i, measurement.elapsed_ms);
+            for (const auto& region : measurement.regions) {
+                ImGui::Text("  [%s] 体积: %.3f mm3  面积: %.3f mm2  最大高度: %.3f", region.name.c_str(),
+                            region.volume, region.area, region.max_height);
+                std::string percentile_text = "    高度分位:";
+                for (size_t k = 0; k < region.percentile_heights.size() && k < measurement.percentiles.size(); ++k) {
+                    char item[64];
+                    snprintf(item, sizeof(item), " P%.0f=%.3f", measurement.percentiles[k], region.percentile_heights[k]);
+                    percentile_text += item;
+                }
+                ImGui::TextUnformatted(percentile_text.c_str());
+            }
+        }
+        ImGui::Unindent();
+        ImGui::Separator();
+    }
     
-    if (point_clouds_.empty()) {
+    if (!scan.point_indices.empty()) {
+        ImGui::Text("高度拾取");
+        ImGui::Indent();
+        ImGui::InputFloat2("X / Y (mm)", pick_xy_, "%.3f");
+        ImGui::InputFloat("搜索半径 (mm)", &pick_radius_, 0.1f, 1.0f, "%.2f");
+        for (size_t i = 0; i < scan.point_indices.size(); ++i) {
+            if (scan.point_indices[i].Empty()) {
+                ImGui::Text("相机 %zu: 无序点云，不支持拾取", i);
+                continue;
+            }
+            float dist = 0.0f;
+            const int64_t index = scan.point_indices[i].Nearest(pick_xy_[0], pick_xy_[1], pick_radius_, &dist);
+            if (index < 0) {
+                ImGui::Text("相机 %zu: 半径内无有效点", i);
+            } else {
+                const cv::Point3f& p = scan.point_indices[i].Points()[index];
+                ImGui::Text("相机 %zu: Z = %.4f  (行 %lld 列 %lld, 距离 %.3f)", i, p.z,
+                            (long long)(index / kDefaultDataWidth), (long long)(index % kDefaultDataWidth), dist);
+                if (i < scan.packed_normals.size() && index < static_cast<int64_t>(scan.packed_normals[i].size())
+                    && scan.packed_normals[i][index] != kNoPackedNormal) {
+                    const cv::Point3f n = UnpackNormal(scan.packed_normals[i][index]);
+                    const double tilt = std::acos(std::min(1.0f, std::fabs(n.z))) * 180.0 / CV_PI;
+                    ImGui::Text("    法向量: (%.3f, %.3f, %.3f)  倾角: %.2f 度", n.x, n.y, n.z, tilt);
+                }
+            }
+        }
+        ImGui::Unindent();
+        ImGui::Separator();
+    }
+    
+    if (scan.point_clouds.empty()) {
         ImGui::Text("暂无数据");
     } else {
-        ImGui::Text("相机数量: %zu", point_clouds_.size());
+        ImGui::Text("相机数量: %zu", scan.point_clouds.size());
         
-        for (size_t i = 0; i < point_clouds_.size(); ++i) {
+        for (size_t i = 0; i < scan.point_clouds.size(); ++i) {
             ImGui::Text("相机 %zu:", i);
             ImGui::Indent();
-            ImGui::Text("  点云数量: %zu", point_clouds_[i].size());
-            ImGui::Text("  灰度图像大小: %zu", gray_images_[i].size());
-            ImGui::Text("  编码器值数量: %zu", encoder_values_[i].size());
-            ImGui::Text("  帧计数数量: %zu", frame_counts_[i].size());
+            ImGui::Text("  点云数量: %zu", scan.point_clouds[i].size());
+            if (i < scan.preview_clouds.size()) {
+                ImGui::Text("  预览点数: %zu", scan.preview_clouds[i].size());
+            }
+            ImGui::Text("  灰度图像大小: %zu", scan.gray_images[i].size());
+            ImGui::Text("  编码器值数量: %zu", scan.encoder_values[i].size());
+            ImGui::Text("  帧计数数量: %zu", scan.frame_counts[i].size());
             ImGui::Unindent();
         }
     }
 }
 
+void CameraScannerUI::ShowLivePreview() {
+    if (!scanner_api_) {
+        return;
+    }
+    const bool live_enabled = scanner_api_->IsLivePreviewEnabled();
+    const bool overview_enabled = scanner_api_->IsPreviewPyramidEnabled();
+    if (!live_enabled && !overview_enabled) {
+        return;
+    }
+    // 每帧只取新数据，采集回调从不等待 UI
+    if (command_executor_.State() == ScannerState::SCANNING) {
+        if (live_enabled) {
+            scanner_api_->FetchLiveProfile(live_profile_);
+        }
+        if (live_auto_range_) {
+            ScanStatistics stats;
+            scanner_api_->GetScanStatistics(stats);
+            if (stats.valid_points > 0 && stats.max_z > stats.min_z) {
+                live_z_range_[0] = stats.min_z;
+                live_z_range_[1] = stats.max_z;
+            }
+        }
+        if (live_enabled) {
+            UpdateLivePreviewTexture();
+        }
+        if (overview_enabled) {
+            UpdateOverviewTexture();
+        }
+    }
+    if (live_profile_.z.empty() && live_height_tex_ == 0 && overview_tex_ == 0) {
+        return;
+    }
+
+    ImGui::Text("实时预览");
+    ImGui::Indent();
+    ImGui::Checkbox("自动高度范围", &live_auto_range_);
+    ImGui::SameLine();
+    ImGui::BeginDisabled(live_auto_range_);
+    ImGui::InputFloat2("高度范围 (mm)", live_z_range_, "%.2f");
+    ImGui::EndDisabled();
+
+    if (!live_profile_.z.empty()) {
+        char overlay[96];
+        snprintf(overlay, sizeof(overlay), "行 %llu  编码器 %d", (unsigned long long)live_profile_.line, live_profile_.encoder);
+        live_profile_plot_.Plot("##live_profile", live_profile_.z.data(), static_cast<int>(live_profile_.z.size()),
+                                live_profile_.line, live_z_range_[0], live_z_range_[1], ImVec2(-1, 120), overlay);
+    }
+
+    if (live_height_tex_ != 0 && live_tex_width_ > 0) {
+        // 最旧的行在上、最新的行在下：纹理是环形的，分两段绘制
+        const float width = ImGui::GetContentRegionAvail().x;
+        const float height = std::min(width * live_tex_rows_ / live_tex_width_, 300.0f);
+        const float head = static_cast<float>(live_tex_head_) / live_tex_rows_;
+        const ImTextureID tex = (ImTextureID)(intptr_t)live_height_tex_;
+        ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
+        if (live_tex_wrapped_ && live_tex_head_ > 0) {
+            ImGui::Image(tex, ImVec2(width, height * (1.0f - head)), ImVec2(0.0f, head), ImVec2(1.0f, 1.0f));
+            ImGui::Image(tex, ImVec2(width, height * head), ImVec2(0.0f, 0.0f), ImVec2(1.0f, head));
+        } else {
+            ImGui::Image(tex, ImVec2(width, height), ImVec2(0.0f, 0.0f), ImVec2(1.0f, 1.0f));
+        }
+        ImGui::PopStyleVar();
+        const uint64_t dropped = scanner_api_->GetLivePreviewDroppedRows();
+        if (dropped > 0) {
+            ImGui::TextDisabled("预览丢弃行数: %llu", (unsigned long long)dropped);
+        }
+    }
+
+    if (overview_tex_ != 0 && overview_tex_width_ > 0) {
+        // 从扫描开始到现在的全部行，按 1/2^level 分辨率显示
+        ImGui::Text("整体预览 (1/%d)", 1 << overview_level_);
+        const float width = ImGui::GetContentRegionAvail().x;
+        const float height = std::min(width * overview_tex_rows_ / overview_tex_width_, 300.0f);
+        ImGui::Image((ImTextureID)(intptr_t)overview_tex_, ImVec2(width, height));
+    }
+    ImGui::Unindent();
+    ImGui::Separator();
+}
+
+// 高度 -> 8 位 -> 伪彩色，无效点为黑色；rgba 已按 z 的尺寸分配时直接写入
+static void ColorizeHeight(const cv::Mat& z, float z_low, float z_high, cv::Mat& rgba) {
+    const float z_span = std::max(z_high - z_low, 1e-3f);
+    cv::Mat z_u8;
+    z.convertTo(z_u8, CV_8UC1, 255.0 / z_span, -z_low * 255.0 / z_span);
+    cv::Mat color;
+    cv::applyColorMap(z_u8, color, cv::COLORMAP_JET);
+    cv::cvtColor(color, rgba, cv::COLOR_BGR2RGBA);
+    rgba.setTo(cv::Scalar(0, 0, 0, 255), z <= kInvalidZThreshold);
+}
+
+void CameraScannerUI::UpdateLivePreviewTexture() {
+    const int width = scanner_api_->GetLivePreviewWidth();
+    if (width <= 0) {
+        return;
+    }
+    if (live_height_tex_ == 0 || width != live_tex_width_) {
+        ReleaseLivePreviewTexture();
+        live_tex_width_ = width;
+        live_rgba_.assign(size_t(live_tex_width_) * live_tex_rows_ * 4, 0);
+        glGenTextures(1, &live_height_tex_);
+        glBindTexture(GL_TEXTURE_2D, live_height_tex_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        // 只在这里分配一次，之后都是子区域更新
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, live_tex_width_, live_tex_rows_, 0, GL_RGBA, GL_UNSIGNED_BYTE, live_rgba_.data());
+        live_tex_head_ = 0;
+        live_tex_wrapped_ = false;
+    }
+
+    const int num = scanner_api_->PopLivePreviewRows(live_rows_, live_tex_rows_);
+    if (num <= 0) {
+        return;
+    }
+    cv::Mat rows_z(num, live_tex_width_, CV_32FC1, live_rows_.data());
+    cv::Mat rows_rgba(num, live_tex_width_, CV_8UC4, live_rgba_.data());
+    ColorizeHeight(rows_z, live_z_range_[0], live_z_range_[1], rows_rgba);
+
+    glBindTexture(GL_TEXTURE_2D, live_height_tex_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int uploaded = 0;
+    while (uploaded < num) {
+        const int count = std::min(num - uploaded, live_tex_rows_ - live_tex_head_);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, live_tex_head_, live_tex_width_, count, GL_RGBA, GL_UNSIGNED_BYTE,
+                        live_rgba_.data() + size_t(uploaded) * live_tex_width_ * 4);
+        uploaded += count;
+        live_tex_head_ += count;
+        if (live_tex_head_ == live_tex_rows_) {
+            live_tex_head_ = 0;
+            live_tex_wrapped_ = true;
+        }
+    }
+}
+
+void CameraScannerUI::UpdateOverviewTexture() {
+    // 最粗一层只有全分辨率的 1/4^level，但整幅复制和上传也不必每帧做
+    const double now = glfwGetTime();
+    if (overview_tex_ != 0 && now - overview_last_update_ < 0.5) {
+        return;
+    }
+    overview_last_update_ = now;
+    const int level = scanner_api_->GetPreviewLevelCount();
+    cv::Mat level_z, level_gray;
+    if (scanner_api_->GetPreviewLevel(level, level_z, level_gray) != 0) {
+        return;
+    }
+    // 很长的扫描按行抽取，纹理高度不超过 GL 的常见上限；最近邻，不把无效点混进有效值
+    constexpr int kMaxOverviewRows = 4096;
+    if (level_z.rows > kMaxOverviewRows) {
+        cv::resize(level_z, level_z, cv::Size(level_z.cols, kMaxOverviewRows), 0, 0, cv::INTER_NEAREST);
+    }
+    cv::Mat rgba;
+    ColorizeHeight(level_z, live_z_range_[0], live_z_range_[1], rgba);
+
+    if (overview_tex_ == 0) {
+        glGenTextures(1, &overview_tex_);
+        glBindTexture(GL_TEXTURE_2D, overview_tex_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_2D, overview_tex_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // 行数随扫描增长，每次整幅重新分配
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, rgba.cols, rgba.rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data);
+    overview_tex_width_ = rgba.cols;
+    overview_tex_rows_ = rgba.rows;
+    overview_level_ = level;
+}
+
+void CameraScannerUI::ClearLivePreview() {
+    live_profile_ = LiveProfile();
+    live_profile_plot_.Invalidate();
+    if (live_height_tex_ != 0) {
+        std::fill(live_rgba_.begin(), live_rgba_.end(), 0);
+        glBindTexture(GL_TEXTURE_2D, live_height_tex_);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, live_tex_width_, live_tex_rows_, GL_RGBA, GL_UNSIGNED_BYTE, live_rgba_.data());
+    }
+    live_tex_head_ = 0;
+    live_tex_wrapped_ = false;
+    // 上一次扫描的整体预览不再显示，新扫描第一帧有数据时重建
+    if (overview_tex_ != 0) {
+        glDeleteTextures(1, &overview_tex_);
+        overview_tex_ = 0;
+    }
+    overview_tex_width_ = 0;
+    overview_tex_rows_ = 0;
+}
+
+void CameraScannerUI::ReleaseLivePreviewTexture() {
+    if (live_height_tex_ != 0) {
+        glDeleteTextures(1, &live_height_tex_);
+        live_height_tex_ = 0;
+    }
+    live_tex_width_ = 0;
+}
+
+// 同时保留的缩略图纹理数，超出后释放最久没画的
+static constexpr size_t kMaxHistoryThumbs = 256;
+
+static std::string HistoryTimeText(int64_t capture_time, const char* format = "%Y-%m-%d %H:%M:%S") {
+    time_t rawtime = static_cast<time_t>(capture_time);
+    struct tm* timeinfo = localtime(&rawtime);
+    char buffer[64] = "-";
+    if (capture_time > 0 && timeinfo) {
+        strftime(buffer, sizeof(buffer), format, timeinfo);
+    }
+    return buffer;
+}
+
+void CameraScannerUI::ShowHistoryToolbar() {
+    // 初始化前先浏览默认保存目录，初始化时再换到配置的 data_root_path
+    if (!history_opened_) {
+        history_opened_ = true;
+        if (!scan_history_.IsOpen()) {
+            scan_history_.Open("./scan_data/");
+        }
+    }
+    const std::string dir = scan_history_.Directory();
+    if (dir != history_thumbs_dir_) {
+        ReleaseHistoryThumbnails();
+        history_thumbs_dir_ = dir;
+        history_selected_.clear();
+    }
+    history_frame_++;
+    history_loads_left_ = 8;
+    if (history_thumbs_.size() > kMaxHistoryThumbs) {
+        // 留出余量，避免滚动时每帧都在释放和重建
+        std::vector<std::pair<uint64_t, uint64_t>> by_age;
+        by_age.reserve(history_thumbs_.size());
+        for (const auto& item : history_thumbs_) {
+            by_age.emplace_back(item.second.last_used, item.first);
+        }
+        const size_t evict = history_thumbs_.size() - kMaxHistoryThumbs * 3 / 4;
+        std::nth_element(by_age.begin(), by_age.begin() + evict, by_age.end());
+        for (size_t i = 0; i < evict; ++i) {
+            auto it = history_thumbs_.find(by_age[i].second);
+            if (it->second.tex != 0) {
+                glDeleteTextures(1, &it->second.tex);
+            }
+            history_thumbs_.erase(it);
+        }
+    }
+
+    ImGui::Text("历史扫描: %zu 次", scan_history_.Size());
+    ImGui::SameLine();
+    ImGui::TextDisabled("%s", dir.empty() ? "（索引未打开）" : dir.c_str());
+    const size_t pending = scan_history_.PendingTasks();
+    if (pending > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("后台任务: %zu", pending);
+    }
+    ImGui::SameLine();
+    if (ImGui::SmallButton("刷新")) {
+        scan_history_.Rescan();
+    }
+    if (!history_selected_.empty()) {
+        ImGui::Text("选中: %s", history_selected_.c_str());
+    }
+}
+
+void CameraScannerUI::ShowHistoryTable() {
+    ShowHistoryToolbar();
+    const float thumb_h = 48.0f;
+    const float thumb_w = thumb_h * kScanThumbWidth / kScanThumbHeight;
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+    if (!ImGui::BeginTable("scan_history", 7, flags, ImVec2(0, 0))) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("缩略图", ImGuiTableColumnFlags_WidthFixed, thumb_w);
+    ImGui::TableSetupColumn("扫描时间");
+    ImGui::TableSetupColumn("配方");
+    ImGui::TableSetupColumn("相机数");
+    ImGui::TableSetupColumn("点数");
+    ImGui::TableSetupColumn("有效点比例");
+    ImGui::TableSetupColumn("高度范围");
+    ImGui::TableHeadersRow();
+
+    // 只取可见行的记录和缩略图
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(scan_history_.Size()), thumb_h + ImGui::GetStyle().CellPadding.y * 2.0f);
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            ScanIndexEntry entry;
+            if (!scan_history_.Get(static_cast<size_t>(i), entry)) {
+                continue;
+            }
+            const std::string stem = entry.Stem();
+            ImGui::PushID(i);
+            ImGui::TableNextRow(0, thumb_h);
+            ImGui::TableNextColumn();
+            const GLuint tex = GetHistoryThumbnail(entry);
+            if (tex != 0) {
+                ImGui::Image((ImTextureID)(intptr_t)tex, ImVec2(thumb_w, thumb_h));
+            } else {
+                ImGui::Dummy(ImVec2(thumb_w, thumb_h));
+            }
+            ImGui::TableNextColumn();
+            if (ImGui::Selectable(HistoryTimeText(entry.capture_time).c_str(), stem == history_selected_,
+                                  ImGuiSelectableFlags_SpanAllColumns, ImVec2(0, thumb_h))) {
+                history_selected_ = stem;
+            }
+            if (ImGui::IsItemHovered()) {
+                ShowHistoryTooltip(entry);
+            }
+            ImGui::TableNextColumn();
+            if (entry.recipe_id >= 0) {
+                ImGui::Text("%d", entry.recipe_id);
+            } else {
+                ImGui::TextDisabled("-");
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", entry.scanner_count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(entry.point_count));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f%%", entry.valid_ratio * 100.0f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f ~ %.3f", entry.min_z, entry.max_z);
+            ImGui::PopID();
+        }
+    }
+    clipper.End();
+    ImGui::EndTable();
+}
+
+void CameraScannerUI::ShowHistoryIcons() {
+    ShowHistoryToolbar();
+    ImGui::PushItemWidth(160.0f);
+    ImGui::SliderFloat("图标大小", &history_icon_size_, 64.0f, 256.0f, "%.0f");
+    ImGui::PopItemWidth();
+
+    ImGui::BeginChild("HistoryIcons", ImVec2(0, 0), true);
+    const ImGuiStyle& style = ImGui::GetStyle();
+    const float icon_w = history_icon_size_;
+    const float icon_h = icon_w * kScanThumbHeight / kScanThumbWidth;
+    const int columns = std::max(1, static_cast<int>((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) / (icon_w + style.ItemSpacing.x)));
+    const int count = static_cast<int>(scan_history_.Size());
+    const int rows = (count + columns - 1) / columns;
+
+    // 按行裁剪，只画可见行的图标
+    ImGuiListClipper clipper;
+    clipper.Begin(rows, icon_h + ImGui::GetTextLineHeightWithSpacing() + style.ItemSpacing.y);
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            for (int col = 0; col < columns; ++col) {
+                const int i = row * columns + col;
+                ScanIndexEntry entry;
+                if (i >= count || !scan_history_.Get(static_cast<size_t>(i), entry)) {
+                    break;
+                }
+                const std::string stem = entry.Stem();
+                if (col > 0) {
+                    ImGui::SameLine();
+                }
+                ImGui::PushID(i);
+                ImGui::BeginGroup();
+                const ImVec2 pos = ImGui::GetCursorScreenPos();
+                ImDrawList* draw_list = ImGui::GetWindowDrawList();
+                const GLuint tex = GetHistoryThumbnail(entry);
+                if (tex != 0) {
+                    ImGui::Image((ImTextureID)(intptr_t)tex, ImVec2(icon_w, icon_h));
+                } else {
+                    ImGui::Dummy(ImVec2(icon_w, icon_h));
+                    draw_list->AddRectFilled(pos, ImVec2(pos.x + icon_w, pos.y + icon_h), ImGui::GetColorU32(ImGuiCol_FrameBg));
+                    const char* placeholder = (entry.flags & kScanThumbFailed) ? "无缩略图" : "生成中...";
+                    draw_list->AddText(ImVec2(pos.x + 4.0f, pos.y + 4.0f), ImGui::GetColorU32(ImGuiCol_TextDisabled), placeholder);
+                }
+                const bool hovered = ImGui::IsItemHovered();
+                if (ImGui::IsItemClicked()) {
+                    history_selected_ = stem;
+                }
+                if (stem == history_selected_) {
+                    draw_list->AddRect(pos, ImVec2(pos.x + icon_w, pos.y + icon_h), ImGui::GetColorU32(ImGuiCol_Text), 0.0f);
+                }
+                ImGui::TextUnformatted(HistoryTimeText(entry.capture_time, "%m-%d %H:%M:%S").c_str());
+                ImGui::EndGroup();
+                if (hovered) {
+                    ShowHistoryTooltip(entry);
+                }
+                ImGui::PopID();
+            }
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+}
+
+void CameraScannerUI::ShowHistoryTooltip(const ScanIndexEntry& entry) {
+    ImGui::BeginTooltip();
+    ImGui::Text("%s", entry.Stem().c_str());
+    ImGui::Text("扫描时间: %s", HistoryTimeText(entry.capture_time).c_str());
+    if (entry.recipe_id >= 0) {
+        ImGui::Text("配方: %d", entry.recipe_id);
+    }
+    ImGui::Text("相机数: %d  点数: %llu  行数: %llu", entry.scanner_count,
+                static_cast<unsigned long long>(entry.point_count), static_cast<unsigned long long>(entry.line_count));
+    ImGui::Text("有效点比例: %.1f%%", entry.valid_ratio * 100.0f);
+    ImGui::Text("高度: %.3f ~ %.3f  平均: %.3f", entry.min_z, entry.max_z, entry.mean_z);
+    const GLuint tex = GetHistoryThumbnail(entry);
+    if (tex != 0) {
+        ImGui::Image((ImTextureID)(intptr_t)tex, ImVec2(kScanThumbWidth * 2.0f, kScanThumbHeight * 2.0f));
+    }
+    ImGui::EndTooltip();
+}
+
+GLuint CameraScannerUI::GetHistoryThumbnail(const ScanIndexEntry& entry) {
+    if (!entry.HasThumbnail()) {
+        return 0;
+    }
+    auto it = history_thumbs_.find(entry.thumb_offset);
+    if (it != history_thumbs_.end()) {
+        it->second.last_used = history_frame_;
+        return it->second.tex;
+    }
+    if (history_loads_left_ <= 0) {
+        // 剩下的下一帧再读
+        RequestRedraw();
+        return 0;
+    }
+    history_loads_left_--;
+    // 读失败也记下来（纹理为 0），不在每帧重复读
+    HistoryThumbnail& thumb = history_thumbs_[entry.thumb_offset];
+    thumb.last_used = history_frame_;
+    cv::Mat rgba;
+    if (!scan_history_.ReadThumbnail(entry, rgba)) {
+        return 0;
+    }
+    glGenTextures(1, &thumb.tex);
+    glBindTexture(GL_TEXTURE_2D, thumb.tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, rgba.cols, rgba.rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data);
+    return thumb.tex;
+}
+
+void CameraScannerUI::ReleaseHistoryThumbnails() {
+    for (auto& item : history_thumbs_) {
+        if (item.second.tex != 0) {
+            glDeleteTextures(1, &item.second.tex);
+        }
+    }
+    history_thumbs_.clear();
+}
+
+// 行速率曲线保留的采样点数
+static constexpr size_t kPerfHistory = 120;
+
+void CameraScannerUI::SamplePerfMetrics() {
+    // 界面自己持有的队列由界面采样，其余由各自的所有者写入
+    Metrics().Gauge(kMetricQueueCommands)->Set(static_cast<double>(command_executor_.QueueDepth()));
+    Metrics().Gauge(kMetricQueueHistoryTasks)->Set(static_cast<double>(scan_history_.PendingTasks()));
+
+    std::swap(perf_prev_, perf_curr_);
+    Metrics().Snapshot(perf_curr_);
+    perf_rss_bytes_ = GetProcessRssBytes();
+    const double elapsed = perf_curr_.seconds - perf_prev_.seconds;
+    if (perf_prev_.seconds <= 0.0 || elapsed <= 0.0) {
+        return;
+    }
+    perf_line_rate_ = (perf_curr_.CounterValue(kMetricScanLines) - perf_prev_.CounterValue(kMetricScanLines)) / elapsed;
+    perf_batch_rate_ = (perf_curr_.CounterValue(kMetricScanBatches) - perf_prev_.CounterValue(kMetricScanBatches)) / elapsed;
+    perf_callback_us_ = perf_curr_.HistogramValue(kMetricScanCallbackUs).Since(perf_prev_.HistogramValue(kMetricScanCallbackUs));
+    perf_frame_ms_ = perf_curr_.HistogramValue(kMetricUiFrameMs).Since(perf_prev_.HistogramValue(kMetricUiFrameMs));
+    if (perf_line_rate_history_.size() >= kPerfHistory) {
+        perf_line_rate_history_.erase(perf_line_rate_history_.begin());
+    }
+    perf_line_rate_history_.push_back(static_cast<float>(perf_line_rate_));
+}
+
+void CameraScannerUI::ShowPerfHud() {
+    ImGui::SetNextWindowSize(ImVec2(380, 0), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("性能", &show_perf_hud_)) {
+        ImGui::End();
+        return;
+    }
+    // 空闲时主循环最多等 idle_timeout_s_，面板也随之刷新
+    const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (now - perf_curr_.seconds >= perf_interval_s_) {
+        SamplePerfMetrics();
+    }
+    const MetricsSnapshot& m = perf_curr_;
+    const double mb = 1024.0 * 1024.0;
+
+    ImGui::TextDisabled("采集");
+    ImGui::Text("行速率: %.0f 行/s  批次: %.1f 个/s", perf_line_rate_, perf_batch_rate_);
+    if (!perf_line_rate_history_.empty()) {
+        ImGui::PlotLines("##line_rate", perf_line_rate_history_.data(), static_cast<int>(perf_line_rate_history_.size()),
+                         0, nullptr, 0.0f, FLT_MAX, ImVec2(-1, 40));
+    }
+    if (perf_callback_us_.count > 0) {
+        ImGui::Text("回调耗时 p50/p95/p99: %.0f / %.0f / %.0f us", perf_callback_us_.Percentile(0.50),
+                    perf_callback_us_.Percentile(0.95), perf_callback_us_.Percentile(0.99));
+    } else {
+        ImGui::Text("回调耗时 p50/p95/p99: - / - / - us");
+    }
+    ImGui::Text("丢帧: %llu  预览丢弃行: %llu", (unsigned long long)m.CounterValue(kMetricScanDroppedFrames),
+                (unsigned long long)(scanner_api_ ? scanner_api_->GetLivePreviewDroppedRows() : 0));
+
+    ImGui::Separator();
+    ImGui::TextDisabled("处理（全部扫描）");
+    const HistogramSnapshot stitch_ms = m.HistogramValue(kMetricScanStitchMs);
+    const HistogramSnapshot get_all_data_ms = m.HistogramValue(kMetricScanGetAllDataMs);
+    ImGui::Text("拼接: 平均 %.1f ms  p95 %.1f ms  (%llu 次)", stitch_ms.Mean(), stitch_ms.Percentile(0.95),
+                (unsigned long long)stitch_ms.count);
+    ImGui::Text("取数据: 平均 %.1f ms  p95 %.1f ms  (%llu 次)", get_all_data_ms.Mean(), get_all_data_ms.Percentile(0.95),
+                (unsigned long long)get_all_data_ms.count);
+
+    ImGui::Separator();
+    ImGui::TextDisabled("保存");
+    const HistogramSnapshot save_ms = m.HistogramValue(kMetricSaveMs);
+    ImGui::Text("最近吞吐量: %.1f MB/s  平均耗时: %.0f ms", m.GaugeValue(kMetricSaveMBps), save_ms.Mean());
+    ImGui::Text("累计写出: %.1f MB  (%llu 次)", m.CounterValue(kMetricSaveBytes) / mb, (unsigned long long)save_ms.count);
+
+    ImGui::Separator();
+    ImGui::TextDisabled("队列深度");
+    ImGui::Text("命令: %.0f  日志: %.0f  预览行: %.0f  缩略图任务: %.0f", m.GaugeValue(kMetricQueueCommands),
+                m.GaugeValue(kMetricQueueLog), m.GaugeValue(kMetricQueuePreviewRows), m.GaugeValue(kMetricQueueHistoryTasks));
+
+    ImGui::Separator();
+    ImGui::TextDisabled("进程");
+    ImGui::Text("内存 (RSS): %.1f MB", perf_rss_bytes_ / mb);
+    if (perf_frame_ms_.count > 0) {
+        ImGui::Text("界面帧耗时 p50/p99: %.2f / %.2f ms  帧间隔: %.1f ms", perf_frame_ms_.Percentile(0.50),
+                    perf_frame_ms_.Percentile(0.99), frame_interval_ms_);
+    }
+    ImGui::End();
+}
+
 void CameraScannerUI::InitScanner() {
-    if (scanner_state_ != ScannerState::IDLE) {
+    if (!ScannerCommandExecutor::IsAllowed(ScannerCommand::INIT, command_executor_.State())) {
         return;
     }
 
-    scanner_state_ = ScannerState::INITIALIZING;
     {
         std::lock_guard<std::mutex> lock(status_mutex_);
         status_message_ = "正在初始化扫描器...";
         AddLogMessage("正在初始化扫描器...");
     }
 
-    // 在后台线程中执行初始化
-    std::thread([this]() {
-        try {
-            // 读取配置文件获取 data_root_path
-            std::string path_config_file = config_path_ + "../all_path_config.json";
-            // 如果 config_path_ 是相对路径，尝试多个可能的路径
-            if (!std::filesystem::exists(path_config_file)) {
-                path_config_file = config_path_ + "all_path_config.json";
-            }
-            if (!std::filesystem::exists(path_config_file)) {
-                path_config_file = "../ScannerConfig/all_path_config.json";
-            }
-            
-            if (std::filesystem::exists(path_config_file)) {
-                std::ifstream f(path_config_file);
-                if (f.is_open()) {
-                    nlohmann::json data = nlohmann::json::parse(f);
-                    f.close();
-                    data_root_path_ = data["data_root_path"];
-                    LOG(INFO) << "读取 data_root_path: " << data_root_path_;
-                } else {
-                    LOG(WARNING) << "无法打开配置文件: " << path_config_file;
-                    data_root_path_ = "./scan_data/";  // 默认路径
-                }
+    command_executor_.Post(ScannerCommand::INIT, [this](const std::atomic<bool>&) { return RunInitScanner(); });
+}
+
+int CameraScannerUI::RunInitScanner() {
+    try {
+        // 读取配置文件获取 data_root_path
+        std::string path_config_file = config_path_ + "../all_path_config.json";
+        // 如果 config_path_ 是相对路径，尝试多个可能的路径
+        if (!std::filesystem::exists(path_config_file)) {
+            path_config_file = config_path_ + "all_path_config.json";
+        }
+        if (!std::filesystem::exists(path_config_file)) {
+            path_config_file = "../ScannerConfig/all_path_config.json";
+        }
+        
+        if (std::filesystem::exists(path_config_file)) {
+            std::ifstream f(path_config_file);
+            if (f.is_open()) {
+                nlohmann::json data = nlohmann::json::parse(f);
+                f.close();
+                data_root_path_ = data["data_root_path"];
+                LOG(INFO) << "读取 data_root_path: " << data_root_path_;
+                // 每个快照含完整点云、灰度、逐点编码器/帧计数和法向量，长扫描可达 GB 级
+                const int history_capacity = data.value("scan_history_capacity", 2);
+                scan_store_.SetCapacity(static_cast<size_t>(std::max(1, history_capacity)));
+                LOG(INFO) << "保留最近 " << scan_store_.Capacity() << " 次扫描";
             } else {
-                LOG(WARNING) << "配置文件不存在: " << path_config_file << "，使用默认路径";
+                LOG(WARNING) << "无法打开配置文件: " << path_config_file;
                 data_root_path_ = "./scan_data/";  // 默认路径
             }
-            
-            // 确保路径以 / 或 \ 结尾
-            if (!data_root_path_.empty() && data_root_path_.back() != '/' && data_root_path_.back() != '\\') {
-                data_root_path_ += "/";
-            }
-            
-            scanner_api_->SetConfigRootPath(config_path_);
-            int result = scanner_api_->Init();
-            
-            if (result == 0) {
-                scanner_state_ = ScannerState::IDLE;
-                std::lock_guard<std::mutex> lock(status_mutex_);
-                status_message_ = "初始化成功，数据保存路径: " + data_root_path_;
-                AddLogMessage("初始化成功，数据保存路径: " + data_root_path_);
-            } else {
-                scanner_state_ = ScannerState::ERROR_STATE;
-                std::lock_guard<std::mutex> lock(status_mutex_);
-                status_message_ = "初始化失败，错误代码: " + std::to_string(result);
-                AddLogMessage("初始化失败，错误代码: " + std::to_string(result));
-            }
-        } catch (const std::exception& e) {
-            scanner_state_ = ScannerState::ERROR_STATE;
+        } else {
+            LOG(WARNING) << "配置文件不存在: " << path_config_file << "，使用默认路径";
+            data_root_path_ = "./scan_data/";  // 默认路径
+        }
+        
+        // 确保路径以 / 或 \ 结尾
+        if (!data_root_path_.empty() && data_root_path_.back() != '/' && data_root_path_.back() != '\\') {
+            data_root_path_ += "/";
+        }
+        
+        // 历史扫描索引跟随保存路径
+        if (!scan_history_.IsOpen() || scan_history_.Directory() != data_root_path_) {
+            scan_history_.Open(data_root_path_);
+        }
+        
+        scanner_api_->SetConfigRootPath(config_path_);
+        int result = scanner_api_->Init();
+        
+        if (result == 0) {
+            // 轮廓特征在采集线程上逐批推送，这里只做计数
+            scanner_api_->SetProfileFeatureCallback([this](const ProfileFeature*, size_t num) {
+                live_feature_count_.fetch_add(num);
+            });
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            status_message_ = "初始化成功，数据保存路径: " + data_root_path_;
+            AddLogMessage("初始化成功，数据保存路径: " + data_root_path_);
+        } else {
             std::lock_guard<std::mutex> lock(status_mutex_);
-            status_message_ = "初始化异常: " + std::string(e.what());
-            AddLogMessage("初始化异常: " + std::string(e.what()));
+            status_message_ = "初始化失败，错误代码: " + std::to_string(result);
+            AddLogMessage("初始化失败，错误代码: " + std::to_string(result), google::GLOG_ERROR);
         }
-    }).detach();
+        return result;
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_message_ = "初始化异常: " + std::string(e.what());
+        AddLogMessage("初始化异常: " + std::string(e.what()), google::GLOG_ERROR);
+        throw;
+    }
 }
 
 void CameraScannerUI::ConnectScanner() {
-    if (scanner_state_ != ScannerState::IDLE) {
+    if (!ScannerCommandExecutor::IsAllowed(ScannerCommand::CONNECT, command_executor_.State())) {
         return;
     }
 
-    scanner_state_ = ScannerState::CONNECTING;
     {
         std::lock_guard<std::mutex> lock(status_mutex_);
         status_message_ = "正在连接扫描器...";
     }
 
-    std::thread([this]() {
-        try {
-            int result = scanner_api_->Connect();
-            
-            if (result == 0) {
-                scanner_state_ = ScannerState::CONNECTED;
-                std::lock_guard<std::mutex> lock(status_mutex_);
-                status_message_ = "连接成功";
-            } else {
-                scanner_state_ = ScannerState::ERROR_STATE;
-                std::lock_guard<std::mutex> lock(status_mutex_);
-                status_message_ = "连接失败，错误代码: " + std::to_string(result);
-            }
-        } catch (const std::exception& e) {
-            scanner_state_ = ScannerState::ERROR_STATE;
-            std::lock_guard<std::mutex> lock(status_mutex_);
-            status_message_ = "连接异常: " + std::string(e.what());
+    command_executor_.Post(ScannerCommand::CONNECT, [this](const std::atomic<bool>&) { return RunConnectScanner(); });
+}
+
+int CameraScannerUI::RunConnectScanner() {
+    try {
+        int result = scanner_api_->Connect();
+        
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        if (result == 0) {
+            status_message_ = "连接成功";
+        } else {
+            status_message_ = "连接失败，错误代码: " + std::to_string(result);
         }
-    }).detach();
+        return result;
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_message_ = "连接异常: " + std::string(e.what());
+        throw;
+    }
 }
 
 void CameraScannerUI::StartScan() {
-    if (scanner_state_ != ScannerState::CONNECTED) {
+    if (!ScannerCommandExecutor::IsAllowed(ScannerCommand::START, command_executor_.State())) {
         return;
     }
 
-    scanner_state_ = ScannerState::SCANNING;
     {
         std::lock_guard<std::mutex> lock(status_mutex_);
         status_message_ = "开始扫描...";
     }
 
-    std::thread([this]() {
-        try {
-            int result = scanner_api_->Start();
-            
-            if (result == 0) {
-                std::lock_guard<std::mutex> lock(status_mutex_);
-                status_message_ = "扫描进行中...";
+    const int recipe_id = recipe_id_;
+    live_feature_count_.store(0);
+    ClearLivePreview();
+    gray_hist_.clear();  // 新扫描的批次数从头计，缓存不能沿用
+    command_executor_.Post(ScannerCommand::START, [this, recipe_id](const std::atomic<bool>&) { return RunStartScan(recipe_id); });
+}
+
+int CameraScannerUI::RunStartScan(int recipe_id) {
+    try {
+        scan_recipe_id_ = recipe_id;
+        scanner_api_->SetRecipeId(recipe_id);
+        if (scanner_api_->IsMeasurementEnabled()) {
+            // 测量区域随配方保存在 config_plc.json 中
+            ConfigData plc_config;
+            Solution solution;
+            if (plc_config.LoadFromJson(config_path_ + "config_plc.json") && plc_config.SetCurrentSolution(recipe_id)
+                && plc_config.GetCurrentSolution(solution)) {
+                scanner_api_->SetMeasurementRois(solution.roi_polygons);
             } else {
-                scanner_state_ = ScannerState::ERROR_STATE;
-                std::lock_guard<std::mutex> lock(status_mutex_);
-                status_message_ = "启动扫描失败，错误代码: " + std::to_string(result);
+                scanner_api_->SetMeasurementRois(std::vector<RoiPolygon>());
+                AddLogMessage("未找到配方 " + std::to_string(recipe_id) + " 的测量区域，测量整幅高度图");
             }
-        } catch (const std::exception& e) {
-            scanner_state_ = ScannerState::ERROR_STATE;
-            std::lock_guard<std::mutex> lock(status_mutex_);
-            status_message_ = "启动扫描异常: " + std::string(e.what());
         }
-    }).detach();
+        if (scanner_api_->IsBidirectionalScan()) {
+            AddLogMessage(scanner_api_->IsBackwardScan() ? "双向扫描：回程" : "双向扫描：去程");
+        }
+        int result = scanner_api_->Start();
+        
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        if (result == 0) {
+            status_message_ = "扫描进行中...";
+        } else {
+            status_message_ = "启动扫描失败，错误代码: " + std::to_string(result);
+        }
+        return result;
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_message_ = "启动扫描异常: " + std::string(e.what());
+        throw;
+    }
 }
 
 void CameraScannerUI::StopScan() {
-    if (scanner_state_ != ScannerState::SCANNING) {
+    if (!ScannerCommandExecutor::IsAllowed(ScannerCommand::STOP, command_executor_.State())) {
         return;
     }
 
-    scanner_state_ = ScannerState::STOPPING;
     {
         std::lock_guard<std::mutex> lock(status_mutex_);
         status_message_ = "正在停止扫描...";
     }
 
-    std::thread([this]() {
-        try {
-            // 停止扫描
-            int result = scanner_api_->End();
+    command_executor_.Post(ScannerCommand::STOP, [this](const std::atomic<bool>& cancelled) { return RunStopScan(cancelled); });
+}
+
+int CameraScannerUI::RunStopScan(const std::atomic<bool>& cancelled) {
+    try {
+        // 停止扫描
+        int result = scanner_api_->End();
+        
+        if (result == 0) {
+            {
+                std::lock_guard<std::mutex> lock(status_mutex_);
+                status_message_ = "扫描已停止，正在获取数据...";
+            }
             
-            if (result == 0) {
-                {
-                    std::lock_guard<std::mutex> lock(status_mutex_);
-                    status_message_ = "扫描已停止，正在获取数据...";
-                }
-                
-                // 自动获取数据
-                std::vector<std::vector<cv::Point3f>> pc_vec;
-                std::vector<std::vector<uint8_t>> gray_vec;
-                std::vector<std::vector<int32_t>> encoder_vec;
-                std::vector<std::vector<uint32_t>> framecnt_vec;
+            // 自动获取数据，直接填入新快照，发布后不再修改
+            auto snapshot = std::make_shared<ScanSnapshot>();
+            snapshot->capture_time = time(nullptr);
+            snapshot->recipe_id = scan_recipe_id_;
+            int data_result = scanner_api_->GetAllData(snapshot->point_clouds, snapshot->gray_images, snapshot->encoder_values,
+                                                       snapshot->frame_counts);
 
-                int data_result = scanner_api_->GetAllData(pc_vec, gray_vec, encoder_vec, framecnt_vec);
-                
-                if (data_result == 0) {
-                    // 先保存数据到文件（使用临时变量）
-                    SaveScanData(pc_vec, gray_vec, encoder_vec, framecnt_vec);
-                    
-                    // 然后保存数据到成员变量
-                    {
-                        std::lock_guard<std::mutex> lock(data_mutex_);
-                        point_clouds_ = std::move(pc_vec);
-                        gray_images_ = std::move(gray_vec);
-                        encoder_values_ = std::move(encoder_vec);
-                        frame_counts_ = std::move(framecnt_vec);
+            // 扫描统计在采集过程中已经累计完成，直接取结果
+            scanner_api_->GetScanStatistics(snapshot->statistics);
+            scanner_api_->GetGoldenComparison(snapshot->golden_result);
+            scanner_api_->GetMeasurements(snapshot->measurements);
+            std::vector<PostProcessResult> post_results;
+            scanner_api_->GetPostProcessResults(post_results);
+            
+            if (data_result == 0) {
+                // 被取消（退出程序）时只保存原始数据，跳过只用于界面显示的法向量、预览点云和索引
+                if (!cancelled) {
+                    // 法向量以压缩形式保存，用于拾取时的角度检查
+                    if (scanner_api_->IsNormalEstimationEnabled()
+                        && scanner_api_->GetPackedNormals(snapshot->point_clouds, snapshot->packed_normals) != 0) {
+                        LOG(WARNING) << "法向量计算失败";
+                    }
+
+                    // 体素降采样得到显示/导出用的预览点云
+                    if (scanner_api_->GetPreviewClouds(snapshot->point_clouds, snapshot->gray_images, snapshot->preview_clouds,
+                                                       snapshot->preview_grays) != 0) {
+                        LOG(WARNING) << "预览点云降采样失败";
+                    }
+
+                    // 索引直接引用快照中的点云，只对仍保持有序的点云建立
+                    snapshot->point_indices.assign(snapshot->point_clouds.size(), OrganizedIndex());
+                    for (size_t j = 0; j < snapshot->point_clouds.size(); ++j) {
+                        const std::vector<cv::Point3f>& pc = snapshot->point_clouds[j];
+                        const bool organized = j >= post_results.size() || post_results[j].organized;
+                        const int rows = static_cast<int>(pc.size() / kDefaultDataWidth);
+                        if (organized && rows > 0 && pc.size() % kDefaultDataWidth == 0) {
+                            snapshot->point_indices[j].Build(pc.data(), kDefaultDataWidth, rows);
+                        }
                     }
-                    
-                    scanner_state_ = ScannerState::CONNECTED;
-                    std::lock_guard<std::mutex> lock(status_mutex_);
-                    status_message_ = "扫描已停止，数据已获取并保存";
-                } else {
-                    scanner_state_ = ScannerState::CONNECTED;
-                    std::lock_guard<std::mutex> lock(status_mutex_);
-                    status_message_ = "扫描已停止，但获取数据失败，错误代码: " + std::to_string(data_result);
                 }
+
+                // 先发布给界面，保存线程持有同一份快照，不再复制
+                const ScanSnapshotPtr published = scan_store_.Publish(std::move(snapshot));
+                RequestRedraw();
+                SaveScanData(*published);
+                
+                std::lock_guard<std::mutex> lock(status_mutex_);
+                status_message_ = "扫描已停止，数据已获取并保存";
             } else {
-                scanner_state_ = ScannerState::ERROR_STATE;
                 std::lock_guard<std::mutex> lock(status_mutex_);
-                status_message_ = "停止扫描失败，错误代码: " + std::to_string(result);
+                status_message_ = "扫描已停止，但获取数据失败，错误代码: " + std::to_string(data_result);
             }
-        } catch (const std::exception& e) {
-            scanner_state_ = ScannerState::ERROR_STATE;
+        } else {
             std::lock_guard<std::mutex> lock(status_mutex_);
-            status_message_ = "停止扫描异常: " + std::string(e.what());
+            status_message_ = "停止扫描失败，错误代码: " + std::to_string(result);
         }
-    }).detach();
+        // 扫描已经结束时，取数据失败不影响回到已连接状态
+        return result;
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_message_ = "停止扫描异常: " + std::string(e.what());
+        throw;
+    }
 }
 
 void CameraScannerUI::DisconnectScanner() {
-    if (scanner_state_ == ScannerState::IDLE) {
+    if (!ScannerCommandExecutor::IsAllowed(ScannerCommand::DISCONNECT, command_executor_.State())) {
         return;
     }
 
@@ -724,27 +1682,30 @@ void CameraScannerUI::DisconnectScanner() {
         status_message_ = "正在断开连接...";
     }
 
-    std::thread([this]() {
-        try {
-            if (scanner_state_ == ScannerState::SCANNING) {
-                scanner_api_->End();
-            }
-            
-            int result = scanner_api_->disconnect();
-            
-            scanner_state_ = ScannerState::IDLE;
-            std::lock_guard<std::mutex> lock(status_mutex_);
-            if (result == 0) {
-                status_message_ = "已断开连接";
-            } else {
-                status_message_ = "断开连接完成（可能有警告）";
-            }
-        } catch (const std::exception& e) {
-            scanner_state_ = ScannerState::ERROR_STATE;
-            std::lock_guard<std::mutex> lock(status_mutex_);
-            status_message_ = "断开连接异常: " + std::string(e.what());
+    command_executor_.Post(ScannerCommand::DISCONNECT, [this](const std::atomic<bool>&) { return RunDisconnectScanner(); });
+}
+
+int CameraScannerUI::RunDisconnectScanner() {
+    try {
+        // 断开连接执行期间状态保持不变
+        if (command_executor_.State() == ScannerState::SCANNING) {
+            scanner_api_->End();
+        }
+        
+        int result = scanner_api_->disconnect();
+        
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        if (result == 0) {
+            status_message_ = "已断开连接";
+        } else {
+            status_message_ = "断开连接完成（可能有警告）";
         }
-    }).detach();
+        return result;
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_message_ = "断开连接异常: " + std::string(e.what());
+        throw;
+    }
 }
 
 // 辅助函数：保存点云为 TIFF
@@ -779,16 +1740,20 @@ static cv::Mat save_gray2tiff(std::vector<uint8_t>& data, int width, int height,
     return tiff_image;
 }
 
-void CameraScannerUI::SaveScanData(const std::vector<std::vector<cv::Point3f>>& pc_vec,
-                                    const std::vector<std::vector<uint8_t>>& gray_vec,
-                                    const std::vector<std::vector<int32_t>>& encoder_vec,
-                                    const std::vector<std::vector<uint32_t>>& framecnt_vec) {
+void CameraScannerUI::SaveScanData(const ScanSnapshot& snapshot) {
+    const auto& pc_vec = snapshot.point_clouds;
+    const auto& gray_vec = snapshot.gray_images;
+    const auto& encoder_vec = snapshot.encoder_values;
+    const auto& framecnt_vec = snapshot.frame_counts;
+    const auto& scan_stats = snapshot.statistics;
+    const auto& preview_pc_vec = snapshot.preview_clouds;
+    const auto& preview_gray_vec = snapshot.preview_grays;
+    const auto save_start = std::chrono::steady_clock::now();
     try {
-        // 获取当前时间作为文件名
-        time_t rawtime;
+        // 扫描结束时间作为文件名
+        time_t rawtime = snapshot.capture_time;
         struct tm* timeinfo;
         char buffer[100];
-        time(&rawtime);
         timeinfo = localtime(&rawtime);
         strftime(buffer, sizeof(buffer), "%Y%m%d_%H%M%S", timeinfo);
         std::string date_time_str = buffer;
@@ -807,6 +1772,137 @@ void CameraScannerUI::SaveScanData(const std::vector<std::vector<cv::Point3f>>&
         LOG(INFO) << "开始保存数据，保存路径: " << save_dir;
         LOG(INFO) << "相机数量: " << pc_vec.size();
         
+        // 本次写出的文件，最后按大小统计保存吞吐量
+        std::vector<std::string> saved_files;
+
+        // 保存扫描统计
+        std::string path_scan_stats = save_dir + "pointclouds_loop_" + date_time_str + "_stats.json";
+        if (!SaveScanStatistics(path_scan_stats, scan_stats)) {
+            LOG(WARNING) << "扫描统计保存失败: " << path_scan_stats;
+        }
+        saved_files.push_back(path_scan_stats);
+
+        // 保存高度图（由扫描数据直接栅格化）
+        if (scanner_api_->IsHeightMapEnabled()) {
+            std::vector<HeightMap> height_maps;
+            if (scanner_api_->GetHeightMaps(height_maps) == 0) {
+                for (size_t j = 0; j < height_maps.size(); ++j) {
+                    const std::string path_height = save_dir + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_height";
+                    SaveHeightMap(path_height, height_maps[j]);
+                    saved_files.push_back(path_height + ".tiff");
+                    saved_files.push_back(path_height + ".json");
+                }
+            } else {
+                LOG(WARNING) << "高度图生成失败";
+            }
+        }
+
+        // 保存与基准扫描的偏差图
+        GoldenCompareResult golden_result;
+        if (scanner_api_->GetGoldenComparison(golden_result) == 0) {
+            const std::string path_golden = save_dir + "pointclouds_loop_" + date_time_str + "_scan_0_golden";
+            SaveGoldenComparison(path_golden, golden_result);
+            saved_files.push_back(path_golden + ".tiff");
+            saved_files.push_back(path_golden + "_class.tiff");
+            saved_files.push_back(path_golden + ".json");
+        }
+
+        // 保存采集过程中提取的轮廓边缘
+        if (scanner_api_->IsProfileFeatureEnabled()) {
+            std::vector<ProfileFeature> features;
+            scanner_api_->GetProfileFeatures(features);
+            const std::string path_features = save_dir + "pointclouds_loop_" + date_time_str + "_features.csv";
+            if (!SaveProfileFeatures(path_features, features)) {
+                LOG(WARNING) << "轮廓特征保存失败";
+            }
+            saved_files.push_back(path_features);
+        }
+
+        // 保存体积/面积测量结果
+        if (scanner_api_->IsMeasurementEnabled()) {
+            std::vector<MeasurementResult> measurements;
+            scanner_api_->GetMeasurements(measurements);
+            for (size_t j = 0; j < measurements.size(); ++j) {
+                if (measurements[j].valid) {
+                    const std::string path_measure = save_dir + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_measure.json";
+                    SaveMeasurement(path_measure, measurements[j]);
+                    saved_files.push_back(path_measure);
+                }
+            }
+        }
+
+        // 保存多相机融合结果（统一到主相机坐标系，重叠区域只保留一份）
+        if (scanner_api_->IsCloudMergeEnabled()) {
+            MergedScan merged;
+            if (scanner_api_->MergeAllData(pc_vec, gray_vec, encoder_vec, framecnt_vec, merged) == 0) {
+                std::string path_merged = save_dir + "pointclouds_loop_" + date_time_str + "_merged";
+                if (!merged.map.height.empty()) {
+                    SaveHeightMap(path_merged + "_height", merged.map);
+                    cv::imwrite(path_merged + "_source.tiff", merged.source);
+                    saved_files.push_back(path_merged + "_height.tiff");
+                    saved_files.push_back(path_merged + "_height.json");
+                    saved_files.push_back(path_merged + "_source.tiff");
+                } else {
+                    WritePCToPLY(merged.pc.data(), static_cast<int>(merged.pc.size()), path_merged + ".ply", nullptr, 0,
+                                 merged.encoder.data(), static_cast<int>(merged.encoder.size()),
+                                 merged.framecnt.data(), static_cast<int>(merged.framecnt.size()),
+                                 merged.gray.data(), static_cast<int>(merged.gray.size()));
+                    saved_files.push_back(path_merged + ".ply");
+                }
+                LOG(INFO) << "融合数据保存完成: " << path_merged;
+            } else {
+                LOG(WARNING) << "多相机融合失败";
+            }
+        }
+
+        // 保存法向量（与 _pc.tiff 相同的排布），由停止扫描时算好的压缩法向量解码，不再重新估计
+        // 退出程序时快照中没有法向量，跳过
+        if (scanner_api_->IsNormalEstimationEnabled()) {
+            const auto& packed_vec = snapshot.packed_normals;
+            std::vector<int> compression_params = { cv::IMWRITE_TIFF_COMPRESSION, 1 };
+            for (size_t j = 0; j < packed_vec.size(); ++j) {
+                const int rows = static_cast<int>(packed_vec[j].size() / kDefaultDataWidth);
+                if (rows == 0) {
+                    continue;
+                }
+                cv::Mat normal_image(rows, kDefaultDataWidth, CV_32FC3);
+                cv::Point3f* normals = normal_image.ptr<cv::Point3f>();
+                for (size_t k = 0; k < size_t(rows) * kDefaultDataWidth; ++k) {
+                    normals[k] = UnpackNormal(packed_vec[j][k]);
+                }
+                const std::string path_normals = save_dir + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_normals.tiff";
+                cv::imwrite(path_normals, normal_image, compression_params);
+                saved_files.push_back(path_normals);
+            }
+        }
+
+        // 保存预览点云（体素降采样，不含编码器/帧计数）
+        if (scanner_api_->IsPreviewExportEnabled()) {
+            for (size_t j = 0; j < preview_pc_vec.size(); ++j) {
+                if (preview_pc_vec[j].empty()) {
+                    continue;
+                }
+                std::string path_preview = save_dir + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_preview.ply";
+                const std::vector<uint8_t>* preview_gray = j < preview_gray_vec.size() ? &preview_gray_vec[j] : nullptr;
+                WritePCToPLY(preview_pc_vec[j].data(), static_cast<int>(preview_pc_vec[j].size()), path_preview, nullptr, 0,
+                             nullptr, 0, nullptr, 0,
+                             preview_gray ? preview_gray->data() : nullptr, preview_gray ? static_cast<int>(preview_gray->size()) : 0);
+                saved_files.push_back(path_preview);
+            }
+        }
+
+        // 保存基准平面拟合结果（平面参数与残差图）
+        std::vector<PostProcessResult> post_results;
+        scanner_api_->GetPostProcessResults(post_results);
+        for (size_t j = 0; j < post_results.size(); ++j) {
+            if (post_results[j].plane.valid) {
+                const std::string path_plane = save_dir + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_plane";
+                SavePlaneFit(path_plane, post_results[j].plane, post_results[j].plane_residual);
+                saved_files.push_back(path_plane + ".tiff");
+                saved_files.push_back(path_plane + ".json");
+            }
+        }
+        
         // 保存每个相机的数据
         for (size_t j = 0; j < pc_vec.size(); ++j) {
             if (pc_vec[j].empty()) {
@@ -882,19 +1978,24 @@ void CameraScannerUI::SaveScanData(const std::vector<std::vector<cv::Point3f>>&
             );
             
             if (ply_status) {
+                saved_files.push_back(path_laser_scan_pc);
                 LOG(INFO) << "PLY 文件保存成功: " << path_laser_scan_pc;
             } else {
                 LOG(ERROR) << "PLY 文件保存失败: " << path_laser_scan_pc;
             }
             
+            // 剔除离群点后点云不再有序，不保存 TIFF
+            const bool organized = j >= post_results.size() || post_results[j].organized;
+
             // 保存 TIFF 文件（点云）
-            if (i_pc_x.size() > 0 && i_pc_y.size() > 0 && i_pc_z.size() > 0) {
+            if (organized && i_pc_x.size() > 0 && i_pc_y.size() > 0 && i_pc_z.size() > 0) {
                 cv::Mat tiff_image = save_ply2tiff(i_pc_x, i_pc_y, i_pc_z, data_width, data_height, path_laser_scan_tiff_pc);
+                saved_files.push_back(path_laser_scan_tiff_pc);
                 LOG(INFO) << "点云 TIFF 文件保存成功: " << path_laser_scan_tiff_pc;
             }
             
             // 保存 TIFF 文件（灰度）
-            if (gray_vec[j].size() > 0) {
+            if (organized && gray_vec[j].size() > 0) {
                 // 创建灰度数据的副本（因为 save_gray2tiff 需要非 const 引用）
                 std::vector<uint8_t> gray_data_copy = gray_vec[j];
                 cv::Mat tiff_image_gray = save_gray2tiff(
@@ -903,10 +2004,44 @@ void CameraScannerUI::SaveScanData(const std::vector<std::vector<cv::Point3f>>&
                     data_height, 
                     path_laser_scan_tiff_gray
                 );
+                saved_files.push_back(path_laser_scan_tiff_gray);
                 LOG(INFO) << "灰度 TIFF 文件保存成功: " << path_laser_scan_tiff_gray;
             }
         }
         
+        // 保存耗时与吞吐量，只统计本次写出的文件（写失败的跳过）
+        const double save_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - save_start).count();
+        uint64_t saved_bytes = 0;
+        for (const std::string& path : saved_files) {
+            std::error_code size_error;
+            const uintmax_t file_size = std::filesystem::file_size(path, size_error);
+            if (!size_error) {
+                saved_bytes += file_size;
+            }
+        }
+        Metrics().Counter(kMetricSaveBytes)->Add(saved_bytes);
+        Metrics().Histogram(kMetricSaveMs)->Record(save_ms);
+        if (save_ms > 0.0) {
+            Metrics().Gauge(kMetricSaveMBps)->Set(saved_bytes / (1024.0 * 1024.0) / (save_ms / 1000.0));
+        }
+        LOG(INFO) << "保存 " << saved_bytes / (1024.0 * 1024.0) << " MB，耗时 " << save_ms << " ms";
+        
+        // 登记到历史索引，缩略图由后台线程从刚保存的文件生成
+        ScanIndexEntry history_entry;
+        history_entry.capture_time = static_cast<int64_t>(snapshot.capture_time);
+        history_entry.recipe_id = snapshot.recipe_id;
+        history_entry.scanner_count = static_cast<int32_t>(pc_vec.size());
+        history_entry.point_count = snapshot.PointCount();
+        history_entry.line_count = scan_stats.line_count;
+        history_entry.valid_ratio = static_cast<float>(scan_stats.ValidRatio());
+        history_entry.min_z = scan_stats.min_z;
+        history_entry.max_z = scan_stats.max_z;
+        history_entry.mean_z = static_cast<float>(scan_stats.MeanZ());
+        history_entry.SetStem("pointclouds_loop_" + date_time_str);
+        if (!scan_history_.Add(history_entry)) {
+            LOG(WARNING) << "扫描索引未打开，本次扫描不会出现在历史记录中";
+        }
+        
         {
             std::lock_guard<std::mutex> lock(status_mutex_);
             status_message_ = "数据已保存到: " + save_dir;
@@ -920,7 +2055,7 @@ void CameraScannerUI::SaveScanData(const std::vector<std::vector<cv::Point3f>>&
 }
 
 const char* CameraScannerUI::GetStateText() const {
-    switch (scanner_state_) {
+    switch (command_executor_.State()) {
         case ScannerState::IDLE: return "空闲";
         case ScannerState::INITIALIZING: return "初始化中";
         case ScannerState::CONNECTING: return "连接中";
@@ -0,0 +1,193 @@
+#include "decimated_plot.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <opencv2/core/hal/intrin.hpp>
+
+void DecimateMinMax(const float* values, int count, int columns, bool skip_invalid_z, float* out_min, float* out_max) {
+    if (values == nullptr || count <= 0 || columns <= 0 || columns > count) {
+        return;
+    }
+    // 不跳过无效点时阈值取 -inf，除 -inf 和 NaN 外的值都参与
+    const float threshold = skip_invalid_z ? kInvalidZThreshold : -INFINITY;
+#if CV_SIMD
+    const int lanes = cv::v_float32::nlanes;
+    const cv::v_float32 v_thr = cv::vx_setall_f32(threshold);
+    const cv::v_float32 v_pos = cv::vx_setall_f32(FLT_MAX);
+    const cv::v_float32 v_neg = cv::vx_setall_f32(-FLT_MAX);
+#endif
+    for (int k = 0; k < columns; ++k) {
+        const int begin = static_cast<int>(int64_t(k) * count / columns);
+        const int end = static_cast<int>(int64_t(k + 1) * count / columns);
+        float lo = FLT_MAX;
+        float hi = -FLT_MAX;
+        int i = begin;
+#if CV_SIMD
+        if (end - begin >= lanes) {
+            cv::v_float32 v_lo = v_pos, v_hi = v_neg;
+            for (; i + lanes <= end; i += lanes) {
+                const cv::v_float32 v = cv::vx_load(values + i);
+                const cv::v_float32 valid = v > v_thr;
+                v_lo = cv::v_min(v_lo, cv::v_select(valid, v, v_pos));
+                v_hi = cv::v_max(v_hi, cv::v_select(valid, v, v_neg));
+            }
+            lo = cv::v_reduce_min(v_lo);
+            hi = cv::v_reduce_max(v_hi);
+        }
+#endif
+        for (; i < end; ++i) {
+            if (values[i] > threshold) {
+                lo = std::min(lo, values[i]);
+                hi = std::max(hi, values[i]);
+            }
+        }
+        out_min[k] = lo;
+        out_max[k] = hi;
+    }
+#if CV_SIMD
+    cv::vx_cleanup();
+#endif
+}
+
+void DecimatedPlot::Plot(const char* label, const float* values, int count, uint64_t version, float scale_min,
+                         float scale_max, const ImVec2& size, const char* overlay, ImU32 color) {
+    const ImVec2 avail = ImGui::GetContentRegionAvail();
+    ImVec2 frame_size = size;
+    if (frame_size.x <= 0.0f) {
+        frame_size.x = std::max(4.0f, avail.x + frame_size.x);
+    }
+    if (frame_size.y <= 0.0f) {
+        frame_size.y = ImGui::GetFrameHeight() * 3.0f;
+    }
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton(label, frame_size);
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    const ImVec2 frame_max(origin.x + frame_size.x, origin.y + frame_size.y);
+    draw_list->AddRectFilled(origin, frame_max, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+    Update(values, count, version, scale_min, scale_max, origin, frame_size);
+    draw_list->PushClipRect(origin, frame_max, true);
+    DrawTrace(draw_list, color != 0 ? color : ImGui::GetColorU32(ImGuiCol_PlotLines));
+    if (overlay != nullptr) {
+        const ImVec2 text_size = ImGui::CalcTextSize(overlay);
+        draw_list->AddText(ImVec2(origin.x + (frame_size.x - text_size.x) * 0.5f, origin.y + 2.0f),
+                           ImGui::GetColorU32(ImGuiCol_Text), overlay);
+    }
+    draw_list->PopClipRect();
+
+    // 悬停时显示该像素列覆盖的点及其范围
+    const int columns = static_cast<int>(min_.size());
+    if (columns > 0 && ImGui::IsItemHovered()) {
+        const float t = (ImGui::GetMousePos().x - origin.x) / frame_size.x;
+        const int k = std::min(columns - 1, std::max(0, static_cast<int>(t * columns)));
+        const int begin = static_cast<int>(int64_t(k) * count_ / columns);
+        const int end = static_cast<int>(int64_t(k + 1) * count_ / columns);
+        if (min_[k] > max_[k]) {
+            ImGui::SetTooltip("%d ~ %d: 无效", begin, end - 1);
+        } else if (end - begin == 1) {
+            ImGui::SetTooltip("%d: %.4f", begin, min_[k]);
+        } else {
+            ImGui::SetTooltip("%d ~ %d: %.4f ~ %.4f", begin, end - 1, min_[k], max_[k]);
+        }
+    }
+}
+
+void DecimatedPlot::Overlay(const float* values, int count, uint64_t version, float scale_min, float scale_max,
+                            ImU32 color) {
+    const ImVec2 origin = ImGui::GetItemRectMin();
+    const ImVec2 frame_max = ImGui::GetItemRectMax();
+    Update(values, count, version, scale_min, scale_max, origin, ImVec2(frame_max.x - origin.x, frame_max.y - origin.y));
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->PushClipRect(origin, frame_max, true);
+    DrawTrace(draw_list, color);
+    draw_list->PopClipRect();
+}
+
+void DecimatedPlot::Invalidate() {
+    cached_ = false;
+}
+
+void DecimatedPlot::Update(const float* values, int count, uint64_t version, float scale_min, float scale_max,
+                           const ImVec2& origin, const ImVec2& size) {
+    if (values == nullptr || count <= 0) {
+        min_.clear();
+        max_.clear();
+        points_.clear();
+        segments_.clear();
+        cached_ = false;
+        return;
+    }
+    const bool same_data = cached_ && version == version_ && count == count_;
+    const bool same_layout = same_data && size.x == size_.x && size.y == size_.y && scale_min == scale_[0]
+        && scale_max == scale_[1];
+    if (same_layout) {
+        // 只是窗口滚动或移动，平移已有顶点
+        if (origin.x != origin_.x || origin.y != origin_.y) {
+            const float dx = origin.x - origin_.x;
+            const float dy = origin.y - origin_.y;
+            for (ImVec2& p : points_) {
+                p.x += dx;
+                p.y += dy;
+            }
+            origin_ = origin;
+        }
+        return;
+    }
+
+    const int columns = std::min(count, std::max(1, static_cast<int>(size.x)));
+    if (!same_data || columns != static_cast<int>(min_.size())) {
+        min_.resize(columns);
+        max_.resize(columns);
+        DecimateMinMax(values, count, columns, skip_invalid_z_, min_.data(), max_.data());
+    }
+
+    // 竖直方向按 scale 映射，超出范围的部分由裁剪处理
+    const float span = scale_max - scale_min;
+    const float y_scale = std::fabs(span) > FLT_EPSILON ? size.y / span : 0.0f;
+    const float x_step = size.x / columns;
+    points_.clear();
+    segments_.clear();
+    bool in_segment = false;
+    for (int k = 0; k < columns; ++k) {
+        if (min_[k] > max_[k]) {
+            in_segment = false;
+            continue;
+        }
+        if (!in_segment) {
+            segments_.push_back(static_cast<int>(points_.size()));
+            in_segment = true;
+        }
+        const float x = origin.x + (k + 0.5f) * x_step;
+        const float y_lo = origin.y + size.y - (min_[k] - scale_min) * y_scale;
+        points_.push_back(ImVec2(x, y_lo));
+        if (max_[k] != min_[k]) {
+            points_.push_back(ImVec2(x, origin.y + size.y - (max_[k] - scale_min) * y_scale));
+        }
+    }
+    segments_.push_back(static_cast<int>(points_.size()));
+
+    cached_ = true;
+    version_ = version;
+    count_ = count;
+    scale_[0] = scale_min;
+    scale_[1] = scale_max;
+    size_ = size;
+    origin_ = origin;
+}
+
+void DecimatedPlot::DrawTrace(ImDrawList* draw_list, ImU32 color) const {
+    for (size_t s = 0; s + 1 < segments_.size(); ++s) {
+        const int begin = segments_[s];
+        const int num = segments_[s + 1] - begin;
+        if (num == 1) {
+            // 孤立的单点画成一个像素
+            const ImVec2& p = points_[begin];
+            draw_list->AddLine(p, ImVec2(p.x + 1.0f, p.y), color);
+        } else if (num > 1) {
+            draw_list->AddPolyline(points_.data() + begin, num, color, 0, 1.0f);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#include "log_ring.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+LogRing::LogRing(size_t capacity) {
+    capacity_ = 16;
+    while (capacity_ < capacity) {
+        capacity_ <<= 1;
+    }
+    mask_ = capacity_ - 1;
+    slots_.reset(new Slot[capacity_]);
+}
+
+bool LogRing::Push(int severity, const struct ::tm* tm_time, const char* message, size_t length) {
+    if (!IsSeverityEnabled(severity)) {
+        filtered_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const uint64_t pos = write_pos_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[pos & mask_];
+    // 占用槽位；若上一圈的写入还没结束（极少见，缓冲被整圈写过），放弃这条而不是等待
+    uint64_t stamp = slot.stamp.load(std::memory_order_relaxed);
+    do {
+        if ((stamp & 1) != 0 || stamp >= 2 * pos + 1) {
+            return false;
+        }
+    } while (!slot.stamp.compare_exchange_weak(stamp, 2 * pos + 1, std::memory_order_acquire, std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_release);
+
+    struct ::tm local_tm;
+    if (tm_time == nullptr) {
+        const time_t now = time(nullptr);
+#ifdef _WIN32
+        localtime_s(&local_tm, &now);
+#else
+        localtime_r(&now, &local_tm);
+#endif
+        tm_time = &local_tm;
+    }
+    LogRecord& record = slot.record;
+    record.severity = severity;
+    size_t used = strftime(record.text, LogRecord::kMaxText, "[%H:%M:%S] ", tm_time);
+    // glog 的消息不带换行，界面消息也按一行处理
+    while (length > 0 && (message[length - 1] == '\n' || message[length - 1] == '\r')) {
+        length--;
+    }
+    const size_t copy = std::min(length, LogRecord::kMaxText - 1 - used);
+    memcpy(record.text + used, message, copy);
+    used += copy;
+    record.text[used] = '\0';
+    record.length = static_cast<uint32_t>(used);
+
+    slot.stamp.store(2 * pos + 2, std::memory_order_release);
+    return true;
+}
+
+LogRing::ReadResult LogRing::Read(uint64_t pos, LogRecord& out) const {
+    const Slot& slot = slots_[pos & mask_];
+    const uint64_t done = 2 * pos + 2;
+    const uint64_t before = slot.stamp.load(std::memory_order_acquire);
+    if (before < done) {
+        return kReadPending;
+    }
+    if (before > done) {
+        return kReadLost;
+    }
+    memcpy(&out, &slot.record, sizeof(LogRecord));
+    // 复制期间被下一圈覆盖则丢弃
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.stamp.load(std::memory_order_relaxed) == done ? kReadOk : kReadLost;
+}
+
+void LogRing::SetSeverityEnabled(int severity, bool enabled) {
+    if (severity < 0 || severity >= 32) {
+        return;
+    }
+    if (enabled) {
+        accept_mask_.fetch_or(1u << severity, std::memory_order_relaxed);
+    } else {
+        accept_mask_.fetch_and(~(1u << severity), std::memory_order_relaxed);
+    }
+}
+
+bool LogRing::IsSeverityEnabled(int severity) const {
+    if (severity < 0 || severity >= 32) {
+        return true;
+    }
+    return (accept_mask_.load(std::memory_order_relaxed) & (1u << severity)) != 0;
+}
@@ -1,11 +1,22 @@
 #include "CameraScannerUI.h"
 #include "glog/logging.h"
+#include "scanner_l/async_log.h"
 #include <iostream>
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
+namespace {
+    // 任何返回路径上都先排空异步日志队列并停止后台线程，再关闭 glog
+    struct LoggingGuard {
+        ~LoggingGuard() {
+            ShutdownAsyncLogging();
+            google::ShutdownGoogleLogging();
+        }
+    };
+}
+
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
     // 设置控制台代码页为 UTF-8，以正确显示中文
@@ -15,7 +26,13 @@ int main(int argc, char* argv[]) {
 
     // 初始化 glog
     google::InitGoogleLogging(argv[0]);
-    FLAGS_logtostderr = 1; // 同时输出到控制台
+    // 日志文件和控制台输出都交给后台线程，LOG() 调用方不等待磁盘和控制台
+    // FATAL 仍由 glog 同步写到控制台
+    FLAGS_stderrthreshold = google::GLOG_FATAL;
+    AsyncLogOptions log_options;
+    log_options.echo_to_stderr = true; // 同时输出到控制台
+    InstallAsyncLogging(log_options);
+    LoggingGuard logging_guard;
 
     try {
         // 创建 UI 实例
@@ -39,6 +56,5 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
-    google::ShutdownGoogleLogging();
     return 0;
 }
@@ -0,0 +1,497 @@
+#include "scan_history.h"
+#include "scanner_l/range_image.h"
+#include "glog/logging.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+namespace {
+    constexpr char kScanIndexMagic[4] = { 'S', 'H', 'I', 'X' };
+    constexpr uint32_t kScanIndexVersion = 1;
+
+    struct ScanIndexHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t record_size;
+        uint32_t reserved;
+    };
+
+    constexpr std::streamoff kScanIndexHeaderSize = sizeof(ScanIndexHeader);
+    const char* const kScanIndexFile = "scan_index.bin";
+    const char* const kScanThumbsFile = "scan_thumbs.bin";
+    const char* const kStatsSuffix = "_stats.json";
+
+    bool EndsWith(const std::string& s, const std::string& suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // 文件名中的时间（..._YYYYmmdd_HHMMSS），解析失败返回 0
+    int64_t ParseStemTime(const std::string& stem) {
+        if (stem.size() < 15) {
+            return 0;
+        }
+        std::tm tm = {};
+        std::istringstream in(stem.substr(stem.size() - 15));
+        in >> std::get_time(&tm, "%Y%m%d_%H%M%S");
+        if (in.fail()) {
+            return 0;
+        }
+        tm.tm_isdst = -1;
+        return static_cast<int64_t>(std::mktime(&tm));
+    }
+
+    // 高度图优先（已栅格化，文件小）；没有时取点云 tiff 的 z 通道
+    cv::Mat LoadScanHeight(const std::string& dir, const std::string& stem) {
+        const std::string height_path = dir + stem + "_scan_0_height.tiff";
+        if (std::filesystem::exists(height_path)) {
+            cv::Mat height = cv::imread(height_path, cv::IMREAD_UNCHANGED);
+            if (height.type() == CV_32FC1) {
+                return height;
+            }
+        }
+        const std::string pc_path = dir + stem + "_scan_0_pc.tiff";
+        if (std::filesystem::exists(pc_path)) {
+            cv::Mat pc = cv::imread(pc_path, cv::IMREAD_UNCHANGED);
+            if (pc.type() == CV_32FC3) {
+                cv::Mat z;
+                cv::extractChannel(pc, z, 2);
+                return z;
+            }
+        }
+        return cv::Mat();
+    }
+
+    // 缩到缩略图尺寸，无效点不参与平均；高度按本次扫描的范围映射到 1..255，0 为无效
+    bool MakeThumbnail(const cv::Mat& z, cv::Mat& out_u8) {
+        if (z.empty()) {
+            return false;
+        }
+        cv::Mat valid = z > kInvalidZThreshold;
+        cv::Mat z_masked = z.clone();
+        z_masked.setTo(0.0f, ~valid);
+        cv::Mat weight;
+        valid.convertTo(weight, CV_32FC1, 1.0 / 255.0);
+        const cv::Size size(kScanThumbWidth, kScanThumbHeight);
+        cv::Mat z_small, weight_small;
+        cv::resize(z_masked, z_small, size, 0, 0, cv::INTER_AREA);
+        cv::resize(weight, weight_small, size, 0, 0, cv::INTER_AREA);
+        cv::Mat valid_small = weight_small > 0.25f;
+        if (cv::countNonZero(valid_small) == 0) {
+            return false;
+        }
+        cv::divide(z_small, cv::max(weight_small, 1e-6f), z_small);
+        double lo = 0.0, hi = 0.0;
+        cv::minMaxLoc(z_small, &lo, &hi, nullptr, nullptr, valid_small);
+        const double span = std::max(hi - lo, 1e-3);
+        z_small.convertTo(out_u8, CV_8UC1, 254.0 / span, 1.0 - lo * 254.0 / span);
+        out_u8.setTo(0, ~valid_small);
+        return true;
+    }
+}
+
+std::string ScanIndexEntry::Stem() const {
+    return std::string(stem, strnlen(stem, sizeof(stem)));
+}
+
+void ScanIndexEntry::SetStem(const std::string& value) {
+    std::memset(stem, 0, sizeof(stem));
+    std::memcpy(stem, value.data(), std::min(value.size(), sizeof(stem) - 1));
+}
+
+ScanHistoryIndex::ScanHistoryIndex(int worker_count) {
+    for (int i = 0; i < std::max(worker_count, 1); ++i) {
+        workers_.emplace_back(&ScanHistoryIndex::WorkerLoop, this);
+    }
+}
+
+ScanHistoryIndex::~ScanHistoryIndex() {
+    Close();
+    {
+        std::lock_guard<std::mutex> lock(task_mutex_);
+        stop_ = true;
+    }
+    task_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+bool ScanHistoryIndex::Open(const std::string& data_dir) {
+    std::string dir = data_dir.empty() ? "./" : data_dir;
+    if (dir.back() != '/' && dir.back() != '\\') {
+        dir += "/";
+    }
+    Close();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    const std::string index_path = dir + kScanIndexFile;
+    const std::string thumbs_path = dir + kScanThumbsFile;
+
+    // 读入已有索引；格式不对就重建，扫描文件都还在，重新导入即可（导入的记录没有配方）
+    bool fresh = true;
+    {
+        std::ifstream in(index_path, std::ios::binary);
+        ScanIndexHeader header = {};
+        if (in.read(reinterpret_cast<char*>(&header), sizeof(header)) && std::memcmp(header.magic, kScanIndexMagic, 4) == 0
+            && header.version == kScanIndexVersion && header.record_size == sizeof(ScanIndexEntry)) {
+            ScanIndexEntry entry;
+            while (in.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+                entries_.push_back(entry);
+            }
+            fresh = false;
+        } else if (in.is_open()) {
+            LOG(WARNING) << "扫描索引格式不符，重建: " << index_path;
+        }
+    }
+    if (fresh) {
+        entries_.clear();
+        std::ofstream out(index_path, std::ios::binary | std::ios::trunc);
+        ScanIndexHeader header = {};
+        std::memcpy(header.magic, kScanIndexMagic, 4);
+        header.version = kScanIndexVersion;
+        header.record_size = sizeof(ScanIndexEntry);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::ofstream(thumbs_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            LOG(ERROR) << "无法创建扫描索引: " << index_path;
+            entries_.clear();
+            return false;
+        }
+    } else if (!std::filesystem::exists(thumbs_path)) {
+        std::ofstream(thumbs_path, std::ios::binary);
+    }
+
+    index_file_.open(index_path, std::ios::binary | std::ios::in | std::ios::out);
+    thumbs_file_.open(thumbs_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!index_file_.is_open() || !thumbs_file_.is_open()) {
+        LOG(ERROR) << "无法打开扫描索引: " << index_path;
+        index_file_.close();
+        thumbs_file_.close();
+        entries_.clear();
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> read_lock(read_mutex_);
+        thumbs_reader_.open(thumbs_path, std::ios::binary);
+    }
+
+    order_.resize(entries_.size());
+    for (size_t i = 0; i < order_.size(); ++i) {
+        order_[i] = static_cast<uint32_t>(i);
+    }
+    std::stable_sort(order_.begin(), order_.end(), [this](uint32_t a, uint32_t b) {
+        return entries_[a].capture_time > entries_[b].capture_time;
+    });
+
+    dir_ = dir;
+    open_ = true;
+    generation_++;
+
+    // 从最新的开始补缩略图
+    size_t queued = 0;
+    for (uint32_t position : order_) {
+        const ScanIndexEntry& entry = entries_[position];
+        if (!entry.HasThumbnail() && !(entry.flags & kScanThumbFailed)) {
+            QueueThumbnail(position, entry.Stem());
+            queued++;
+        }
+    }
+    if (fresh) {
+        const uint64_t generation = generation_;
+        Post([this, generation]() { ImportMissing(generation); });
+    }
+    LOG(INFO) << "扫描索引: " << index_path << " 记录 " << entries_.size() << " 待生成缩略图 " << queued
+              << (fresh ? "（新建，导入目录中已有扫描）" : "");
+    return true;
+}
+
+void ScanHistoryIndex::Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    open_ = false;
+    entries_.clear();
+    order_.clear();
+    index_file_.close();
+    thumbs_file_.close();
+    {
+        std::lock_guard<std::mutex> read_lock(read_mutex_);
+        thumbs_reader_.close();
+    }
+    std::lock_guard<std::mutex> task_lock(task_mutex_);
+    tasks_.clear();
+}
+
+bool ScanHistoryIndex::IsOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_;
+}
+
+std::string ScanHistoryIndex::Directory() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dir_;
+}
+
+bool ScanHistoryIndex::Add(const ScanIndexEntry& entry) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_) {
+            return false;
+        }
+        const size_t position = AppendLocked(entry);
+        QueueThumbnail(position, entry.Stem());
+    }
+    NotifyChanged();
+    return true;
+}
+
+void ScanHistoryIndex::Rescan() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+        return;
+    }
+    const uint64_t generation = generation_;
+    Post([this, generation]() { ImportMissing(generation); });
+}
+
+size_t ScanHistoryIndex::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return order_.size();
+}
+
+bool ScanHistoryIndex::Get(size_t i, ScanIndexEntry& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (i >= order_.size()) {
+        return false;
+    }
+    out = entries_[order_[i]];
+    return true;
+}
+
+bool ScanHistoryIndex::ReadThumbnail(const ScanIndexEntry& entry, cv::Mat& out_rgba) const {
+    if (!entry.HasThumbnail() || entry.thumb_bytes == 0) {
+        return false;
+    }
+    std::vector<uint8_t> bytes(entry.thumb_bytes);
+    {
+        std::lock_guard<std::mutex> lock(read_mutex_);
+        if (!thumbs_reader_.is_open()) {
+            return false;
+        }
+        thumbs_reader_.clear();
+        thumbs_reader_.seekg(static_cast<std::streamoff>(entry.thumb_offset));
+        if (!thumbs_reader_.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+            return false;
+        }
+    }
+    cv::Mat u8 = cv::imdecode(bytes, cv::IMREAD_GRAYSCALE);
+    if (u8.empty()) {
+        return false;
+    }
+    cv::Mat color;
+    cv::applyColorMap(u8, color, cv::COLORMAP_JET);
+    cv::cvtColor(color, out_rgba, cv::COLOR_BGR2RGBA);
+    out_rgba.setTo(cv::Scalar(0, 0, 0, 255), u8 == 0);
+    return true;
+}
+
+size_t ScanHistoryIndex::PendingTasks() const {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    return tasks_.size() + running_tasks_;
+}
+
+void ScanHistoryIndex::SetChangedListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(listener_mutex_);
+    changed_listener_ = std::move(listener);
+}
+
+void ScanHistoryIndex::WorkerLoop() {
+    while (true) {
+        std::function<void()> run;
+        {
+            std::unique_lock<std::mutex> lock(task_mutex_);
+            task_cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (stop_) {
+                return;
+            }
+            run = std::move(tasks_.front());
+            tasks_.pop_front();
+            running_tasks_++;
+        }
+        try {
+            run();
+        } catch (const std::exception& e) {
+            LOG(ERROR) << "扫描索引后台任务异常: " << e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(task_mutex_);
+            running_tasks_--;
+        }
+    }
+}
+
+void ScanHistoryIndex::Post(std::function<void()> run) {
+    {
+        std::lock_guard<std::mutex> lock(task_mutex_);
+        tasks_.push_back(std::move(run));
+    }
+    task_cv_.notify_one();
+}
+
+bool ScanHistoryIndex::WriteRecord(size_t position, const ScanIndexEntry& entry) {
+    index_file_.clear();
+    index_file_.seekp(kScanIndexHeaderSize + static_cast<std::streamoff>(position * sizeof(ScanIndexEntry)));
+    index_file_.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    index_file_.flush();
+    if (!index_file_) {
+        LOG(ERROR) << "扫描索引写入失败: " << dir_ << kScanIndexFile;
+        return false;
+    }
+    return true;
+}
+
+size_t ScanHistoryIndex::AppendLocked(const ScanIndexEntry& entry) {
+    const size_t position = entries_.size();
+    entries_.push_back(entry);
+    WriteRecord(position, entry);
+    auto it = std::upper_bound(order_.begin(), order_.end(), entry.capture_time,
+        [this](int64_t time, uint32_t i) { return time > entries_[i].capture_time; });
+    order_.insert(it, static_cast<uint32_t>(position));
+    return position;
+}
+
+void ScanHistoryIndex::QueueThumbnail(size_t position, const std::string& stem) {
+    const uint64_t generation = generation_;
+    Post([this, generation, position, stem]() { GenerateThumbnail(generation, position, stem); });
+}
+
+void ScanHistoryIndex::GenerateThumbnail(uint64_t generation, size_t position, const std::string& stem) {
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_) {
+            return;
+        }
+        dir = dir_;
+    }
+
+    // 读大文件和缩放都不持锁
+    cv::Mat thumb;
+    std::vector<uint8_t> png;
+    const bool ok = MakeThumbnail(LoadScanHeight(dir, stem), thumb) && cv::imencode(".png", thumb, png);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_ || position >= entries_.size()) {
+            return;
+        }
+        ScanIndexEntry& entry = entries_[position];
+        if (ok) {
+            thumbs_file_.clear();
+            thumbs_file_.seekp(0, std::ios::end);
+            const std::streamoff offset = thumbs_file_.tellp();
+            thumbs_file_.write(reinterpret_cast<const char*>(png.data()), png.size());
+            thumbs_file_.flush();
+            if (thumbs_file_ && offset >= 0) {
+                entry.thumb_offset = static_cast<uint64_t>(offset);
+                entry.thumb_bytes = static_cast<uint32_t>(png.size());
+                entry.thumb_width = static_cast<uint16_t>(thumb.cols);
+                entry.thumb_height = static_cast<uint16_t>(thumb.rows);
+            } else {
+                LOG(ERROR) << "缩略图写入失败: " << dir << kScanThumbsFile;
+            }
+        } else {
+            LOG(WARNING) << "无法生成缩略图（缺少高度图 / 点云 tiff）: " << dir << stem;
+            entry.flags |= kScanThumbFailed;
+        }
+        WriteRecord(position, entry);
+    }
+    NotifyChanged();
+}
+
+void ScanHistoryIndex::ImportMissing(uint64_t generation) {
+    std::string dir;
+    std::set<std::string> known;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_) {
+            return;
+        }
+        dir = dir_;
+        for (const auto& entry : entries_) {
+            known.insert(entry.Stem());
+        }
+    }
+
+    std::set<std::string> names;
+    std::error_code ec;
+    for (const auto& item : std::filesystem::directory_iterator(dir, ec)) {
+        if (item.is_regular_file(ec)) {
+            names.insert(item.path().filename().string());
+        }
+    }
+
+    std::vector<ScanIndexEntry> found;
+    for (const auto& name : names) {
+        if (!EndsWith(name, kStatsSuffix)) {
+            continue;
+        }
+        const std::string stem = name.substr(0, name.size() - strlen(kStatsSuffix));
+        if (known.count(stem) || stem.size() >= sizeof(ScanIndexEntry::stem)) {
+            continue;
+        }
+        ScanIndexEntry entry;
+        entry.SetStem(stem);
+        entry.capture_time = ParseStemTime(stem);
+        try {
+            std::ifstream f(dir + name);
+            nlohmann::json stats = nlohmann::json::parse(f);
+            entry.point_count = stats.value("total_points", uint64_t(0));
+            entry.line_count = stats.value("line_count", uint64_t(0));
+            entry.valid_ratio = stats.value("valid_ratio", 0.0f);
+            entry.min_z = stats.value("min_z", 0.0f);
+            entry.max_z = stats.value("max_z", 0.0f);
+            entry.mean_z = stats.value("mean_z", 0.0f);
+        } catch (const std::exception& e) {
+            LOG(WARNING) << "扫描统计读取失败: " << dir << name << " " << e.what();
+        }
+        while (names.count(stem + "_scan_" + std::to_string(entry.scanner_count) + ".ply")
+               || names.count(stem + "_scan_" + std::to_string(entry.scanner_count) + "_pc.tiff")) {
+            entry.scanner_count++;
+        }
+        found.push_back(entry);
+    }
+    if (found.empty()) {
+        return;
+    }
+    // 新的先生成缩略图
+    std::sort(found.begin(), found.end(), [](const ScanIndexEntry& a, const ScanIndexEntry& b) {
+        return a.capture_time > b.capture_time;
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_) {
+            return;
+        }
+        for (const auto& entry : found) {
+            const size_t position = AppendLocked(entry);
+            QueueThumbnail(position, entry.Stem());
+        }
+    }
+    LOG(INFO) << "扫描索引导入 " << found.size() << " 次扫描: " << dir;
+    NotifyChanged();
+}
+
+void ScanHistoryIndex::NotifyChanged() {
+    std::lock_guard<std::mutex> lock(listener_mutex_);
+    if (changed_listener_) {
+        changed_listener_();
+    }
+}
@@ -0,0 +1,69 @@
+#include "scan_snapshot.h"
+#include <algorithm>
+
+size_t ScanSnapshot::PointCount() const {
+    size_t count = 0;
+    for (const auto& pc : point_clouds) {
+        count += pc.size();
+    }
+    return count;
+}
+
+ScanSnapshotStore::ScanSnapshotStore(size_t capacity)
+    : history_(std::make_shared<const ScanHistory>())
+    , capacity_(std::max<size_t>(capacity, 1)) {
+}
+
+ScanSnapshotPtr ScanSnapshotStore::Publish(std::shared_ptr<ScanSnapshot> snapshot) {
+    if (!snapshot) {
+        return nullptr;
+    }
+    snapshot->id = next_id_.fetch_add(1);
+    ScanSnapshotPtr published = std::move(snapshot);
+
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    const std::shared_ptr<const ScanHistory> old_history = std::atomic_load(&history_);
+    auto history = std::make_shared<ScanHistory>();
+    const size_t keep = std::min(old_history->scans.size(), capacity_.load() - 1);
+    history->scans.reserve(keep + 1);
+    history->scans.push_back(published);
+    history->scans.insert(history->scans.end(), old_history->scans.begin(), old_history->scans.begin() + keep);
+    std::atomic_store(&history_, std::shared_ptr<const ScanHistory>(std::move(history)));
+    return published;
+}
+
+ScanSnapshotPtr ScanSnapshotStore::Latest() const {
+    const std::shared_ptr<const ScanHistory> history = std::atomic_load(&history_);
+    return history->scans.empty() ? nullptr : history->scans.front();
+}
+
+ScanSnapshotPtr ScanSnapshotStore::Find(uint64_t id) const {
+    const std::shared_ptr<const ScanHistory> history = std::atomic_load(&history_);
+    for (const auto& scan : history->scans) {
+        if (scan->id == id) {
+            return scan;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const ScanHistory> ScanSnapshotStore::History() const {
+    return std::atomic_load(&history_);
+}
+
+void ScanSnapshotStore::SetCapacity(size_t capacity) {
+    capacity = std::max<size_t>(capacity, 1);
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    capacity_ = capacity;
+    const std::shared_ptr<const ScanHistory> old_history = std::atomic_load(&history_);
+    if (old_history->scans.size() <= capacity) {
+        return;
+    }
+    auto history = std::make_shared<ScanHistory>();
+    history->scans.assign(old_history->scans.begin(), old_history->scans.begin() + capacity);
+    std::atomic_store(&history_, std::shared_ptr<const ScanHistory>(std::move(history)));
+}
+
+size_t ScanSnapshotStore::Capacity() const {
+    return capacity_.load();
+}
@@ -0,0 +1,192 @@
+#include "scanner_command_executor.h"
+#include "glog/logging.h"
+#include <exception>
+
+namespace {
+    std::future<int> ReadyFuture(int value) {
+        std::promise<int> promise;
+        promise.set_value(value);
+        return promise.get_future();
+    }
+
+    // 命令执行期间的状态
+    ScannerState RunningState(ScannerCommand command, ScannerState from) {
+        switch (command) {
+            case ScannerCommand::INIT: return ScannerState::INITIALIZING;
+            case ScannerCommand::CONNECT: return ScannerState::CONNECTING;
+            case ScannerCommand::START: return ScannerState::SCANNING;
+            case ScannerCommand::STOP: return ScannerState::STOPPING;
+            default: return from;
+        }
+    }
+
+    // 命令完成后的状态
+    ScannerState FinalState(ScannerCommand command, int result) {
+        switch (command) {
+            case ScannerCommand::INIT: return result == 0 ? ScannerState::IDLE : ScannerState::ERROR_STATE;
+            case ScannerCommand::CONNECT: return result == 0 ? ScannerState::CONNECTED : ScannerState::ERROR_STATE;
+            case ScannerCommand::START: return result == 0 ? ScannerState::SCANNING : ScannerState::ERROR_STATE;
+            case ScannerCommand::STOP: return result == 0 ? ScannerState::CONNECTED : ScannerState::ERROR_STATE;
+            default: return ScannerState::IDLE;  // 断开连接即使有警告也回到空闲
+        }
+    }
+}
+
+ScannerCommandExecutor::ScannerCommandExecutor() {
+    worker_ = std::thread(&ScannerCommandExecutor::Run, this);
+}
+
+ScannerCommandExecutor::~ScannerCommandExecutor() {
+    Shutdown();
+}
+
+void ScannerCommandExecutor::SetStateListener(std::function<void(ScannerState)> listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    state_listener_ = std::move(listener);
+}
+
+bool ScannerCommandExecutor::IsAllowed(ScannerCommand command, ScannerState state) {
+    switch (command) {
+        case ScannerCommand::INIT:
+        case ScannerCommand::CONNECT: return state == ScannerState::IDLE;
+        case ScannerCommand::START: return state == ScannerState::CONNECTED;
+        case ScannerCommand::STOP: return state == ScannerState::SCANNING;
+        case ScannerCommand::DISCONNECT: return state != ScannerState::IDLE;
+        default: return true;
+    }
+}
+
+std::future<int> ScannerCommandExecutor::Post(ScannerCommand command, Handler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+        return ReadyFuture(kCommandCancelled);
+    }
+    // 没有排队或执行中的命令时状态不会再变，可以直接判断
+    if (queue_.empty() && !running_cancelled_ && !IsAllowed(command, State())) {
+        return ReadyFuture(kCommandRejected);
+    }
+    Item item;
+    item.command = command;
+    item.required = ScannerState::IDLE;
+    item.handler = std::move(handler);
+    item.cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::future<int> future = item.result.get_future();
+    queue_.push_back(std::move(item));
+    cv_.notify_one();
+    return future;
+}
+
+std::future<int> ScannerCommandExecutor::PostTask(ScannerState required, Handler task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+        return ReadyFuture(kCommandCancelled);
+    }
+    if (queue_.empty() && !running_cancelled_ && State() != required) {
+        return ReadyFuture(kCommandRejected);
+    }
+    Item item;
+    item.command = ScannerCommand::TASK;
+    item.required = required;
+    item.handler = std::move(task);
+    item.cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::future<int> future = item.result.get_future();
+    queue_.push_back(std::move(item));
+    cv_.notify_one();
+    return future;
+}
+
+void ScannerCommandExecutor::CancelAll() {
+    std::deque<Item> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled.swap(queue_);
+        if (running_cancelled_) {
+            running_cancelled_->store(true);
+        }
+    }
+    for (Item& item : cancelled) {
+        item.result.set_value(kCommandCancelled);
+    }
+}
+
+void ScannerCommandExecutor::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    CancelAll();
+    cv_.notify_one();
+    if (worker_.joinable() && worker_.get_id() != std::this_thread::get_id()) {
+        worker_.join();
+    }
+}
+
+bool ScannerCommandExecutor::IsBusy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !queue_.empty() || running_cancelled_;
+}
+
+size_t ScannerCommandExecutor::QueueDepth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+void ScannerCommandExecutor::Run() {
+    for (;;) {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            item = std::move(queue_.front());
+            queue_.pop_front();
+            running_cancelled_ = item.cancelled;
+        }
+        const int result = Execute(item);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_cancelled_.reset();
+        }
+        item.result.set_value(result);
+    }
+}
+
+int ScannerCommandExecutor::Execute(Item& item) {
+    const ScannerState from = State();
+    const bool is_task = item.command == ScannerCommand::TASK;
+    if (is_task ? from != item.required : !IsAllowed(item.command, from)) {
+        LOG(INFO) << "ScannerCommandExecutor - command " << static_cast<int>(item.command) << " rejected in state "
+                  << static_cast<int>(from);
+        return kCommandRejected;
+    }
+    if (!is_task) {
+        SetState(RunningState(item.command, from));
+    }
+    try {
+        const int result = item.handler ? item.handler(*item.cancelled) : 0;
+        if (!is_task) {
+            SetState(FinalState(item.command, result));
+        }
+        return result;
+    } catch (const std::exception& e) {
+        LOG(ERROR) << "ScannerCommandExecutor - command " << static_cast<int>(item.command) << " threw: " << e.what();
+    } catch (...) {
+        LOG(ERROR) << "ScannerCommandExecutor - command " << static_cast<int>(item.command) << " threw";
+    }
+    SetState(ScannerState::ERROR_STATE);
+    return kCommandException;
+}
+
+void ScannerCommandExecutor::SetState(ScannerState state) {
+    state_.store(state, std::memory_order_release);
+    std::function<void(ScannerState)> listener;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listener = state_listener_;
+    }
+    if (listener) {
+        listener(state);
+    }
+}
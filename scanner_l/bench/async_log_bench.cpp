@@ -0,0 +1,99 @@
+// Producer-side cost of LOG(INFO), synchronous glog file logging against the
+// asynchronous backend.
+//
+// Every thread times each LOG() call; the mean and the tail are what a caller on
+// the acquisition path pays. The async run also reports drops and the queue high
+// water mark, the files end up in log_dir.
+//
+// usage: async_log_bench [threads] [lines per thread] [log_dir]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glog/logging.h"
+#include "scanner_l/async_log.h"
+
+namespace {
+    struct Timing
+    {
+        double mean_ns = 0.0;
+        double p99_ns = 0.0;
+        double max_ns = 0.0;
+        double wall_ms = 0.0;
+    };
+
+    Timing Run(int threads, int lines) {
+        std::vector<std::vector<float>> per_thread(threads, std::vector<float>(lines));
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&per_thread, t, lines]() {
+                std::vector<float>& ns = per_thread[t];
+                for (int i = 0; i < lines; i++) {
+                    const auto t0 = std::chrono::steady_clock::now();
+                    LOG(INFO) << "bench thread " << t << " line " << i << " encoder " << i * 16 << " batch 3200";
+                    ns[i] = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - t0).count();
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        Timing timing;
+        timing.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<float> all;
+        all.reserve(size_t(threads) * lines);
+        for (const auto& ns : per_thread)
+            all.insert(all.end(), ns.begin(), ns.end());
+        double sum = 0.0;
+        for (float v : all)
+            sum += v;
+        timing.mean_ns = all.empty() ? 0.0 : sum / all.size();
+        if (!all.empty()) {
+            const size_t p99 = all.size() * 99 / 100;
+            std::nth_element(all.begin(), all.begin() + p99, all.end());
+            timing.p99_ns = all[p99];
+            timing.max_ns = *std::max_element(all.begin(), all.end());
+        }
+        return timing;
+    }
+
+    void Print(const char* name, const Timing& timing) {
+        std::cout << name << ": mean " << timing.mean_ns << " ns, p99 " << timing.p99_ns << " ns, max "
+                  << timing.max_ns / 1000.0 << " us, wall " << timing.wall_ms << " ms" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    const int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    const int lines = argc > 2 ? std::atoi(argv[2]) : 100000;
+    const std::string log_dir = argc > 3 ? argv[3] : ".";
+
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = 0;
+    FLAGS_stderrthreshold = google::GLOG_FATAL;
+    google::SetLogDestination(google::GLOG_INFO, (log_dir + "/async_log_bench_").c_str());
+    std::cout << threads << " threads x " << lines << " LOG(INFO) lines" << std::endl;
+
+    Print("sync ", Run(threads, lines));
+    google::FlushLogFiles(google::GLOG_INFO);
+
+    AsyncLogOptions options;
+    if (InstallAsyncLogging(options) != 0) {
+        std::cerr << "InstallAsyncLogging failed" << std::endl;
+        return -1;
+    }
+    Print("async", Run(threads, lines));
+    const AsyncLogStats stats = GetAsyncLogStats();
+    const auto drain_start = std::chrono::steady_clock::now();
+    ShutdownAsyncLogging();
+    const double drain_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drain_start).count();
+    std::cout << "async: enqueued " << stats.enqueued << ", dropped " << stats.dropped << ", max depth " << stats.max_depth
+              << " / " << stats.queue_capacity << ", final drain " << drain_ms << " ms" << std::endl;
+
+    google::ShutdownGoogleLogging();
+    return 0;
+}
@@ -0,0 +1,131 @@
+// OrganizedIndex against pcl::KdTreeFLANN on a synthetic 3200 x 20000 scan.
+//
+// Both answer the same XY queries (the kd-tree gets the points with z = 0), the
+// results are cross checked so the timings compare equal work.
+//
+// usage: organized_index_bench [rows] [queries] [radius]
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/kdtree/kdtree_flann.h>
+#include "scanner_l/organized_index.h"
+#include "scanner_l/range_image.h"
+
+namespace {
+    void MakeScan(std::vector<cv::Point3f>& pc, int width, int rows) {
+        pc.resize(size_t(width) * rows);
+        uint32_t seed = 12345;
+        auto next = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 8;
+        };
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < width; c++) {
+                cv::Point3f& p = pc[size_t(r) * width + c];
+                p.x = c * 0.01f + (next() % 100) * 1e-5f;
+                p.y = r * 0.02f;
+                p.z = (c / 400 + r / 2000) % 2 ? 2.0f : 0.0f;
+                if (next() % 1000 < 20)
+                    p.z = kInvalidZ;
+            }
+        }
+    }
+
+    double MsSince(const std::chrono::steady_clock::time_point& start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    const int width = kDefaultDataWidth;
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const int num_queries = argc > 2 ? std::atoi(argv[2]) : 100000;
+    const float radius = argc > 3 ? static_cast<float>(std::atof(argv[3])) : 0.05f;
+
+    std::vector<cv::Point3f> pc;
+    MakeScan(pc, width, rows);
+    std::vector<cv::Point2f> queries(num_queries);
+    uint32_t seed = 777;
+    for (auto& q : queries) {
+        seed = seed * 1664525u + 1013904223u;
+        q.x = (seed >> 8) % 32000 * 0.001f;
+        seed = seed * 1664525u + 1013904223u;
+        q.y = (seed >> 8) % (rows * 20) * 0.001f;
+    }
+    std::cout << "scan " << width << " x " << rows << ", " << num_queries << " queries, radius " << radius << std::endl;
+
+    // organized index
+    auto start = std::chrono::steady_clock::now();
+    OrganizedIndex index;
+    index.Build(pc.data(), width, rows);
+    const double index_build_ms = MsSince(start);
+
+    std::vector<int64_t> index_nearest(num_queries);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; i++) {
+        index_nearest[i] = index.Nearest(queries[i].x, queries[i].y, 0.0f);
+    }
+    const double index_nearest_ms = MsSince(start);
+
+    std::vector<int64_t> found;
+    uint64_t index_radius_total = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; i++) {
+        index_radius_total += index.RadiusSearch(queries[i].x, queries[i].y, radius, found);
+    }
+    const double index_radius_ms = MsSince(start);
+
+    // kd-tree over the valid points
+    start = std::chrono::steady_clock::now();
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    std::vector<int64_t> cloud_to_scan;
+    cloud->reserve(pc.size());
+    cloud_to_scan.reserve(pc.size());
+    for (size_t i = 0; i < pc.size(); i++) {
+        if (!IsValidZ(pc[i].z))
+            continue;
+        cloud->push_back(pcl::PointXYZ(pc[i].x, pc[i].y, 0.0f));
+        cloud_to_scan.push_back(static_cast<int64_t>(i));
+    }
+    pcl::KdTreeFLANN<pcl::PointXYZ> kdtree;
+    kdtree.setInputCloud(cloud);
+    const double kdtree_build_ms = MsSince(start);
+
+    std::vector<int> k_indices(1);
+    std::vector<float> k_sqr_dists(1);
+    uint64_t nearest_mismatch = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; i++) {
+        const pcl::PointXYZ q(queries[i].x, queries[i].y, 0.0f);
+        if (kdtree.nearestKSearch(q, 1, k_indices, k_sqr_dists) > 0 && cloud_to_scan[k_indices[0]] != index_nearest[i]) {
+            // equidistant points may be reported differently
+            const cv::Point3f& a = pc[cloud_to_scan[k_indices[0]]];
+            const cv::Point3f& b = pc[index_nearest[i]];
+            const float da = (a.x - q.x) * (a.x - q.x) + (a.y - q.y) * (a.y - q.y);
+            const float db = (b.x - q.x) * (b.x - q.x) + (b.y - q.y) * (b.y - q.y);
+            if (std::abs(da - db) > 1e-9f)
+                nearest_mismatch++;
+        }
+    }
+    const double kdtree_nearest_ms = MsSince(start);
+
+    uint64_t kdtree_radius_total = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; i++) {
+        const pcl::PointXYZ q(queries[i].x, queries[i].y, 0.0f);
+        kdtree_radius_total += kdtree.radiusSearch(q, radius, k_indices, k_sqr_dists);
+    }
+    const double kdtree_radius_ms = MsSince(start);
+
+    std::cout << "build:   index " << index_build_ms << " ms, kdtree " << kdtree_build_ms << " ms" << std::endl;
+    std::cout << "nearest: index " << index_nearest_ms << " ms, kdtree " << kdtree_nearest_ms << " ms, mismatches "
+              << nearest_mismatch << std::endl;
+    std::cout << "radius:  index " << index_radius_ms << " ms, kdtree " << kdtree_radius_ms << " ms, points "
+              << index_radius_total << " / " << kdtree_radius_total << std::endl;
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Benchmark of the range image kernels on a synthetic 3200 x 20000 scan.
+//
+// usage: range_filter_bench [rows] [repeats]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "scanner_l/range_image.h"
+#include "scanner_l/range_image_filter.h"
+
+namespace {
+    // tilted plane with a raised block, single point spikes and dropouts
+    void MakeScan(std::vector<cv::Point3f>& pc, int width, int rows) {
+        pc.resize(size_t(width) * rows);
+        uint32_t seed = 12345;
+        auto next = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 8;
+        };
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < width; c++) {
+                cv::Point3f& p = pc[size_t(r) * width + c];
+                p.x = c * 0.01f;
+                p.y = r * 0.02f;
+                p.z = 0.001f * c + 0.0005f * r + ((c / 400 + r / 2000) % 2 ? 2.0f : 0.0f)
+                    + (next() % 1000) * 1e-5f;
+                const uint32_t event = next() % 1000;
+                if (event < 20)
+                    p.z = kInvalidZ;
+                else if (event < 22)
+                    p.z += 3.0f;
+            }
+        }
+    }
+
+    template<typename F>
+    double TimeMs(std::vector<cv::Point3f>& work, const std::vector<cv::Point3f>& src, int repeats, F kernel) {
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++) {
+            work = src;
+            auto start = std::chrono::steady_clock::now();
+            kernel(work);
+            auto stop = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(stop - start).count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    const int width = kDefaultDataWidth;
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const int repeats = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    std::vector<cv::Point3f> src, work;
+    MakeScan(src, width, rows);
+    std::cout << "scan " << width << " x " << rows << ", best of " << repeats << std::endl;
+
+    RangeFilterParams params;
+    const double despike_ms = TimeMs(work, src, repeats, [&](std::vector<cv::Point3f>& pc) {
+        DespikeProfiles(pc.data(), width, rows, 0.5f);
+    });
+    const double fill_ms = TimeMs(work, src, repeats, [&](std::vector<cv::Point3f>& pc) {
+        FillRangeHoles(pc.data(), width, rows, 4, params.tile_rows);
+    });
+    params.smooth = RangeSmoothMethod::Bilateral;
+    const double bilateral_ms = TimeMs(work, src, repeats, [&](std::vector<cv::Point3f>& pc) {
+        SmoothRangeImage(pc.data(), width, rows, params);
+    });
+    params.smooth = RangeSmoothMethod::Median;
+    const double median_ms = TimeMs(work, src, repeats, [&](std::vector<cv::Point3f>& pc) {
+        SmoothRangeImage(pc.data(), width, rows, params);
+    });
+
+    const double mpts = double(width) * rows / 1e6;
+    auto report = [mpts](const char* name, double ms) {
+        std::cout << name << ": " << ms << " ms, " << mpts / (ms / 1000.0) << " Mpts/s" << std::endl;
+    };
+    report("despike", despike_ms);
+    report("fill holes (gap 4)", fill_ms);
+    report("bilateral 5x5", bilateral_ms);
+    report("median 5x5", median_ms);
+    return 0;
+}
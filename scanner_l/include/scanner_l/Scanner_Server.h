@@ -70,6 +70,9 @@ public:
 
     int Disconnect_Scanner();
 
+    // Volume / area / height percentiles of the last scan, per scanner.
+    int Get_Measurements(std::vector<MeasurementResult>& out_results);
+
 
 
 private:
@@ -82,6 +85,7 @@ private:
     std::string set_config_root_path;
     std::string shared_memory_name_pc;
     std::string shared_memory_name_gray;
+    std::string shared_memory_name_height;
 
     std::string plc_setting_path;
     Solution sol_current;
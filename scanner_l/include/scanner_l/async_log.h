@@ -0,0 +1,67 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include "glog/logging.h"
+
+/*
+ * Asynchronous backend for glog.
+ *
+ * glog formats each LOG() line and hands it to the logger of every file it goes to.
+ * InstallAsyncLogging() replaces those loggers with adapters that copy the formatted
+ * line into a bounded lock-free MPSC queue and return. A background thread drains the
+ * queue into the original file loggers, optionally echoes the lines to stderr and
+ * forwards them to one LogSink, so neither disk nor console latency reaches the
+ * calling thread. When the queue is full the line is dropped and counted.
+ *
+ * A FATAL line, google::FlushLogFiles() and glog's own flush before aborting drain the
+ * queue synchronously on the calling thread, so nothing logged before a crash is lost.
+ *
+ * Only lines that glog writes to log files pass through here: FLAGS_logtostderr must
+ * be off. Sinks registered with google::AddLogSink() are still called synchronously.
+ */
+
+struct AsyncLogOptions
+{
+    // records the queue holds, rounded up to a power of two
+    size_t queue_records = 8192;
+
+    // how often the background thread looks at an idle queue
+    int drain_interval_ms = 20;
+
+    // write lines below FLAGS_stderrthreshold to stderr from the background thread,
+    // replacing FLAGS_logtostderr / FLAGS_alsologtostderr
+    bool echo_to_stderr = false;
+};
+
+struct AsyncLogStats
+{
+    uint64_t enqueued = 0;
+    uint64_t dropped = 0;  // queue full
+    uint64_t written = 0;  // drained into the file loggers
+    size_t queue_capacity = 0;
+    size_t max_depth = 0;  // high-water mark of queued records
+};
+
+/**
+ * @brief Route glog file output through the asynchronous backend.
+ *
+ * Call after google::InitGoogleLogging() and before any thread logs.
+ *
+ * @return 0 success, -1 already installed or FLAGS_logtostderr is set
+ */
+int InstallAsyncLogging(const AsyncLogOptions& options = AsyncLogOptions());
+
+// Drain the queue, stop the thread and restore glog's loggers; call before google::ShutdownGoogleLogging()
+void ShutdownAsyncLogging();
+
+bool IsAsyncLoggingInstalled();
+
+// Sink that receives every line from the background thread (nullptr to detach); it must
+// stay valid until detached and must not log itself
+void SetAsyncLogSink(google::LogSink* sink);
+
+AsyncLogStats GetAsyncLogStats();
+
+#endif
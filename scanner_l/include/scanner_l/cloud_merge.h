@@ -0,0 +1,72 @@
+#ifndef CLOUD_MERGE_H
+#define CLOUD_MERGE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "scanner_l/height_map.h"
+
+enum class CloudMergeMode
+{
+    // one fused cloud; in voxels seen by several heads only the owning head's points are kept
+    Voxel = 0,
+    // one fused height map on a grid shared by all heads, every cell taken from its owning head
+    HeightMap
+};
+
+// "voxel" / "height_map", anything else maps to Voxel
+CloudMergeMode CloudMergeModeFromString(const std::string& name);
+const char* CloudMergeModeName(CloudMergeMode mode);
+
+struct CloudMergeParams
+{
+    CloudMergeMode mode = CloudMergeMode::Voxel;
+
+    // edge of the dedup voxels (mm)
+    float voxel_size = 0.1f;
+
+    // grid of the fused height map; reduce is ignored, a cell is the mean of its owning head
+    HeightMapParams height_map;
+};
+
+/**
+ * @brief Fused result of all heads.
+ *
+ * A voxel or cell seen by several heads is owned by the head with the most points in it,
+ * i.e. the head looking at it from closest / most perpendicular; ties go to the lower index.
+ */
+struct MergedScan
+{
+    // Voxel mode: unorganized cloud in the common frame with its per-point data
+    std::vector<cv::Point3f> pc;
+    std::vector<uint8_t> gray;
+    std::vector<int32_t> encoder;
+    std::vector<uint32_t> framecnt;
+
+    // HeightMap mode: fused map and the head index of every cell (255 = empty)
+    HeightMap map;
+    cv::Mat source;  // CV_8UC1
+
+    // valid points per head that were kept / dropped as duplicates
+    std::vector<uint64_t> kept;
+    std::vector<uint64_t> dropped;
+
+    double elapsed_ms = 0.0;
+};
+
+/**
+ * @brief Transform every head into the common frame and fuse them without duplicated overlap.
+ *
+ * Heads are processed in parallel; gray / encoder / framecnt may be empty or must match the cloud size.
+ *
+ * @param rts 4x4 CV_64FC1 per head, an empty Mat (or a missing entry) keeps the head as is
+ * @return 0 success, -1 no valid point, -2 bad parameters or grid too large
+ */
+int MergeScans(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+               const std::vector<std::vector<uint8_t>>& gray_vec,
+               const std::vector<std::vector<int32_t>>& encoder_vec,
+               const std::vector<std::vector<uint32_t>>& framecnt_vec,
+               const std::vector<cv::Mat>& rts, const CloudMergeParams& params, MergedScan& out_scan);
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef GOLDEN_COMPARE_H
+#define GOLDEN_COMPARE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "scanner_l/height_map.h"
+
+struct GoldenCompareParams
+{
+    // +- cells searched around the encoder prior
+    int search_radius = 10;
+
+    // every n-th row and column scores the coarse search, the best offset is refined at full resolution
+    int search_decimation = 4;
+
+    // overlapping cells a candidate offset needs to be scored
+    int min_overlap = 1000;
+
+    // |deviation| above tolerance_warn is Warn, above tolerance_fail is Fail (mm)
+    float tolerance_warn = 0.05f;
+    float tolerance_fail = 0.1f;
+
+    int tile_rows = 64;
+
+    int encoder_wrap_bits = 16;
+};
+
+enum class DeviationClass : uint8_t
+{
+    NoData = 0,
+    Ok = 1,
+    Warn = 2,
+    Fail = 3
+};
+
+/**
+ * @brief Height map of the golden part of a recipe and the encoder value its scan started at.
+ */
+struct GoldenReference
+{
+    HeightMap map;
+    bool has_encoder = false;
+    int32_t encoder_first = 0;
+};
+
+struct GoldenCompareResult
+{
+    bool valid = false;
+    int recipe_id = -1;
+
+    // on the grid of the new scan: scan - golden (kInvalidZ without overlap) and its DeviationClass
+    cv::Mat deviation;  // CV_32FC1
+    cv::Mat classes;    // CV_8UC1
+
+    // golden cell = scan cell + offset; prior is where the encoder alone puts it
+    int offset_row = 0;
+    int offset_col = 0;
+    double prior_row = 0.0;
+    double prior_col = 0.0;
+
+    double mean_deviation = 0.0;
+    double rms_deviation = 0.0;
+    uint64_t ok_cells = 0;
+    uint64_t warn_cells = 0;
+    uint64_t fail_cells = 0;
+
+    double elapsed_ms = 0.0;
+};
+
+/**
+ * @brief Golden references per recipe id, kept in memory, and the comparison against them.
+ *
+ * References are immutable once stored, Compare() works on a shared snapshot so a
+ * reference can be replaced while a comparison is running.
+ */
+class GoldenCompare
+{
+public:
+    void SetParams(const GoldenCompareParams& params);
+
+    void SetReference(int recipe_id, const GoldenReference& reference);
+
+    bool HasReference(int recipe_id) const;
+
+    /**
+     * @brief Load every golden_<id>_height.tiff/.json of a directory.
+     *
+     * @return number of references loaded
+     */
+    int LoadReferences(const std::string& dir);
+
+    bool SaveReference(const std::string& dir, int recipe_id) const;
+
+    /**
+     * @brief Align a scan to the golden map of its recipe and build the deviation map.
+     *
+     * The prior offset comes from the grid origins plus the encoder difference of the two
+     * scans along the move direction, an exhaustive +-search_radius search refines it.
+     *
+     * @param move_per_pulse_x / _y travel of one encoder pulse along x / y (mm)
+     * @return 0 success, -1 no reference, -2 bad maps, -3 no offset with enough overlap
+     */
+    int Compare(int recipe_id, const HeightMap& scan, bool has_encoder, int32_t encoder_first,
+                double move_per_pulse_x, double move_per_pulse_y, GoldenCompareResult& out_result) const;
+
+    static std::string ReferenceFileName(const std::string& dir, int recipe_id);
+
+private:
+    mutable std::mutex mutex_;
+    std::map<int, std::shared_ptr<const GoldenReference>> references_;
+    GoldenCompareParams params_;
+};
+
+/**
+ * @brief Save the deviation map as float TIFF, the classes as 8 bit TIFF and a json summary.
+ *
+ * @param filename path without extension
+ */
+bool SaveGoldenComparison(const std::string& filename, const GoldenCompareResult& result);
+
+#endif
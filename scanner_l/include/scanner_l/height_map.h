@@ -0,0 +1,84 @@
+#ifndef HEIGHT_MAP_H
+#define HEIGHT_MAP_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief How several points falling into one cell are combined.
+ */
+enum class HeightMapReduce {
+    MAX = 0,  // default
+    MIN = 1,
+    MEAN = 2
+};
+
+// "max" / "min" / "mean", anything else maps to MAX
+HeightMapReduce HeightMapReduceFromString(const std::string& name);
+
+const char* HeightMapReduceName(HeightMapReduce reduce);
+
+struct HeightMapParams
+{
+    // cell size in x and y (mm)
+    double resolution = 0.05;
+
+    HeightMapReduce reduce = HeightMapReduce::MAX;
+
+    // grid rows handled by one parallel tile
+    int tile_rows = 64;
+
+    // refuse grids larger than this many cells
+    size_t max_cells = size_t(1) << 28;
+};
+
+/**
+ * @brief Orthographic Z height map on a regular XY grid.
+ *
+ * Cell (row, col) covers x in [origin_x + col * resolution, + resolution) and
+ * y in [origin_y + row * resolution, + resolution). Cells without points are
+ * kInvalidZ in `height` and 0 in `mask`.
+ */
+struct HeightMap
+{
+    cv::Mat height;  // CV_32FC1
+    cv::Mat mask;    // CV_8UC1, 255 = cell has data
+    double origin_x = 0.0;
+    double origin_y = 0.0;
+    double resolution = 0.0;
+    HeightMapReduce reduce = HeightMapReduce::MAX;
+};
+
+/**
+ * @brief Rasterize a point cloud into a height map.
+ *
+ * Points are binned into bands of tile_rows grid rows with a parallel counting
+ * sort, then every band is reduced by its own task, so no two tasks write the
+ * same cell. Points with an invalid z are ignored.
+ *
+ * @param xyz interleaved x, y, z floats (cv::Point3f / AIeveR_Point3F layout)
+ * @param num number of points
+ * @return 0 success, -1 no valid point, -2 grid too large or bad resolution
+ */
+int BuildHeightMap(const float* xyz, size_t num, const HeightMapParams& params, HeightMap& out_map);
+
+inline int BuildHeightMap(const std::vector<cv::Point3f>& pc, const HeightMapParams& params, HeightMap& out_map) {
+    return BuildHeightMap(reinterpret_cast<const float*>(pc.data()), pc.size(), params, out_map);
+}
+
+/**
+ * @brief Save the height as float TIFF and its grid placement as json.
+ *
+ * @param filename path without extension; writes <filename>.tiff and <filename>.json
+ */
+bool SaveHeightMap(const std::string& filename, const HeightMap& map);
+
+/**
+ * @brief Read a height map written by SaveHeightMap, the mask is rebuilt from the invalid markers.
+ *
+ * @param filename path without extension
+ */
+bool LoadHeightMap(const std::string& filename, HeightMap& out_map);
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef LIVE_PREVIEW_H
+#define LIVE_PREVIEW_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Single-producer / single-consumer "latest value" mailbox (triple buffer).
+ *
+ * The producer fills Back() and calls Publish(), the consumer calls Fetch() and reads
+ * Front(). Neither side ever waits: a value the consumer did not fetch in time is
+ * simply replaced by the next one. Slots are reused, so steady state does not allocate.
+ */
+template<typename T>
+class LatestMailbox
+{
+public:
+    T& Back() { return slots_[back_]; }
+
+    void Publish() {
+        const int prev = shared_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+        back_ = prev & kIndexMask;
+    }
+
+    // true if a value newer than the last fetched one was published, Front() then holds it
+    bool Fetch() {
+        if (!(shared_.load(std::memory_order_relaxed) & kFresh))
+            return false;
+        const int prev = shared_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & kIndexMask;
+        return true;
+    }
+
+    const T& Front() const { return slots_[front_]; }
+
+    // not concurrent with either side
+    void Reset() {
+        back_ = 0;
+        front_ = 1;
+        shared_.store(2, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int kFresh = 4;
+    static constexpr int kIndexMask = 3;
+
+    T slots_[3];
+    int back_ = 0;
+    int front_ = 1;
+    std::atomic<int> shared_{ 2 };
+};
+
+struct LivePreviewParams
+{
+    // points / lines averaged into one preview cell
+    int column_step = 8;
+    int row_step = 4;
+
+    // preview rows buffered between the acquisition thread and the UI
+    int ring_rows = 1024;
+};
+
+struct LiveProfile
+{
+    // lines received so far, the profile is the last of them
+    uint64_t line = 0;
+    int32_t encoder = 0;
+    std::vector<float> z;
+};
+
+/**
+ * @brief Preview channel from the batch callback to the UI while scanning.
+ *
+ * AddBatch() (acquisition thread) publishes the newest profile through a LatestMailbox
+ * and appends decimated rows to a bounded lock-free ring; it never blocks and drops
+ * preview rows when the ring is full. The consumer side (one UI thread) fetches the
+ * profile and pops the new rows to scroll them into a texture.
+ */
+class LivePreview
+{
+public:
+    // between scans only, not concurrent with AddBatch()
+    void Reset(bool enable, const LivePreviewParams& params, int width);
+
+    void AddBatch(const float* z, const int32_t* encoder, int width, int rows);
+
+    bool IsEnabled() const;
+
+    // true and out filled if a newer profile arrived since the last call
+    bool FetchProfile(LiveProfile& out);
+
+    /**
+     * @brief Move up to max_rows preview rows (RowWidth() z values each, kInvalidZ if empty) to out_rows.
+     *
+     * @return number of rows
+     */
+    int PopRows(std::vector<float>& out_rows, int max_rows);
+
+    int RowWidth() const;
+
+    uint64_t DroppedRows() const;
+
+    // rows waiting for PopRows()
+    uint64_t QueuedRows() const;
+
+private:
+    void PushRow();
+
+    // guards Reset() against the consumer side, the producer never takes it
+    mutable std::mutex consumer_mutex_;
+
+    std::atomic<bool> enable_{ false };
+    LivePreviewParams params_;
+    int width_ = 0;
+    int row_width_ = 0;
+    uint64_t line_count_ = 0;
+
+    LatestMailbox<LiveProfile> profile_;
+
+    // rows being averaged on the producer side
+    std::vector<float> acc_sum_;
+    std::vector<uint32_t> acc_count_;
+    int acc_rows_ = 0;
+
+    std::vector<float> ring_;
+    int ring_capacity_ = 0;
+    std::atomic<uint64_t> head_{ 0 };
+    std::atomic<uint64_t> tail_{ 0 };
+    std::atomic<uint64_t> dropped_{ 0 };
+};
+
+#endif
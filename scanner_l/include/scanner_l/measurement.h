@@ -0,0 +1,68 @@
+#ifndef MEASUREMENT_H
+#define MEASUREMENT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "scanner_l/height_map.h"
+#include "scanner_l/plane_fit.h"
+#include "scanner_l/motion_conf.h"
+
+struct MeasurementParams
+{
+    // base height used when no fitted plane is given (mm)
+    double base_z = 0.0;
+
+    // cells higher than this above the base belong to the part (mm)
+    float min_height = 0.05f;
+
+    // height percentiles reported per region, 0 - 100
+    std::vector<double> percentiles = { 5.0, 50.0, 95.0 };
+
+    int tile_rows = 64;
+};
+
+struct RegionMeasurement
+{
+    std::string name;
+    // valid cells inside the region / of those, cells above min_height
+    uint64_t valid_cells = 0;
+    uint64_t part_cells = 0;
+    // projected part area (mm^2) and volume above the base (mm^3)
+    double area = 0.0;
+    double volume = 0.0;
+    double mean_height = 0.0;
+    double max_height = 0.0;
+    // height above base of the part cells at MeasurementParams::percentiles
+    std::vector<double> percentile_heights;
+};
+
+struct MeasurementResult
+{
+    bool valid = false;
+    std::vector<double> percentiles;
+    // one entry per ROI polygon, a single "all" entry without ROIs
+    std::vector<RegionMeasurement> regions;
+    double elapsed_ms = 0.0;
+};
+
+/**
+ * @brief Volume, projected area and height percentiles of a height map above its base.
+ *
+ * The base is the fitted plane when base_plane is valid, MeasurementParams::base_z otherwise.
+ * Rows are reduced in parallel tiles with Kahan-compensated sums, the tile partials are
+ * merged in row order so the result does not depend on scheduling.
+ *
+ * @param base_plane may be nullptr
+ * @param rois polygons in map coordinates (mm), empty measures the whole map
+ * @return 0 success, -1 empty map
+ */
+int MeasureHeightMap(const HeightMap& map, const PlaneModel* base_plane, const std::vector<RoiPolygon>& rois,
+                     const MeasurementParams& params, MeasurementResult& out_result);
+
+/**
+ * @brief Write the measurement as json next to the saved scan files.
+ */
+bool SaveMeasurement(const std::string& filename, const MeasurementResult& result);
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Process-wide metrics registry.
+ *
+ * Producers look a metric up by name once and keep the pointer, which stays valid for
+ * the life of the process. Updating a metric is then a relaxed atomic operation, cheap
+ * enough for the batch callback. Readers take a MetricsSnapshot and difference two of
+ * them for rates and windowed percentiles; nothing is ever reset behind their back.
+ *
+ * Histograms are log-linear with 8 sub-buckets per power of two: a percentile is
+ * interpolated inside its bucket and off by at most 1/8 of its value.
+ */
+
+// fed by scanner_l
+constexpr const char* kMetricScanLines = "scan.lines";                    // counter, profile lines received
+constexpr const char* kMetricScanBatches = "scan.batches";                // counter, batches stored
+constexpr const char* kMetricScanDroppedFrames = "scan.dropped_frames";   // counter, gaps in the frame numbers
+constexpr const char* kMetricScanCallbackUs = "scan.callback_us";         // histogram, time spent in the batch callback
+constexpr const char* kMetricScanStitchMs = "scan.stitch_ms";             // histogram, stitching in End()
+constexpr const char* kMetricScanGetAllDataMs = "scan.get_all_data_ms";   // histogram
+// fed by the saving code
+constexpr const char* kMetricSaveBytes = "io.save_bytes";                 // counter
+constexpr const char* kMetricSaveMs = "io.save_ms";                       // histogram, one sample per scan
+constexpr const char* kMetricSaveMBps = "io.save_mb_per_s";               // gauge, throughput of the last save
+// queue depths (gauges), sampled by their owners
+constexpr const char* kMetricQueueCommands = "queue.commands";
+constexpr const char* kMetricQueueLog = "queue.log";
+constexpr const char* kMetricQueuePreviewRows = "queue.preview_rows";
+constexpr const char* kMetricQueueHistoryTasks = "queue.history_tasks";
+// process
+constexpr const char* kMetricUiFrameMs = "ui.frame_ms";                   // histogram, CPU time of a UI frame
+
+class MetricCounter
+{
+public:
+    void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{ 0 };
+};
+
+class MetricGauge
+{
+public:
+    void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+
+    double Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{ 0.0 };
+};
+
+struct HistogramSnapshot
+{
+    std::vector<uint64_t> buckets;  // MetricHistogram::kBucketCount entries, empty without samples
+    uint64_t count = 0;
+    double sum = 0.0;
+
+    double Mean() const;
+
+    // p in [0, 1]; 0 without samples
+    double Percentile(double p) const;
+
+    // samples recorded between earlier and this snapshot of the same histogram
+    HistogramSnapshot Since(const HistogramSnapshot& earlier) const;
+};
+
+class MetricHistogram
+{
+public:
+    static constexpr int kSubBuckets = 8;
+    static constexpr int kOctaves = 40;  // values up to 2^40, larger ones land in the last bucket
+    // bucket 0 holds [0, 1)
+    static constexpr int kBucketCount = 1 + kOctaves * kSubBuckets;
+
+    // negative values count as 0
+    void Record(double value);
+
+    void Snapshot(HistogramSnapshot& out) const;
+
+    static int BucketIndex(double value);
+
+    // lower bound of a bucket, BucketLower(i + 1) is its upper bound
+    static double BucketLower(int index);
+
+private:
+    std::atomic<uint64_t> buckets_[kBucketCount] = {};
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<double> sum_{ 0.0 };
+};
+
+struct MetricsSnapshot
+{
+    double seconds = 0.0;  // steady clock
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, double> gauges;
+    std::map<std::string, HistogramSnapshot> histograms;
+
+    // 0 / empty for metrics nobody registered yet
+    uint64_t CounterValue(const std::string& name) const;
+
+    double GaugeValue(const std::string& name) const;
+
+    HistogramSnapshot HistogramValue(const std::string& name) const;
+};
+
+class MetricsRegistry
+{
+public:
+    // registers the metric on first use; the same name always returns the same object
+    MetricCounter* Counter(const std::string& name);
+
+    MetricGauge* Gauge(const std::string& name);
+
+    MetricHistogram* Histogram(const std::string& name);
+
+    void Snapshot(MetricsSnapshot& out) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<MetricCounter>> counters_;
+    std::map<std::string, std::unique_ptr<MetricGauge>> gauges_;
+    std::map<std::string, std::unique_ptr<MetricHistogram>> histograms_;
+};
+
+MetricsRegistry& Metrics();
+
+// Records the time until destruction into a histogram, scale converts seconds (1000 = ms, 1e6 = us).
+class ScopedMetricTimer
+{
+public:
+    explicit ScopedMetricTimer(MetricHistogram* histogram, double scale = 1000.0)
+        : histogram_(histogram), scale_(scale), start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedMetricTimer() { histogram_->Record(Elapsed()); }
+
+    ScopedMetricTimer(const ScopedMetricTimer&) = delete;
+    ScopedMetricTimer& operator=(const ScopedMetricTimer&) = delete;
+
+    // in units of scale
+    double Elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count() * scale_;
+    }
+
+private:
+    MetricHistogram* histogram_;
+    double scale_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// resident set size of the process in bytes, 0 if unknown
+size_t GetProcessRssBytes();
+
+#endif
@@ -39,6 +39,28 @@ struct YCoordInfo
 };
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(YCoordInfo, highest_pt, lowest_pt, scanner_design_pt)
 
+/**
+* @brief 测量区域顶点, 高度图坐标系, 单位mm
+*
+*/
+struct RoiPoint
+{
+    float x = 0.0f;
+    float y = 0.0f;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RoiPoint, x, y)
+
+/**
+* @brief 测量区域(多边形)
+*
+*/
+struct RoiPolygon
+{
+    std::string name = "";
+    std::vector<RoiPoint> points;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RoiPolygon, name, points)
+
 /**
 * @brief 配方信息
 *
@@ -50,9 +72,32 @@ struct Solution
     int set_speed = 100;
     XCoordInfo x_coord_info;
     YCoordInfo y_coord_info;
+    // 体积/面积测量区域, 为空时测量整幅高度图
+    std::vector<RoiPolygon> roi_polygons;
 
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Solution, id, name, x_coord_info, y_coord_info)
+
+inline void to_json(nlohmann::json& j, const Solution& sol)
+{
+    j["id"] = sol.id;
+    j["name"] = sol.name;
+    j["x_coord_info"] = sol.x_coord_info;
+    j["y_coord_info"] = sol.y_coord_info;
+    j["roi_polygons"] = sol.roi_polygons;
+}
+
+inline void from_json(const nlohmann::json& j, Solution& sol)
+{
+    j.at("id").get_to(sol.id);
+    j.at("name").get_to(sol.name);
+    j.at("x_coord_info").get_to(sol.x_coord_info);
+    j.at("y_coord_info").get_to(sol.y_coord_info);
+    // 旧配方文件没有测量区域
+    if (j.contains("roi_polygons"))
+    {
+        j.at("roi_polygons").get_to(sol.roi_polygons);
+    }
+}
 
 
 /**
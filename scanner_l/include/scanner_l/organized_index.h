@@ -0,0 +1,88 @@
+#ifndef ORGANIZED_INDEX_H
+#define ORGANIZED_INDEX_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Nearest / radius queries in the XY plane of an organized scan, without a kd-tree.
+ *
+ * Every profile line lies at (almost) one y given by the encoder, and x runs along
+ * the columns. Build() records per row the x / y bounds of its valid points in one
+ * pass and sorts the rows by y, so a query finds its first candidate rows with a
+ * binary search over rows and the points inside a row with a binary search over x
+ * (rising or falling). Rows whose x is not monotonic fall back to a scan of the row.
+ *
+ * The index does not copy the cloud, it must stay alive and unchanged while queried.
+ * Queries are const and may run concurrently.
+ */
+class OrganizedIndex
+{
+public:
+    /**
+     * @param pc rows profiles of width points, row major, invalid z allowed
+     * @return 0 success, -1 bad parameters
+     */
+    int Build(const cv::Point3f* pc, int width, int rows);
+
+    void Clear();
+
+    bool Empty() const;
+
+    /**
+     * @brief Closest valid point to (x, y) in the XY plane.
+     *
+     * @param max_dist search radius (mm), <= 0 searches the whole scan
+     * @return point index (row * width + column), -1 none within max_dist
+     */
+    int64_t Nearest(float x, float y, float max_dist, float* out_dist = nullptr) const;
+
+    /**
+     * @brief All valid points within radius of (x, y) in the XY plane, in scan order.
+     *
+     * @return number of points found
+     */
+    int RadiusSearch(float x, float y, float radius, std::vector<int64_t>& out_indices,
+                     std::vector<float>* out_sqr_dists = nullptr) const;
+
+    /**
+     * @brief Height of the closest valid point within max_dist, for picking.
+     */
+    bool HeightAt(float x, float y, float max_dist, float& out_z) const;
+
+    const cv::Point3f* Points() const { return pc_; }
+
+    int Width() const { return width_; }
+
+    int Rows() const { return rows_; }
+
+private:
+    struct RowBounds
+    {
+        float y_min;
+        float y_max;
+        float x_min;
+        float x_max;
+        // valid columns lie in [first, last]
+        int first;
+        int last;
+        // +1 / -1 when x rises / falls along the columns, 0 not monotonic
+        float x_dir;
+    };
+
+    // first valid column in [lo, hi) with dir * x >= key, hi if none
+    int LowerBound(const cv::Point3f* row, int lo, int hi, float dir, float key) const;
+
+    const cv::Point3f* pc_ = nullptr;
+    int width_ = 0;
+    int rows_ = 0;
+    std::vector<RowBounds> bounds_;
+    // rows with valid points sorted by y_min, and their y_min for the binary search
+    std::vector<int> order_;
+    std::vector<float> order_y_;
+    // largest y extent of a single row
+    float max_row_span_ = 0.0f;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef ORGANIZED_NORMALS_H
+#define ORGANIZED_NORMALS_H
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+/*
+ * Surface normals on the organized scan (rows profiles of width points, row major).
+ * The normal of a point is the cross product of its row tangent (right - left
+ * neighbor) and column tangent (next - previous line). A neighbor that is invalid,
+ * outside the scan or across a depth jump is not used; the tangent then falls back
+ * to the one-sided difference, and without any tangent along a direction the point
+ * gets no normal.
+ */
+
+struct NormalEstimationParams
+{
+    // distance of the neighbors in points / lines, larger smooths the normals
+    int step = 1;
+
+    // neighbors farther than this in z (mm) lie on another surface, <= 0 disables
+    float max_depth_jump = 0.5f;
+
+    // flip every normal to n.z >= 0, i.e. towards the sensor
+    bool orient_up = true;
+};
+
+/**
+ * @brief Unit normal per point, (0, 0, 0) where none can be estimated.
+ *
+ * Rows run in parallel, the common all-neighbors-valid case is vectorized.
+ *
+ * @param out_normals width * rows entries, same layout as pc
+ * @return number of valid normals, -1 bad parameters
+ */
+int EstimateOrganizedNormals(const cv::Point3f* pc, int width, int rows, const NormalEstimationParams& params,
+                             cv::Point3f* out_normals);
+
+/**
+ * @brief Same as EstimateOrganizedNormals() but stored octahedral-encoded, 4 instead of 12 bytes per point.
+ *
+ * @param out_packed width * rows entries, kNoPackedNormal where there is no normal
+ */
+int EstimateOrganizedNormalsPacked(const cv::Point3f* pc, int width, int rows, const NormalEstimationParams& params,
+                                   uint32_t* out_packed);
+
+// Packed value of a point without normal
+constexpr uint32_t kNoPackedNormal = 0;
+
+/**
+ * @brief Octahedral encoding of a unit normal, two 16 bit unorm coordinates (u low, v high).
+ *
+ * The angular error is below 0.01 degree. A zero vector encodes to kNoPackedNormal.
+ */
+uint32_t PackNormal(const cv::Point3f& n);
+
+// kNoPackedNormal decodes to (0, 0, 0)
+cv::Point3f UnpackNormal(uint32_t packed);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef OUTLIER_FILTER_H
+#define OUTLIER_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+enum class OutlierMethod
+{
+    Median = 0,
+    Mean
+};
+
+OutlierMethod OutlierMethodFromString(const std::string& name);
+const char* OutlierMethodName(OutlierMethod method);
+
+struct OutlierFilterParams
+{
+    OutlierMethod method = OutlierMethod::Median;
+
+    // odd side of the row/column neighborhood, 3 - 15
+    int window = 5;
+
+    // |z - local median/mean| above this is an outlier (mm)
+    float threshold = 0.5f;
+
+    // a point with fewer valid neighbors than this is an outlier (isolated speckle)
+    int min_neighbors = 3;
+
+    // rows per parallel task
+    int tile_rows = 32;
+};
+
+/**
+ * @brief Flag spikes and speckle of an organized cloud from its k x k row/column neighborhood.
+ *
+ * Only z is compared, neighbors and the center must be valid. The decision is made on
+ * the input as a whole, flagging one point does not change the statistics of the others.
+ * Both statistics exclude the center. The mean is computed with SIMD box sums, O(1) per
+ * point. The median sorts the k*k - 1 neighbors of a whole SIMD vector of columns with one
+ * sorting network (130 compare-exchanges for k = 5, 3300 for k = 15), so its cost
+ * grows with the window; prefer small windows or the mean on long scans.
+ *
+ * @param pc organized cloud, rows * width points
+ * @param out_mask rows * width, 1 where the point is an outlier
+ * @return number of outliers, -1 bad parameters
+ */
+int FindOutliers(const cv::Point3f* pc, int width, int rows, const OutlierFilterParams& params,
+                 std::vector<uint8_t>& out_mask);
+
+/**
+ * @brief Set z of every masked point to kInvalidZ, the cloud stays organized.
+ */
+void MarkOutliersInvalid(cv::Point3f* pc, size_t num, const std::vector<uint8_t>& mask);
+
+/**
+ * @brief Drop the masked entries of a per-point array, keeping the order of the rest.
+ *
+ * @return false and values untouched if the sizes differ
+ */
+template<typename T>
+bool RemoveMasked(std::vector<T>& values, const std::vector<uint8_t>& mask) {
+    if (values.size() != mask.size())
+        return false;
+    size_t out = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        if (!mask[i])
+            values[out++] = values[i];
+    }
+    values.resize(out);
+    return true;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PLANE_FIT_H
+#define PLANE_FIT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+struct PlaneFitParams
+{
+    // RANSAC samples every grid_step-th row and column of the organized cloud
+    int grid_step = 8;
+
+    int iterations = 256;
+
+    // |distance| below this is an inlier (mm)
+    float inlier_threshold = 0.1f;
+
+    // least-squares passes on the inliers of the best hypothesis
+    int refine_iterations = 2;
+
+    // fewer inliers than this and the fit is rejected
+    int min_inliers = 100;
+
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+};
+
+/**
+ * @brief Plane nx * x + ny * y + nz * z + d = 0 with a unit normal, nz >= 0.
+ */
+struct PlaneModel
+{
+    bool valid = false;
+    double nx = 0.0;
+    double ny = 0.0;
+    double nz = 1.0;
+    double d = 0.0;
+    // decimated samples supporting the plane and their rms distance
+    int inliers = 0;
+    double rms = 0.0;
+};
+
+/**
+ * @brief Fit the dominant (base) plane of an organized cloud.
+ *
+ * RANSAC hypotheses are scored in parallel with a SIMD kernel on a decimated
+ * grid, the best one is refined by least squares on its inliers.
+ *
+ * @param pc organized cloud, rows * width points, invalid z allowed
+ * @return 0 success, -1 not enough valid samples, -2 no plane with min_inliers support
+ */
+int FitBasePlane(const cv::Point3f* pc, int width, int rows, const PlaneFitParams& params, PlaneModel& out_plane);
+
+/**
+ * @brief Signed distance of every point to the plane (SIMD, parallel).
+ *
+ * @param out_residual num floats, kInvalidZ where the point is invalid
+ */
+void PlaneResidual(const cv::Point3f* pc, size_t num, const PlaneModel& plane, float* out_residual);
+
+/**
+ * @brief Replace z by the signed distance to the plane, x and y are kept.
+ */
+void RemovePlaneInPlace(cv::Point3f* pc, size_t num, const PlaneModel& plane);
+
+/**
+ * @brief Save the residual map as float TIFF and the plane as json.
+ *
+ * @param filename path without extension; writes <filename>.tiff (if the map is not empty) and <filename>.json
+ */
+bool SavePlaneFit(const std::string& filename, const PlaneModel& plane, const cv::Mat& residual);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include "scanner_l/plane_fit.h"
+#include "scanner_l/outlier_filter.h"
+#include "scanner_l/range_image_filter.h"
+
+/**
+ * @brief Post-scan pipeline configuration, read from scanner_x.json.
+ *
+ * Every key is optional; a missing key keeps the default below so older
+ * configuration files load unchanged.
+ */
+struct PostProcessConfig
+{
+    // transform the cloud with multi_calib_rt before any other stage
+    bool apply_multi_calib_rt = false;
+
+    bool outlier_filter_enable = false;
+    // "mark_invalid": outliers get kInvalidZ, "remove": outliers are dropped and the cloud is no longer organized
+    std::string outlier_filter_action = "mark_invalid";
+    OutlierFilterParams outlier_filter;
+
+    // despike / hole fill / smoothing, each kernel is off while its parameter keeps the default
+    RangeFilterParams range_filter;
+
+    bool plane_fit_enable = false;
+    // "in_place": z becomes the distance to the plane, "residual": keep the cloud, produce a residual map
+    std::string plane_fit_output = "residual";
+    PlaneFitParams plane_fit;
+
+    void LoadFromJson(const nlohmann::json& data);
+};
+
+/**
+ * @brief Side products of the pipeline for one scanner.
+ */
+struct PostProcessResult
+{
+    int outliers = 0;
+    // rows x width, only kept in "remove" mode so the caller can drop the matching gray/encoder/frame entries
+    std::vector<uint8_t> outlier_mask;
+    // false once points were removed, the cloud can no longer be saved as an image
+    bool organized = true;
+
+    PlaneModel plane;
+    // rows x width CV_32FC1, only filled in "residual" mode
+    cv::Mat plane_residual;
+};
+
+/**
+ * @brief Apply the 4x4 RT matrix (CV_64FC1) to every valid point.
+ */
+void TransformValidPoints(std::vector<cv::Point3f>& pc, const cv::Mat& rt);
+
+/**
+ * @brief Run the enabled stages on one organized cloud in order.
+ *
+ * @param pc organized cloud, modified in place
+ * @param width points per line
+ * @param rt multi_calib_rt of the scanner
+ * @return 0 success, otherwise the status of the first failing stage
+ */
+int RunPostProcess(std::vector<cv::Point3f>& pc, int width, const cv::Mat& rt,
+                   const PostProcessConfig& config, PostProcessResult& out_result);
+
+#endif
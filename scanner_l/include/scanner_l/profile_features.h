@@ -0,0 +1,99 @@
+#ifndef PROFILE_FEATURES_H
+#define PROFILE_FEATURES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ProfileFeatureParams
+{
+    // z(c + span) - z(c - span) is the gradient at column c
+    int gradient_span = 2;
+
+    // |gradient| above high starts an edge, the edge grows while |gradient| stays above low (mm)
+    float gradient_high = 0.3f;
+    float gradient_low = 0.1f;
+
+    // points on each side of an edge averaged into the plateau heights
+    int plateau_width = 8;
+
+    // edges whose plateaus differ by less than this are dropped (mm)
+    float min_step_height = 0.1f;
+};
+
+/**
+ * @brief One edge of a profile line.
+ *
+ * width is the distance to the next edge of the same line, i.e. the width of the
+ * plateau the edge opens (a raised segment for polarity +1, a lowered one for -1).
+ */
+struct ProfileFeature
+{
+    uint32_t line = 0;
+    int32_t encoder = 0;
+    // gradient weighted edge column (sub point)
+    float column = 0.0f;
+    // +1 step up, -1 step down along the profile
+    int8_t polarity = 0;
+    // right plateau - left plateau (mm)
+    float step_height = 0.0f;
+    // mm when x is available, columns otherwise; 0 for the last edge of a line
+    float width = 0.0f;
+};
+
+using ProfileFeatureCallback = std::function<void(const ProfileFeature* features, size_t num)>;
+
+/**
+ * @brief Detect the edges of every line of a batch (lines run in parallel).
+ *
+ * @param z decoded z values, rows * width
+ * @param xyz decoded points (x, y, z packed), rows * width, may be nullptr
+ * @param encoder encoder value per line, may be nullptr
+ * @param first_line line index of the first row
+ * @param out_features features appended in line order, then column order
+ * @return number of features appended
+ */
+size_t ExtractProfileFeatures(const float* z, const float* xyz, const int32_t* encoder,
+                              int width, int rows, uint32_t first_line,
+                              const ProfileFeatureParams& params, std::vector<ProfileFeature>& out_features);
+
+/**
+ * @brief Write the features as csv next to the saved scan files.
+ */
+bool SaveProfileFeatures(const std::string& filename, const std::vector<ProfileFeature>& features);
+
+/**
+ * @brief Feature stream of the running scan, fed by the batch callback.
+ *
+ * Every batch is handed to the callback as soon as it is extracted, and kept
+ * for GetFeatures() / saving once the scan has ended.
+ */
+class ProfileFeatureExtractor
+{
+public:
+    void Reset(bool enable, const ProfileFeatureParams& params);
+
+    // called on the acquisition thread, keep it short
+    void SetCallback(ProfileFeatureCallback callback);
+
+    void AddBatch(const float* z, const float* xyz, const int32_t* encoder, int width, int rows);
+
+    bool IsEnabled() const;
+
+    std::vector<ProfileFeature> Snapshot() const;
+
+private:
+    mutable std::mutex mutex_;
+    bool enable_ = false;
+    ProfileFeatureParams params_;
+    uint32_t line_count_ = 0;
+    std::vector<ProfileFeature> features_;
+
+    std::mutex callback_mutex_;
+    ProfileFeatureCallback callback_;
+};
+
+#endif
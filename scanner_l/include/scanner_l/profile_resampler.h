@@ -0,0 +1,142 @@
+#ifndef PROFILE_RESAMPLER_H
+#define PROFILE_RESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+#include "../../SDK_C++/include/AIeveR.h"
+#include "scanner_l/range_image.h"
+
+using namespace AIeveR::Device;
+
+/**
+ * @brief Parameters of the encoder driven resampler.
+ *
+ * dist_per_pulse has the same meaning as the value passed to the SDK's
+ * setDistInterval() (profile_stitch_distance in scanner_x.json), move_dir is
+ * the mp_calib_factor_* motion vector.
+ */
+struct ProfileResamplerParams
+{
+    // points per profile line
+    int data_width = kDefaultDataWidth;
+
+    // travel per encoder pulse (mm)
+    double dist_per_pulse = 0.05;
+
+    // spacing of the output lines (mm)
+    double pitch = 0.05;
+
+    // width of the hardware encoder counter, 0 disables unwrapping
+    int encoder_wrap_bits = 16;
+
+    // motion direction of the platform in scanner coordinates
+    double move_dir_x = 0.0;
+    double move_dir_y = 1.0;
+    double move_dir_z = 0.0;
+
+    // output lines handled by one parallel task
+    int block_rows = 64;
+};
+
+/**
+ * @brief Unwrap the raw encoder counter into a continuous pulse count.
+ *
+ * The step between two lines is taken modulo 2^wrap_bits and mapped to
+ * [-2^(wrap_bits-1), 2^(wrap_bits-1)), so both forward and backward
+ * overflow are handled. The first line keeps its raw value.
+ *
+ * @param encoder raw encoder value of every line
+ * @param num number of lines
+ * @param wrap_bits counter width, 0 returns the raw values
+ * @param out_pulses unwrapped values, resized to num
+ */
+void UnwrapEncoder(const int32_t* encoder, size_t num, int wrap_bits, std::vector<int64_t>& out_pulses);
+
+/**
+ * @brief Signed pulse count from `from` to `to` on a wrapping counter.
+ */
+int64_t EncoderStep(int32_t from, int32_t to, int wrap_bits);
+
+/**
+ * @brief Reverse the line order of a scan in place (points, gray, encoder, frame).
+ *
+ * Used for the return stroke of a bidirectional scan so that its lines are
+ * ordered like the outbound stroke before stitching.
+ *
+ * @param gray may be empty
+ * @param frame may be empty
+ */
+void ReverseProfileLines(std::vector<AIeveR_Point3F>& pc, std::vector<uint8_t>& gray,
+                         std::vector<int32_t>& encoder, std::vector<uint32_t>& frame, int data_width);
+
+/**
+ * @brief Add an offset to every valid point, invalid markers are left untouched.
+ */
+void OffsetValidPoints(std::vector<AIeveR_Point3F>& pc, float dx, float dy, float dz);
+
+/**
+ * @brief Deviation between two stitched clouds of identical layout.
+ */
+struct StitchCompareResult
+{
+    bool size_match = false;
+    uint64_t compared_points = 0;
+    double max_deviation = 0.0;
+    double mean_deviation = 0.0;
+};
+
+StitchCompareResult CompareStitchedClouds(const std::vector<AIeveR_Point3F>& reference,
+                                          const std::vector<AIeveR_Point3F>& result);
+
+/**
+ * @brief Replacement for PostProcessing::ProfileStitch.
+ *
+ * Line travel is derived from the unwrapped encoder values; all work is split
+ * over blocks of lines with cv::parallel_for_ and writes straight into the
+ * output buffers, so no intermediate copy of the cloud is made.
+ */
+class ProfileResampler
+{
+public:
+    explicit ProfileResampler(const ProfileResamplerParams& params);
+
+    /**
+     * @brief Offset every line along the motion direction by its own travel,
+     *        without changing the line count (what ProfileStitch does).
+     *
+     * @return 0 success, -1 point count does not match lines * data_width
+     */
+    int Stitch(const std::vector<AIeveR_Point3F>& in_pc,
+               const std::vector<int32_t>& in_encoder,
+               std::vector<AIeveR_Point3F>& out_pc) const;
+
+    /**
+     * @brief Interpolate the profiles onto lines spaced exactly `pitch` apart.
+     *
+     * Each output line lies between two input lines and is blended linearly
+     * per column when both neighbours are valid; otherwise the nearer input
+     * point is copied (invalid markers included). Gray, encoder and frame
+     * values are taken from the nearer input line. Lines that do not advance
+     * the travel (encoder standstill or jitter against the scan direction)
+     * are skipped.
+     *
+     * @param in_gray may be empty
+     * @return 0 success, -1 input sizes do not match, -2 fewer than two usable lines
+     */
+    int Resample(const std::vector<AIeveR_Point3F>& in_pc,
+                 const std::vector<uint8_t>& in_gray,
+                 const std::vector<int32_t>& in_encoder,
+                 const std::vector<uint32_t>& in_frame,
+                 std::vector<AIeveR_Point3F>& out_pc,
+                 std::vector<uint8_t>& out_gray,
+                 std::vector<int32_t>& out_encoder,
+                 std::vector<uint32_t>& out_frame) const;
+
+private:
+    // travel of every line relative to the first one (mm)
+    void LineTravel(const std::vector<int32_t>& in_encoder, std::vector<double>& out_travel) const;
+
+    ProfileResamplerParams params_;
+};
+
+#endif
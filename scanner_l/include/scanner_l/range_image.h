@@ -0,0 +1,25 @@
+#ifndef RANGE_IMAGE_H
+#define RANGE_IMAGE_H
+
+/**
+ * @brief Helpers shared by the organized-scan (range image) processing stages.
+ *
+ * The L-series profiler marks rejected points with z = -999, -998 or -997,
+ * each value carrying a different meaning. Any z at or below -997 is treated
+ * as invalid; NaN compares false and is therefore invalid as well.
+ */
+
+// Number of points per profile line (L10400 / L10050: data_width = 3200)
+constexpr int kDefaultDataWidth = 3200;
+
+// Marker written by our own stages when they invalidate a point
+constexpr float kInvalidZ = -999.0f;
+
+// z <= kInvalidZThreshold is invalid
+constexpr float kInvalidZThreshold = -997.0f;
+
+inline bool IsValidZ(float z) {
+    return z > kInvalidZThreshold;
+}
+
+#endif
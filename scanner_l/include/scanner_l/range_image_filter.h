@@ -0,0 +1,74 @@
+#ifndef RANGE_IMAGE_FILTER_H
+#define RANGE_IMAGE_FILTER_H
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+/*
+ * In-place kernels on the organized scan (rows profiles of width points, row major).
+ * Rows run in parallel; column passes work on row tiles that read a snapshot of the
+ * neighbouring tiles' border rows, so the result does not depend on scheduling.
+ */
+
+enum class RangeSmoothMethod
+{
+    None = 0,
+    Bilateral,
+    Median
+};
+
+RangeSmoothMethod RangeSmoothMethodFromString(const std::string& name);
+const char* RangeSmoothMethodName(RangeSmoothMethod method);
+
+struct RangeFilterParams
+{
+    // longest run of invalid points closed by linear interpolation, 0 disables
+    int fill_max_gap = 0;
+
+    // single point spikes along a profile above this (mm) are replaced, 0 disables
+    float despike_threshold = 0.0f;
+
+    RangeSmoothMethod smooth = RangeSmoothMethod::None;
+    // odd window of the separable smoother, 3 - 15
+    int smooth_window = 5;
+    // bilateral spatial sigma in points
+    float smooth_sigma_space = 1.5f;
+    // bilateral range support (mm), neighbors farther than this in z get no weight
+    float smooth_sigma_range = 0.2f;
+
+    int tile_rows = 32;
+};
+
+/**
+ * @brief Close invalid runs of at most max_gap points bounded by valid points on both sides.
+ *
+ * x, y and z are interpolated linearly, first along the profiles, then along the columns.
+ */
+void FillRangeHoles(cv::Point3f* pc, int width, int rows, int max_gap, int tile_rows = 32);
+
+/**
+ * @brief Replace single point spikes of every profile with the mean of their two neighbors.
+ *
+ * A point is a spike when both neighbors are valid, agree within threshold, and
+ * the point is farther than threshold from their mean.
+ * @return number of replaced points
+ */
+int DespikeProfiles(cv::Point3f* pc, int width, int rows, float threshold);
+
+/**
+ * @brief Separable edge-preserving smoothing of z, profile pass then column pass.
+ *
+ * Bilateral uses a Gaussian spatial weight and a truncated quadratic range weight
+ * max(0, 1 - (dz / sigma_range)^2), which keeps the kernel in plain SIMD arithmetic.
+ * Median takes the median of the valid points of each 1D window. Invalid points are kept.
+ */
+void SmoothRangeImage(cv::Point3f* pc, int width, int rows, const RangeFilterParams& params);
+
+/**
+ * @brief Run the enabled kernels in the order despike, fill, smooth.
+ *
+ * @return 0 success, -1 bad parameters
+ */
+int FilterRangeImage(cv::Point3f* pc, int width, int rows, const RangeFilterParams& params);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef RANGE_PYRAMID_H
+#define RANGE_PYRAMID_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief 2x decimated levels of the organized range image and gray image.
+ *
+ * Rows are appended as batches arrive; as soon as two rows of a level exist
+ * they are reduced into one row of the next level, so coarse levels are
+ * always up to date and the full resolution data is never read again.
+ *
+ * Each output cell is the mean of the valid z values of its 2x2 children
+ * (kInvalidZ if none is valid) and the mean of their gray values. Level 0 is
+ * the input itself and is not stored; GetLevel() serves levels 1..NumLevels().
+ * Row r of level l covers input rows [r * 2^l, (r + 1) * 2^l).
+ */
+class RangePyramid
+{
+public:
+    /**
+     * @brief Drop all data; the width is taken from the next AppendRows().
+     *
+     * @param num_levels number of decimated levels kept (1 = half resolution only)
+     */
+    void Reset(int num_levels);
+
+    /**
+     * @brief Append full-resolution rows.
+     *
+     * @param z decoded z values, rows * width
+     * @param gray gray values, rows * width, may be nullptr
+     * @return 0 success, -1 width differs from the rows already appended
+     */
+    int AppendRows(const float* z, const uint8_t* gray, int width, int rows);
+
+    int NumLevels() const;
+
+    // rows currently available at a level (1..NumLevels())
+    int Rows(int level) const;
+
+    /**
+     * @brief Copy one level out.
+     *
+     * @param out_z CV_32FC1
+     * @param out_gray CV_8UC1
+     * @return 0 success, -1 level out of range, -2 level has no rows yet
+     */
+    int GetLevel(int level, cv::Mat& out_z, cv::Mat& out_gray) const;
+
+private:
+    struct Level
+    {
+        int width = 0;
+        std::vector<float> z;
+        std::vector<uint8_t> gray;
+        // row waiting for its partner before the next level can be produced
+        std::vector<float> pending_z;
+        std::vector<uint8_t> pending_gray;
+        bool has_pending = false;
+    };
+
+    // levels_[0] holds the input pending row only, levels_[i] holds level i
+    void PushRow(int level, const float* z, const uint8_t* gray);
+
+    mutable std::mutex mutex_;
+    int num_levels_ = 0;
+    std::vector<Level> levels_;
+};
+
+#endif
@@ -15,6 +15,7 @@
 
 HANDLE shared_file_handler_gray = NULL;
 HANDLE shared_file_handler_pc = NULL;
+HANDLE shared_file_handler_height = NULL;
 HANDLE hFile_gray = NULL;
 HANDLE hFile_pc = NULL;
 
@@ -295,5 +296,63 @@ int writeMemory_pc(cv::Mat img, const std::string obj_name, const std::string fi
     return 0;
 }
 
+int writeMemory_height(cv::Mat img, const std::string obj_name, uint64& mem_size) {
+    // same layout as writeMemory_pc: width, height, channels, mat_type, then CV_32FC1 pixels
+    LOG(INFO) << "Img type: height map\n";
+    if (img.empty()) {
+        LOG(ERROR) << "height map is empty\n";
+        return -1;
+    }
+
+    int width = img.cols;
+    int height = img.rows;
+    int channels = img.channels();
+    int mat_type = img.type();
+    size_t data_size = img.total() * img.elemSize();
+    size_t header_size = 4 * sizeof(int);
+    size_t buffer_size = data_size + header_size;
+
+    // a new scan replaces the previous mapping
+    if (shared_file_handler_height) {
+        CloseHandle(shared_file_handler_height);
+        shared_file_handler_height = NULL;
+    }
+    shared_file_handler_height = CreateFileMapping(
+        INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+        static_cast<DWORD>(buffer_size), obj_name.c_str());
+    if (!shared_file_handler_height) {
+        LOG(ERROR) << "CreateFileMapping failed with error: " << GetLastError();
+        return -2;
+    }
+
+    LPVOID lp_base = MapViewOfFile(shared_file_handler_height, FILE_MAP_ALL_ACCESS, 0, 0, buffer_size);
+    if (lp_base == NULL) {
+        LOG(ERROR) << "MapViewOfFile failed with error: " << GetLastError();
+        CloseHandle(shared_file_handler_height);
+        shared_file_handler_height = NULL;
+        return -3;
+    }
+
+    char* ptr = static_cast<char*>(lp_base);
+    memcpy(ptr, &width, sizeof(int));
+    ptr += sizeof(int);
+    memcpy(ptr, &height, sizeof(int));
+    ptr += sizeof(int);
+    memcpy(ptr, &channels, sizeof(int));
+    ptr += sizeof(int);
+    memcpy(ptr, &mat_type, sizeof(int));
+    ptr += sizeof(int);
+    // the Mat may be a ROI, copy row by row
+    for (int row = 0; row < height; row++) {
+        memcpy(ptr, img.ptr(row), width * img.elemSize());
+        ptr += width * img.elemSize();
+    }
+
+    FlushViewOfFile(lp_base, buffer_size);
+    UnmapViewOfFile(lp_base);
+    mem_size = buffer_size;
+    return 0;
+}
+
 
 #endif
\ No newline at end of file
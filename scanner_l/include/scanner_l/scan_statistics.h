@@ -0,0 +1,108 @@
+#ifndef SCAN_STATISTICS_H
+#define SCAN_STATISTICS_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Scan-level statistics, built batch by batch on the acquisition path.
+ *
+ * Every field is a plain reduction (count / min / max / sum / histogram), so two
+ * partial results can be merged in any grouping; this is what lets each decode
+ * worker build its own partial and fold it in once per batch.
+ */
+struct ScanStatistics
+{
+    // points received / points with a valid z
+    uint64_t total_points = 0;
+    uint64_t valid_points = 0;
+
+    // height range and sum over valid points
+    float min_z = 0.0f;
+    float max_z = 0.0f;
+    double sum_z = 0.0;
+
+    // profile lines and batches received
+    uint64_t line_count = 0;
+    uint64_t batch_count = 0;
+
+    // encoder values of the first / last line and their range
+    bool has_encoder = false;
+    int32_t encoder_first = 0;
+    int32_t encoder_last = 0;
+    int32_t encoder_min = 0;
+    int32_t encoder_max = 0;
+
+    std::array<uint64_t, 256> gray_histogram{};
+
+    // set by ScanStatisticsAccumulator::Finalize() at End()
+    bool finalized = false;
+
+    void Reset();
+
+    /**
+     * @brief Reduce a block of decoded z values (SIMD when available).
+     *
+     * @param z decoded z values, invalid markers included
+     * @param num number of values
+     */
+    void AccumulateZ(const float* z, size_t num);
+
+    void AccumulateGray(const uint8_t* gray, size_t num);
+
+    void AccumulateEncoder(const int32_t* encoder, size_t num);
+
+    /**
+     * @brief Fold another partial result into this one.
+     *
+     * @param other partial result of a batch that arrived after the ones already in *this
+     */
+    void Merge(const ScanStatistics& other);
+
+    double MeanZ() const;
+
+    double ValidRatio() const;
+
+    int64_t EncoderSpan() const;
+};
+
+/**
+ * @brief Write the statistics as json next to the saved scan files.
+ *
+ * @return true success
+ * @return false the file could not be written
+ */
+bool SaveScanStatistics(const std::string& filename, const ScanStatistics& stats);
+
+/**
+ * @brief Thread-safe holder fed by the batch callback and read by the UI.
+ *
+ * The reduction of a batch runs without the lock; only the merge of the
+ * finished partial result is serialized.
+ */
+class ScanStatisticsAccumulator
+{
+public:
+    void Reset();
+
+    void AddBatch(const float* z, size_t num_z,
+                  const uint8_t* gray, size_t num_gray,
+                  const int32_t* encoder, size_t num_encoder);
+
+    void Merge(const ScanStatistics& partial);
+
+    // copy of the current state, valid while the scan is running
+    ScanStatistics Snapshot() const;
+
+    // mark the statistics as complete and return them
+    ScanStatistics Finalize();
+
+private:
+    mutable std::mutex mutex_;
+    ScanStatistics stats_;
+};
+
+#endif
@@ -15,6 +15,20 @@
 #include "scanner_l/type.h"
 #include "scanner_l/scanner_all_data.h"
 #include "scanner_l/scan_io.h"
+#include "scanner_l/scan_statistics.h"
+#include "scanner_l/profile_resampler.h"
+#include "scanner_l/height_map.h"
+#include "scanner_l/range_pyramid.h"
+#include "scanner_l/post_process.h"
+#include "scanner_l/golden_compare.h"
+#include "scanner_l/profile_features.h"
+#include "scanner_l/measurement.h"
+#include "scanner_l/cloud_merge.h"
+#include "scanner_l/voxel_downsample.h"
+#include "scanner_l/organized_normals.h"
+#include "scanner_l/live_preview.h"
+#include "scanner_l/simulated_device.h"
+#include "scanner_l/metrics.h"
 #include "../../plc_serial/include/mitsubishi_plc_fx_link.h"
 #include "./motion_conf.h"
 #include "FileWatcher.h"
@@ -24,6 +38,8 @@
 
 #define debug_show_cam_params 0
 #define dynamic_change_cam_params 0
+// run SDK ProfileStitch and ProfileResampler side by side in End() and log deviation / timing
+#define validate_profile_resampler 0
 
 #ifdef _WIN32
 #define SANY_GRPC_SCANNER_L_EXPORTS __declspec(dllexport)
@@ -56,6 +72,111 @@ public:
                 std::vector<std::vector<int32_t>>& out_encoder_vec,
                 std::vector<std::vector<uint32_t>>& out_framecnt_vec);
 
+    // Live while scanning, finalized once End() returns.
+    int GetScanStatistics(ScanStatistics& out_stats);
+
+    // Direction of the next stroke. In bidirectional mode it flips after every End().
+    void SetScanDirection(bool backward);
+
+    bool IsBackwardScan() const;
+
+    bool IsBidirectionalScan() const;
+
+    // Height map of every scanner, rasterized from the stitched data of the last scan.
+    int GetHeightMaps(std::vector<HeightMap>& out_maps);
+
+    bool IsHeightMapEnabled() const;
+
+    // Decimated range / gray image (level 1..GetPreviewLevelCount()) of the main scanner,
+    // grown while scanning when preview_pyramid_enable is set. Level 1 is half resolution.
+    int GetPreviewLevel(int level, cv::Mat& out_z, cv::Mat& out_gray);
+
+    int GetPreviewLevelCount() const;
+
+    bool IsPreviewPyramidEnabled() const;
+
+    // Side products (fitted plane, residual map) of the post-scan pipeline run by GetAllData().
+    int GetPostProcessResults(std::vector<PostProcessResult>& out_results);
+
+    // Recipe (Solution id) of the following scans, selects the golden reference.
+    void SetRecipeId(int recipe_id);
+
+    // Store the last scan of the main scanner as golden reference of the current recipe.
+    int CaptureGoldenReference();
+
+    // Deviation from the golden reference, computed in End() when a reference exists.
+    int GetGoldenComparison(GoldenCompareResult& out_result);
+
+    bool IsGoldenCompareEnabled() const;
+
+    // Called on the acquisition thread with the edges of every batch as it arrives.
+    void SetProfileFeatureCallback(ProfileFeatureCallback callback);
+
+    // Edges of every line received so far.
+    int GetProfileFeatures(std::vector<ProfileFeature>& out_features);
+
+    bool IsProfileFeatureEnabled() const;
+
+    // Newest profile line while scanning, true if it changed since the last call. Never blocks acquisition.
+    bool FetchLiveProfile(LiveProfile& out_profile);
+
+    // Decimated rows received since the last call (GetLivePreviewWidth() values each), for a scrolling preview.
+    int PopLivePreviewRows(std::vector<float>& out_rows, int max_rows);
+
+    int GetLivePreviewWidth() const;
+
+    uint64_t GetLivePreviewDroppedRows() const;
+
+    bool IsLivePreviewEnabled() const;
+
+    // ROI polygons of the current recipe, empty measures the whole height map.
+    void SetMeasurementRois(const std::vector<RoiPolygon>& rois);
+
+    // Volume / area / height percentiles per scanner, computed by GetAllData().
+    int GetMeasurements(std::vector<MeasurementResult>& out_results);
+
+    bool IsMeasurementEnabled() const;
+
+    // Fuse the per-scanner data returned by GetAllData() into the main scanner's frame.
+    int MergeAllData(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                     const std::vector<std::vector<uint8_t>>& gray_vec,
+                     const std::vector<std::vector<int32_t>>& encoder_vec,
+                     const std::vector<std::vector<uint32_t>>& framecnt_vec,
+                     MergedScan& out_scan);
+
+    bool IsCloudMergeEnabled() const;
+
+    // Voxel-downsampled copy of every scanner's cloud for display and "_preview.ply".
+    int GetPreviewClouds(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                         const std::vector<std::vector<uint8_t>>& gray_vec,
+                         std::vector<std::vector<cv::Point3f>>& out_pc_vec,
+                         std::vector<std::vector<uint8_t>>& out_gray_vec);
+
+    bool IsPreviewExportEnabled() const;
+
+    // Normals of every organized cloud returned by GetAllData(), empty for clouds that lost their organization.
+    int GetNormals(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                   std::vector<std::vector<cv::Point3f>>& out_normals_vec);
+
+    // Same as GetNormals(), octahedral-encoded (see PackNormal).
+    int GetPackedNormals(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                         std::vector<std::vector<uint32_t>>& out_packed_vec);
+
+    bool IsNormalEstimationEnabled() const;
+
+    // Acquire from SimulatedDevice instead of the SDK. Overrides "simulated_device_enable", call before Init().
+    void SetSimulatedDevice(bool enable);
+
+    bool IsSimulatedDevice() const;
+
+    // All batches of the current scan (needCallbackCount) have arrived.
+    bool IsAcquisitionComplete() const;
+
+    int GetBatchCount() const;
+
+    // Time End() spent stitching / resampling the last scan.
+    double GetLastStitchMs() const;
+
     void camera_params_load();
 
     //¼
@@ -86,6 +207,82 @@ private:
 
     std::vector<double> profile_stitch_distances;
 
+    // stitch with ProfileResampler instead of the SDK's ProfileStitch
+    bool use_profile_resampler_ = false;
+
+    // output line spacing of ProfileResampler, <= 0 uses profile_stitch_distance
+    double resample_pitch_ = 0.0;
+
+    int encoder_wrap_bits_ = 16;
+
+    bool height_map_enable_ = false;
+
+    HeightMapParams height_map_params_;
+
+    // decimated range / gray levels built on the acquisition thread, off by default
+    bool preview_pyramid_enable_ = false;
+
+    int preview_pyramid_levels_ = 4;
+
+    PostProcessConfig post_process_config_;
+
+    std::vector<PostProcessResult> post_process_results_;
+
+    bool golden_compare_enable_ = false;
+
+    // golden_<recipe id>_height.tiff/.json, relative paths are under the config root
+    std::string golden_reference_dir_ = "golden/";
+
+    GoldenCompareParams golden_compare_params_;
+
+    GoldenCompare golden_compare_;
+
+    GoldenCompareResult golden_result_;
+
+    int recipe_id_ = -1;
+
+    bool cloud_merge_enable_ = false;
+
+    CloudMergeParams cloud_merge_params_;
+
+    bool preview_export_enable_ = false;
+
+    VoxelDownsampleParams preview_downsample_params_;
+
+    bool normal_estimation_enable_ = false;
+
+    NormalEstimationParams normal_params_;
+
+    bool live_preview_enable_ = true;
+
+    LivePreviewParams live_preview_params_;
+
+    bool measurement_enable_ = false;
+
+    MeasurementParams measurement_params_;
+
+    std::vector<RoiPolygon> measurement_rois_;
+
+    std::vector<MeasurementResult> measurement_results_;
+
+    bool profile_feature_enable_ = false;
+
+    ProfileFeatureParams profile_feature_params_;
+
+    bool simulated_device_enable_ = false;
+
+    // set by SetSimulatedDevice(), the config no longer decides
+    bool simulated_device_forced_ = false;
+
+    SimulatedDeviceParams simulated_device_params_;
+
+    SimulatedDevice simulated_device_;
+
+    double last_stitch_ms_ = 0.0;
+
+    // direction of the stroke the data in all_PC_data came from
+    bool last_scan_backward_ = false;
+
     std::vector<cv::Mat> scanner_l_rt_vec_;
 
     // scanners' min and max zrange.
@@ -95,8 +292,12 @@ private:
 
     bool b_backward_= false;
 
+    // capture on both the outbound and the return stroke
+    bool bidirectional_scan_ = false;
+
     float x_distance_ = 0.0;
 
+    // encoder value of the first line of the last outbound stroke, per scanner
     std::vector<unsigned int> forward_encoder_values_;
 
     std::vector<float> mv_dists_ = {0,0};
@@ -111,6 +312,15 @@ private:
 
     void release_scanner_l_ptr();
 
+    // move a return stroke into the frame of the outbound stroke
+    void align_backward_pass(Scanner_All_Data& all_data, int scanner_idx, const AIeveR_Point3D& mv_vec);
+
+    // height map and first encoder value of the main scanner's last scan, in the outbound frame
+    int build_main_height_map(HeightMap& out_map, bool& has_encoder, int32_t& encoder_first);
+
+    // cloud index of GetAllData() still laid out as whole kDefaultDataWidth lines
+    bool is_organized_cloud(int index, size_t num_points) const;
+
 };
 
 
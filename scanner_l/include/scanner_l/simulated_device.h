@@ -0,0 +1,103 @@
+#ifndef SIMULATED_DEVICE_H
+#define SIMULATED_DEVICE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "scanner_l/range_image.h"
+
+struct SimulatedDeviceParams
+{
+    int data_width = kDefaultDataWidth;
+    int lines_per_batch = 100;
+
+    // profile rate; <= 0 produces batches as fast as they are consumed
+    double line_rate_hz = 2000.0;
+
+    // point spacing along the laser line and travel per encoder pulse, mm
+    float x_pitch = 0.02f;
+    float y_per_pulse = 0.004f;
+    int pulses_per_line = 5;
+    int encoder_wrap_bits = 16;
+
+    // synthetic part: a tilted base plane with a raised block, a dome and a ripple
+    float base_z = 0.0f;
+    float block_height = 2.0f;
+    float dome_height = 1.5f;
+    float ripple_amplitude = 0.05f;
+    float noise_sigma = 0.005f;
+
+    // fraction of points reported invalid (occlusion / dropouts)
+    float invalid_ratio = 0.01f;
+
+    unsigned int seed = 1;
+};
+
+// one decoded batch, row-major with data_width points per line
+struct SimulatedBatch
+{
+    int data_width = 0;
+    int lines = 0;
+    std::vector<cv::Point3f> xyz;  // sensor frame, y = 0
+    std::vector<float> z;
+    std::vector<uint8_t> gray;
+    std::vector<int32_t> encoder;  // per line
+    std::vector<uint32_t> frame;   // per line
+};
+
+using SimulatedBatchCallback = std::function<void(const SimulatedBatch& batch)>;
+
+/**
+ * @brief Stand-in for the profiler when no hardware is present.
+ *
+ * Start() runs a thread that renders profiles of a synthetic part at the configured
+ * line rate and hands them to the callback in batches, already decoded, the way the
+ * batch callback of the SDK sees them after DecodeProfilesZ / DecodeProfilesXYZ.
+ * Encoder and frame counters keep running across scans like on a real device.
+ */
+class SimulatedDevice
+{
+public:
+    ~SimulatedDevice();
+
+    void SetParams(const SimulatedDeviceParams& params);
+
+    const SimulatedDeviceParams& Params() const { return params_; }
+
+    /**
+     * @brief Start producing batches.
+     *
+     * @param max_batches stop after this many batches, <= 0 runs until Stop()
+     * @return 0 success, -1 already running
+     */
+    int Start(SimulatedBatchCallback callback, int max_batches);
+
+    // Stop and join the thread; the callback is not called after this returns
+    void Stop();
+
+    bool IsRunning() const { return running_.load(); }
+
+    uint64_t BatchCount() const { return batch_count_.load(); }
+
+private:
+    void Run(int max_batches);
+
+    void RenderBatch(SimulatedBatch& batch);
+
+    SimulatedDeviceParams params_;
+    SimulatedBatchCallback callback_;
+    std::thread thread_;
+    std::atomic<bool> running_{ false };
+    std::atomic<bool> stop_{ false };
+    std::atomic<uint64_t> batch_count_{ 0 };
+
+    // continuous across scans
+    uint64_t line_ = 0;
+    uint32_t frame_ = 0;
+    cv::RNG rng_;
+};
+
+#endif
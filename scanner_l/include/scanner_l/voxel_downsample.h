@@ -0,0 +1,69 @@
+#ifndef VOXEL_DOWNSAMPLE_H
+#define VOXEL_DOWNSAMPLE_H
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+enum class VoxelPolicy
+{
+    // mean position and gray of the points in the voxel
+    Centroid = 0,
+    // the first point of the voxel in scan order
+    First,
+    // the highest point of the voxel
+    MaxZ
+};
+
+// "centroid" / "first" / "max_z", anything else maps to Centroid
+VoxelPolicy VoxelPolicyFromString(const std::string& name);
+const char* VoxelPolicyName(VoxelPolicy policy);
+
+/**
+ * @brief Packed 21 bit per axis voxel index, +-2^20 voxels (100 m at 0.1 mm) around the origin.
+ */
+inline uint64_t VoxelKey(const cv::Point3f& p, float inv_size) {
+    constexpr int kKeyBits = 21;
+    constexpr int64_t kKeyOffset = int64_t(1) << (kKeyBits - 1);
+    constexpr uint64_t kKeyMask = (uint64_t(1) << kKeyBits) - 1;
+    const int64_t ix = static_cast<int64_t>(std::floor(p.x * inv_size)) + kKeyOffset;
+    const int64_t iy = static_cast<int64_t>(std::floor(p.y * inv_size)) + kKeyOffset;
+    const int64_t iz = static_cast<int64_t>(std::floor(p.z * inv_size)) + kKeyOffset;
+    return ((uint64_t(ix) & kKeyMask) << (2 * kKeyBits)) | ((uint64_t(iy) & kKeyMask) << kKeyBits) | (uint64_t(iz) & kKeyMask);
+}
+
+struct VoxelDownsampleParams
+{
+    // voxel edge (mm)
+    float voxel_size = 0.5f;
+
+    VoxelPolicy policy = VoxelPolicy::Centroid;
+
+    // profile lines hashed by one task; its hash table holds at most the voxels of these lines
+    int chunk_rows = 256;
+};
+
+/**
+ * @brief Voxel-grid downsampling of a profiler cloud, one point per occupied voxel.
+ *
+ * Consecutive profile lines touch mostly the same few voxel slabs, so every chunk of
+ * chunk_rows lines is hashed on its own (one chunk per thread at a time), then combined
+ * with the voxels of the previous chunk only and emitted. Besides the output, memory is
+ * bounded by a few chunks of voxels whatever the scan length. A voxel met again after a
+ * whole chunk in between (chunk_rows lines shorter than a voxel along the scan, or a
+ * head standing still) gets one point per visit. The output is in order of first
+ * appearance and independent of scheduling.
+ *
+ * @param pc cloud in scan order, invalid z allowed (skipped)
+ * @param gray per-point gray, may be nullptr
+ * @param width points per line, used to align chunks to whole lines (<= 0: no alignment)
+ * @param out_gray filled when gray is given
+ * @return 0 success, -1 bad parameters
+ */
+int VoxelDownsample(const cv::Point3f* pc, const uint8_t* gray, size_t num, int width,
+                    const VoxelDownsampleParams& params,
+                    std::vector<cv::Point3f>& out_pc, std::vector<uint8_t>& out_gray);
+
+#endif
@@ -1,4 +1,5 @@
 #include "scanner_l/Scanner_Server.h"
+#include "scanner_l/scan_share_memory.h"
 
 namespace {
     void SaveXYZData(std::vector<cv::Point3f>& XYZ_Data, std::vector<uint8_t>& gray_vec, std::vector<int32_t>& encoder_vec,
@@ -189,12 +190,12 @@ int Scanner_Server::Config_Scanner(RealtimeLogSink& sink){
     set_config_root_path = data["set_config_root_path"];
     shared_memory_name_pc = data["shared_memory_name_pc"];
     shared_memory_name_gray = data["shared_memory_name_gray"];
+    shared_memory_name_height = data.value("shared_memory_name_height", std::string("Local\\pointclouds_loop_scan_0_height"));
 
     scanner_sys_.SetConfigRootPath(set_config_root_path + "ScannerConfig/"); // Must set config path first.
     int flag_scan = scanner_sys_.Init();
 
     plc_setting_path = set_config_root_path + "/ScannerConfig/" + config_plc_filename;
-    Solution sol_current;
     try {
         ConfigData config = parse_config(plc_setting_path);
         //config.moving_speed = 150;
@@ -202,6 +203,9 @@ int Scanner_Server::Config_Scanner(RealtimeLogSink& sink){
         //sol_current.set_speed = config.moving_speed;
         LOG(INFO) << "Current speed: " << sol_current.set_speed << " = " << config.moving_speed;
         config.GetCurrentSolution(sol_current);
+        scanner_sys_.SetRecipeId(sol_current.id);
+        scanner_sys_.SetMeasurementRois(sol_current.roi_polygons);
+        LOG(INFO) << "Solution " << sol_current.id << " measurement ROIs: " << sol_current.roi_polygons.size();
         LOG(INFO) << "set speed: " << sol_current.set_speed;
         LOG(INFO) << "Solution set speed: " << sol_current.set_speed;
         LOG(INFO) << "Solution " << sol_current.id << " name " << sol_current.name << " scanner y design position: "
@@ -243,6 +247,12 @@ int Scanner_Server::Connect_Scanner(){
 }
 
 int Scanner_Server::Start_Scanner(){
+    if (scanner_sys_.IsBackwardScan()) {
+        LOG(INFO) << "Solution " << sol_current.id << " return stroke: " << move_left_position << " -> " << move_right_position << "mm";
+    }
+    else {
+        LOG(INFO) << "Solution " << sol_current.id << " outbound stroke: " << ready_position << " -> " << move_left_position << "mm";
+    }
     int flag_scan = scanner_sys_.Start();
     LOG(INFO) << "Start return: " << flag_scan;
     if (flag_scan != 0) {
@@ -282,6 +292,51 @@ int Scanner_Server::End_Scanner(){
     cv::Mat tiff_image;
     cv::Mat tiff_image_gray;
     scanner_sys_.GetAllData(i_pc_vec, i_gray_vec, i_encoder_vec, i_framecnt_vec);
+    ScanStatistics scan_stats;
+    scanner_sys_.GetScanStatistics(scan_stats);
+    SaveScanStatistics(data_root_path + "pointclouds_loop_" + date_time_str + "_stats.json", scan_stats);
+    if (scanner_sys_.IsHeightMapEnabled()) {
+        std::vector<HeightMap> height_maps;
+        if (scanner_sys_.GetHeightMaps(height_maps) == 0) {
+            for (int j = 0; j < height_maps.size(); j++) {
+                SaveHeightMap(data_root_path + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_height", height_maps[j]);
+            }
+            // the main scanner's map is published for the downstream tools; empty when no scan reached End()
+            if (!height_maps.empty() && !height_maps[0].height.empty()) {
+                uint64 shared_memory_size_height = 0;
+                writeMemory_height(height_maps[0].height, shared_memory_name_height, shared_memory_size_height);
+                LOG(INFO) << "shared_memory_size_height: " << shared_memory_size_height;
+            }
+            else {
+                LOG(WARNING) << "no height map of the main scanner, shared memory not updated";
+            }
+        }
+    }
+    if (scanner_sys_.IsProfileFeatureEnabled()) {
+        std::vector<ProfileFeature> features;
+        scanner_sys_.GetProfileFeatures(features);
+        SaveProfileFeatures(data_root_path + "pointclouds_loop_" + date_time_str + "_features.csv", features);
+    }
+    GoldenCompareResult golden_result;
+    if (scanner_sys_.GetGoldenComparison(golden_result) == 0) {
+        SaveGoldenComparison(data_root_path + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(0) + "_golden", golden_result);
+    }
+    if (scanner_sys_.IsMeasurementEnabled()) {
+        std::vector<MeasurementResult> measurements;
+        scanner_sys_.GetMeasurements(measurements);
+        for (int j = 0; j < measurements.size(); j++) {
+            if (measurements[j].valid) {
+                SaveMeasurement(data_root_path + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_measure.json", measurements[j]);
+            }
+        }
+    }
+    std::vector<PostProcessResult> post_results;
+    scanner_sys_.GetPostProcessResults(post_results);
+    for (int j = 0; j < post_results.size(); j++) {
+        if (post_results[j].plane.valid) {
+            SavePlaneFit(data_root_path + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_plane", post_results[j].plane, post_results[j].plane_residual);
+        }
+    }
     auto save_ply_starttime = std::chrono::system_clock::now();
     // TODO: Store pc in corresponding container.
     LOG(INFO) << "Save pc to files";
@@ -327,8 +382,11 @@ int Scanner_Server::End_Scanner(){
             continue;
         }
         
-        tiff_image = save_ply2tiff(i_pc_x, i_pc_y, i_pc_z, 3200, i_pc_z.size() / 3200, path_laser_scan_tiff_pc);
-        tiff_image_gray = save_gray2tiff(i_gray, 3200 , i_gray.size() / 3200, path_laser_scan_tiff_gray);
+        // outlier removal leaves an unorganized cloud, only the ply is meaningful then
+        if (j >= post_results.size() || post_results[j].organized) {
+            tiff_image = save_ply2tiff(i_pc_x, i_pc_y, i_pc_z, 3200, i_pc_z.size() / 3200, path_laser_scan_tiff_pc);
+            tiff_image_gray = save_gray2tiff(i_gray, 3200 , i_gray.size() / 3200, path_laser_scan_tiff_gray);
+        }
         SaveXYZData_happly(*point_cloud_ptr_tmp, grays_tmp, encoders_tmp, framecnts_tmp, path_laser_scan_pc_nothr.c_str());
         std::thread save_ply([&]() {
             SaveXYZData_happly(*point_cloud_ptr_tmp, grays_tmp, encoders_tmp, framecnts_tmp, path_laser_scan_pc_thr.c_str());
@@ -363,6 +421,7 @@ int Scanner_Server::End_Scanner(){
     }
         
 
+    // raw concatenation of the heads in their own frames, input of the multi-head calibration
 #if SAVE_OVERALL_PC
     for (size_t i = 0; i < i_pc_vec.size(); i++)
     {
@@ -378,6 +437,54 @@ int Scanner_Server::End_Scanner(){
     ply_data_calibr_file(loop_cnt);
 #endif
 
+    // all scanners fused into the main scanner's frame, overlap kept once
+    if (scanner_sys_.IsCloudMergeEnabled()) {
+        MergedScan merged;
+        if (scanner_sys_.MergeAllData(i_pc_vec, i_gray_vec, i_encoder_vec, i_framecnt_vec, merged) == 0) {
+            LOG(INFO) << "saving merged data...";
+            std::string path_merged = data_root_path + "pointclouds_loop_" + date_time_str + "_merged";
+            if (!merged.map.height.empty()) {
+                SaveHeightMap(path_merged + "_height", merged.map);
+                cv::imwrite(path_merged + "_source.tiff", merged.source);
+            }
+            else {
+                SaveXYZData_happly(merged.pc, merged.gray, merged.encoder, merged.framecnt, (path_merged + ".ply").c_str());
+            }
+            LOG(INFO) << "saving merged data done";
+        }
+    }
+
+    // per-point normals in the layout of the _pc.tiff
+    if (scanner_sys_.IsNormalEstimationEnabled()) {
+        std::vector<std::vector<cv::Point3f>> normals_vec;
+        if (scanner_sys_.GetNormals(i_pc_vec, normals_vec) == 0) {
+            std::vector<int> compression_params = { cv::IMWRITE_TIFF_COMPRESSION, 1 };
+            for (int j = 0; j < normals_vec.size(); j++) {
+                if (normals_vec[j].empty())
+                    continue;
+                cv::Mat normal_image(static_cast<int>(normals_vec[j].size() / kDefaultDataWidth), kDefaultDataWidth, CV_32FC3, normals_vec[j].data());
+                cv::imwrite(data_root_path + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_normals.tiff",
+                            normal_image, compression_params);
+            }
+        }
+    }
+
+    // reduced clouds for quick viewing, no per-point encoder / frame count survives the voxel grid
+    if (scanner_sys_.IsPreviewExportEnabled()) {
+        std::vector<std::vector<cv::Point3f>> preview_pc_vec;
+        std::vector<std::vector<uint8_t>> preview_gray_vec;
+        if (scanner_sys_.GetPreviewClouds(i_pc_vec, i_gray_vec, preview_pc_vec, preview_gray_vec) == 0) {
+            std::vector<int> no_encoder;
+            std::vector<unsigned int> no_framecnt;
+            for (int j = 0; j < preview_pc_vec.size(); j++) {
+                if (preview_pc_vec[j].empty())
+                    continue;
+                std::string path_preview = data_root_path + "pointclouds_loop_" + date_time_str + "_scan_" + std::to_string(j) + "_preview.ply";
+                SaveXYZData_happly(preview_pc_vec[j], preview_gray_vec[j], no_encoder, no_framecnt, path_preview.c_str());
+            }
+        }
+    }
+
     std::vector<std::vector<cv::Point3f>>().swap(i_pc_vec);
     std::vector<std::vector<uint8_t>>().swap(i_gray_vec);
     std::vector<std::vector<int32_t>>().swap(i_encoder_vec);
@@ -421,6 +528,10 @@ int Scanner_Server::Disconnect_Scanner(){
     return 0;
 }
 
+int Scanner_Server::Get_Measurements(std::vector<MeasurementResult>& out_results){
+    return scanner_sys_.GetMeasurements(out_results);
+}
+
 //int main() {
 //    Scanner_Server test;
 //    return 0;
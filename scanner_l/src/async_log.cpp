@@ -0,0 +1,342 @@
+#include "scanner_l/async_log.h"
+#include "scanner_l/metrics.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+    // most lines fit, longer ones go to Record::overflow
+    constexpr size_t kInlineText = 256;
+
+    struct Record
+    {
+        std::atomic<uint64_t> seq{ 0 };
+        int target = 0;
+        bool force_flush = false;
+        std::chrono::system_clock::time_point timestamp;
+        size_t length = 0;
+        char text[kInlineText];
+        std::string overflow;
+
+        const char* Data() const { return length <= kInlineText ? text : overflow.data(); }
+    };
+
+    int SeverityOfLine(const char* line, size_t length) {
+        if (length == 0)
+            return google::GLOG_INFO;
+        switch (line[0]) {
+        case 'W': return google::GLOG_WARNING;
+        case 'E': return google::GLOG_ERROR;
+        case 'F': return google::GLOG_FATAL;
+        default: return google::GLOG_INFO;
+        }
+    }
+
+    class AsyncBackend;
+
+    // Stands in for glog's file logger of one severity
+    class AsyncFileLogger : public google::base::Logger
+    {
+    public:
+        AsyncFileLogger(AsyncBackend& backend, int severity, google::base::Logger* wrapped)
+            : backend_(backend), severity_(severity), wrapped_(wrapped) {}
+
+        void Write(bool force_flush, const std::chrono::system_clock::time_point& timestamp, const char* message,
+                   size_t message_len) override;
+
+        void Flush() override;
+
+        uint32_t LogSize() override { return wrapped_->LogSize(); }
+
+        google::base::Logger* Wrapped() const { return wrapped_; }
+
+    private:
+        AsyncBackend& backend_;
+        int severity_;
+        google::base::Logger* wrapped_;
+    };
+
+    class AsyncBackend
+    {
+    public:
+        explicit AsyncBackend(const AsyncLogOptions& options) : options_(options) {
+            capacity_ = 16;
+            while (capacity_ < options_.queue_records)
+                capacity_ <<= 1;
+            mask_ = capacity_ - 1;
+            records_.reset(new Record[capacity_]);
+            for (size_t i = 0; i < capacity_; i++)
+                records_[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        void Install() {
+            for (int s = 0; s < google::NUM_SEVERITIES; s++) {
+                loggers_[s].reset(new AsyncFileLogger(*this, s, google::base::GetLogger(s)));
+            }
+            thread_ = std::thread(&AsyncBackend::Run, this);
+            for (int s = 0; s < google::NUM_SEVERITIES; s++) {
+                google::base::SetLogger(s, loggers_[s].get());
+            }
+        }
+
+        void Uninstall() {
+            // glog calls the loggers under its own mutex, after this no thread is inside them
+            for (int s = 0; s < google::NUM_SEVERITIES; s++) {
+                google::base::SetLogger(s, loggers_[s]->Wrapped());
+            }
+            stop_.store(true);
+            wake_cv_.notify_one();
+            if (thread_.joinable())
+                thread_.join();
+            DrainNow();
+            for (int s = 0; s < google::NUM_SEVERITIES; s++) {
+                loggers_[s]->Wrapped()->Flush();
+            }
+        }
+
+        // lock-free, false when the queue is full
+        bool Enqueue(int target, bool force_flush, const std::chrono::system_clock::time_point& timestamp,
+                     const char* message, size_t length) {
+            uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            Record* record = nullptr;
+            for (;;) {
+                record = &records_[pos & mask_];
+                const uint64_t seq = record->seq.load(std::memory_order_acquire);
+                const int64_t dif = static_cast<int64_t>(seq - pos);
+                if (dif == 0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (dif < 0) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+            record->target = target;
+            record->force_flush = force_flush;
+            record->timestamp = timestamp;
+            record->length = length;
+            if (length <= kInlineText)
+                memcpy(record->text, message, length);
+            else
+                record->overflow.assign(message, length);
+            record->seq.store(pos + 1, std::memory_order_release);
+
+            enqueued_.fetch_add(1, std::memory_order_relaxed);
+            const size_t depth = static_cast<size_t>(pos + 1 - dequeue_pos_.load(std::memory_order_relaxed));
+            size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+            while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+            }
+            if (force_flush)
+                wake_cv_.notify_one();
+            return true;
+        }
+
+        // drain on the calling thread, used for flushes and FATAL
+        void DrainNow() {
+            std::lock_guard<std::mutex> lock(consumer_mutex_);
+            DrainLocked();
+        }
+
+        // the queue was full on a line that must not be lost
+        void WriteDirect(int target, bool force_flush, const std::chrono::system_clock::time_point& timestamp,
+                         const char* message, size_t length) {
+            std::lock_guard<std::mutex> lock(consumer_mutex_);
+            DrainLocked();
+            Deliver(target, force_flush, timestamp, message, length);
+        }
+
+        void SetSink(google::LogSink* sink) {
+            // the background thread holds consumer_mutex_ while it uses the sink
+            std::lock_guard<std::mutex> lock(consumer_mutex_);
+            sink_ = sink;
+        }
+
+        AsyncLogStats Stats() const {
+            AsyncLogStats stats;
+            stats.enqueued = enqueued_.load(std::memory_order_relaxed);
+            stats.dropped = dropped_.load(std::memory_order_relaxed);
+            stats.written = written_.load(std::memory_order_relaxed);
+            stats.queue_capacity = capacity_;
+            stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        void Run() {
+            while (!stop_.load()) {
+                {
+                    std::lock_guard<std::mutex> lock(consumer_mutex_);
+                    // backlog found by this pass, what the HUD shows as the log queue depth
+                    depth_gauge_->Set(static_cast<double>(
+                        enqueue_pos_.load(std::memory_order_relaxed) - dequeue_pos_.load(std::memory_order_relaxed)));
+                    DrainLocked();
+                    ReportDroppedLocked();
+                }
+                std::unique_lock<std::mutex> wake_lock(wake_mutex_);
+                wake_cv_.wait_for(wake_lock, std::chrono::milliseconds(options_.drain_interval_ms));
+            }
+        }
+
+        void DrainLocked() {
+            uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            uint64_t count = 0;
+            for (;;) {
+                Record& record = records_[pos & mask_];
+                if (record.seq.load(std::memory_order_acquire) != pos + 1)
+                    break;
+                Deliver(record.target, record.force_flush, record.timestamp, record.Data(), record.length);
+                record.seq.store(pos + capacity_, std::memory_order_release);
+                pos++;
+                count++;
+                dequeue_pos_.store(pos, std::memory_order_relaxed);
+            }
+            written_.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        // must not LOG(): a FATAL line holds glog's mutex while it waits for consumer_mutex_
+        void Deliver(int target, bool force_flush, const std::chrono::system_clock::time_point& timestamp,
+                     const char* message, size_t length) {
+            loggers_[target]->Wrapped()->Write(force_flush, timestamp, message, length);
+            // every line reaches the INFO logger exactly once, echo and forward from there
+            if (target != google::GLOG_INFO || length == 0)
+                return;
+            const int severity = SeverityOfLine(message, length);
+            if (options_.echo_to_stderr && severity < FLAGS_stderrthreshold) {
+                fwrite(message, 1, length, stderr);
+            }
+            if (sink_ != nullptr) {
+                const time_t seconds = std::chrono::system_clock::to_time_t(timestamp);
+                struct ::tm tm_time;
+#ifdef _WIN32
+                localtime_s(&tm_time, &seconds);
+#else
+                localtime_r(&seconds, &tm_time);
+#endif
+                // hand over only the text after glog's "I20240101 12:00:00.000000 1234 file.cpp:12] " prefix
+                const char* text = message;
+                size_t text_len = length;
+                const char* prefix_end = static_cast<const char*>(memchr(message, ']', length));
+                if (prefix_end != nullptr && prefix_end + 1 < message + length && prefix_end[1] == ' ') {
+                    text = prefix_end + 2;
+                    text_len = length - (text - message);
+                }
+                while (text_len > 0 && text[text_len - 1] == '\n')
+                    text_len--;
+                sink_->send(static_cast<google::LogSeverity>(severity), "", "", 0, &tm_time, text, text_len);
+            }
+        }
+
+        void ReportDroppedLocked() {
+            const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+            if (dropped == reported_dropped_)
+                return;
+            char line[128];
+            const int len = snprintf(line, sizeof(line), "W async_log] %llu log lines dropped, queue of %llu full\n",
+                                     (unsigned long long)(dropped - reported_dropped_), (unsigned long long)capacity_);
+            reported_dropped_ = dropped;
+            const auto now = std::chrono::system_clock::now();
+            Deliver(google::GLOG_WARNING, true, now, line, static_cast<size_t>(len));
+            Deliver(google::GLOG_INFO, true, now, line, static_cast<size_t>(len));
+        }
+
+        AsyncLogOptions options_;
+        size_t capacity_ = 0;
+        size_t mask_ = 0;
+        std::unique_ptr<Record[]> records_;
+        std::atomic<uint64_t> enqueue_pos_{ 0 };
+        std::atomic<uint64_t> dequeue_pos_{ 0 };
+
+        std::unique_ptr<AsyncFileLogger> loggers_[google::NUM_SEVERITIES];
+        google::LogSink* sink_ = nullptr;
+
+        // single consumer: the background thread or a synchronous flush
+        std::mutex consumer_mutex_;
+        std::mutex wake_mutex_;
+        std::condition_variable wake_cv_;
+        std::atomic<bool> stop_{ false };
+        std::thread thread_;
+
+        std::atomic<uint64_t> enqueued_{ 0 };
+        std::atomic<uint64_t> dropped_{ 0 };
+        std::atomic<uint64_t> written_{ 0 };
+        std::atomic<size_t> max_depth_{ 0 };
+        MetricGauge* depth_gauge_ = Metrics().Gauge(kMetricQueueLog);
+        uint64_t reported_dropped_ = 0;
+    };
+
+    void AsyncFileLogger::Write(bool force_flush, const std::chrono::system_clock::time_point& timestamp,
+                                const char* message, size_t message_len) {
+        if (message_len == 0) {
+            // glog's flush of every logger before it aborts on FATAL
+            if (force_flush)
+                backend_.DrainNow();
+            return;
+        }
+        const bool fatal = severity_ == google::GLOG_FATAL || SeverityOfLine(message, message_len) == google::GLOG_FATAL;
+        if (!backend_.Enqueue(severity_, force_flush, timestamp, message, message_len)) {
+            if (fatal)
+                backend_.WriteDirect(severity_, true, timestamp, message, message_len);
+            return;
+        }
+        if (fatal)
+            backend_.DrainNow();
+    }
+
+    void AsyncFileLogger::Flush() {
+        backend_.DrainNow();
+        wrapped_->Flush();
+    }
+
+    std::mutex g_install_mutex;
+    std::unique_ptr<AsyncBackend> g_backend;
+}
+
+int InstallAsyncLogging(const AsyncLogOptions& options) {
+    std::lock_guard<std::mutex> lock(g_install_mutex);
+    if (g_backend) {
+        LOG(WARNING) << "InstallAsyncLogging - already installed";
+        return -1;
+    }
+    if (FLAGS_logtostderr) {
+        LOG(WARNING) << "InstallAsyncLogging - FLAGS_logtostderr is set, glog bypasses the file loggers";
+        return -1;
+    }
+    g_backend.reset(new AsyncBackend(options));
+    g_backend->Install();
+    return 0;
+}
+
+void ShutdownAsyncLogging() {
+    std::lock_guard<std::mutex> lock(g_install_mutex);
+    if (!g_backend)
+        return;
+    g_backend->Uninstall();
+    g_backend.reset();
+}
+
+bool IsAsyncLoggingInstalled() {
+    std::lock_guard<std::mutex> lock(g_install_mutex);
+    return static_cast<bool>(g_backend);
+}
+
+void SetAsyncLogSink(google::LogSink* sink) {
+    std::lock_guard<std::mutex> lock(g_install_mutex);
+    if (g_backend)
+        g_backend->SetSink(sink);
+}
+
+AsyncLogStats GetAsyncLogStats() {
+    std::lock_guard<std::mutex> lock(g_install_mutex);
+    return g_backend ? g_backend->Stats() : AsyncLogStats();
+}
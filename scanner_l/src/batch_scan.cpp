@@ -0,0 +1,386 @@
+// Headless batch scan: N scan cycles of one recipe without the UI.
+//
+// Every cycle runs Start -> wait for all batches -> End -> GetAllData -> save and
+// times each phase; connect is timed once. The result is one JSON document with the
+// per-cycle timings and a min / mean / max summary, on stdout or in --json.
+// Without hardware (or with --simulate on) the scanner is replaced by SimulatedDevice.
+//
+// usage: batch_scan [--config dir] [--recipe id] [--cycles n] [--save ply,tiff,height,stats,measure|none]
+//                   [--out dir] [--simulate auto|on|off] [--timeout seconds] [--json file] [--log-dir dir]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "glog/logging.h"
+#include "scanner_l/async_log.h"
+#include "scanner_l/scanner_l_api.h"
+
+namespace {
+    using json = nlohmann::json;
+    using SteadyClock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        std::string config_dir = "../ScannerConfig/";
+        int recipe_id = -1;
+        int cycles = 1;
+        std::set<std::string> save_formats = { "ply" };
+        std::string out_dir = "./batch_scan/";
+        std::string simulate = "auto";
+        double timeout_s = 60.0;
+        std::string json_path;
+        std::string log_dir = ".";
+    };
+
+    struct CycleTiming
+    {
+        double start_ms = 0.0;
+        double acquisition_ms = 0.0;
+        double end_ms = 0.0;  // End() as a whole, stitching included
+        double stitch_ms = 0.0;
+        double get_all_data_ms = 0.0;
+        double save_ms = 0.0;
+        double total_ms = 0.0;
+        int batches = 0;
+        size_t points = 0;
+        int status = 0;
+    };
+
+    double ElapsedMs(SteadyClock::time_point since) {
+        return std::chrono::duration<double, std::milli>(SteadyClock::now() - since).count();
+    }
+
+    std::string EnsureTrailingSlash(std::string dir) {
+        if (!dir.empty() && dir.back() != '/' && dir.back() != '\\')
+            dir += "/";
+        return dir;
+    }
+
+    void PrintUsage() {
+        std::cerr << "usage: batch_scan [--config dir] [--recipe id] [--cycles n]\n"
+                     "                  [--save ply,tiff,height,stats,measure|none] [--out dir]\n"
+                     "                  [--simulate auto|on|off] [--timeout seconds] [--json file] [--log-dir dir]\n";
+    }
+
+    int ParseArgs(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg == "-h" || arg == "--help")
+                return 1;
+            if (i + 1 >= argc) {
+                std::cerr << "missing value for " << arg << "\n";
+                return -1;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--config") {
+                options.config_dir = EnsureTrailingSlash(value);
+            } else if (arg == "--recipe") {
+                options.recipe_id = std::atoi(value.c_str());
+            } else if (arg == "--cycles") {
+                options.cycles = std::max(1, std::atoi(value.c_str()));
+            } else if (arg == "--save") {
+                options.save_formats.clear();
+                std::stringstream ss(value);
+                std::string format;
+                while (std::getline(ss, format, ',')) {
+                    if (format == "none")
+                        continue;
+                    if (format != "ply" && format != "tiff" && format != "height" && format != "stats" && format != "measure") {
+                        std::cerr << "unknown save format " << format << "\n";
+                        return -1;
+                    }
+                    options.save_formats.insert(format);
+                }
+            } else if (arg == "--out") {
+                options.out_dir = EnsureTrailingSlash(value);
+            } else if (arg == "--simulate") {
+                if (value != "auto" && value != "on" && value != "off") {
+                    std::cerr << "--simulate expects auto, on or off\n";
+                    return -1;
+                }
+                options.simulate = value;
+            } else if (arg == "--timeout") {
+                options.timeout_s = std::atof(value.c_str());
+            } else if (arg == "--json") {
+                options.json_path = value;
+            } else if (arg == "--log-dir") {
+                options.log_dir = value;
+            } else {
+                std::cerr << "unknown option " << arg << "\n";
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    std::unique_ptr<ScannerLApi> CreateScanner(const Options& options, bool simulated, int& out_status) {
+        auto scanner = std::make_unique<ScannerLApi>();
+        scanner->SetConfigRootPath(options.config_dir);
+        if (simulated)
+            scanner->SetSimulatedDevice(true);
+        else if (options.simulate == "off")
+            scanner->SetSimulatedDevice(false);
+        out_status = scanner->Init();
+        return scanner;
+    }
+
+    void ApplyRecipe(ScannerLApi& scanner, const Options& options) {
+        scanner.SetRecipeId(options.recipe_id);
+        if (!scanner.IsMeasurementEnabled())
+            return;
+        // measurement ROIs are stored with the recipe in config_plc.json, like in the UI
+        ConfigData plc_config;
+        Solution solution;
+        if (plc_config.LoadFromJson(options.config_dir + "config_plc.json") && plc_config.SetCurrentSolution(options.recipe_id)
+            && plc_config.GetCurrentSolution(solution)) {
+            scanner.SetMeasurementRois(solution.roi_polygons);
+        } else {
+            LOG(WARNING) << "no measurement ROIs for recipe " << options.recipe_id << ", measuring the whole height map";
+            scanner.SetMeasurementRois(std::vector<RoiPolygon>());
+        }
+    }
+
+    bool WaitAcquisition(const ScannerLApi& scanner, double timeout_s) {
+        const auto deadline = SteadyClock::now() + std::chrono::duration_cast<SteadyClock::duration>(std::chrono::duration<double>(timeout_s));
+        while (!scanner.IsAcquisitionComplete()) {
+            if (SteadyClock::now() >= deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    int SaveCycle(ScannerLApi& scanner, const Options& options, int cycle,
+                  const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                  const std::vector<std::vector<uint8_t>>& gray_vec,
+                  const std::vector<std::vector<int32_t>>& encoder_vec,
+                  const std::vector<std::vector<uint32_t>>& framecnt_vec) {
+        const std::string prefix = options.out_dir + "cycle_" + std::to_string(cycle);
+        int failed = 0;
+        if (options.save_formats.count("stats")) {
+            ScanStatistics stats;
+            scanner.GetScanStatistics(stats);
+            failed += SaveScanStatistics(prefix + "_stats.json", stats) ? 0 : 1;
+        }
+        if (options.save_formats.count("height") && scanner.IsHeightMapEnabled()) {
+            std::vector<HeightMap> height_maps;
+            if (scanner.GetHeightMaps(height_maps) == 0) {
+                for (size_t j = 0; j < height_maps.size(); j++)
+                    failed += SaveHeightMap(prefix + "_scan_" + std::to_string(j) + "_height", height_maps[j]) ? 0 : 1;
+            } else {
+                failed++;
+            }
+        }
+        if (options.save_formats.count("measure") && scanner.IsMeasurementEnabled()) {
+            std::vector<MeasurementResult> measurements;
+            scanner.GetMeasurements(measurements);
+            for (size_t j = 0; j < measurements.size(); j++) {
+                if (measurements[j].valid)
+                    failed += SaveMeasurement(prefix + "_scan_" + std::to_string(j) + "_measure.json", measurements[j]) ? 0 : 1;
+            }
+        }
+        for (size_t j = 0; j < pc_vec.size(); j++) {
+            const std::string scan_prefix = prefix + "_scan_" + std::to_string(j);
+            if (pc_vec[j].empty())
+                continue;
+            if (options.save_formats.count("ply")) {
+                const bool per_point = encoder_vec[j].size() == pc_vec[j].size() && framecnt_vec[j].size() == pc_vec[j].size();
+                const bool has_gray = gray_vec[j].size() == pc_vec[j].size();
+                const bool ok = WritePCToPLY(pc_vec[j].data(), static_cast<int>(pc_vec[j].size()), scan_prefix + ".ply", nullptr, 0,
+                    per_point ? reinterpret_cast<const int*>(encoder_vec[j].data()) : nullptr, per_point ? static_cast<int>(encoder_vec[j].size()) : 0,
+                    per_point ? reinterpret_cast<const unsigned int*>(framecnt_vec[j].data()) : nullptr, per_point ? static_cast<int>(framecnt_vec[j].size()) : 0,
+                    has_gray ? gray_vec[j].data() : nullptr, has_gray ? static_cast<int>(gray_vec[j].size()) : 0);
+                failed += ok ? 0 : 1;
+            }
+            if (options.save_formats.count("tiff") && pc_vec[j].size() % kDefaultDataWidth == 0) {
+                const int rows = static_cast<int>(pc_vec[j].size() / kDefaultDataWidth);
+                const std::vector<int> compression_params = { cv::IMWRITE_TIFF_COMPRESSION, 1 };
+                cv::Mat pc_image(rows, kDefaultDataWidth, CV_32FC3, const_cast<cv::Point3f*>(pc_vec[j].data()));
+                failed += cv::imwrite(scan_prefix + "_pc.tiff", pc_image, compression_params) ? 0 : 1;
+                if (gray_vec[j].size() == pc_vec[j].size()) {
+                    cv::Mat gray_image(rows, kDefaultDataWidth, CV_8UC1, const_cast<uint8_t*>(gray_vec[j].data()));
+                    failed += cv::imwrite(scan_prefix + "_gray.tiff", gray_image, compression_params) ? 0 : 1;
+                }
+            }
+        }
+        if (failed > 0)
+            LOG(WARNING) << "cycle " << cycle << ": " << failed << " files failed to save";
+        return failed > 0 ? -1 : 0;
+    }
+
+    CycleTiming RunCycle(ScannerLApi& scanner, const Options& options, int cycle) {
+        CycleTiming timing;
+        const auto cycle_time = SteadyClock::now();
+
+        auto phase_time = SteadyClock::now();
+        int flag = scanner.Start();
+        timing.start_ms = ElapsedMs(phase_time);
+        if (flag != 0) {
+            LOG(ERROR) << "cycle " << cycle << ": Start failed " << flag;
+            timing.status = -1;
+            return timing;
+        }
+
+        phase_time = SteadyClock::now();
+        if (!WaitAcquisition(scanner, options.timeout_s)) {
+            LOG(ERROR) << "cycle " << cycle << ": acquisition timed out after " << scanner.GetBatchCount() << " batches";
+            timing.status = -2;
+        }
+        timing.acquisition_ms = ElapsedMs(phase_time);
+        timing.batches = scanner.GetBatchCount();
+
+        phase_time = SteadyClock::now();
+        flag = scanner.End();
+        timing.end_ms = ElapsedMs(phase_time);
+        timing.stitch_ms = scanner.GetLastStitchMs();
+        if (flag != 0) {
+            LOG(ERROR) << "cycle " << cycle << ": End failed " << flag;
+            timing.status = -3;
+            return timing;
+        }
+
+        std::vector<std::vector<cv::Point3f>> pc_vec;
+        std::vector<std::vector<uint8_t>> gray_vec;
+        std::vector<std::vector<int32_t>> encoder_vec;
+        std::vector<std::vector<uint32_t>> framecnt_vec;
+        phase_time = SteadyClock::now();
+        flag = scanner.GetAllData(pc_vec, gray_vec, encoder_vec, framecnt_vec);
+        timing.get_all_data_ms = ElapsedMs(phase_time);
+        if (flag != 0) {
+            LOG(ERROR) << "cycle " << cycle << ": GetAllData failed " << flag;
+            timing.status = -4;
+            return timing;
+        }
+        for (const auto& pc : pc_vec)
+            timing.points += pc.size();
+
+        if (!options.save_formats.empty()) {
+            phase_time = SteadyClock::now();
+            if (SaveCycle(scanner, options, cycle, pc_vec, gray_vec, encoder_vec, framecnt_vec) != 0 && timing.status == 0)
+                timing.status = -5;
+            timing.save_ms = ElapsedMs(phase_time);
+        }
+        timing.total_ms = ElapsedMs(cycle_time);
+        LOG(INFO) << "cycle " << cycle << " status " << timing.status << " points " << timing.points << " total " << timing.total_ms << " ms";
+        return timing;
+    }
+
+    json Summarize(const std::vector<CycleTiming>& cycles, double CycleTiming::*field) {
+        json summary;
+        if (cycles.empty())
+            return summary;
+        double min_v = cycles.front().*field, max_v = min_v, sum = 0.0;
+        for (const auto& c : cycles) {
+            min_v = std::min(min_v, c.*field);
+            max_v = std::max(max_v, c.*field);
+            sum += c.*field;
+        }
+        summary["min"] = min_v;
+        summary["mean"] = sum / cycles.size();
+        summary["max"] = max_v;
+        return summary;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    const int parse_flag = ParseArgs(argc, argv, options);
+    if (parse_flag != 0) {
+        PrintUsage();
+        return parse_flag > 0 ? 0 : 1;
+    }
+
+    // stdout carries the JSON, the log only goes to files
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = 0;
+    FLAGS_stderrthreshold = google::GLOG_FATAL;
+    google::SetLogDestination(google::GLOG_INFO, (options.log_dir + "/batch_scan_").c_str());
+    InstallAsyncLogging();
+
+    std::filesystem::create_directories(options.out_dir);
+
+    int result = 0;
+    json report;
+    {
+        // hardware first in auto mode, a failed Init leaves the instance half set up so start over
+        int init_status = 0;
+        auto scanner = CreateScanner(options, options.simulate == "on", init_status);
+        if (init_status != 0 && options.simulate == "auto" && !scanner->IsSimulatedDevice()) {
+            LOG(WARNING) << "Init failed (" << init_status << "), falling back to the simulated device";
+            scanner = CreateScanner(options, true, init_status);
+        }
+        report["simulated"] = scanner->IsSimulatedDevice();
+        report["recipe"] = options.recipe_id;
+        report["init_status"] = init_status;
+
+        std::vector<CycleTiming> cycles;
+        if (init_status == 0) {
+            ApplyRecipe(*scanner, options);
+            const auto connect_time = SteadyClock::now();
+            const int connect_status = scanner->Connect();
+            report["connect_ms"] = ElapsedMs(connect_time);
+            report["connect_status"] = connect_status;
+            if (connect_status == 0) {
+                for (int i = 0; i < options.cycles; i++)
+                    cycles.push_back(RunCycle(*scanner, options, i));
+                scanner->disconnect();
+            }
+        }
+
+        json cycle_array = json::array();
+        int failed_cycles = 0;
+        for (size_t i = 0; i < cycles.size(); i++) {
+            const CycleTiming& c = cycles[i];
+            cycle_array.push_back({ { "cycle", i }, { "status", c.status }, { "batches", c.batches }, { "points", c.points },
+                { "start_ms", c.start_ms }, { "acquisition_ms", c.acquisition_ms }, { "end_ms", c.end_ms },
+                { "stitch_ms", c.stitch_ms }, { "get_all_data_ms", c.get_all_data_ms }, { "save_ms", c.save_ms },
+                { "total_ms", c.total_ms } });
+            failed_cycles += c.status != 0 ? 1 : 0;
+        }
+        report["cycles"] = cycle_array;
+        report["failed_cycles"] = failed_cycles;
+        report["summary"] = {
+            { "start_ms", Summarize(cycles, &CycleTiming::start_ms) },
+            { "acquisition_ms", Summarize(cycles, &CycleTiming::acquisition_ms) },
+            { "end_ms", Summarize(cycles, &CycleTiming::end_ms) },
+            { "stitch_ms", Summarize(cycles, &CycleTiming::stitch_ms) },
+            { "get_all_data_ms", Summarize(cycles, &CycleTiming::get_all_data_ms) },
+            { "save_ms", Summarize(cycles, &CycleTiming::save_ms) },
+            { "total_ms", Summarize(cycles, &CycleTiming::total_ms) },
+        };
+        // batch callback cost and frame gaps over all cycles, from the shared metrics registry
+        MetricsSnapshot metrics;
+        Metrics().Snapshot(metrics);
+        const HistogramSnapshot callback_us = metrics.HistogramValue(kMetricScanCallbackUs);
+        report["callback_us"] = { { "count", callback_us.count }, { "mean", callback_us.Mean() },
+            { "p50", callback_us.Percentile(0.50) }, { "p95", callback_us.Percentile(0.95) },
+            { "p99", callback_us.Percentile(0.99) } };
+        report["dropped_frames"] = metrics.CounterValue(kMetricScanDroppedFrames);
+        if (init_status != 0 || report.value("connect_status", -1) != 0 || failed_cycles > 0)
+            result = 1;
+    }
+
+    if (options.json_path.empty()) {
+        std::cout << report.dump(2) << std::endl;
+    } else {
+        std::ofstream out(options.json_path);
+        out << report.dump(2) << std::endl;
+        if (!out) {
+            std::cerr << "failed to write " << options.json_path << "\n";
+            result = 1;
+        }
+    }
+
+    ShutdownAsyncLogging();
+    google::ShutdownGoogleLogging();
+    return result;
+}
@@ -0,0 +1,311 @@
+#include "scanner_l/cloud_merge.h"
+#include "scanner_l/range_image.h"
+#include "scanner_l/post_process.h"
+#include "scanner_l/voxel_downsample.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+#include "glog/logging.h"
+
+namespace {
+    constexpr uint8_t kNoSource = 255;
+
+    using VoxelCounts = std::unordered_map<uint64_t, uint32_t>;
+
+    struct Bounds {
+        float min_x = FLT_MAX;
+        float min_y = FLT_MAX;
+        float max_x = -FLT_MAX;
+        float max_y = -FLT_MAX;
+    };
+
+    uint32_t CountOf(const VoxelCounts& counts, uint64_t key) {
+        auto it = counts.find(key);
+        return it == counts.end() ? 0 : it->second;
+    }
+
+    // head h owns a voxel unless another head has more points in it (ties go to the lower index)
+    bool OwnsVoxel(const std::vector<VoxelCounts>& counts, size_t h, uint64_t key) {
+        const uint32_t own = CountOf(counts[h], key);
+        for (size_t g = 0; g < counts.size(); g++) {
+            if (g == h)
+                continue;
+            const uint32_t other = CountOf(counts[g], key);
+            if (other > own || (other == own && g < h))
+                return false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    void CopyKept(const std::vector<T>& src, const std::vector<uint8_t>& keep, size_t expected, T* dst) {
+        if (src.size() != keep.size())
+            return;
+        size_t out = 0;
+        for (size_t i = 0; i < src.size() && out < expected; i++) {
+            if (keep[i])
+                dst[out++] = src[i];
+        }
+    }
+
+    int MergeVoxel(const std::vector<const std::vector<cv::Point3f>*>& heads,
+                   const std::vector<std::vector<uint8_t>>& gray_vec,
+                   const std::vector<std::vector<int32_t>>& encoder_vec,
+                   const std::vector<std::vector<uint32_t>>& framecnt_vec,
+                   const CloudMergeParams& params, MergedScan& out) {
+        if (params.voxel_size <= 0.0f) {
+            LOG(ERROR) << "MergeScans - bad voxel size: " << params.voxel_size;
+            return -2;
+        }
+        const float inv_size = 1.0f / params.voxel_size;
+        const int num_heads = static_cast<int>(heads.size());
+
+        // 1. points per voxel of every head
+        std::vector<VoxelCounts> counts(num_heads);
+        cv::parallel_for_(cv::Range(0, num_heads), [&](const cv::Range& range) {
+            for (int h = range.start; h < range.end; h++) {
+                counts[h].reserve((*heads[h]).size() / 8 + 1);
+                for (const auto& p : (*heads[h])) {
+                    if (IsValidZ(p.z))
+                        counts[h][VoxelKey(p, inv_size)]++;
+                }
+            }
+        });
+
+        // 2. keep the points of owned voxels; neighbours along a profile mostly share a voxel
+        std::vector<std::vector<uint8_t>> keep(num_heads);
+        cv::parallel_for_(cv::Range(0, num_heads), [&](const cv::Range& range) {
+            for (int h = range.start; h < range.end; h++) {
+                keep[h].assign((*heads[h]).size(), 0);
+                uint64_t last_key = 0;
+                bool last_owned = false;
+                bool has_last = false;
+                for (size_t i = 0; i < (*heads[h]).size(); i++) {
+                    const cv::Point3f& p = (*heads[h])[i];
+                    if (!IsValidZ(p.z))
+                        continue;
+                    const uint64_t key = VoxelKey(p, inv_size);
+                    if (!has_last || key != last_key) {
+                        last_owned = OwnsVoxel(counts, h, key);
+                        last_key = key;
+                        has_last = true;
+                    }
+                    if (last_owned)
+                        keep[h][i] = 1;
+                    else
+                        out.dropped[h]++;
+                }
+                out.kept[h] = std::count(keep[h].begin(), keep[h].end(), uint8_t(1));
+            }
+        });
+
+        // 3. concatenate in head order
+        std::vector<size_t> offsets(num_heads + 1, 0);
+        for (int h = 0; h < num_heads; h++) {
+            offsets[h + 1] = offsets[h] + out.kept[h];
+        }
+        const size_t total = offsets[num_heads];
+        auto all_match = [&](auto& vec) {
+            for (int h = 0; h < num_heads; h++) {
+                if (h >= int(vec.size()) || vec[h].size() != (*heads[h]).size())
+                    return false;
+            }
+            return true;
+        };
+        const bool with_gray = all_match(gray_vec);
+        const bool with_encoder = all_match(encoder_vec);
+        const bool with_framecnt = all_match(framecnt_vec);
+        out.pc.resize(total);
+        out.gray.resize(with_gray ? total : 0);
+        out.encoder.resize(with_encoder ? total : 0);
+        out.framecnt.resize(with_framecnt ? total : 0);
+        cv::parallel_for_(cv::Range(0, num_heads), [&](const cv::Range& range) {
+            for (int h = range.start; h < range.end; h++) {
+                CopyKept((*heads[h]), keep[h], out.kept[h], out.pc.data() + offsets[h]);
+                if (with_gray)
+                    CopyKept(gray_vec[h], keep[h], out.kept[h], out.gray.data() + offsets[h]);
+                if (with_encoder)
+                    CopyKept(encoder_vec[h], keep[h], out.kept[h], out.encoder.data() + offsets[h]);
+                if (with_framecnt)
+                    CopyKept(framecnt_vec[h], keep[h], out.kept[h], out.framecnt.data() + offsets[h]);
+            }
+        });
+        return total > 0 ? 0 : -1;
+    }
+
+    int MergeHeightMap(const std::vector<const std::vector<cv::Point3f>*>& heads, const CloudMergeParams& params, MergedScan& out) {
+        const HeightMapParams& grid = params.height_map;
+        const int num_heads = static_cast<int>(heads.size());
+        if (grid.resolution <= 0.0 || num_heads >= kNoSource) {
+            LOG(ERROR) << "MergeScans - bad resolution " << grid.resolution << " or too many heads " << num_heads;
+            return -2;
+        }
+
+        // 1. shared grid over the valid points of all heads
+        std::vector<Bounds> head_bounds(num_heads);
+        cv::parallel_for_(cv::Range(0, num_heads), [&](const cv::Range& range) {
+            for (int h = range.start; h < range.end; h++) {
+                Bounds& b = head_bounds[h];
+                for (const auto& p : (*heads[h])) {
+                    if (!IsValidZ(p.z))
+                        continue;
+                    b.min_x = std::min(b.min_x, p.x);
+                    b.max_x = std::max(b.max_x, p.x);
+                    b.min_y = std::min(b.min_y, p.y);
+                    b.max_y = std::max(b.max_y, p.y);
+                }
+            }
+        });
+        Bounds bounds;
+        for (const auto& b : head_bounds) {
+            bounds.min_x = std::min(bounds.min_x, b.min_x);
+            bounds.max_x = std::max(bounds.max_x, b.max_x);
+            bounds.min_y = std::min(bounds.min_y, b.min_y);
+            bounds.max_y = std::max(bounds.max_y, b.max_y);
+        }
+        if (bounds.min_x > bounds.max_x) {
+            LOG(ERROR) << "MergeScans - no valid point";
+            return -1;
+        }
+        const double res = grid.resolution;
+        // checked in double first, a stray far-away point would overflow the int cast
+        const double cols_d = std::floor((double(bounds.max_x) - bounds.min_x) / res) + 1.0;
+        const double rows_d = std::floor((double(bounds.max_y) - bounds.min_y) / res) + 1.0;
+        const double max_side = double(INT_MAX);
+        if (!(cols_d * rows_d <= double(grid.max_cells)) || cols_d > max_side || rows_d > max_side) {
+            LOG(ERROR) << "MergeScans - grid " << cols_d << " x " << rows_d << " exceeds " << grid.max_cells << " cells";
+            return -2;
+        }
+        const int cols = static_cast<int>(cols_d);
+        const int rows = static_cast<int>(rows_d);
+        const size_t cells = size_t(rows) * size_t(cols);
+
+        // 2. every head accumulates into its own layer, no two tasks share a cell
+        std::vector<std::vector<float>> sums(num_heads);
+        std::vector<std::vector<uint16_t>> counts(num_heads);
+        cv::parallel_for_(cv::Range(0, num_heads), [&](const cv::Range& range) {
+            for (int h = range.start; h < range.end; h++) {
+                sums[h].assign(cells, 0.0f);
+                counts[h].assign(cells, 0);
+                for (const auto& p : (*heads[h])) {
+                    if (!IsValidZ(p.z))
+                        continue;
+                    const int row = std::min(rows - 1, static_cast<int>((p.y - bounds.min_y) / res));
+                    const int col = std::min(cols - 1, static_cast<int>((p.x - bounds.min_x) / res));
+                    const size_t idx = size_t(row) * cols + col;
+                    if (counts[h][idx] == UINT16_MAX)
+                        continue;
+                    sums[h][idx] += p.z;
+                    counts[h][idx]++;
+                }
+            }
+        });
+
+        // 3. pick the owning head of every cell, row tiles in parallel
+        out.map.origin_x = bounds.min_x;
+        out.map.origin_y = bounds.min_y;
+        out.map.resolution = res;
+        out.map.reduce = HeightMapReduce::MEAN;
+        out.map.height.create(rows, cols, CV_32FC1);
+        out.map.mask.create(rows, cols, CV_8UC1);
+        out.source.create(rows, cols, CV_8UC1);
+        const int tile_rows = std::max(1, grid.tile_rows);
+        const int num_tiles = (rows + tile_rows - 1) / tile_rows;
+        std::vector<std::vector<uint64_t>> tile_kept(num_tiles, std::vector<uint64_t>(num_heads, 0));
+        std::vector<std::vector<uint64_t>> tile_dropped(num_tiles, std::vector<uint64_t>(num_heads, 0));
+        cv::parallel_for_(cv::Range(0, num_tiles), [&](const cv::Range& range) {
+            for (int t = range.start; t < range.end; t++) {
+                const int row_end = std::min(rows, (t + 1) * tile_rows);
+                for (int row = t * tile_rows; row < row_end; row++) {
+                    float* height = out.map.height.ptr<float>(row);
+                    uint8_t* mask = out.map.mask.ptr<uint8_t>(row);
+                    uint8_t* source = out.source.ptr<uint8_t>(row);
+                    const size_t base = size_t(row) * cols;
+                    for (int col = 0; col < cols; col++) {
+                        int best = -1;
+                        uint16_t best_count = 0;
+                        for (int h = 0; h < num_heads; h++) {
+                            const uint16_t cnt = counts[h][base + col];
+                            if (cnt > best_count) {
+                                best = h;
+                                best_count = cnt;
+                            }
+                        }
+                        if (best < 0) {
+                            height[col] = kInvalidZ;
+                            mask[col] = 0;
+                            source[col] = kNoSource;
+                            continue;
+                        }
+                        for (int h = 0; h < num_heads; h++) {
+                            const uint16_t cnt = counts[h][base + col];
+                            if (h == best)
+                                tile_kept[t][h] += cnt;
+                            else
+                                tile_dropped[t][h] += cnt;
+                        }
+                        height[col] = sums[best][base + col] / best_count;
+                        mask[col] = 255;
+                        source[col] = static_cast<uint8_t>(best);
+                    }
+                }
+            }
+        });
+        for (int t = 0; t < num_tiles; t++) {
+            for (int h = 0; h < num_heads; h++) {
+                out.kept[h] += tile_kept[t][h];
+                out.dropped[h] += tile_dropped[t][h];
+            }
+        }
+        return 0;
+    }
+}
+
+CloudMergeMode CloudMergeModeFromString(const std::string& name) {
+    if (name == "height_map")
+        return CloudMergeMode::HeightMap;
+    return CloudMergeMode::Voxel;
+}
+
+const char* CloudMergeModeName(CloudMergeMode mode) {
+    return mode == CloudMergeMode::HeightMap ? "height_map" : "voxel";
+}
+
+int MergeScans(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+               const std::vector<std::vector<uint8_t>>& gray_vec,
+               const std::vector<std::vector<int32_t>>& encoder_vec,
+               const std::vector<std::vector<uint32_t>>& framecnt_vec,
+               const std::vector<cv::Mat>& rts, const CloudMergeParams& params, MergedScan& out_scan) {
+    auto start = std::chrono::steady_clock::now();
+    out_scan = MergedScan();
+    const int num_heads = static_cast<int>(pc_vec.size());
+    if (num_heads == 0)
+        return -1;
+    out_scan.kept.assign(num_heads, 0);
+    out_scan.dropped.assign(num_heads, 0);
+
+    // common frame; only heads with an RT are copied and transformed, the others are used in place
+    std::vector<std::vector<cv::Point3f>> transformed(num_heads);
+    std::vector<const std::vector<cv::Point3f>*> heads(num_heads);
+    cv::parallel_for_(cv::Range(0, num_heads), [&](const cv::Range& range) {
+        for (int h = range.start; h < range.end; h++) {
+            if (h < int(rts.size()) && !rts[h].empty()) {
+                transformed[h] = pc_vec[h];
+                TransformValidPoints(transformed[h], rts[h]);
+                heads[h] = &transformed[h];
+            }
+            else {
+                heads[h] = &pc_vec[h];
+            }
+        }
+    });
+
+    int flag_merge = params.mode == CloudMergeMode::HeightMap
+        ? MergeHeightMap(heads, params, out_scan)
+        : MergeVoxel(heads, gray_vec, encoder_vec, framecnt_vec, params, out_scan);
+    out_scan.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return flag_merge;
+}
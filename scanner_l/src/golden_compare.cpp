@@ -0,0 +1,364 @@
+#include "scanner_l/golden_compare.h"
+#include "scanner_l/range_image.h"
+#include "scanner_l/profile_resampler.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <opencv2/core/hal/intrin.hpp>
+#include <nlohmann/json.hpp>
+#include "glog/logging.h"
+
+namespace {
+    struct OffsetScore
+    {
+        int dr = 0;
+        int dc = 0;
+        double sum = 0.0;
+        uint64_t count = 0;
+
+        double Mean() const { return count > 0 ? sum / count : DBL_MAX; }
+    };
+
+    // sum of |s - g| and number of cells where both are valid
+    void RowAbsDiff(const float* s, const float* g, int n, double& sum, uint64_t& count) {
+        int i = 0;
+        float row_sum = 0.0f, row_count = 0.0f;
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        const cv::v_float32 v_thr = cv::vx_setall_f32(kInvalidZThreshold), v_one = cv::vx_setall_f32(1.0f);
+        cv::v_float32 v_sum = cv::vx_setzero_f32(), v_cnt = cv::vx_setzero_f32();
+        for (; i + lanes <= n; i += lanes) {
+            const cv::v_float32 vs = cv::vx_load(s + i);
+            const cv::v_float32 vg = cv::vx_load(g + i);
+            const cv::v_float32 valid = (vs > v_thr) & (vg > v_thr);
+            v_sum += cv::v_abs(vs - vg) & valid;
+            v_cnt += v_one & valid;
+        }
+        row_sum = cv::v_reduce_sum(v_sum);
+        row_count = cv::v_reduce_sum(v_cnt);
+#endif
+        for (; i < n; i++) {
+            if (IsValidZ(s[i]) && IsValidZ(g[i])) {
+                row_sum += std::fabs(s[i] - g[i]);
+                row_count += 1.0f;
+            }
+        }
+        sum += row_sum;
+        count += static_cast<uint64_t>(row_count);
+    }
+
+    void ScoreOffset(const cv::Mat& scan, const cv::Mat& golden, int row_step, OffsetScore& score) {
+        const int r0 = std::max(0, -score.dr), r1 = std::min(scan.rows, golden.rows - score.dr);
+        const int c0 = std::max(0, -score.dc), c1 = std::min(scan.cols, golden.cols - score.dc);
+        score.sum = 0.0;
+        score.count = 0;
+        if (r1 <= r0 || c1 <= c0)
+            return;
+        for (int r = r0; r < r1; r += row_step) {
+            RowAbsDiff(scan.ptr<float>(r) + c0, golden.ptr<float>(r + score.dr) + c0 + score.dc, c1 - c0, score.sum, score.count);
+        }
+    }
+
+    // best mean |deviation| over the candidates, ties go to the one closest to the prior
+    bool SearchOffsets(const cv::Mat& scan, const cv::Mat& golden, std::vector<OffsetScore>& candidates,
+                       int row_step, uint64_t min_count, int prior_r, int prior_c, OffsetScore& best) {
+        cv::parallel_for_(cv::Range(0, static_cast<int>(candidates.size())), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; i++) {
+                ScoreOffset(scan, golden, row_step, candidates[i]);
+            }
+        });
+        bool found = false;
+        for (const auto& c : candidates) {
+            if (c.count < min_count)
+                continue;
+            const int dist = std::abs(c.dr - prior_r) + std::abs(c.dc - prior_c);
+            const int best_dist = std::abs(best.dr - prior_r) + std::abs(best.dc - prior_c);
+            if (!found || c.Mean() < best.Mean() || (c.Mean() == best.Mean() && dist < best_dist)) {
+                best = c;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    struct TileSums
+    {
+        double sum = 0.0;
+        double sum_sq = 0.0;
+        uint64_t ok = 0;
+        uint64_t warn = 0;
+        uint64_t fail = 0;
+    };
+
+    void BuildDeviation(const cv::Mat& scan, const cv::Mat& golden, int dr, int dc, const GoldenCompareParams& params,
+                        GoldenCompareResult& out) {
+        out.deviation.create(scan.rows, scan.cols, CV_32FC1);
+        out.classes.create(scan.rows, scan.cols, CV_8UC1);
+        const int c0 = std::max(0, -dc), c1 = std::max(c0, std::min(scan.cols, golden.cols - dc));
+        const int tile_rows = std::max(1, params.tile_rows);
+        const int num_tiles = (scan.rows + tile_rows - 1) / tile_rows;
+        std::vector<TileSums> tiles(num_tiles);
+        cv::parallel_for_(cv::Range(0, num_tiles), [&](const cv::Range& range) {
+            for (int t = range.start; t < range.end; t++) {
+                TileSums& sums = tiles[t];
+                const int r_end = std::min(scan.rows, (t + 1) * tile_rows);
+                for (int r = t * tile_rows; r < r_end; r++) {
+                    float* dev = out.deviation.ptr<float>(r);
+                    uint8_t* cls = out.classes.ptr<uint8_t>(r);
+                    std::fill(dev, dev + scan.cols, kInvalidZ);
+                    std::fill(cls, cls + scan.cols, static_cast<uint8_t>(DeviationClass::NoData));
+                    const int gr = r + dr;
+                    if (gr < 0 || gr >= golden.rows || c1 <= c0)
+                        continue;
+                    const float* s = scan.ptr<float>(r);
+                    const float* g = golden.ptr<float>(gr) + dc;
+                    int c = c0;
+#if CV_SIMD
+                    const int lanes = cv::v_float32::nlanes;
+                    const cv::v_float32 v_thr = cv::vx_setall_f32(kInvalidZThreshold), v_inv = cv::vx_setall_f32(kInvalidZ);
+                    for (; c + lanes <= c1; c += lanes) {
+                        const cv::v_float32 vs = cv::vx_load(s + c);
+                        const cv::v_float32 vg = cv::vx_load(g + c);
+                        cv::v_store(dev + c, cv::v_select((vs > v_thr) & (vg > v_thr), vs - vg, v_inv));
+                    }
+#endif
+                    for (; c < c1; c++) {
+                        dev[c] = IsValidZ(s[c]) && IsValidZ(g[c]) ? s[c] - g[c] : kInvalidZ;
+                    }
+                    for (c = c0; c < c1; c++) {
+                        const float d = dev[c];
+                        if (!IsValidZ(d))
+                            continue;
+                        const float a = std::fabs(d);
+                        DeviationClass k = DeviationClass::Ok;
+                        if (a > params.tolerance_fail) {
+                            k = DeviationClass::Fail;
+                            sums.fail++;
+                        }
+                        else if (a > params.tolerance_warn) {
+                            k = DeviationClass::Warn;
+                            sums.warn++;
+                        }
+                        else {
+                            sums.ok++;
+                        }
+                        cls[c] = static_cast<uint8_t>(k);
+                        sums.sum += d;
+                        sums.sum_sq += double(d) * d;
+                    }
+                }
+            }
+        });
+        double sum = 0.0, sum_sq = 0.0;
+        for (const auto& t : tiles) {
+            sum += t.sum;
+            sum_sq += t.sum_sq;
+            out.ok_cells += t.ok;
+            out.warn_cells += t.warn;
+            out.fail_cells += t.fail;
+        }
+        const uint64_t n = out.ok_cells + out.warn_cells + out.fail_cells;
+        out.mean_deviation = n > 0 ? sum / n : 0.0;
+        out.rms_deviation = n > 0 ? std::sqrt(sum_sq / n) : 0.0;
+    }
+}
+
+void GoldenCompare::SetParams(const GoldenCompareParams& params) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    params_ = params;
+}
+
+void GoldenCompare::SetReference(int recipe_id, const GoldenReference& reference) {
+    auto snapshot = std::make_shared<const GoldenReference>(reference);
+    std::lock_guard<std::mutex> lock(mutex_);
+    references_[recipe_id] = snapshot;
+}
+
+bool GoldenCompare::HasReference(int recipe_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return references_.count(recipe_id) > 0;
+}
+
+std::string GoldenCompare::ReferenceFileName(const std::string& dir, int recipe_id) {
+    return dir + "golden_" + std::to_string(recipe_id) + "_height";
+}
+
+int GoldenCompare::LoadReferences(const std::string& dir) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec)) {
+        LOG(WARNING) << "GoldenCompare - reference directory not found: " << dir;
+        return 0;
+    }
+    const std::regex name_re("golden_(-?[0-9]+)_height\\.json");
+    int loaded = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        std::smatch match;
+        const std::string name = entry.path().filename().string();
+        if (!std::regex_match(name, match, name_re))
+            continue;
+        const int recipe_id = std::stoi(match[1].str());
+        GoldenReference reference;
+        const std::string base = ReferenceFileName(dir, recipe_id);
+        if (!LoadHeightMap(base, reference.map))
+            continue;
+        try {
+            std::ifstream in_file(base + ".json");
+            nlohmann::json data = nlohmann::json::parse(in_file);
+            reference.has_encoder = data.value("has_encoder", false);
+            reference.encoder_first = data.value("encoder_first", 0);
+        }
+        catch (const std::exception& e) {
+            LOG(WARNING) << "GoldenCompare - no encoder information in " << base << ".json: " << e.what();
+        }
+        SetReference(recipe_id, reference);
+        LOG(INFO) << "GoldenCompare - loaded reference of recipe " << recipe_id << ": " << reference.map.height.cols
+            << " x " << reference.map.height.rows;
+        loaded++;
+    }
+    return loaded;
+}
+
+bool GoldenCompare::SaveReference(const std::string& dir, int recipe_id) const {
+    std::shared_ptr<const GoldenReference> reference;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = references_.find(recipe_id);
+        if (it == references_.end())
+            return false;
+        reference = it->second;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    const std::string base = ReferenceFileName(dir, recipe_id);
+    if (!SaveHeightMap(base, reference->map))
+        return false;
+
+    // the sidecar of SaveHeightMap also carries what is needed to align later scans
+    nlohmann::json data;
+    try {
+        std::ifstream in_file(base + ".json");
+        data = nlohmann::json::parse(in_file);
+    }
+    catch (const std::exception& e) {
+        LOG(ERROR) << "GoldenCompare - failed to read back " << base << ".json: " << e.what();
+        return false;
+    }
+    data["recipe_id"] = recipe_id;
+    data["has_encoder"] = reference->has_encoder;
+    data["encoder_first"] = reference->encoder_first;
+    std::ofstream out_file(base + ".json");
+    if (!out_file.is_open())
+        return false;
+    out_file << data.dump(4);
+    return true;
+}
+
+int GoldenCompare::Compare(int recipe_id, const HeightMap& scan, bool has_encoder, int32_t encoder_first,
+                           double move_per_pulse_x, double move_per_pulse_y, GoldenCompareResult& out_result) const {
+    auto start_time = std::chrono::steady_clock::now();
+    out_result = GoldenCompareResult();
+    out_result.recipe_id = recipe_id;
+
+    std::shared_ptr<const GoldenReference> reference;
+    GoldenCompareParams params;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = references_.find(recipe_id);
+        if (it == references_.end())
+            return -1;
+        reference = it->second;
+        params = params_;
+    }
+    const HeightMap& golden = reference->map;
+    if (scan.height.empty() || golden.height.empty() || scan.height.type() != CV_32FC1 || golden.height.type() != CV_32FC1
+        || std::fabs(scan.resolution - golden.resolution) > 1e-9 || scan.resolution <= 0.0) {
+        LOG(ERROR) << "GoldenCompare - maps are empty or on different grids, resolution " << scan.resolution
+            << " vs " << golden.resolution;
+        return -2;
+    }
+
+    double shift_x = scan.origin_x - golden.origin_x;
+    double shift_y = scan.origin_y - golden.origin_y;
+    if (has_encoder && reference->has_encoder) {
+        const int64_t pulses = EncoderStep(reference->encoder_first, encoder_first, params.encoder_wrap_bits);
+        shift_x += pulses * move_per_pulse_x;
+        shift_y += pulses * move_per_pulse_y;
+    }
+    out_result.prior_row = shift_y / scan.resolution;
+    out_result.prior_col = shift_x / scan.resolution;
+    const int prior_r = static_cast<int>(std::lround(out_result.prior_row));
+    const int prior_c = static_cast<int>(std::lround(out_result.prior_col));
+
+    const int radius = std::max(0, params.search_radius);
+    const int step = std::max(1, params.search_decimation);
+    std::vector<OffsetScore> candidates;
+    candidates.reserve(size_t(2 * radius + 1) * (2 * radius + 1));
+    for (int i = -radius; i <= radius; i++) {
+        for (int j = -radius; j <= radius; j++) {
+            OffsetScore c;
+            c.dr = prior_r + i;
+            c.dc = prior_c + j;
+            candidates.push_back(c);
+        }
+    }
+    OffsetScore best;
+    const uint64_t min_count = static_cast<uint64_t>(std::max(1, params.min_overlap));
+    if (!SearchOffsets(scan.height, golden.height, candidates, step, std::max<uint64_t>(1, min_count / step), prior_r, prior_c, best)) {
+        LOG(ERROR) << "GoldenCompare - no offset within " << radius << " cells overlaps " << min_count << " cells";
+        return -3;
+    }
+    if (step > 1) {
+        // the coarse search only saw every step-th row, settle the neighbourhood on all rows
+        candidates.clear();
+        for (int i = -1; i <= 1; i++) {
+            for (int j = -1; j <= 1; j++) {
+                OffsetScore c;
+                c.dr = best.dr + i;
+                c.dc = best.dc + j;
+                candidates.push_back(c);
+            }
+        }
+        SearchOffsets(scan.height, golden.height, candidates, 1, min_count, best.dr, best.dc, best);
+    }
+    out_result.offset_row = best.dr;
+    out_result.offset_col = best.dc;
+
+    BuildDeviation(scan.height, golden.height, best.dr, best.dc, params, out_result);
+    out_result.valid = true;
+    out_result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    return 0;
+}
+
+bool SaveGoldenComparison(const std::string& filename, const GoldenCompareResult& result) {
+    if (!result.valid)
+        return false;
+    std::vector<int> compression_params = { cv::IMWRITE_TIFF_COMPRESSION, 1 };
+    if (!cv::imwrite(filename + ".tiff", result.deviation, compression_params)
+        || !cv::imwrite(filename + "_class.tiff", result.classes, compression_params)) {
+        LOG(ERROR) << "SaveGoldenComparison - failed to write " << filename << " images";
+        return false;
+    }
+    nlohmann::json data;
+    data["recipe_id"] = result.recipe_id;
+    data["offset_row"] = result.offset_row;
+    data["offset_col"] = result.offset_col;
+    data["prior_row"] = result.prior_row;
+    data["prior_col"] = result.prior_col;
+    data["mean_deviation"] = result.mean_deviation;
+    data["rms_deviation"] = result.rms_deviation;
+    data["ok_cells"] = result.ok_cells;
+    data["warn_cells"] = result.warn_cells;
+    data["fail_cells"] = result.fail_cells;
+    data["elapsed_ms"] = result.elapsed_ms;
+    std::ofstream out_file(filename + ".json");
+    if (!out_file.is_open()) {
+        LOG(ERROR) << "SaveGoldenComparison - failed to write " << filename << ".json";
+        return false;
+    }
+    out_file << data.dump(4);
+    return true;
+}
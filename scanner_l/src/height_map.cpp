@@ -0,0 +1,252 @@
+#include "scanner_l/height_map.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // points per binning chunk, chunks are the unit of parallel work before the tiles exist
+    constexpr size_t kChunkPoints = 1 << 16;
+
+    struct Bounds {
+        float min_x = FLT_MAX;
+        float min_y = FLT_MAX;
+        float max_x = -FLT_MAX;
+        float max_y = -FLT_MAX;
+    };
+}
+
+HeightMapReduce HeightMapReduceFromString(const std::string& name) {
+    if (name == "min")
+        return HeightMapReduce::MIN;
+    if (name == "mean")
+        return HeightMapReduce::MEAN;
+    return HeightMapReduce::MAX;
+}
+
+const char* HeightMapReduceName(HeightMapReduce reduce) {
+    switch (reduce) {
+    case HeightMapReduce::MIN:
+        return "min";
+    case HeightMapReduce::MEAN:
+        return "mean";
+    default:
+        return "max";
+    }
+}
+
+int BuildHeightMap(const float* xyz, size_t num, const HeightMapParams& params, HeightMap& out_map) {
+    if (params.resolution <= 0.0) {
+        LOG(ERROR) << "BuildHeightMap - bad resolution: " << params.resolution;
+        return -2;
+    }
+    if (num > UINT32_MAX) {
+        LOG(ERROR) << "BuildHeightMap - too many points: " << num;
+        return -2;
+    }
+    const size_t num_chunks = std::max<size_t>(1, (num + kChunkPoints - 1) / kChunkPoints);
+
+    // 1. bounds of the valid points
+    std::vector<Bounds> chunk_bounds(num_chunks);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(num_chunks)), [&](const cv::Range& range) {
+        for (int c = range.start; c < range.end; c++) {
+            Bounds b;
+            const size_t end = std::min(num, (c + 1) * kChunkPoints);
+            for (size_t i = c * kChunkPoints; i < end; i++) {
+                const float* p = xyz + i * 3;
+                if (!IsValidZ(p[2]))
+                    continue;
+                b.min_x = std::min(b.min_x, p[0]);
+                b.max_x = std::max(b.max_x, p[0]);
+                b.min_y = std::min(b.min_y, p[1]);
+                b.max_y = std::max(b.max_y, p[1]);
+            }
+            chunk_bounds[c] = b;
+        }
+    });
+    Bounds bounds;
+    for (const auto& b : chunk_bounds) {
+        bounds.min_x = std::min(bounds.min_x, b.min_x);
+        bounds.max_x = std::max(bounds.max_x, b.max_x);
+        bounds.min_y = std::min(bounds.min_y, b.min_y);
+        bounds.max_y = std::max(bounds.max_y, b.max_y);
+    }
+    if (bounds.min_x > bounds.max_x) {
+        LOG(ERROR) << "BuildHeightMap - no valid point in " << num;
+        return -1;
+    }
+
+    const double res = params.resolution;
+    // checked in double first, a stray far-away point would overflow the int cast
+    const double cols_d = std::floor((double(bounds.max_x) - bounds.min_x) / res) + 1.0;
+    const double rows_d = std::floor((double(bounds.max_y) - bounds.min_y) / res) + 1.0;
+    const double max_side = double(INT_MAX);
+    if (!(cols_d * rows_d <= double(params.max_cells)) || cols_d > max_side || rows_d > max_side) {
+        LOG(ERROR) << "BuildHeightMap - grid " << cols_d << " x " << rows_d << " exceeds " << params.max_cells << " cells";
+        return -2;
+    }
+    const int cols = static_cast<int>(cols_d);
+    const int rows = static_cast<int>(rows_d);
+    const int tile_rows = std::max(1, params.tile_rows);
+    const int num_tiles = (rows + tile_rows - 1) / tile_rows;
+
+    out_map.origin_x = bounds.min_x;
+    out_map.origin_y = bounds.min_y;
+    out_map.resolution = res;
+    out_map.reduce = params.reduce;
+    out_map.height.create(rows, cols, CV_32FC1);
+    out_map.mask.create(rows, cols, CV_8UC1);
+    out_map.height.setTo(cv::Scalar(kInvalidZ));
+    out_map.mask.setTo(cv::Scalar(0));
+
+    auto cell_row = [&](const float* p) {
+        return std::min(rows - 1, static_cast<int>((p[1] - bounds.min_y) / res));
+    };
+    auto cell_col = [&](const float* p) {
+        return std::min(cols - 1, static_cast<int>((p[0] - bounds.min_x) / res));
+    };
+
+    // 2. counting sort of the point indices by tile
+    std::vector<uint32_t> chunk_counts(num_chunks * num_tiles, 0);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(num_chunks)), [&](const cv::Range& range) {
+        for (int c = range.start; c < range.end; c++) {
+            uint32_t* counts = chunk_counts.data() + size_t(c) * num_tiles;
+            const size_t end = std::min(num, (c + 1) * kChunkPoints);
+            for (size_t i = c * kChunkPoints; i < end; i++) {
+                const float* p = xyz + i * 3;
+                if (IsValidZ(p[2]))
+                    counts[cell_row(p) / tile_rows]++;
+            }
+        }
+    });
+    // tile t of chunk c starts at tile_begin[t] + counts of t in chunks before c
+    std::vector<size_t> tile_begin(num_tiles + 1, 0);
+    std::vector<size_t> chunk_offsets(num_chunks * num_tiles);
+    for (int t = 0; t < num_tiles; t++) {
+        size_t offset = tile_begin[t];
+        for (size_t c = 0; c < num_chunks; c++) {
+            chunk_offsets[c * num_tiles + t] = offset;
+            offset += chunk_counts[c * num_tiles + t];
+        }
+        tile_begin[t + 1] = offset;
+    }
+    std::vector<uint32_t> order(tile_begin[num_tiles]);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(num_chunks)), [&](const cv::Range& range) {
+        for (int c = range.start; c < range.end; c++) {
+            size_t* offsets = chunk_offsets.data() + size_t(c) * num_tiles;
+            const size_t end = std::min(num, (c + 1) * kChunkPoints);
+            for (size_t i = c * kChunkPoints; i < end; i++) {
+                const float* p = xyz + i * 3;
+                if (IsValidZ(p[2]))
+                    order[offsets[cell_row(p) / tile_rows]++] = static_cast<uint32_t>(i);
+            }
+        }
+    });
+
+    // 3. every tile reduces its own rows
+    cv::parallel_for_(cv::Range(0, num_tiles), [&](const cv::Range& range) {
+        std::vector<float> sum;
+        std::vector<int> count;
+        for (int t = range.start; t < range.end; t++) {
+            const int row_begin = t * tile_rows;
+            const int row_end = std::min(rows, row_begin + tile_rows);
+            if (params.reduce == HeightMapReduce::MEAN) {
+                sum.assign(size_t(row_end - row_begin) * cols, 0.0f);
+                count.assign(sum.size(), 0);
+            }
+            for (size_t k = tile_begin[t]; k < tile_begin[t + 1]; k++) {
+                const float* p = xyz + size_t(order[k]) * 3;
+                const int row = cell_row(p);
+                const int col = cell_col(p);
+                float& h = out_map.height.at<float>(row, col);
+                uchar& m = out_map.mask.at<uchar>(row, col);
+                switch (params.reduce) {
+                case HeightMapReduce::MIN:
+                    h = m ? std::min(h, p[2]) : p[2];
+                    break;
+                case HeightMapReduce::MEAN: {
+                    const size_t idx = size_t(row - row_begin) * cols + col;
+                    sum[idx] += p[2];
+                    count[idx]++;
+                    break;
+                }
+                default:
+                    h = m ? std::max(h, p[2]) : p[2];
+                    break;
+                }
+                m = 255;
+            }
+            if (params.reduce == HeightMapReduce::MEAN) {
+                for (int row = row_begin; row < row_end; row++) {
+                    float* h = out_map.height.ptr<float>(row);
+                    const size_t base = size_t(row - row_begin) * cols;
+                    for (int col = 0; col < cols; col++) {
+                        if (count[base + col] > 0)
+                            h[col] = sum[base + col] / count[base + col];
+                    }
+                }
+            }
+        }
+    });
+    return 0;
+}
+
+bool SaveHeightMap(const std::string& filename, const HeightMap& map) {
+    if (map.height.empty()) {
+        LOG(ERROR) << "SaveHeightMap - empty height map: " << filename;
+        return false;
+    }
+    std::vector<int> compression_params = { cv::IMWRITE_TIFF_COMPRESSION, 1 };
+    if (!cv::imwrite(filename + ".tiff", map.height, compression_params)) {
+        LOG(ERROR) << "SaveHeightMap - failed to write " << filename << ".tiff";
+        return false;
+    }
+
+    nlohmann::json data;
+    data["cols"] = map.height.cols;
+    data["rows"] = map.height.rows;
+    data["origin_x"] = map.origin_x;
+    data["origin_y"] = map.origin_y;
+    data["resolution"] = map.resolution;
+    data["reduce"] = HeightMapReduceName(map.reduce);
+    data["invalid_z"] = kInvalidZ;
+    std::ofstream out_file(filename + ".json");
+    if (!out_file.is_open()) {
+        LOG(ERROR) << "SaveHeightMap - failed to write " << filename << ".json";
+        return false;
+    }
+    out_file << data.dump(4);
+    return true;
+}
+
+bool LoadHeightMap(const std::string& filename, HeightMap& out_map) {
+    std::ifstream in_file(filename + ".json");
+    if (!in_file.is_open()) {
+        LOG(ERROR) << "LoadHeightMap - failed to open " << filename << ".json";
+        return false;
+    }
+    nlohmann::json data;
+    try {
+        data = nlohmann::json::parse(in_file);
+    }
+    catch (const std::exception& e) {
+        LOG(ERROR) << "LoadHeightMap - bad json " << filename << ".json: " << e.what();
+        return false;
+    }
+    cv::Mat height = cv::imread(filename + ".tiff", cv::IMREAD_UNCHANGED);
+    if (height.empty() || height.type() != CV_32FC1) {
+        LOG(ERROR) << "LoadHeightMap - " << filename << ".tiff is missing or not CV_32FC1";
+        return false;
+    }
+    out_map.height = height;
+    out_map.mask = height > kInvalidZThreshold;
+    out_map.origin_x = data.value("origin_x", 0.0);
+    out_map.origin_y = data.value("origin_y", 0.0);
+    out_map.resolution = data.value("resolution", 0.0);
+    out_map.reduce = HeightMapReduceFromString(data.value("reduce", std::string("max")));
+    return true;
+}
@@ -0,0 +1,130 @@
+#include "scanner_l/live_preview.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include "glog/logging.h"
+
+void LivePreview::Reset(bool enable, const LivePreviewParams& params, int width) {
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+    params_ = params;
+    params_.column_step = std::max(1, params_.column_step);
+    params_.row_step = std::max(1, params_.row_step);
+    params_.ring_rows = std::max(1, params_.ring_rows);
+    width_ = std::max(1, width);
+    row_width_ = (width_ + params_.column_step - 1) / params_.column_step;
+    line_count_ = 0;
+
+    profile_.Reset();
+    acc_sum_.assign(row_width_, 0.0f);
+    acc_count_.assign(row_width_, 0);
+    acc_rows_ = 0;
+
+    // allocated here once, AddBatch() only writes into it
+    ring_capacity_ = params_.ring_rows;
+    ring_.assign(size_t(ring_capacity_) * row_width_, kInvalidZ);
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+    enable_.store(enable, std::memory_order_release);
+}
+
+bool LivePreview::IsEnabled() const {
+    return enable_.load(std::memory_order_acquire);
+}
+
+void LivePreview::AddBatch(const float* z, const int32_t* encoder, int width, int rows) {
+    if (!enable_.load(std::memory_order_acquire) || z == nullptr || rows <= 0)
+        return;
+    if (width != width_) {
+        if (line_count_ == 0)
+            LOG(WARNING) << "LivePreview - batch width " << width << " differs from " << width_ << ", no preview";
+        line_count_ += rows;
+        return;
+    }
+
+    for (int r = 0; r < rows; r++) {
+        const float* line = z + size_t(r) * width;
+        for (int cell = 0, c = 0; cell < row_width_; cell++) {
+            const int c_end = std::min(width, c + params_.column_step);
+            float sum = 0.0f;
+            uint32_t cnt = 0;
+            for (; c < c_end; c++) {
+                if (IsValidZ(line[c])) {
+                    sum += line[c];
+                    cnt++;
+                }
+            }
+            acc_sum_[cell] += sum;
+            acc_count_[cell] += cnt;
+        }
+        if (++acc_rows_ == params_.row_step)
+            PushRow();
+    }
+    line_count_ += rows;
+
+    LiveProfile& profile = profile_.Back();
+    profile.line = line_count_;
+    profile.encoder = encoder ? encoder[rows - 1] : 0;
+    profile.z.assign(z + size_t(rows - 1) * width, z + size_t(rows) * width);
+    profile_.Publish();
+}
+
+void LivePreview::PushRow() {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= uint64_t(ring_capacity_)) {
+        // the UI is behind, losing a preview row is better than stalling acquisition
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        float* dst = ring_.data() + size_t(head % ring_capacity_) * row_width_;
+        for (int cell = 0; cell < row_width_; cell++) {
+            dst[cell] = acc_count_[cell] > 0 ? acc_sum_[cell] / acc_count_[cell] : kInvalidZ;
+        }
+        head_.store(head + 1, std::memory_order_release);
+    }
+    std::fill(acc_sum_.begin(), acc_sum_.end(), 0.0f);
+    std::fill(acc_count_.begin(), acc_count_.end(), 0);
+    acc_rows_ = 0;
+}
+
+bool LivePreview::FetchProfile(LiveProfile& out) {
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+    if (!profile_.Fetch())
+        return false;
+    const LiveProfile& front = profile_.Front();
+    out.line = front.line;
+    out.encoder = front.encoder;
+    out.z.assign(front.z.begin(), front.z.end());
+    return true;
+}
+
+int LivePreview::PopRows(std::vector<float>& out_rows, int max_rows) {
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+    out_rows.clear();
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    const int num = static_cast<int>(std::min<uint64_t>(head - tail, uint64_t(std::max(0, max_rows))));
+    if (num == 0)
+        return 0;
+    out_rows.resize(size_t(num) * row_width_);
+    for (int i = 0; i < num; i++) {
+        const float* src = ring_.data() + size_t((tail + i) % ring_capacity_) * row_width_;
+        std::copy(src, src + row_width_, out_rows.data() + size_t(i) * row_width_);
+    }
+    tail_.store(tail + num, std::memory_order_release);
+    return num;
+}
+
+int LivePreview::RowWidth() const {
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+    return row_width_;
+}
+
+uint64_t LivePreview::DroppedRows() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t LivePreview::QueuedRows() const {
+    // tail first, it never passes a head loaded after it
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    return head_.load(std::memory_order_acquire) - tail;
+}
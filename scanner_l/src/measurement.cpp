@@ -0,0 +1,204 @@
+#include "scanner_l/measurement.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // compensated sum, millions of small cell volumes would otherwise lose their low bits
+    struct KahanSum
+    {
+        double sum = 0.0;
+        double c = 0.0;
+
+        void Add(double value) {
+            const double y = value - c;
+            const double t = sum + y;
+            c = (t - sum) - y;
+            sum = t;
+        }
+
+        void Add(const KahanSum& other) {
+            Add(other.sum);
+            Add(-other.c);
+        }
+    };
+
+    struct TilePartial
+    {
+        uint64_t valid_cells = 0;
+        uint64_t part_cells = 0;
+        KahanSum volume;
+        KahanSum height_sum;
+        double max_height = 0.0;
+        std::vector<float> heights;
+    };
+
+    // ROI polygon in map coordinates -> 255 inside, cells are hit by their centers
+    cv::Mat RasterizeRoi(const RoiPolygon& roi, const HeightMap& map) {
+        cv::Mat mask = cv::Mat::zeros(map.height.rows, map.height.cols, CV_8UC1);
+        if (roi.points.size() < 3)
+            return mask;
+        constexpr int kShift = 4;
+        const double scale = double(1 << kShift) / map.resolution;
+        std::vector<cv::Point> pts;
+        pts.reserve(roi.points.size());
+        for (const auto& p : roi.points) {
+            pts.emplace_back(cvRound((p.x - map.origin_x) * scale - 0.5 * (1 << kShift)),
+                             cvRound((p.y - map.origin_y) * scale - 0.5 * (1 << kShift)));
+        }
+        std::vector<std::vector<cv::Point>> polys(1, pts);
+        cv::fillPoly(mask, polys, cv::Scalar(255), cv::LINE_8, kShift);
+        return mask;
+    }
+
+    double Percentile(std::vector<float>& values, double percentile) {
+        if (values.empty())
+            return 0.0;
+        const double pos = std::min(std::max(percentile, 0.0), 100.0) / 100.0 * (values.size() - 1);
+        const size_t lo = static_cast<size_t>(pos);
+        std::nth_element(values.begin(), values.begin() + lo, values.end());
+        const double v_lo = values[lo];
+        if (lo + 1 >= values.size())
+            return v_lo;
+        const double v_hi = *std::min_element(values.begin() + lo + 1, values.end());
+        return v_lo + (pos - lo) * (v_hi - v_lo);
+    }
+
+    void MeasureRegion(const HeightMap& map, const PlaneModel* plane, const cv::Mat& roi_mask,
+                       const MeasurementParams& params, RegionMeasurement& out) {
+        const int rows = map.height.rows;
+        const int cols = map.height.cols;
+        const int tile_rows = std::max(1, params.tile_rows);
+        const int num_tiles = (rows + tile_rows - 1) / tile_rows;
+        const double res = map.resolution;
+        const double cell_area = res * res;
+
+        std::vector<TilePartial> partials(num_tiles);
+        cv::parallel_for_(cv::Range(0, num_tiles), [&](const cv::Range& range) {
+            for (int t = range.start; t < range.end; t++) {
+                TilePartial& part = partials[t];
+                const int r_end = std::min(rows, (t + 1) * tile_rows);
+                for (int r = t * tile_rows; r < r_end; r++) {
+                    const float* z = map.height.ptr<float>(r);
+                    const uint8_t* inside = roi_mask.empty() ? nullptr : roi_mask.ptr<uint8_t>(r);
+                    // base height along the row is linear in the column
+                    double base = params.base_z;
+                    double base_step = 0.0;
+                    if (plane) {
+                        const double y = map.origin_y + (r + 0.5) * res;
+                        const double x0 = map.origin_x + 0.5 * res;
+                        base = -(plane->nx * x0 + plane->ny * y + plane->d) / plane->nz;
+                        base_step = -plane->nx * res / plane->nz;
+                    }
+                    for (int c = 0; c < cols; c++, base += base_step) {
+                        if ((inside && !inside[c]) || !IsValidZ(z[c]))
+                            continue;
+                        part.valid_cells++;
+                        const double h = z[c] - base;
+                        if (h <= params.min_height)
+                            continue;
+                        part.part_cells++;
+                        part.volume.Add(h * cell_area);
+                        part.height_sum.Add(h);
+                        part.max_height = std::max(part.max_height, h);
+                        part.heights.push_back(static_cast<float>(h));
+                    }
+                }
+            }
+        });
+
+        KahanSum volume;
+        KahanSum height_sum;
+        std::vector<float> heights;
+        for (const auto& part : partials) {
+            out.valid_cells += part.valid_cells;
+            out.part_cells += part.part_cells;
+            volume.Add(part.volume);
+            height_sum.Add(part.height_sum);
+            out.max_height = std::max(out.max_height, part.max_height);
+        }
+        heights.reserve(out.part_cells);
+        for (auto& part : partials) {
+            heights.insert(heights.end(), part.heights.begin(), part.heights.end());
+            std::vector<float>().swap(part.heights);
+        }
+
+        out.area = out.part_cells * cell_area;
+        out.volume = volume.sum;
+        out.mean_height = out.part_cells > 0 ? height_sum.sum / out.part_cells : 0.0;
+        out.percentile_heights.clear();
+        for (double p : params.percentiles) {
+            out.percentile_heights.push_back(Percentile(heights, p));
+        }
+    }
+}
+
+int MeasureHeightMap(const HeightMap& map, const PlaneModel* base_plane, const std::vector<RoiPolygon>& rois,
+                     const MeasurementParams& params, MeasurementResult& out_result) {
+    auto start = std::chrono::steady_clock::now();
+    out_result = MeasurementResult();
+    if (map.height.empty() || map.height.type() != CV_32FC1 || map.resolution <= 0.0) {
+        LOG(ERROR) << "MeasureHeightMap - empty height map";
+        return -1;
+    }
+    const PlaneModel* plane = nullptr;
+    if (base_plane && base_plane->valid) {
+        if (std::fabs(base_plane->nz) > 1e-6)
+            plane = base_plane;
+        else
+            LOG(WARNING) << "MeasureHeightMap - base plane is vertical, falling back to base_z " << params.base_z;
+    }
+
+    out_result.percentiles = params.percentiles;
+    if (rois.empty()) {
+        RegionMeasurement region;
+        region.name = "all";
+        MeasureRegion(map, plane, cv::Mat(), params, region);
+        out_result.regions.push_back(region);
+    }
+    else {
+        for (const auto& roi : rois) {
+            RegionMeasurement region;
+            region.name = roi.name;
+            if (roi.points.size() < 3)
+                LOG(WARNING) << "MeasureHeightMap - ROI " << roi.name << " has fewer than 3 points";
+            MeasureRegion(map, plane, RasterizeRoi(roi, map), params, region);
+            out_result.regions.push_back(region);
+        }
+    }
+    out_result.valid = true;
+    out_result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return 0;
+}
+
+bool SaveMeasurement(const std::string& filename, const MeasurementResult& result) {
+    nlohmann::json data;
+    data["valid"] = result.valid;
+    data["percentiles"] = result.percentiles;
+    data["elapsed_ms"] = result.elapsed_ms;
+    data["regions"] = nlohmann::json::array();
+    for (const auto& region : result.regions) {
+        nlohmann::json item;
+        item["name"] = region.name;
+        item["valid_cells"] = region.valid_cells;
+        item["part_cells"] = region.part_cells;
+        item["area"] = region.area;
+        item["volume"] = region.volume;
+        item["mean_height"] = region.mean_height;
+        item["max_height"] = region.max_height;
+        item["percentile_heights"] = region.percentile_heights;
+        data["regions"].push_back(item);
+    }
+
+    std::ofstream out_file(filename);
+    if (!out_file.is_open()) {
+        LOG(ERROR) << "Failed to open measurement file: " << filename;
+        return false;
+    }
+    out_file << data.dump(4);
+    return true;
+}
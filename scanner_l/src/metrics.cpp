@@ -0,0 +1,183 @@
+#include "scanner_l/metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+double HistogramSnapshot::Mean() const {
+    return count > 0 ? sum / static_cast<double>(count) : 0.0;
+}
+
+double HistogramSnapshot::Percentile(double p) const {
+    if (count == 0 || buckets.empty()) {
+        return 0.0;
+    }
+    const double rank = std::min(1.0, std::max(0.0, p)) * static_cast<double>(count);
+    uint64_t below = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        if (static_cast<double>(below + buckets[i]) >= rank) {
+            // spread the bucket's samples evenly over its range
+            const double lower = MetricHistogram::BucketLower(static_cast<int>(i));
+            const double upper = MetricHistogram::BucketLower(static_cast<int>(i) + 1);
+            const double fraction = std::max(0.0, rank - static_cast<double>(below)) / static_cast<double>(buckets[i]);
+            return lower + (upper - lower) * fraction;
+        }
+        below += buckets[i];
+    }
+    return MetricHistogram::BucketLower(MetricHistogram::kBucketCount);
+}
+
+HistogramSnapshot HistogramSnapshot::Since(const HistogramSnapshot& earlier) const {
+    HistogramSnapshot out;
+    if (earlier.count == 0 || earlier.buckets.size() != buckets.size()) {
+        return *this;
+    }
+    out.count = count >= earlier.count ? count - earlier.count : 0;
+    if (out.count == 0) {
+        return out;
+    }
+    out.sum = sum - earlier.sum;
+    out.buckets.resize(buckets.size());
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        out.buckets[i] = buckets[i] >= earlier.buckets[i] ? buckets[i] - earlier.buckets[i] : 0;
+    }
+    return out;
+}
+
+int MetricHistogram::BucketIndex(double value) {
+    if (!(value >= 1.0)) {
+        return 0;
+    }
+    int exponent = 0;
+    const double mantissa = std::frexp(value, &exponent);  // [0.5, 1)
+    const int octave = exponent - 1;
+    if (octave >= kOctaves) {
+        return kBucketCount - 1;
+    }
+    const int sub = std::min(kSubBuckets - 1, static_cast<int>((mantissa * 2.0 - 1.0) * kSubBuckets));
+    return 1 + octave * kSubBuckets + sub;
+}
+
+double MetricHistogram::BucketLower(int index) {
+    if (index <= 0) {
+        return 0.0;
+    }
+    const int octave = (index - 1) / kSubBuckets;
+    const int sub = (index - 1) % kSubBuckets;
+    return std::ldexp(1.0 + static_cast<double>(sub) / kSubBuckets, octave);
+}
+
+void MetricHistogram::Record(double value) {
+    value = std::max(0.0, value);
+    buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    double sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+    }
+    count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MetricHistogram::Snapshot(HistogramSnapshot& out) const {
+    // not atomic as a whole; a sample recorded meanwhile may show in the buckets before the count
+    out.count = count_.load(std::memory_order_relaxed);
+    out.sum = sum_.load(std::memory_order_relaxed);
+    out.buckets.clear();
+    if (out.count == 0) {
+        return;
+    }
+    out.buckets.resize(kBucketCount);
+    for (int i = 0; i < kBucketCount; ++i) {
+        out.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+}
+
+uint64_t MetricsSnapshot::CounterValue(const std::string& name) const {
+    auto it = counters.find(name);
+    return it != counters.end() ? it->second : 0;
+}
+
+double MetricsSnapshot::GaugeValue(const std::string& name) const {
+    auto it = gauges.find(name);
+    return it != gauges.end() ? it->second : 0.0;
+}
+
+HistogramSnapshot MetricsSnapshot::HistogramValue(const std::string& name) const {
+    auto it = histograms.find(name);
+    return it != histograms.end() ? it->second : HistogramSnapshot();
+}
+
+MetricCounter* MetricsRegistry::Counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<MetricCounter>& metric = counters_[name];
+    if (!metric) {
+        metric.reset(new MetricCounter());
+    }
+    return metric.get();
+}
+
+MetricGauge* MetricsRegistry::Gauge(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<MetricGauge>& metric = gauges_[name];
+    if (!metric) {
+        metric.reset(new MetricGauge());
+    }
+    return metric.get();
+}
+
+MetricHistogram* MetricsRegistry::Histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<MetricHistogram>& metric = histograms_[name];
+    if (!metric) {
+        metric.reset(new MetricHistogram());
+    }
+    return metric.get();
+}
+
+void MetricsRegistry::Snapshot(MetricsSnapshot& out) const {
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    out.counters.clear();
+    out.gauges.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& item : counters_) {
+        out.counters[item.first] = item.second->Value();
+    }
+    for (const auto& item : gauges_) {
+        out.gauges[item.first] = item.second->Value();
+    }
+    // keep the entries (and their bucket vectors) of a reused snapshot
+    for (const auto& item : histograms_) {
+        item.second->Snapshot(out.histograms[item.first]);
+    }
+}
+
+MetricsRegistry& Metrics() {
+    // never destroyed, detached threads may still record while the process exits
+    static MetricsRegistry* registry = new MetricsRegistry();
+    return *registry;
+}
+
+size_t GetProcessRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<size_t>(counters.WorkingSetSize);
+    }
+    return 0;
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
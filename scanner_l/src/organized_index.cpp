@@ -0,0 +1,230 @@
+#include "scanner_l/organized_index.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "glog/logging.h"
+
+int OrganizedIndex::Build(const cv::Point3f* pc, int width, int rows) {
+    Clear();
+    if (pc == nullptr || width <= 0 || rows <= 0) {
+        LOG(ERROR) << "OrganizedIndex - bad scan " << width << " x " << rows;
+        return -1;
+    }
+    pc_ = pc;
+    width_ = width;
+    rows_ = rows;
+    bounds_.resize(rows);
+
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for (int r = range.start; r < range.end; r++) {
+            const cv::Point3f* row = pc + size_t(r) * width;
+            RowBounds& b = bounds_[r];
+            b.y_min = b.x_min = std::numeric_limits<float>::max();
+            b.y_max = b.x_max = std::numeric_limits<float>::lowest();
+            b.first = -1;
+            b.last = -1;
+            bool rising = true;
+            bool falling = true;
+            float prev_x = 0.0f;
+            for (int c = 0; c < width; c++) {
+                const cv::Point3f& p = row[c];
+                if (!IsValidZ(p.z))
+                    continue;
+                if (b.first < 0)
+                    b.first = c;
+                else {
+                    rising = rising && p.x >= prev_x;
+                    falling = falling && p.x <= prev_x;
+                }
+                b.last = c;
+                prev_x = p.x;
+                b.x_min = std::min(b.x_min, p.x);
+                b.x_max = std::max(b.x_max, p.x);
+                b.y_min = std::min(b.y_min, p.y);
+                b.y_max = std::max(b.y_max, p.y);
+            }
+            b.x_dir = rising ? 1.0f : (falling ? -1.0f : 0.0f);
+        }
+    });
+
+    order_.reserve(rows);
+    for (int r = 0; r < rows; r++) {
+        if (bounds_[r].first < 0)
+            continue;
+        order_.push_back(r);
+        max_row_span_ = std::max(max_row_span_, bounds_[r].y_max - bounds_[r].y_min);
+    }
+    // scans are already ordered along y (or reversed), the sort is cheap then
+    std::stable_sort(order_.begin(), order_.end(), [this](int a, int b) {
+        return bounds_[a].y_min < bounds_[b].y_min;
+    });
+    order_y_.resize(order_.size());
+    for (size_t i = 0; i < order_.size(); i++) {
+        order_y_[i] = bounds_[order_[i]].y_min;
+    }
+    return 0;
+}
+
+void OrganizedIndex::Clear() {
+    pc_ = nullptr;
+    width_ = 0;
+    rows_ = 0;
+    std::vector<RowBounds>().swap(bounds_);
+    std::vector<int>().swap(order_);
+    std::vector<float>().swap(order_y_);
+    max_row_span_ = 0.0f;
+}
+
+bool OrganizedIndex::Empty() const {
+    return order_.empty();
+}
+
+int OrganizedIndex::LowerBound(const cv::Point3f* row, int lo, int hi, float dir, float key) const {
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        int m = mid;
+        while (m < hi && !IsValidZ(row[m].z))
+            m++;
+        if (m == hi) {
+            // [mid, hi) holds no valid point
+            hi = mid;
+        }
+        else if (dir * row[m].x < key) {
+            lo = m + 1;
+        }
+        else {
+            hi = m;
+        }
+    }
+    return lo;
+}
+
+int64_t OrganizedIndex::Nearest(float x, float y, float max_dist, float* out_dist) const {
+    if (order_.empty())
+        return -1;
+    float best_sqr = max_dist > 0.0f ? max_dist * max_dist : std::numeric_limits<float>::max();
+    int64_t best = -1;
+
+    auto visit_row = [&](int r) {
+        const RowBounds& b = bounds_[r];
+        const float dy = std::max(0.0f, std::max(b.y_min - y, y - b.y_max));
+        const float dx = std::max(0.0f, std::max(b.x_min - x, x - b.x_max));
+        if (dx * dx + dy * dy >= best_sqr)
+            return;
+        const cv::Point3f* row = pc_ + size_t(r) * width_;
+        auto check = [&](int c) {
+            const cv::Point3f& p = row[c];
+            const float sqr = (p.x - x) * (p.x - x) + (p.y - y) * (p.y - y);
+            if (sqr < best_sqr) {
+                best_sqr = sqr;
+                best = int64_t(r) * width_ + c;
+            }
+        };
+        if (b.x_dir == 0.0f) {
+            for (int c = b.first; c <= b.last; c++) {
+                if (IsValidZ(row[c].z))
+                    check(c);
+            }
+            return;
+        }
+        // walk outwards from the insertion point until x alone is too far
+        const int start = LowerBound(row, b.first, b.last + 1, b.x_dir, b.x_dir * x);
+        for (int c = start; c <= b.last; c++) {
+            if (!IsValidZ(row[c].z))
+                continue;
+            if ((row[c].x - x) * (row[c].x - x) >= best_sqr)
+                break;
+            check(c);
+        }
+        for (int c = start - 1; c >= b.first; c--) {
+            if (!IsValidZ(row[c].z))
+                continue;
+            if ((row[c].x - x) * (row[c].x - x) >= best_sqr)
+                break;
+            check(c);
+        }
+    };
+
+    // rows at or above y by y_min, then alternate outwards while a closer point is still possible
+    const size_t split = std::lower_bound(order_y_.begin(), order_y_.end(), y) - order_y_.begin();
+    size_t up = split;
+    size_t down = split;
+    bool up_open = up < order_.size();
+    bool down_open = down > 0;
+    while (up_open || down_open) {
+        if (up_open) {
+            const float dy = order_y_[up] - y;
+            if (dy * dy >= best_sqr) {
+                up_open = false;
+            }
+            else {
+                visit_row(order_[up]);
+                up_open = ++up < order_.size();
+            }
+        }
+        if (down_open) {
+            // a row below reaches at most max_row_span_ above its y_min
+            const float dy = y - (order_y_[down - 1] + max_row_span_);
+            if (dy > 0.0f && dy * dy >= best_sqr) {
+                down_open = false;
+            }
+            else {
+                visit_row(order_[down - 1]);
+                down_open = --down > 0;
+            }
+        }
+    }
+    if (best >= 0 && out_dist)
+        *out_dist = std::sqrt(best_sqr);
+    return best;
+}
+
+int OrganizedIndex::RadiusSearch(float x, float y, float radius, std::vector<int64_t>& out_indices,
+                                 std::vector<float>* out_sqr_dists) const {
+    out_indices.clear();
+    if (out_sqr_dists)
+        out_sqr_dists->clear();
+    if (order_.empty() || radius <= 0.0f)
+        return 0;
+    const float radius_sqr = radius * radius;
+
+    size_t first = std::lower_bound(order_y_.begin(), order_y_.end(), y - radius - max_row_span_) - order_y_.begin();
+    size_t last = std::upper_bound(order_y_.begin(), order_y_.end(), y + radius) - order_y_.begin();
+    // visit rows in scan order so the result is in scan order as well
+    std::vector<int> rows(order_.begin() + first, order_.begin() + last);
+    std::sort(rows.begin(), rows.end());
+
+    for (int r : rows) {
+        const RowBounds& b = bounds_[r];
+        if (b.y_max < y - radius || b.x_max < x - radius || b.x_min > x + radius)
+            continue;
+        const cv::Point3f* row = pc_ + size_t(r) * width_;
+        int c_begin = b.first;
+        int c_end = b.last + 1;
+        if (b.x_dir != 0.0f) {
+            c_begin = LowerBound(row, b.first, b.last + 1, b.x_dir, b.x_dir * x - radius);
+            c_end = LowerBound(row, c_begin, b.last + 1, b.x_dir, std::nextafter(b.x_dir * x + radius, std::numeric_limits<float>::max()));
+        }
+        for (int c = c_begin; c < c_end; c++) {
+            const cv::Point3f& p = row[c];
+            if (!IsValidZ(p.z))
+                continue;
+            const float sqr = (p.x - x) * (p.x - x) + (p.y - y) * (p.y - y);
+            if (sqr <= radius_sqr) {
+                out_indices.push_back(int64_t(r) * width_ + c);
+                if (out_sqr_dists)
+                    out_sqr_dists->push_back(sqr);
+            }
+        }
+    }
+    return static_cast<int>(out_indices.size());
+}
+
+bool OrganizedIndex::HeightAt(float x, float y, float max_dist, float& out_z) const {
+    const int64_t index = Nearest(x, y, max_dist);
+    if (index < 0)
+        return false;
+    out_z = pc_[index].z;
+    return true;
+}
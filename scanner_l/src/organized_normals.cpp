@@ -0,0 +1,197 @@
+#include "scanner_l/organized_normals.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include <opencv2/core/hal/intrin.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // squared length below which the tangents are treated as parallel
+    constexpr float kMinNormalSqr = 1e-12f;
+
+    inline bool Usable(const cv::Point3f& q, float z_center, float max_jump) {
+        return IsValidZ(q.z) && (max_jump <= 0.0f || std::fabs(q.z - z_center) <= max_jump);
+    }
+
+    // central difference if both neighbors are usable, else one-sided
+    inline bool Tangent(const cv::Point3f& o, const cv::Point3f* lo, const cv::Point3f* hi, float max_jump,
+                        cv::Point3f& t) {
+        const bool lo_ok = lo && Usable(*lo, o.z, max_jump);
+        const bool hi_ok = hi && Usable(*hi, o.z, max_jump);
+        if (lo_ok && hi_ok)
+            t = *hi - *lo;
+        else if (hi_ok)
+            t = *hi - o;
+        else if (lo_ok)
+            t = o - *lo;
+        else
+            return false;
+        return true;
+    }
+
+    bool PointNormal(const cv::Point3f* pc, int width, int rows, int r, int c, const NormalEstimationParams& params,
+                     cv::Point3f& n) {
+        const cv::Point3f* o = pc + size_t(r) * width + c;
+        if (!IsValidZ(o->z))
+            return false;
+        const int s = params.step;
+        cv::Point3f th, tv;
+        if (!Tangent(*o, c - s >= 0 ? o - s : nullptr, c + s < width ? o + s : nullptr, params.max_depth_jump, th))
+            return false;
+        if (!Tangent(*o, r - s >= 0 ? o - size_t(s) * width : nullptr, r + s < rows ? o + size_t(s) * width : nullptr,
+                     params.max_depth_jump, tv))
+            return false;
+        n = th.cross(tv);
+        const float len_sqr = n.dot(n);
+        if (len_sqr < kMinNormalSqr)
+            return false;
+        float inv = 1.0f / std::sqrt(len_sqr);
+        if (params.orient_up && n.z < 0.0f)
+            inv = -inv;
+        n *= inv;
+        return true;
+    }
+
+    // normals of row r, returns the valid count
+    int NormalRow(const cv::Point3f* pc, int width, int rows, int r, const NormalEstimationParams& params,
+                  cv::Point3f* out) {
+        const int s = params.step;
+        int valid = 0;
+        int c = 0;
+        auto scalar = [&](int col) {
+            if (PointNormal(pc, width, rows, r, col, params, out[col]))
+                valid++;
+            else
+                out[col] = cv::Point3f(0.0f, 0.0f, 0.0f);
+        };
+#if CV_SIMD
+        if (r - s >= 0 && r + s < rows) {
+            const int lanes = cv::v_float32::nlanes;
+            const float* cur = reinterpret_cast<const float*>(pc + size_t(r) * width);
+            const float* prev = reinterpret_cast<const float*>(pc + size_t(r - s) * width);
+            const float* next = reinterpret_cast<const float*>(pc + size_t(r + s) * width);
+            float* dst = reinterpret_cast<float*>(out);
+            const cv::v_float32 v_thr = cv::vx_setall_f32(kInvalidZThreshold);
+            const cv::v_float32 v_jump = cv::vx_setall_f32(params.max_depth_jump > 0.0f ? params.max_depth_jump : FLT_MAX);
+            const cv::v_float32 v_min_sqr = cv::vx_setall_f32(kMinNormalSqr);
+            const cv::v_float32 v_zero = cv::vx_setzero_f32();
+            const cv::v_float32 v_one = cv::vx_setall_f32(1.0f);
+            for (; c < s && c < width; c++)
+                scalar(c);
+            for (; c + lanes <= width - s; c += lanes) {
+                cv::v_float32 ox, oy, oz, lx, ly, lz, rx, ry, rz, ux, uy, uz, dx, dy, dz;
+                cv::v_load_deinterleave(cur + 3 * c, ox, oy, oz);
+                cv::v_load_deinterleave(cur + 3 * (c - s), lx, ly, lz);
+                cv::v_load_deinterleave(cur + 3 * (c + s), rx, ry, rz);
+                cv::v_load_deinterleave(prev + 3 * c, ux, uy, uz);
+                cv::v_load_deinterleave(next + 3 * c, dx, dy, dz);
+                // fast path: all four neighbors usable, anything else goes through the scalar fallbacks
+                cv::v_float32 ok = (oz > v_thr) & (lz > v_thr) & (rz > v_thr) & (uz > v_thr) & (dz > v_thr);
+                ok = ok & (cv::v_abs(lz - oz) <= v_jump) & (cv::v_abs(rz - oz) <= v_jump)
+                    & (cv::v_abs(uz - oz) <= v_jump) & (cv::v_abs(dz - oz) <= v_jump);
+                const cv::v_float32 hx = rx - lx, hy = ry - ly, hz = rz - lz;
+                const cv::v_float32 vx = dx - ux, vy = dy - uy, vz = dz - uz;
+                const cv::v_float32 nx = hy * vz - hz * vy;
+                const cv::v_float32 ny = hz * vx - hx * vz;
+                const cv::v_float32 nz = hx * vy - hy * vx;
+                const cv::v_float32 len_sqr = nx * nx + ny * ny + nz * nz;
+                ok = ok & (len_sqr >= v_min_sqr);
+                if (!cv::v_check_all(ok)) {
+                    for (int k = c; k < c + lanes; k++)
+                        scalar(k);
+                    continue;
+                }
+                cv::v_float32 inv = v_one / cv::v_sqrt(len_sqr);
+                if (params.orient_up)
+                    inv = cv::v_select(nz < v_zero, v_zero - inv, inv);
+                cv::v_store_interleave(dst + 3 * c, nx * inv, ny * inv, nz * inv);
+                valid += lanes;
+            }
+        }
+#endif
+        for (; c < width; c++)
+            scalar(c);
+        return valid;
+    }
+
+    bool CheckParams(const cv::Point3f* pc, int width, int rows, const NormalEstimationParams& params) {
+        if (pc == nullptr || width <= 0 || rows <= 0 || params.step < 1) {
+            LOG(ERROR) << "EstimateOrganizedNormals - bad parameters, scan " << width << " x " << rows
+                << " step " << params.step;
+            return false;
+        }
+        return true;
+    }
+}
+
+int EstimateOrganizedNormals(const cv::Point3f* pc, int width, int rows, const NormalEstimationParams& params,
+                             cv::Point3f* out_normals) {
+    if (!CheckParams(pc, width, rows, params) || out_normals == nullptr)
+        return -1;
+    std::atomic<int> valid(0);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        int range_valid = 0;
+        for (int r = range.start; r < range.end; r++) {
+            range_valid += NormalRow(pc, width, rows, r, params, out_normals + size_t(r) * width);
+        }
+        valid += range_valid;
+    });
+    return valid;
+}
+
+int EstimateOrganizedNormalsPacked(const cv::Point3f* pc, int width, int rows, const NormalEstimationParams& params,
+                                   uint32_t* out_packed) {
+    if (!CheckParams(pc, width, rows, params) || out_packed == nullptr)
+        return -1;
+    std::atomic<int> valid(0);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        // only one line of float normals per task
+        std::vector<cv::Point3f> line(width);
+        int range_valid = 0;
+        for (int r = range.start; r < range.end; r++) {
+            range_valid += NormalRow(pc, width, rows, r, params, line.data());
+            uint32_t* dst = out_packed + size_t(r) * width;
+            for (int c = 0; c < width; c++) {
+                dst[c] = PackNormal(line[c]);
+            }
+        }
+        valid += range_valid;
+    });
+    return valid;
+}
+
+uint32_t PackNormal(const cv::Point3f& n) {
+    const float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (!(l1 > 0.0f))
+        return kNoPackedNormal;
+    float u = n.x / l1;
+    float v = n.y / l1;
+    if (n.z < 0.0f) {
+        // fold the lower hemisphere over the diagonals
+        const float fu = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        const float fv = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+        v = fv;
+    }
+    const uint32_t qu = static_cast<uint32_t>(std::lround((std::min(std::max(u, -1.0f), 1.0f) * 0.5f + 0.5f) * 65535.0f));
+    const uint32_t qv = static_cast<uint32_t>(std::lround((std::min(std::max(v, -1.0f), 1.0f) * 0.5f + 0.5f) * 65535.0f));
+    const uint32_t packed = qu | (qv << 16);
+    // (0, 0) is a pointing-down normal in the folded corner, move it by one step
+    return packed == kNoPackedNormal ? 1u : packed;
+}
+
+cv::Point3f UnpackNormal(uint32_t packed) {
+    if (packed == kNoPackedNormal)
+        return cv::Point3f(0.0f, 0.0f, 0.0f);
+    const float u = (packed & 0xffffu) / 65535.0f * 2.0f - 1.0f;
+    const float v = (packed >> 16) / 65535.0f * 2.0f - 1.0f;
+    cv::Point3f n(u, v, 1.0f - std::fabs(u) - std::fabs(v));
+    if (n.z < 0.0f) {
+        n.x = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+    }
+    return n * (1.0f / std::sqrt(n.dot(n)));
+}
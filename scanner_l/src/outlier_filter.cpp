@@ -0,0 +1,303 @@
+#include "scanner_l/outlier_filter.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <opencv2/core/hal/intrin.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // mean of the valid neighbors (center excluded) from SIMD box sums, one row tile
+    void MeanTile(const cv::Point3f* pc, int width, int rows, int r0, int r1, const OutlierFilterParams& params,
+                  uint8_t* mask, int& outliers) {
+        const int h = params.window / 2;
+        const int s0 = std::max(0, r0 - h);
+        const int s1 = std::min(rows, r1 + h);
+        const int padded = width + 2 * h;
+
+        // z and validity of one row with h zero columns on each side
+        std::vector<float> z_pad(padded, 0.0f), v_pad(padded, 0.0f);
+        // horizontal window sums of the source rows s0 .. s1
+        std::vector<float> hz(size_t(s1 - s0) * width), hv(size_t(s1 - s0) * width);
+        for (int r = s0; r < s1; r++) {
+            const cv::Point3f* row = pc + size_t(r) * width;
+            for (int c = 0; c < width; c++) {
+                const bool valid = IsValidZ(row[c].z);
+                z_pad[c + h] = valid ? row[c].z : 0.0f;
+                v_pad[c + h] = valid ? 1.0f : 0.0f;
+            }
+            float* out_z = hz.data() + size_t(r - s0) * width;
+            float* out_v = hv.data() + size_t(r - s0) * width;
+            int c = 0;
+#if CV_SIMD
+            const int lanes = cv::v_float32::nlanes;
+            for (; c + lanes <= width; c += lanes) {
+                cv::v_float32 sz = cv::vx_setzero_f32(), sv = cv::vx_setzero_f32();
+                for (int d = 0; d <= 2 * h; d++) {
+                    sz += cv::vx_load(z_pad.data() + c + d);
+                    sv += cv::vx_load(v_pad.data() + c + d);
+                }
+                cv::v_store(out_z + c, sz);
+                cv::v_store(out_v + c, sv);
+            }
+#endif
+            for (; c < width; c++) {
+                float sz = 0.0f, sv = 0.0f;
+                for (int d = 0; d <= 2 * h; d++) {
+                    sz += z_pad[c + d];
+                    sv += v_pad[c + d];
+                }
+                out_z[c] = sz;
+                out_v[c] = sv;
+            }
+        }
+
+        std::vector<float> box_z(width), box_v(width), center(width);
+        for (int r = r0; r < r1; r++) {
+            const int w0 = std::max(s0, r - h);
+            const int w1 = std::min(s1, r + h + 1);
+            std::fill(box_z.begin(), box_z.end(), 0.0f);
+            std::fill(box_v.begin(), box_v.end(), 0.0f);
+            for (int k = w0; k < w1; k++) {
+                const float* src_z = hz.data() + size_t(k - s0) * width;
+                const float* src_v = hv.data() + size_t(k - s0) * width;
+                int c = 0;
+#if CV_SIMD
+                const int lanes = cv::v_float32::nlanes;
+                for (; c + lanes <= width; c += lanes) {
+                    cv::v_store(box_z.data() + c, cv::vx_load(box_z.data() + c) + cv::vx_load(src_z + c));
+                    cv::v_store(box_v.data() + c, cv::vx_load(box_v.data() + c) + cv::vx_load(src_v + c));
+                }
+#endif
+                for (; c < width; c++) {
+                    box_z[c] += src_z[c];
+                    box_v[c] += src_v[c];
+                }
+            }
+
+            const cv::Point3f* row = pc + size_t(r) * width;
+            for (int c = 0; c < width; c++) {
+                center[c] = row[c].z;
+            }
+            // deviation of the center from the neighbor mean, kInvalidZ where undecided
+            int c = 0;
+#if CV_SIMD
+            const int lanes = cv::v_float32::nlanes;
+            const cv::v_float32 v_one = cv::vx_setall_f32(1.0f), v_thr = cv::vx_setall_f32(kInvalidZThreshold);
+            for (; c + lanes <= width; c += lanes) {
+                cv::v_float32 z = cv::vx_load(center.data() + c);
+                cv::v_float32 n = cv::vx_load(box_v.data() + c) - v_one;
+                cv::v_float32 mean = (cv::vx_load(box_z.data() + c) - z) / cv::v_max(n, v_one);
+                // box_v now holds the neighbor count, box_z the deviation
+                cv::v_store(box_v.data() + c, n);
+                cv::v_store(box_z.data() + c, cv::v_abs(z - mean));
+                cv::v_store(center.data() + c, cv::v_select(z > v_thr, v_one, cv::vx_setzero_f32()));
+            }
+#endif
+            for (; c < width; c++) {
+                const float z = center[c];
+                const float n = box_v[c] - 1.0f;
+                const float mean = (box_z[c] - z) / std::max(n, 1.0f);
+                box_v[c] = n;
+                box_z[c] = std::fabs(z - mean);
+                center[c] = IsValidZ(z) ? 1.0f : 0.0f;
+            }
+
+            uint8_t* out = mask + size_t(r) * width;
+            for (int i = 0; i < width; i++) {
+                if (center[i] == 0.0f)
+                    continue;
+                if (box_v[i] < params.min_neighbors || box_z[i] > params.threshold) {
+                    out[i] = 1;
+                    outliers++;
+                }
+            }
+        }
+    }
+
+    // Batcher's odd-even merge sort of n values, each pair (a, b) with a < b moves the min to a.
+    // The inputs padded up to a power of two would be +inf and never move, their comparators are dropped.
+    std::vector<std::pair<int, int>> SortingNetwork(int n) {
+        int size = 1;
+        while (size < n)
+            size <<= 1;
+        std::vector<std::pair<int, int>> pairs;
+        for (int p = 1; p < size; p <<= 1) {
+            for (int k = p; k >= 1; k >>= 1) {
+                for (int j = k % p; j + k < size; j += 2 * k) {
+                    for (int i = 0; i < std::min(k, size - j - k); i++) {
+                        if ((i + j) / (2 * p) == (i + j + k) / (2 * p) && i + j + k < n)
+                            pairs.emplace_back(i + j, i + j + k);
+                    }
+                }
+            }
+        }
+        return pairs;
+    }
+
+    bool IsMedianOutlier(const cv::Point3f* pc, int width, int rows, int r, int c, const OutlierFilterParams& params,
+                         std::vector<float>& neighbors) {
+        const int h = params.window / 2;
+        const float z = pc[size_t(r) * width + c].z;
+        const int w0 = std::max(0, r - h);
+        const int w1 = std::min(rows, r + h + 1);
+        const int c0 = std::max(0, c - h);
+        const int c1 = std::min(width, c + h + 1);
+        neighbors.clear();
+        for (int k = w0; k < w1; k++) {
+            const cv::Point3f* row = pc + size_t(k) * width;
+            for (int j = c0; j < c1; j++) {
+                if ((k != r || j != c) && IsValidZ(row[j].z))
+                    neighbors.push_back(row[j].z);
+            }
+        }
+        if (static_cast<int>(neighbors.size()) < params.min_neighbors)
+            return true;
+        if (neighbors.empty())
+            return false;
+        auto mid = neighbors.begin() + neighbors.size() / 2;
+        std::nth_element(neighbors.begin(), mid, neighbors.end());
+        return std::fabs(z - *mid) > params.threshold;
+    }
+
+    // median of the valid neighbors (center excluded), one row tile; the SIMD path sorts the
+    // neighborhoods of nlanes adjacent columns at once with a sorting network, invalid values as +inf
+    void MedianTile(const cv::Point3f* pc, int width, int rows, int r0, int r1, const OutlierFilterParams& params,
+                    const std::vector<std::pair<int, int>>& network, uint8_t* mask, int& outliers) {
+        const int h = params.window / 2;
+        std::vector<float> neighbors;
+        neighbors.reserve(size_t(params.window) * params.window);
+        int c_end = 0;
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        const int num_neighbors = params.window * params.window - 1;
+        const float inf = std::numeric_limits<float>::infinity();
+        const int s0 = std::max(0, r0 - h);
+        const int s1 = std::min(rows, r1 + h);
+        const int padded = width + 2 * h;
+        // z of the source rows with h columns on each side, +inf where invalid or outside
+        std::vector<float> z_pad(size_t(s1 - s0) * padded, inf);
+        const std::vector<float> no_row(padded, inf);
+        for (int r = s0; r < s1; r++) {
+            const cv::Point3f* row = pc + size_t(r) * width;
+            float* out = z_pad.data() + size_t(r - s0) * padded + h;
+            for (int c = 0; c < width; c++) {
+                out[c] = IsValidZ(row[c].z) ? row[c].z : inf;
+            }
+        }
+        // one vector per neighbor, sorted in place
+        std::vector<float> sorted(size_t(num_neighbors) * lanes);
+        std::vector<float> flags(lanes);
+        const cv::v_float32 v_inf = cv::vx_setall_f32(inf), v_one = cv::vx_setall_f32(1.0f), v_zero = cv::vx_setzero_f32();
+        const cv::v_float32 v_half = cv::vx_setall_f32(0.5f), v_thr = cv::vx_setall_f32(params.threshold);
+        const cv::v_float32 v_min_neighbors = cv::vx_setall_f32(static_cast<float>(params.min_neighbors));
+        c_end = width - width % lanes;
+        for (int r = r0; r < r1; r++) {
+            const float* center_row = z_pad.data() + size_t(r - s0) * padded + h;
+            for (int c = 0; c < c_end; c += lanes) {
+                cv::v_float32 count = v_zero;
+                int k = 0;
+                for (int dr = -h; dr <= h; dr++) {
+                    const int src = r + dr;
+                    const float* row = (src >= 0 && src < rows) ? z_pad.data() + size_t(src - s0) * padded + h : no_row.data() + h;
+                    for (int dc = -h; dc <= h; dc++) {
+                        if (dr == 0 && dc == 0)
+                            continue;
+                        const cv::v_float32 v = cv::vx_load(row + c + dc);
+                        count += cv::v_select(v < v_inf, v_one, v_zero);
+                        cv::v_store(sorted.data() + size_t(k++) * lanes, v);
+                    }
+                }
+                for (const auto& pair : network) {
+                    float* a = sorted.data() + size_t(pair.first) * lanes;
+                    float* b = sorted.data() + size_t(pair.second) * lanes;
+                    const cv::v_float32 va = cv::vx_load(a), vb = cv::vx_load(b);
+                    cv::v_store(a, cv::v_min(va, vb));
+                    cv::v_store(b, cv::v_max(va, vb));
+                }
+                // the invalid neighbors sort to the end, the median of count valid ones sits at count / 2
+                const cv::v_float32 z = cv::vx_load(center_row + c);
+                const cv::v_float32 mid = cv::v_cvt_f32(cv::v_floor(count * v_half));
+                cv::v_float32 median = z;
+                for (int i = 0; i <= num_neighbors / 2; i++) {
+                    median = cv::v_select(mid == cv::vx_setall_f32(static_cast<float>(i)),
+                                          cv::vx_load(sorted.data() + size_t(i) * lanes), median);
+                }
+                const cv::v_float32 outlier = (z < v_inf) & ((count < v_min_neighbors) | (cv::v_abs(z - median) > v_thr));
+                if (!cv::v_check_any(outlier))
+                    continue;
+                cv::v_store(flags.data(), cv::v_select(outlier, v_one, v_zero));
+                for (int i = 0; i < lanes; i++) {
+                    if (flags[i] != 0.0f) {
+                        mask[size_t(r) * width + c + i] = 1;
+                        outliers++;
+                    }
+                }
+            }
+        }
+#endif
+        for (int r = r0; r < r1; r++) {
+            for (int c = c_end; c < width; c++) {
+                if (!IsValidZ(pc[size_t(r) * width + c].z))
+                    continue;
+                if (IsMedianOutlier(pc, width, rows, r, c, params, neighbors)) {
+                    mask[size_t(r) * width + c] = 1;
+                    outliers++;
+                }
+            }
+        }
+    }
+}
+
+OutlierMethod OutlierMethodFromString(const std::string& name) {
+    if (name == "mean")
+        return OutlierMethod::Mean;
+    return OutlierMethod::Median;
+}
+
+const char* OutlierMethodName(OutlierMethod method) {
+    return method == OutlierMethod::Mean ? "mean" : "median";
+}
+
+int FindOutliers(const cv::Point3f* pc, int width, int rows, const OutlierFilterParams& params,
+                 std::vector<uint8_t>& out_mask) {
+    if (params.window < 3 || params.window > 15 || params.window % 2 == 0) {
+        LOG(ERROR) << "FindOutliers - window must be odd and in [3, 15]: " << params.window;
+        return -1;
+    }
+    out_mask.assign(size_t(rows) * width, 0);
+    if (pc == nullptr || width <= 0 || rows <= 0)
+        return 0;
+
+    const int tile_rows = std::max(1, params.tile_rows);
+    std::vector<std::pair<int, int>> network;
+    if (params.method == OutlierMethod::Median)
+        network = SortingNetwork(params.window * params.window - 1);
+    const int num_tiles = (rows + tile_rows - 1) / tile_rows;
+    std::vector<int> tile_outliers(num_tiles, 0);
+    cv::parallel_for_(cv::Range(0, num_tiles), [&](const cv::Range& range) {
+        for (int t = range.start; t < range.end; t++) {
+            const int r0 = t * tile_rows;
+            const int r1 = std::min(rows, r0 + tile_rows);
+            if (params.method == OutlierMethod::Mean)
+                MeanTile(pc, width, rows, r0, r1, params, out_mask.data(), tile_outliers[t]);
+            else
+                MedianTile(pc, width, rows, r0, r1, params, network, out_mask.data(), tile_outliers[t]);
+        }
+    });
+
+    int outliers = 0;
+    for (int n : tile_outliers) {
+        outliers += n;
+    }
+    return outliers;
+}
+
+void MarkOutliersInvalid(cv::Point3f* pc, size_t num, const std::vector<uint8_t>& mask) {
+    const size_t n = std::min(num, mask.size());
+    for (size_t i = 0; i < n; i++) {
+        if (mask[i])
+            pc[i].z = kInvalidZ;
+    }
+}
@@ -0,0 +1,262 @@
+#include "scanner_l/plane_fit.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <opencv2/core/hal/intrin.hpp>
+#include <nlohmann/json.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // points per parallel task of the full-resolution kernels
+    constexpr size_t kResidualChunk = 1 << 16;
+
+    // RANSAC hypotheses are split into this many independently seeded tasks
+    constexpr int kRansacTasks = 16;
+
+    struct PlaneSamples {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+    };
+
+    int CountInliers(const PlaneSamples& s, float nx, float ny, float nz, float d, float thr) {
+        const int n = static_cast<int>(s.x.size());
+        int i = 0;
+        float count = 0.0f;
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        cv::v_float32 v_nx = cv::vx_setall_f32(nx), v_ny = cv::vx_setall_f32(ny);
+        cv::v_float32 v_nz = cv::vx_setall_f32(nz), v_d = cv::vx_setall_f32(d);
+        cv::v_float32 v_thr = cv::vx_setall_f32(thr), v_one = cv::vx_setall_f32(1.0f);
+        cv::v_float32 v_cnt = cv::vx_setzero_f32();
+        for (; i + lanes <= n; i += lanes) {
+            cv::v_float32 r = cv::v_muladd(cv::vx_load(s.x.data() + i), v_nx,
+                              cv::v_muladd(cv::vx_load(s.y.data() + i), v_ny,
+                              cv::v_muladd(cv::vx_load(s.z.data() + i), v_nz, v_d)));
+            v_cnt += v_one & (cv::v_abs(r) < v_thr);
+        }
+        count = cv::v_reduce_sum(v_cnt);
+#endif
+        for (; i < n; i++) {
+            if (std::fabs(s.x[i] * nx + s.y[i] * ny + s.z[i] * nz + d) < thr)
+                count += 1.0f;
+        }
+        return static_cast<int>(count);
+    }
+
+    // least-squares plane through the samples within thr of `plane`
+    bool RefinePlane(const PlaneSamples& s, float thr, PlaneModel& plane) {
+        double sum[3] = { 0, 0, 0 };
+        std::vector<int> inliers;
+        inliers.reserve(s.x.size());
+        for (size_t i = 0; i < s.x.size(); i++) {
+            double dist = plane.nx * s.x[i] + plane.ny * s.y[i] + plane.nz * s.z[i] + plane.d;
+            if (std::fabs(dist) >= thr)
+                continue;
+            inliers.push_back(static_cast<int>(i));
+            sum[0] += s.x[i];
+            sum[1] += s.y[i];
+            sum[2] += s.z[i];
+        }
+        if (inliers.size() < 3)
+            return false;
+        const double n = static_cast<double>(inliers.size());
+        const double c[3] = { sum[0] / n, sum[1] / n, sum[2] / n };
+        cv::Mat cov = cv::Mat::zeros(3, 3, CV_64FC1);
+        for (int i : inliers) {
+            const double p[3] = { s.x[i] - c[0], s.y[i] - c[1], s.z[i] - c[2] };
+            for (int r = 0; r < 3; r++) {
+                for (int k = 0; k < 3; k++) {
+                    cov.at<double>(r, k) += p[r] * p[k];
+                }
+            }
+        }
+        cv::Mat eigen_values, eigen_vectors;
+        cv::eigen(cov, eigen_values, eigen_vectors);
+        // eigen values are sorted descending, the normal is the last vector
+        double nx = eigen_vectors.at<double>(2, 0);
+        double ny = eigen_vectors.at<double>(2, 1);
+        double nz = eigen_vectors.at<double>(2, 2);
+        if (nz < 0.0) {
+            nx = -nx;
+            ny = -ny;
+            nz = -nz;
+        }
+        plane.nx = nx;
+        plane.ny = ny;
+        plane.nz = nz;
+        plane.d = -(nx * c[0] + ny * c[1] + nz * c[2]);
+
+        double sq = 0.0;
+        int count = 0;
+        for (size_t i = 0; i < s.x.size(); i++) {
+            double dist = plane.nx * s.x[i] + plane.ny * s.y[i] + plane.nz * s.z[i] + plane.d;
+            if (std::fabs(dist) >= thr)
+                continue;
+            sq += dist * dist;
+            count++;
+        }
+        plane.inliers = count;
+        plane.rms = count > 0 ? std::sqrt(sq / count) : 0.0;
+        return true;
+    }
+}
+
+int FitBasePlane(const cv::Point3f* pc, int width, int rows, const PlaneFitParams& params, PlaneModel& out_plane) {
+    out_plane = PlaneModel();
+    const int step = std::max(1, params.grid_step);
+    PlaneSamples samples;
+    for (int r = 0; r < rows; r += step) {
+        const cv::Point3f* row = pc + size_t(r) * width;
+        for (int c = 0; c < width; c += step) {
+            if (!IsValidZ(row[c].z))
+                continue;
+            samples.x.push_back(row[c].x);
+            samples.y.push_back(row[c].y);
+            samples.z.push_back(row[c].z);
+        }
+    }
+    const int num_samples = static_cast<int>(samples.x.size());
+    if (num_samples < std::max(3, params.min_inliers)) {
+        LOG(ERROR) << "FitBasePlane - not enough valid samples: " << num_samples;
+        return -1;
+    }
+
+    std::vector<PlaneModel> task_best(kRansacTasks);
+    const int per_task = std::max(1, (params.iterations + kRansacTasks - 1) / kRansacTasks);
+    cv::parallel_for_(cv::Range(0, kRansacTasks), [&](const cv::Range& range) {
+        for (int t = range.start; t < range.end; t++) {
+            cv::RNG rng(params.seed + 0x9E3779B97F4A7C15ULL * (t + 1));
+            PlaneModel best;
+            for (int it = 0; it < per_task; it++) {
+                const int a = rng.uniform(0, num_samples);
+                const int b = rng.uniform(0, num_samples);
+                const int c = rng.uniform(0, num_samples);
+                const double ux = samples.x[b] - samples.x[a], uy = samples.y[b] - samples.y[a], uz = samples.z[b] - samples.z[a];
+                const double vx = samples.x[c] - samples.x[a], vy = samples.y[c] - samples.y[a], vz = samples.z[c] - samples.z[a];
+                double nx = uy * vz - uz * vy;
+                double ny = uz * vx - ux * vz;
+                double nz = ux * vy - uy * vx;
+                const double len = std::sqrt(nx * nx + ny * ny + nz * nz);
+                if (len < 1e-9)
+                    continue;
+                nx /= len;
+                ny /= len;
+                nz /= len;
+                const double d = -(nx * samples.x[a] + ny * samples.y[a] + nz * samples.z[a]);
+                const int inliers = CountInliers(samples, float(nx), float(ny), float(nz), float(d), params.inlier_threshold);
+                if (inliers > best.inliers) {
+                    best.valid = true;
+                    best.nx = nx;
+                    best.ny = ny;
+                    best.nz = nz;
+                    best.d = d;
+                    best.inliers = inliers;
+                }
+            }
+            task_best[t] = best;
+        }
+    });
+
+    PlaneModel best;
+    for (const auto& candidate : task_best) {
+        if (candidate.inliers > best.inliers)
+            best = candidate;
+    }
+    if (!best.valid || best.inliers < params.min_inliers) {
+        LOG(ERROR) << "FitBasePlane - best hypothesis has " << best.inliers << " of " << num_samples << " samples";
+        return -2;
+    }
+    for (int i = 0; i < std::max(1, params.refine_iterations); i++) {
+        if (!RefinePlane(samples, params.inlier_threshold, best))
+            break;
+    }
+    if (best.inliers < params.min_inliers) {
+        LOG(ERROR) << "FitBasePlane - refined plane has " << best.inliers << " of " << num_samples << " samples";
+        return -2;
+    }
+    best.valid = true;
+    out_plane = best;
+    return 0;
+}
+
+void PlaneResidual(const cv::Point3f* pc, size_t num, const PlaneModel& plane, float* out_residual) {
+    const float nx = float(plane.nx), ny = float(plane.ny), nz = float(plane.nz), d = float(plane.d);
+    const int num_chunks = static_cast<int>((num + kResidualChunk - 1) / kResidualChunk);
+    cv::parallel_for_(cv::Range(0, num_chunks), [&](const cv::Range& range) {
+        for (int k = range.start; k < range.end; k++) {
+            size_t i = size_t(k) * kResidualChunk;
+            const size_t end = std::min(num, i + kResidualChunk);
+            const float* xyz = &pc[0].x;
+#if CV_SIMD
+            const size_t lanes = cv::v_float32::nlanes;
+            cv::v_float32 v_nx = cv::vx_setall_f32(nx), v_ny = cv::vx_setall_f32(ny);
+            cv::v_float32 v_nz = cv::vx_setall_f32(nz), v_d = cv::vx_setall_f32(d);
+            cv::v_float32 v_thr = cv::vx_setall_f32(kInvalidZThreshold), v_invalid = cv::vx_setall_f32(kInvalidZ);
+            for (; i + lanes <= end; i += lanes) {
+                cv::v_float32 x, y, z;
+                cv::v_load_deinterleave(xyz + 3 * i, x, y, z);
+                cv::v_float32 r = cv::v_muladd(x, v_nx, cv::v_muladd(y, v_ny, cv::v_muladd(z, v_nz, v_d)));
+                cv::v_store(out_residual + i, cv::v_select(z > v_thr, r, v_invalid));
+            }
+#endif
+            for (; i < end; i++) {
+                out_residual[i] = IsValidZ(pc[i].z) ? pc[i].x * nx + pc[i].y * ny + pc[i].z * nz + d : kInvalidZ;
+            }
+        }
+    });
+}
+
+void RemovePlaneInPlace(cv::Point3f* pc, size_t num, const PlaneModel& plane) {
+    const float nx = float(plane.nx), ny = float(plane.ny), nz = float(plane.nz), d = float(plane.d);
+    const int num_chunks = static_cast<int>((num + kResidualChunk - 1) / kResidualChunk);
+    cv::parallel_for_(cv::Range(0, num_chunks), [&](const cv::Range& range) {
+        for (int k = range.start; k < range.end; k++) {
+            size_t i = size_t(k) * kResidualChunk;
+            const size_t end = std::min(num, i + kResidualChunk);
+            float* xyz = &pc[0].x;
+#if CV_SIMD
+            const size_t lanes = cv::v_float32::nlanes;
+            cv::v_float32 v_nx = cv::vx_setall_f32(nx), v_ny = cv::vx_setall_f32(ny);
+            cv::v_float32 v_nz = cv::vx_setall_f32(nz), v_d = cv::vx_setall_f32(d);
+            cv::v_float32 v_thr = cv::vx_setall_f32(kInvalidZThreshold);
+            for (; i + lanes <= end; i += lanes) {
+                cv::v_float32 x, y, z;
+                cv::v_load_deinterleave(xyz + 3 * i, x, y, z);
+                cv::v_float32 r = cv::v_muladd(x, v_nx, cv::v_muladd(y, v_ny, cv::v_muladd(z, v_nz, v_d)));
+                cv::v_store_interleave(xyz + 3 * i, x, y, cv::v_select(z > v_thr, r, z));
+            }
+#endif
+            for (; i < end; i++) {
+                if (IsValidZ(pc[i].z))
+                    pc[i].z = pc[i].x * nx + pc[i].y * ny + pc[i].z * nz + d;
+            }
+        }
+    });
+}
+
+bool SavePlaneFit(const std::string& filename, const PlaneModel& plane, const cv::Mat& residual) {
+    if (!residual.empty()) {
+        std::vector<int> compression_params = { cv::IMWRITE_TIFF_COMPRESSION, 1 };
+        if (!cv::imwrite(filename + ".tiff", residual, compression_params)) {
+            LOG(ERROR) << "SavePlaneFit - failed to write " << filename << ".tiff";
+            return false;
+        }
+    }
+    nlohmann::json data;
+    data["valid"] = plane.valid;
+    data["nx"] = plane.nx;
+    data["ny"] = plane.ny;
+    data["nz"] = plane.nz;
+    data["d"] = plane.d;
+    data["inliers"] = plane.inliers;
+    data["rms"] = plane.rms;
+    std::ofstream out_file(filename + ".json");
+    if (!out_file.is_open()) {
+        LOG(ERROR) << "SavePlaneFit - failed to write " << filename << ".json";
+        return false;
+    }
+    out_file << data.dump(4);
+    return true;
+}
@@ -0,0 +1,118 @@
+#include "scanner_l/post_process.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include "glog/logging.h"
+
+namespace {
+    constexpr size_t kTransformChunk = 1 << 16;
+}
+
+void PostProcessConfig::LoadFromJson(const nlohmann::json& data) {
+    apply_multi_calib_rt = data.value("apply_multi_calib_rt", apply_multi_calib_rt);
+
+    outlier_filter_enable = data.value("outlier_filter_enable", outlier_filter_enable);
+    outlier_filter_action = data.value("outlier_filter_action", outlier_filter_action);
+    outlier_filter.method = OutlierMethodFromString(data.value("outlier_filter_method", std::string(OutlierMethodName(outlier_filter.method))));
+    outlier_filter.window = data.value("outlier_filter_window", outlier_filter.window);
+    outlier_filter.threshold = data.value("outlier_filter_threshold", outlier_filter.threshold);
+    outlier_filter.min_neighbors = data.value("outlier_filter_min_neighbors", outlier_filter.min_neighbors);
+
+    range_filter.fill_max_gap = data.value("range_filter_fill_max_gap", range_filter.fill_max_gap);
+    range_filter.despike_threshold = data.value("range_filter_despike_threshold", range_filter.despike_threshold);
+    range_filter.smooth = RangeSmoothMethodFromString(data.value("range_filter_smooth", std::string(RangeSmoothMethodName(range_filter.smooth))));
+    range_filter.smooth_window = data.value("range_filter_smooth_window", range_filter.smooth_window);
+    range_filter.smooth_sigma_space = data.value("range_filter_smooth_sigma_space", range_filter.smooth_sigma_space);
+    range_filter.smooth_sigma_range = data.value("range_filter_smooth_sigma_range", range_filter.smooth_sigma_range);
+
+    plane_fit_enable = data.value("plane_fit_enable", plane_fit_enable);
+    plane_fit_output = data.value("plane_fit_output", plane_fit_output);
+    plane_fit.grid_step = data.value("plane_fit_grid_step", plane_fit.grid_step);
+    plane_fit.iterations = data.value("plane_fit_iterations", plane_fit.iterations);
+    plane_fit.inlier_threshold = data.value("plane_fit_inlier_threshold", plane_fit.inlier_threshold);
+    plane_fit.refine_iterations = data.value("plane_fit_refine_iterations", plane_fit.refine_iterations);
+    plane_fit.min_inliers = data.value("plane_fit_min_inliers", plane_fit.min_inliers);
+}
+
+void TransformValidPoints(std::vector<cv::Point3f>& pc, const cv::Mat& rt) {
+    if (rt.rows != 4 || rt.cols != 4 || rt.type() != CV_64FC1) {
+        LOG(ERROR) << "TransformValidPoints - expect a 4x4 CV_64FC1 matrix";
+        return;
+    }
+    cv::Matx33f r;
+    cv::Vec3f t;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            r(i, j) = static_cast<float>(rt.at<double>(i, j));
+        }
+        t[i] = static_cast<float>(rt.at<double>(i, 3));
+    }
+    const int num_chunks = static_cast<int>((pc.size() + kTransformChunk - 1) / kTransformChunk);
+    cv::parallel_for_(cv::Range(0, num_chunks), [&](const cv::Range& range) {
+        for (int k = range.start; k < range.end; k++) {
+            const size_t end = std::min(pc.size(), (k + 1) * kTransformChunk);
+            for (size_t i = k * kTransformChunk; i < end; i++) {
+                cv::Point3f& p = pc[i];
+                if (!IsValidZ(p.z))
+                    continue;
+                const float x = r(0, 0) * p.x + r(0, 1) * p.y + r(0, 2) * p.z + t[0];
+                const float y = r(1, 0) * p.x + r(1, 1) * p.y + r(1, 2) * p.z + t[1];
+                const float z = r(2, 0) * p.x + r(2, 1) * p.y + r(2, 2) * p.z + t[2];
+                p = cv::Point3f(x, y, z);
+            }
+        }
+    });
+}
+
+int RunPostProcess(std::vector<cv::Point3f>& pc, int width, const cv::Mat& rt,
+                   const PostProcessConfig& config, PostProcessResult& out_result) {
+    out_result = PostProcessResult();
+    if (pc.empty() || width <= 0)
+        return 0;
+    const int rows = static_cast<int>(pc.size() / width);
+
+    if (config.apply_multi_calib_rt && !rt.empty()) {
+        TransformValidPoints(pc, rt);
+    }
+
+    if (config.outlier_filter_enable) {
+        std::vector<uint8_t> mask;
+        int flag_outlier = FindOutliers(pc.data(), width, rows, config.outlier_filter, mask);
+        if (flag_outlier < 0) {
+            LOG(ERROR) << "post process - outlier filter failed: " << flag_outlier;
+            return flag_outlier;
+        }
+        out_result.outliers = flag_outlier;
+        LOG(INFO) << "post process - " << OutlierMethodName(config.outlier_filter.method) << " outlier filter flagged "
+            << flag_outlier << " points";
+        // later stages rely on the organized layout, removal is left to the caller
+        MarkOutliersInvalid(pc.data(), pc.size(), mask);
+        if (config.outlier_filter_action == "remove") {
+            out_result.outlier_mask.swap(mask);
+        }
+    }
+
+    int flag_range = FilterRangeImage(pc.data(), width, rows, config.range_filter);
+    if (flag_range != 0) {
+        LOG(ERROR) << "post process - range image filter failed: " << flag_range;
+        return flag_range;
+    }
+
+    if (config.plane_fit_enable) {
+        int flag_plane = FitBasePlane(pc.data(), width, rows, config.plane_fit, out_result.plane);
+        if (flag_plane != 0) {
+            LOG(ERROR) << "post process - plane fit failed: " << flag_plane;
+            return flag_plane;
+        }
+        LOG(INFO) << "post process - plane(nx|ny|nz|d): " << out_result.plane.nx << " | " << out_result.plane.ny << " | "
+            << out_result.plane.nz << " | " << out_result.plane.d << " inliers: " << out_result.plane.inliers
+            << " rms: " << out_result.plane.rms;
+        if (config.plane_fit_output == "in_place") {
+            RemovePlaneInPlace(pc.data(), pc.size(), out_result.plane);
+        }
+        else {
+            out_result.plane_residual.create(rows, width, CV_32FC1);
+            PlaneResidual(pc.data(), size_t(rows) * width, out_result.plane, out_result.plane_residual.ptr<float>());
+        }
+    }
+    return 0;
+}
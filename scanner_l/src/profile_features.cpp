@@ -0,0 +1,206 @@
+#include "scanner_l/profile_features.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // g[c] = z[c + span] - z[c - span], 0 where either side is invalid or out of the row
+    void RowGradient(const float* z, int width, int span, float* g) {
+        const int begin = std::min(span, width);
+        const int end = std::max(begin, width - span);
+        std::fill(g, g + begin, 0.0f);
+        std::fill(g + end, g + width, 0.0f);
+        int c = begin;
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        cv::v_float32 v_thr = cv::vx_setall_f32(kInvalidZThreshold);
+        cv::v_float32 v_zero = cv::vx_setzero_f32();
+        for (; c + lanes <= end; c += lanes) {
+            cv::v_float32 a = cv::vx_load(z + c + span);
+            cv::v_float32 b = cv::vx_load(z + c - span);
+            cv::v_float32 valid = (a > v_thr) & (b > v_thr);
+            cv::v_store(g + c, cv::v_select(valid, a - b, v_zero));
+        }
+#endif
+        for (; c < end; c++) {
+            const float a = z[c + span];
+            const float b = z[c - span];
+            g[c] = IsValidZ(a) && IsValidZ(b) ? a - b : 0.0f;
+        }
+    }
+
+    // mean of the valid z in [begin, end), false if there is none
+    bool PlateauMean(const float* z, int width, int begin, int end, float& mean) {
+        begin = std::max(begin, 0);
+        end = std::min(end, width);
+        float sum = 0.0f;
+        int cnt = 0;
+        for (int c = begin; c < end; c++) {
+            if (!IsValidZ(z[c]))
+                continue;
+            sum += z[c];
+            cnt++;
+        }
+        if (cnt == 0)
+            return false;
+        mean = sum / cnt;
+        return true;
+    }
+
+    // x spacing of the line from its first and last valid point, 0 if unknown
+    float RowPitch(const float* xyz, const float* z, int width) {
+        int first = 0;
+        while (first < width && !IsValidZ(z[first]))
+            first++;
+        int last = width - 1;
+        while (last > first && !IsValidZ(z[last]))
+            last--;
+        if (last <= first)
+            return 0.0f;
+        return std::fabs(xyz[size_t(last) * 3] - xyz[size_t(first) * 3]) / (last - first);
+    }
+
+    void ExtractRow(const float* z, const float* xyz, int width, uint32_t line, int32_t encoder,
+                    const ProfileFeatureParams& params, std::vector<float>& g,
+                    std::vector<ProfileFeature>& out) {
+        const int span = std::max(1, params.gradient_span);
+        g.resize(width);
+        RowGradient(z, width, span, g.data());
+
+        const size_t first_feature = out.size();
+        int c = 0;
+        while (c < width) {
+            if (std::fabs(g[c]) < params.gradient_low) {
+                c++;
+                continue;
+            }
+            // run of same-sign gradient above the low threshold; an edge if it reaches the high one
+            const bool rising = g[c] > 0.0f;
+            const int begin = c;
+            float peak = 0.0f;
+            float weight = 0.0f;
+            float weighted = 0.0f;
+            for (; c < width && std::fabs(g[c]) >= params.gradient_low && (g[c] > 0.0f) == rising; c++) {
+                const float mag = std::fabs(g[c]);
+                peak = std::max(peak, mag);
+                weight += mag;
+                weighted += mag * c;
+            }
+            const int end = c - 1;
+            if (peak < params.gradient_high)
+                continue;
+
+            float left = 0.0f;
+            float right = 0.0f;
+            if (!PlateauMean(z, width, begin - span - params.plateau_width + 1, begin - span + 1, left)
+                || !PlateauMean(z, width, end + span, end + span + params.plateau_width, right))
+                continue;
+            const float step = right - left;
+            if (std::fabs(step) < params.min_step_height)
+                continue;
+
+            ProfileFeature feature;
+            feature.line = line;
+            feature.encoder = encoder;
+            feature.column = weighted / weight;
+            feature.polarity = step > 0.0f ? 1 : -1;
+            feature.step_height = step;
+            out.push_back(feature);
+        }
+
+        const float pitch = xyz ? RowPitch(xyz, z, width) : 0.0f;
+        for (size_t i = first_feature; i + 1 < out.size(); i++) {
+            const float columns = out[i + 1].column - out[i].column;
+            out[i].width = pitch > 0.0f ? columns * pitch : columns;
+        }
+    }
+}
+
+size_t ExtractProfileFeatures(const float* z, const float* xyz, const int32_t* encoder,
+                              int width, int rows, uint32_t first_line,
+                              const ProfileFeatureParams& params, std::vector<ProfileFeature>& out_features) {
+    if (z == nullptr || width <= 0 || rows <= 0)
+        return 0;
+
+    std::vector<std::vector<ProfileFeature>> row_features(rows);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        std::vector<float> g;
+        for (int r = range.start; r < range.end; r++) {
+            const size_t offset = size_t(r) * width;
+            ExtractRow(z + offset, xyz ? xyz + offset * 3 : nullptr, width, first_line + r,
+                       encoder ? encoder[r] : 0, params, g, row_features[r]);
+        }
+    });
+
+    const size_t before = out_features.size();
+    for (const auto& features : row_features) {
+        out_features.insert(out_features.end(), features.begin(), features.end());
+    }
+    return out_features.size() - before;
+}
+
+bool SaveProfileFeatures(const std::string& filename, const std::vector<ProfileFeature>& features) {
+    std::ofstream out_file(filename);
+    if (!out_file.is_open()) {
+        LOG(ERROR) << "Failed to open feature file: " << filename;
+        return false;
+    }
+    out_file << "line,encoder,column,polarity,step_height,width\n";
+    for (const auto& f : features) {
+        out_file << f.line << "," << f.encoder << "," << f.column << "," << int(f.polarity) << ","
+            << f.step_height << "," << f.width << "\n";
+    }
+    return true;
+}
+
+void ProfileFeatureExtractor::Reset(bool enable, const ProfileFeatureParams& params) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enable_ = enable;
+    params_ = params;
+    line_count_ = 0;
+    std::vector<ProfileFeature>().swap(features_);
+}
+
+void ProfileFeatureExtractor::SetCallback(ProfileFeatureCallback callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = std::move(callback);
+}
+
+void ProfileFeatureExtractor::AddBatch(const float* z, const float* xyz, const int32_t* encoder, int width, int rows) {
+    uint32_t first_line = 0;
+    ProfileFeatureParams params;
+    {
+        // reserve the line range, the extraction itself runs without the lock
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enable_)
+            return;
+        first_line = line_count_;
+        line_count_ += rows;
+        params = params_;
+    }
+
+    std::vector<ProfileFeature> batch;
+    ExtractProfileFeatures(z, xyz, encoder, width, rows, first_line, params, batch);
+
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        if (callback_ && !batch.empty())
+            callback_(batch.data(), batch.size());
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    features_.insert(features_.end(), batch.begin(), batch.end());
+}
+
+bool ProfileFeatureExtractor::IsEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return enable_;
+}
+
+std::vector<ProfileFeature> ProfileFeatureExtractor::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return features_;
+}
@@ -0,0 +1,245 @@
+#include "scanner_l/profile_resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include "glog/logging.h"
+
+void UnwrapEncoder(const int32_t* encoder, size_t num, int wrap_bits, std::vector<int64_t>& out_pulses) {
+    out_pulses.resize(num);
+    if (num == 0)
+        return;
+    out_pulses[0] = encoder[0];
+    for (size_t i = 1; i < num; i++) {
+        out_pulses[i] = out_pulses[i - 1] + EncoderStep(encoder[i - 1], encoder[i], wrap_bits);
+    }
+}
+
+int64_t EncoderStep(int32_t from, int32_t to, int wrap_bits) {
+    int64_t step = static_cast<int64_t>(to) - from;
+    if (wrap_bits <= 0 || wrap_bits >= 32)
+        return step;
+    const int64_t period = int64_t(1) << wrap_bits;
+    const int64_t half = period >> 1;
+    step %= period;
+    if (step >= half)
+        step -= period;
+    else if (step < -half)
+        step += period;
+    return step;
+}
+
+void ReverseProfileLines(std::vector<AIeveR_Point3F>& pc, std::vector<uint8_t>& gray,
+                         std::vector<int32_t>& encoder, std::vector<uint32_t>& frame, int data_width) {
+    const size_t lines = encoder.size();
+    if (data_width <= 0 || pc.size() != lines * data_width) {
+        LOG(ERROR) << "ReverseProfileLines - point count " << pc.size() << " does not match lines " << lines;
+        return;
+    }
+    const bool has_gray = gray.size() == pc.size();
+    for (size_t top = 0, bottom = lines - (lines > 0 ? 1 : 0); top < bottom; top++, bottom--) {
+        std::swap_ranges(pc.begin() + top * data_width, pc.begin() + (top + 1) * data_width,
+                         pc.begin() + bottom * data_width);
+        if (has_gray) {
+            std::swap_ranges(gray.begin() + top * data_width, gray.begin() + (top + 1) * data_width,
+                             gray.begin() + bottom * data_width);
+        }
+    }
+    std::reverse(encoder.begin(), encoder.end());
+    if (frame.size() == lines) {
+        std::reverse(frame.begin(), frame.end());
+    }
+}
+
+void OffsetValidPoints(std::vector<AIeveR_Point3F>& pc, float dx, float dy, float dz) {
+    for (auto& p : pc) {
+        if (!IsValidZ(p.z))
+            continue;
+        p.x += dx;
+        p.y += dy;
+        p.z += dz;
+    }
+}
+
+StitchCompareResult CompareStitchedClouds(const std::vector<AIeveR_Point3F>& reference,
+                                          const std::vector<AIeveR_Point3F>& result) {
+    StitchCompareResult cmp;
+    cmp.size_match = reference.size() == result.size();
+    const size_t num = std::min(reference.size(), result.size());
+    double sum = 0.0;
+    for (size_t i = 0; i < num; i++) {
+        if (!IsValidZ(reference[i].z) || !IsValidZ(result[i].z))
+            continue;
+        const double dx = double(reference[i].x) - result[i].x;
+        const double dy = double(reference[i].y) - result[i].y;
+        const double dz = double(reference[i].z) - result[i].z;
+        const double dev = std::sqrt(dx * dx + dy * dy + dz * dz);
+        cmp.max_deviation = std::max(cmp.max_deviation, dev);
+        sum += dev;
+        cmp.compared_points++;
+    }
+    cmp.mean_deviation = cmp.compared_points > 0 ? sum / cmp.compared_points : 0.0;
+    return cmp;
+}
+
+ProfileResampler::ProfileResampler(const ProfileResamplerParams& params)
+    : params_(params) {
+    if (params_.block_rows <= 0)
+        params_.block_rows = 64;
+}
+
+void ProfileResampler::LineTravel(const std::vector<int32_t>& in_encoder, std::vector<double>& out_travel) const {
+    std::vector<int64_t> pulses;
+    UnwrapEncoder(in_encoder.data(), in_encoder.size(), params_.encoder_wrap_bits, pulses);
+    out_travel.resize(pulses.size());
+    for (size_t i = 0; i < pulses.size(); i++) {
+        out_travel[i] = static_cast<double>(pulses[i] - pulses[0]) * params_.dist_per_pulse;
+    }
+}
+
+int ProfileResampler::Stitch(const std::vector<AIeveR_Point3F>& in_pc,
+                             const std::vector<int32_t>& in_encoder,
+                             std::vector<AIeveR_Point3F>& out_pc) const {
+    const int width = params_.data_width;
+    const int lines = static_cast<int>(in_encoder.size());
+    if (width <= 0 || in_pc.size() != size_t(lines) * width) {
+        LOG(ERROR) << "Stitch - point count " << in_pc.size() << " does not match lines " << lines << " * width " << width;
+        return -1;
+    }
+    std::vector<double> travel;
+    LineTravel(in_encoder, travel);
+
+    out_pc.resize(in_pc.size());
+    const int num_blocks = (lines + params_.block_rows - 1) / params_.block_rows;
+    cv::parallel_for_(cv::Range(0, num_blocks), [&](const cv::Range& range) {
+        for (int b = range.start; b < range.end; b++) {
+            const int row_end = std::min(lines, (b + 1) * params_.block_rows);
+            for (int row = b * params_.block_rows; row < row_end; row++) {
+                const float ox = static_cast<float>(travel[row] * params_.move_dir_x);
+                const float oy = static_cast<float>(travel[row] * params_.move_dir_y);
+                const float oz = static_cast<float>(travel[row] * params_.move_dir_z);
+                const AIeveR_Point3F* src = in_pc.data() + size_t(row) * width;
+                AIeveR_Point3F* dst = out_pc.data() + size_t(row) * width;
+                for (int c = 0; c < width; c++) {
+                    dst[c] = src[c];
+                    if (!IsValidZ(src[c].z))
+                        continue;
+                    dst[c].x += ox;
+                    dst[c].y += oy;
+                    dst[c].z += oz;
+                }
+            }
+        }
+    });
+    return 0;
+}
+
+int ProfileResampler::Resample(const std::vector<AIeveR_Point3F>& in_pc,
+                               const std::vector<uint8_t>& in_gray,
+                               const std::vector<int32_t>& in_encoder,
+                               const std::vector<uint32_t>& in_frame,
+                               std::vector<AIeveR_Point3F>& out_pc,
+                               std::vector<uint8_t>& out_gray,
+                               std::vector<int32_t>& out_encoder,
+                               std::vector<uint32_t>& out_frame) const {
+    const int width = params_.data_width;
+    const size_t lines = in_encoder.size();
+    const bool has_gray = !in_gray.empty();
+    const bool has_frame = !in_frame.empty();
+    if (width <= 0 || params_.pitch <= 0.0 || in_pc.size() != lines * width ||
+        (has_gray && in_gray.size() != in_pc.size()) || (has_frame && in_frame.size() != lines)) {
+        LOG(ERROR) << "Resample - input size mismatch, points: " << in_pc.size() << " gray: " << in_gray.size()
+            << " lines: " << lines << " frames: " << in_frame.size() << " width: " << width;
+        return -1;
+    }
+
+    std::vector<double> travel;
+    LineTravel(in_encoder, travel);
+    if (lines < 2) {
+        LOG(ERROR) << "Resample - not enough lines: " << lines;
+        return -2;
+    }
+
+    // resample along the scan direction; backward scans are mirrored so that
+    // the travel used for the search is increasing
+    const double sign = travel.back() < travel.front() ? -1.0 : 1.0;
+    std::vector<int> keep;
+    std::vector<double> keep_s;
+    keep.reserve(lines);
+    keep_s.reserve(lines);
+    for (size_t i = 0; i < lines; i++) {
+        const double s = sign * travel[i];
+        if (!keep_s.empty() && s <= keep_s.back())
+            continue;
+        keep.push_back(static_cast<int>(i));
+        keep_s.push_back(s);
+    }
+    if (keep.size() < 2) {
+        LOG(ERROR) << "Resample - encoder did not advance, usable lines: " << keep.size();
+        return -2;
+    }
+
+    const double s_first = keep_s.front();
+    const size_t out_lines = static_cast<size_t>(std::floor((keep_s.back() - s_first) / params_.pitch)) + 1;
+    out_pc.resize(out_lines * width);
+    out_gray.assign(has_gray ? out_lines * width : 0, 0);
+    out_encoder.resize(out_lines);
+    out_frame.assign(has_frame ? out_lines : 0, 0);
+
+    const int num_blocks = static_cast<int>((out_lines + params_.block_rows - 1) / params_.block_rows);
+    cv::parallel_for_(cv::Range(0, num_blocks), [&](const cv::Range& range) {
+        for (int b = range.start; b < range.end; b++) {
+            const size_t row_begin = size_t(b) * params_.block_rows;
+            const size_t row_end = std::min(out_lines, row_begin + params_.block_rows);
+            // one binary search per block, then walk forward
+            const double s_begin = s_first + row_begin * params_.pitch;
+            size_t k = std::upper_bound(keep_s.begin(), keep_s.end(), s_begin) - keep_s.begin();
+            k = k == 0 ? 0 : k - 1;
+            for (size_t row = row_begin; row < row_end; row++) {
+                const double s = s_first + row * params_.pitch;
+                while (k + 2 < keep_s.size() && keep_s[k + 1] <= s) {
+                    k++;
+                }
+                const double t = std::min(1.0, std::max(0.0, (s - keep_s[k]) / (keep_s[k + 1] - keep_s[k])));
+                const float tf = static_cast<float>(t);
+                const int line_a = keep[k];
+                const int line_b = keep[k + 1];
+                const int line_near = t < 0.5 ? line_a : line_b;
+
+                const double row_travel = sign * s;
+                const float ox = static_cast<float>(row_travel * params_.move_dir_x);
+                const float oy = static_cast<float>(row_travel * params_.move_dir_y);
+                const float oz = static_cast<float>(row_travel * params_.move_dir_z);
+
+                const AIeveR_Point3F* pa = in_pc.data() + size_t(line_a) * width;
+                const AIeveR_Point3F* pb = in_pc.data() + size_t(line_b) * width;
+                const AIeveR_Point3F* pn = in_pc.data() + size_t(line_near) * width;
+                AIeveR_Point3F* dst = out_pc.data() + row * width;
+                for (int c = 0; c < width; c++) {
+                    if (IsValidZ(pa[c].z) && IsValidZ(pb[c].z)) {
+                        dst[c].x = pa[c].x + (pb[c].x - pa[c].x) * tf + ox;
+                        dst[c].y = pa[c].y + (pb[c].y - pa[c].y) * tf + oy;
+                        dst[c].z = pa[c].z + (pb[c].z - pa[c].z) * tf + oz;
+                    }
+                    else {
+                        // the travel offset would move the invalid marker, keep it as delivered
+                        dst[c] = pn[c];
+                        if (IsValidZ(pn[c].z)) {
+                            dst[c].x += ox;
+                            dst[c].y += oy;
+                            dst[c].z += oz;
+                        }
+                    }
+                }
+                if (has_gray) {
+                    std::copy(in_gray.begin() + size_t(line_near) * width, in_gray.begin() + size_t(line_near + 1) * width,
+                              out_gray.begin() + row * width);
+                }
+                out_encoder[row] = in_encoder[line_near];
+                if (has_frame) {
+                    out_frame[row] = in_frame[line_near];
+                }
+            }
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "scanner_l/range_image_filter.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <opencv2/core/hal/intrin.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // Runs kernel(band, s0, s1, r0, r1) for every tile of rows [r0, r1). band holds the
+    // image rows [s0, s1) = tile plus `halo` rows each side, as they were before the pass;
+    // the kernel writes its results for rows [r0, r1) straight into pc.
+    template<typename Kernel>
+    void ForEachRowTile(cv::Point3f* pc, int width, int rows, int halo, int tile_rows, Kernel kernel) {
+        tile_rows = std::max(tile_rows, std::max(1, halo));
+        const int num_tiles = (rows + tile_rows - 1) / tile_rows;
+        const size_t row_bytes = size_t(width) * sizeof(cv::Point3f);
+
+        // rows around every tile boundary, copied before any tile starts writing
+        std::vector<std::vector<cv::Point3f>> boundary(num_tiles);
+        cv::parallel_for_(cv::Range(1, std::max(1, num_tiles)), [&](const cv::Range& range) {
+            for (int t = range.start; t < range.end; t++) {
+                const int b0 = std::max(0, t * tile_rows - halo);
+                const int b1 = std::min(rows, t * tile_rows + halo);
+                boundary[t].assign(pc + size_t(b0) * width, pc + size_t(b1) * width);
+            }
+        });
+
+        cv::parallel_for_(cv::Range(0, num_tiles), [&](const cv::Range& range) {
+            std::vector<cv::Point3f> band;
+            for (int t = range.start; t < range.end; t++) {
+                const int r0 = t * tile_rows;
+                const int r1 = std::min(rows, r0 + tile_rows);
+                const int s0 = std::max(0, r0 - halo);
+                const int s1 = std::min(rows, r1 + halo);
+                band.resize(size_t(s1 - s0) * width);
+                if (r0 > s0)
+                    memcpy(band.data(), boundary[t].data(), size_t(r0 - s0) * row_bytes);
+                memcpy(band.data() + size_t(r0 - s0) * width, pc + size_t(r0) * width, size_t(r1 - r0) * row_bytes);
+                if (s1 > r1) {
+                    // boundary[t + 1] starts at r1 - halo, which lies inside this tile
+                    const int offset = r1 - std::max(0, r1 - halo);
+                    memcpy(band.data() + size_t(r1 - s0) * width, boundary[t + 1].data() + size_t(offset) * width,
+                           size_t(s1 - r1) * row_bytes);
+                }
+                kernel(band.data(), s0, s1, r0, r1);
+            }
+        });
+    }
+
+    inline cv::Point3f Lerp(const cv::Point3f& a, const cv::Point3f& b, float t) {
+        return cv::Point3f(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+    }
+
+    void FillRowHoles(cv::Point3f* row, int width, int max_gap) {
+        int last = -1;
+        for (int c = 0; c < width; c++) {
+            if (!IsValidZ(row[c].z))
+                continue;
+            const int gap = c - last - 1;
+            if (last >= 0 && gap > 0 && gap <= max_gap) {
+                const float inv = 1.0f / (gap + 1);
+                for (int k = 1; k <= gap; k++) {
+                    row[last + k] = Lerp(row[last], row[c], k * inv);
+                }
+            }
+            last = c;
+        }
+    }
+
+    // z of one profile with `pad` invalid points on each side, validity as 1 / 0
+    void LoadPaddedZ(const cv::Point3f* row, int width, int pad, float* z_pad, float* v_pad) {
+        for (int c = 0; c < pad; c++) {
+            z_pad[c] = z_pad[width + pad + c] = 0.0f;
+            v_pad[c] = v_pad[width + pad + c] = 0.0f;
+        }
+        for (int c = 0; c < width; c++) {
+            const bool valid = IsValidZ(row[c].z);
+            z_pad[c + pad] = valid ? row[c].z : 0.0f;
+            v_pad[c + pad] = valid ? 1.0f : 0.0f;
+        }
+    }
+
+    // One bilateral output row. taps[k] points at the z of the k-th neighbor row (or the
+    // row shifted by k - h for the profile pass), vtaps at its validity.
+    void BilateralRow(const float* const* taps, const float* const* vtaps, const float* space_w, int num_taps,
+                      const float* center_z, const float* center_v, float inv_range2, int width, float* out) {
+        int c = 0;
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        const cv::v_float32 v_one = cv::vx_setall_f32(1.0f), v_zero = cv::vx_setzero_f32();
+        const cv::v_float32 v_inv = cv::vx_setall_f32(inv_range2), v_half = cv::vx_setall_f32(0.5f);
+        const cv::v_float32 v_eps = cv::vx_setall_f32(1e-12f);
+        for (; c + lanes <= width; c += lanes) {
+            const cv::v_float32 zc = cv::vx_load(center_z + c);
+            cv::v_float32 sum = v_zero, wsum = v_zero;
+            for (int k = 0; k < num_taps; k++) {
+                const cv::v_float32 zn = cv::vx_load(taps[k] + c);
+                const cv::v_float32 diff = zn - zc;
+                const cv::v_float32 wr = cv::v_max(v_zero, v_one - diff * diff * v_inv);
+                const cv::v_float32 w = cv::vx_setall_f32(space_w[k]) * wr * cv::vx_load(vtaps[k] + c);
+                sum = cv::v_muladd(w, zn, sum);
+                wsum += w;
+            }
+            const cv::v_float32 res = sum / cv::v_max(wsum, v_eps);
+            cv::v_store(out + c, cv::v_select(cv::vx_load(center_v + c) > v_half, res, zc));
+        }
+#endif
+        for (; c < width; c++) {
+            const float zc = center_z[c];
+            if (center_v[c] < 0.5f) {
+                out[c] = zc;
+                continue;
+            }
+            float sum = 0.0f, wsum = 0.0f;
+            for (int k = 0; k < num_taps; k++) {
+                const float diff = taps[k][c] - zc;
+                const float w = space_w[k] * std::max(0.0f, 1.0f - diff * diff * inv_range2) * vtaps[k][c];
+                sum += w * taps[k][c];
+                wsum += w;
+            }
+            out[c] = sum / std::max(wsum, 1e-12f);
+        }
+    }
+
+    float MedianOf(std::vector<float>& values) {
+        auto mid = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    }
+
+    // One median output row over the valid taps, same tap layout as BilateralRow. Blocks whose
+    // windows are fully valid go through an odd-even transposition sorting network.
+    void MedianRow(const float* const* taps, const float* const* vtaps, int num_taps,
+                   const float* center_z, const float* center_v, int width, float* out) {
+        int c = 0;
+        std::vector<float> window;
+        window.reserve(num_taps);
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        const cv::v_float32 v_half = cv::vx_setall_f32(0.5f);
+        std::vector<cv::v_float32> sorted(num_taps);
+        for (; c + lanes <= width; c += lanes) {
+            cv::v_float32 all_valid = cv::vx_load(vtaps[0] + c);
+            for (int k = 1; k < num_taps; k++) {
+                all_valid = cv::v_min(all_valid, cv::vx_load(vtaps[k] + c));
+            }
+            if (cv::v_reduce_min(all_valid) > 0.5f) {
+                for (int k = 0; k < num_taps; k++) {
+                    sorted[k] = cv::vx_load(taps[k] + c);
+                }
+                for (int pass = 0; pass < num_taps; pass++) {
+                    for (int k = pass & 1; k + 1 < num_taps; k += 2) {
+                        const cv::v_float32 lo = cv::v_min(sorted[k], sorted[k + 1]);
+                        sorted[k + 1] = cv::v_max(sorted[k], sorted[k + 1]);
+                        sorted[k] = lo;
+                    }
+                }
+                cv::v_store(out + c, cv::v_select(cv::vx_load(center_v + c) > v_half, sorted[num_taps / 2],
+                                                  cv::vx_load(center_z + c)));
+                continue;
+            }
+            for (int i = c; i < c + lanes; i++) {
+                window.clear();
+                for (int k = 0; k < num_taps; k++) {
+                    if (vtaps[k][i] != 0.0f)
+                        window.push_back(taps[k][i]);
+                }
+                out[i] = center_v[i] == 0.0f ? center_z[i] : MedianOf(window);
+            }
+        }
+#endif
+        for (; c < width; c++) {
+            window.clear();
+            for (int k = 0; k < num_taps; k++) {
+                if (vtaps[k][c] != 0.0f)
+                    window.push_back(taps[k][c]);
+            }
+            out[c] = center_v[c] == 0.0f ? center_z[c] : MedianOf(window);
+        }
+    }
+
+    void SmoothProfiles(cv::Point3f* pc, int width, int rows, const RangeFilterParams& params,
+                        const std::vector<float>& space_w) {
+        const int h = params.smooth_window / 2;
+        const float inv_range2 = 1.0f / (params.smooth_sigma_range * params.smooth_sigma_range);
+        cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+            std::vector<float> z_pad(width + 2 * h), v_pad(width + 2 * h), out(width);
+            std::vector<const float*> taps(2 * h + 1), vtaps(2 * h + 1);
+            for (int k = 0; k <= 2 * h; k++) {
+                taps[k] = z_pad.data() + k;
+                vtaps[k] = v_pad.data() + k;
+            }
+            for (int r = range.start; r < range.end; r++) {
+                cv::Point3f* row = pc + size_t(r) * width;
+                LoadPaddedZ(row, width, h, z_pad.data(), v_pad.data());
+                if (params.smooth == RangeSmoothMethod::Bilateral)
+                    BilateralRow(taps.data(), vtaps.data(), space_w.data(), 2 * h + 1, z_pad.data() + h,
+                                 v_pad.data() + h, inv_range2, width, out.data());
+                else
+                    MedianRow(taps.data(), vtaps.data(), 2 * h + 1, z_pad.data() + h, v_pad.data() + h, width, out.data());
+                // invalid points were loaded as 0, leave their markers alone
+                for (int c = 0; c < width; c++) {
+                    if (IsValidZ(row[c].z))
+                        row[c].z = out[c];
+                }
+            }
+        });
+    }
+
+    void SmoothColumns(cv::Point3f* pc, int width, int rows, const RangeFilterParams& params,
+                       const std::vector<float>& space_w) {
+        const int h = params.smooth_window / 2;
+        const float inv_range2 = 1.0f / (params.smooth_sigma_range * params.smooth_sigma_range);
+        ForEachRowTile(pc, width, rows, h, params.tile_rows, [&](const cv::Point3f* band, int s0, int s1, int r0, int r1) {
+            const int band_rows = s1 - s0;
+            std::vector<float> band_z(size_t(band_rows) * width), band_v(size_t(band_rows) * width), out(width);
+            for (size_t i = 0; i < band_z.size(); i++) {
+                const bool valid = IsValidZ(band[i].z);
+                band_z[i] = valid ? band[i].z : 0.0f;
+                band_v[i] = valid ? 1.0f : 0.0f;
+            }
+            std::vector<const float*> taps, vtaps;
+            std::vector<float> tap_w;
+            for (int r = r0; r < r1; r++) {
+                cv::Point3f* row = pc + size_t(r) * width;
+                const float* center_z = band_z.data() + size_t(r - s0) * width;
+                const float* center_v = band_v.data() + size_t(r - s0) * width;
+                taps.clear();
+                vtaps.clear();
+                tap_w.clear();
+                for (int k = -h; k <= h; k++) {
+                    if (r + k < s0 || r + k >= s1)
+                        continue;
+                    taps.push_back(band_z.data() + size_t(r + k - s0) * width);
+                    vtaps.push_back(band_v.data() + size_t(r + k - s0) * width);
+                    tap_w.push_back(space_w[k + h]);
+                }
+                const int num_taps = static_cast<int>(taps.size());
+                if (params.smooth == RangeSmoothMethod::Bilateral)
+                    BilateralRow(taps.data(), vtaps.data(), tap_w.data(), num_taps, center_z, center_v, inv_range2, width, out.data());
+                else
+                    MedianRow(taps.data(), vtaps.data(), num_taps, center_z, center_v, width, out.data());
+                for (int c = 0; c < width; c++) {
+                    if (IsValidZ(row[c].z))
+                        row[c].z = out[c];
+                }
+            }
+        });
+    }
+}
+
+RangeSmoothMethod RangeSmoothMethodFromString(const std::string& name) {
+    if (name == "bilateral")
+        return RangeSmoothMethod::Bilateral;
+    if (name == "median")
+        return RangeSmoothMethod::Median;
+    return RangeSmoothMethod::None;
+}
+
+const char* RangeSmoothMethodName(RangeSmoothMethod method) {
+    switch (method) {
+    case RangeSmoothMethod::Bilateral:
+        return "bilateral";
+    case RangeSmoothMethod::Median:
+        return "median";
+    default:
+        return "none";
+    }
+}
+
+void FillRangeHoles(cv::Point3f* pc, int width, int rows, int max_gap, int tile_rows) {
+    if (pc == nullptr || width <= 0 || rows <= 0 || max_gap <= 0)
+        return;
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for (int r = range.start; r < range.end; r++) {
+            FillRowHoles(pc + size_t(r) * width, width, max_gap);
+        }
+    });
+
+    // column pass, runs are tracked for all columns at once so the band is walked row by row
+    ForEachRowTile(pc, width, rows, max_gap, tile_rows, [&](const cv::Point3f* band, int s0, int s1, int r0, int r1) {
+        std::vector<int> last(width, -1);
+        for (int i = s0; i < s1; i++) {
+            const cv::Point3f* row = band + size_t(i - s0) * width;
+            for (int c = 0; c < width; c++) {
+                if (!IsValidZ(row[c].z))
+                    continue;
+                const int a = last[c];
+                const int gap = i - a - 1;
+                if (a >= 0 && gap > 0 && gap <= max_gap && a + 1 < r1 && i - 1 >= r0) {
+                    const cv::Point3f& pa = band[size_t(a - s0) * width + c];
+                    const float inv = 1.0f / (gap + 1);
+                    for (int k = std::max(a + 1, r0); k < std::min(i, r1); k++) {
+                        pc[size_t(k) * width + c] = Lerp(pa, row[c], (k - a) * inv);
+                    }
+                }
+                last[c] = i;
+            }
+        }
+    });
+}
+
+int DespikeProfiles(cv::Point3f* pc, int width, int rows, float threshold) {
+    if (pc == nullptr || width < 3 || rows <= 0 || threshold <= 0.0f)
+        return 0;
+    std::vector<int> row_spikes(rows, 0);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        std::vector<float> z(width), v(width), out(width);
+        for (int r = range.start; r < range.end; r++) {
+            cv::Point3f* row = pc + size_t(r) * width;
+            for (int c = 0; c < width; c++) {
+                z[c] = row[c].z;
+                v[c] = IsValidZ(row[c].z) ? 1.0f : 0.0f;
+            }
+            out[0] = z[0];
+            out[width - 1] = z[width - 1];
+            int c = 1;
+#if CV_SIMD
+            const int lanes = cv::v_float32::nlanes;
+            const cv::v_float32 v_thr = cv::vx_setall_f32(threshold), v_half = cv::vx_setall_f32(0.5f);
+            for (; c + lanes <= width - 1; c += lanes) {
+                const cv::v_float32 zl = cv::vx_load(z.data() + c - 1);
+                const cv::v_float32 zc = cv::vx_load(z.data() + c);
+                const cv::v_float32 zr = cv::vx_load(z.data() + c + 1);
+                const cv::v_float32 valid = cv::vx_load(v.data() + c - 1) * cv::vx_load(v.data() + c) * cv::vx_load(v.data() + c + 1);
+                const cv::v_float32 mid = (zl + zr) * v_half;
+                const cv::v_float32 spike = (valid > v_half) & (cv::v_abs(zl - zr) < v_thr) & (cv::v_abs(zc - mid) > v_thr);
+                cv::v_store(out.data() + c, cv::v_select(spike, mid, zc));
+            }
+#endif
+            for (; c < width - 1; c++) {
+                const float mid = (z[c - 1] + z[c + 1]) * 0.5f;
+                const bool spike = v[c - 1] * v[c] * v[c + 1] > 0.5f && std::fabs(z[c - 1] - z[c + 1]) < threshold
+                    && std::fabs(z[c] - mid) > threshold;
+                out[c] = spike ? mid : z[c];
+            }
+            for (int k = 1; k < width - 1; k++) {
+                if (out[k] != z[k]) {
+                    row[k].z = out[k];
+                    row_spikes[r]++;
+                }
+            }
+        }
+    });
+    int spikes = 0;
+    for (int n : row_spikes) {
+        spikes += n;
+    }
+    return spikes;
+}
+
+void SmoothRangeImage(cv::Point3f* pc, int width, int rows, const RangeFilterParams& params) {
+    if (pc == nullptr || width <= 0 || rows <= 0 || params.smooth == RangeSmoothMethod::None)
+        return;
+    const int h = params.smooth_window / 2;
+    std::vector<float> space_w(2 * h + 1);
+    for (int k = -h; k <= h; k++) {
+        space_w[k + h] = std::exp(-0.5f * k * k / (params.smooth_sigma_space * params.smooth_sigma_space));
+    }
+    SmoothProfiles(pc, width, rows, params, space_w);
+    SmoothColumns(pc, width, rows, params, space_w);
+}
+
+int FilterRangeImage(cv::Point3f* pc, int width, int rows, const RangeFilterParams& params) {
+    if (params.smooth != RangeSmoothMethod::None) {
+        if (params.smooth_window < 3 || params.smooth_window > 15 || params.smooth_window % 2 == 0) {
+            LOG(ERROR) << "FilterRangeImage - smooth window must be odd and in [3, 15]: " << params.smooth_window;
+            return -1;
+        }
+        if (params.smooth_sigma_space <= 0.0f || params.smooth_sigma_range <= 0.0f) {
+            LOG(ERROR) << "FilterRangeImage - smooth sigmas must be positive";
+            return -1;
+        }
+    }
+    if (params.despike_threshold > 0.0f) {
+        int spikes = DespikeProfiles(pc, width, rows, params.despike_threshold);
+        LOG(INFO) << "FilterRangeImage - replaced " << spikes << " spikes";
+    }
+    FillRangeHoles(pc, width, rows, params.fill_max_gap, params.tile_rows);
+    SmoothRangeImage(pc, width, rows, params);
+    return 0;
+}
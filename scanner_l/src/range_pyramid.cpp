@@ -0,0 +1,108 @@
+#include "scanner_l/range_pyramid.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include "glog/logging.h"
+
+namespace {
+    // 2x2 invalid-aware mean of two rows into one row of half width
+    void ReduceRowPair(const float* za, const float* zb, const uint8_t* ga, const uint8_t* gb,
+                       int width, float* out_z, uint8_t* out_gray) {
+        const int out_width = (width + 1) / 2;
+        for (int c = 0; c < out_width; c++) {
+            const int c0 = 2 * c;
+            const int c1 = std::min(c0 + 1, width - 1);
+            const float v[4] = { za[c0], za[c1], zb[c0], zb[c1] };
+            float sum = 0.0f;
+            int cnt = 0;
+            for (int k = 0; k < 4; k++) {
+                if (!IsValidZ(v[k]))
+                    continue;
+                sum += v[k];
+                cnt++;
+            }
+            out_z[c] = cnt > 0 ? sum / cnt : kInvalidZ;
+            out_gray[c] = static_cast<uint8_t>((ga[c0] + ga[c1] + gb[c0] + gb[c1] + 2) >> 2);
+        }
+    }
+}
+
+void RangePyramid::Reset(int num_levels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_levels_ = std::max(1, num_levels);
+    std::vector<Level>(num_levels_ + 1).swap(levels_);
+}
+
+int RangePyramid::AppendRows(const float* z, const uint8_t* gray, int width, int rows) {
+    if (z == nullptr || width <= 0 || rows <= 0)
+        return 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (levels_.empty()) {
+        num_levels_ = 1;
+        levels_.resize(2);
+    }
+    if (levels_[0].width == 0) {
+        int level_width = width;
+        for (auto& level : levels_) {
+            level.width = level_width;
+            level_width = (level_width + 1) / 2;
+        }
+    }
+    else if (levels_[0].width != width) {
+        LOG(ERROR) << "RangePyramid - row width " << width << " differs from " << levels_[0].width;
+        return -1;
+    }
+
+    std::vector<uint8_t> no_gray;
+    if (gray == nullptr)
+        no_gray.assign(width, 0);
+    for (int r = 0; r < rows; r++) {
+        PushRow(0, z + size_t(r) * width, gray ? gray + size_t(r) * width : no_gray.data());
+    }
+    return 0;
+}
+
+void RangePyramid::PushRow(int level, const float* z, const uint8_t* gray) {
+    if (level >= num_levels_)
+        return;
+    Level& cur = levels_[level];
+    if (!cur.has_pending) {
+        cur.pending_z.assign(z, z + cur.width);
+        cur.pending_gray.assign(gray, gray + cur.width);
+        cur.has_pending = true;
+        return;
+    }
+    // reduce straight into the next level, then let that row climb further
+    Level& next = levels_[level + 1];
+    const size_t offset = next.z.size();
+    next.z.resize(offset + next.width);
+    next.gray.resize(offset + next.width);
+    ReduceRowPair(cur.pending_z.data(), z, cur.pending_gray.data(), gray, cur.width,
+                  next.z.data() + offset, next.gray.data() + offset);
+    cur.has_pending = false;
+    PushRow(level + 1, next.z.data() + offset, next.gray.data() + offset);
+}
+
+int RangePyramid::NumLevels() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_levels_;
+}
+
+int RangePyramid::Rows(int level) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (level < 1 || level > num_levels_ || levels_[level].width == 0)
+        return 0;
+    return static_cast<int>(levels_[level].z.size() / levels_[level].width);
+}
+
+int RangePyramid::GetLevel(int level, cv::Mat& out_z, cv::Mat& out_gray) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (level < 1 || level > num_levels_)
+        return -1;
+    const Level& src = levels_[level];
+    if (src.width == 0 || src.z.empty())
+        return -2;
+    const int rows = static_cast<int>(src.z.size() / src.width);
+    cv::Mat(rows, src.width, CV_32FC1, const_cast<float*>(src.z.data())).copyTo(out_z);
+    cv::Mat(rows, src.width, CV_8UC1, const_cast<uint8_t*>(src.gray.data())).copyTo(out_gray);
+    return 0;
+}
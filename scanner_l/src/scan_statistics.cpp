@@ -0,0 +1,225 @@
+#include "scanner_l/scan_statistics.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <opencv2/core/hal/intrin.hpp>
+#include <nlohmann/json.hpp>
+#include "glog/logging.h"
+
+namespace {
+    // float lane sums are flushed into the double total every block to keep precision
+    constexpr size_t kSumBlock = 4096;
+}
+
+void ScanStatistics::Reset() {
+    *this = ScanStatistics();
+}
+
+void ScanStatistics::AccumulateZ(const float* z, size_t num) {
+    if (z == nullptr || num == 0)
+        return;
+
+    float block_min = FLT_MAX;
+    float block_max = -FLT_MAX;
+    uint64_t block_valid = 0;
+    double block_sum = 0.0;
+
+    for (size_t start = 0; start < num; start += kSumBlock) {
+        const size_t end = std::min(num, start + kSumBlock);
+        size_t i = start;
+        float sum = 0.0f;
+        float count = 0.0f;
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        cv::v_float32 v_thr = cv::vx_setall_f32(kInvalidZThreshold);
+        cv::v_float32 v_one = cv::vx_setall_f32(1.0f);
+        cv::v_float32 v_zero = cv::vx_setzero_f32();
+        cv::v_float32 v_min_acc = cv::vx_setall_f32(FLT_MAX);
+        cv::v_float32 v_max_acc = cv::vx_setall_f32(-FLT_MAX);
+        cv::v_float32 v_sum = cv::vx_setzero_f32();
+        cv::v_float32 v_cnt = cv::vx_setzero_f32();
+        for (; i + lanes <= end; i += lanes) {
+            cv::v_float32 v = cv::vx_load(z + i);
+            cv::v_float32 valid = v > v_thr;
+            v_min_acc = cv::v_min(v_min_acc, cv::v_select(valid, v, cv::vx_setall_f32(FLT_MAX)));
+            v_max_acc = cv::v_max(v_max_acc, cv::v_select(valid, v, cv::vx_setall_f32(-FLT_MAX)));
+            v_sum += cv::v_select(valid, v, v_zero);
+            v_cnt += v_one & valid;
+        }
+        block_min = std::min(block_min, cv::v_reduce_min(v_min_acc));
+        block_max = std::max(block_max, cv::v_reduce_max(v_max_acc));
+        sum = cv::v_reduce_sum(v_sum);
+        count = cv::v_reduce_sum(v_cnt);
+#endif
+        for (; i < end; i++) {
+            if (!IsValidZ(z[i]))
+                continue;
+            block_min = std::min(block_min, z[i]);
+            block_max = std::max(block_max, z[i]);
+            sum += z[i];
+            count += 1.0f;
+        }
+        block_sum += sum;
+        block_valid += static_cast<uint64_t>(count);
+    }
+
+    if (block_valid > 0) {
+        if (valid_points == 0) {
+            min_z = block_min;
+            max_z = block_max;
+        }
+        else {
+            min_z = std::min(min_z, block_min);
+            max_z = std::max(max_z, block_max);
+        }
+    }
+    valid_points += block_valid;
+    total_points += num;
+    sum_z += block_sum;
+}
+
+void ScanStatistics::AccumulateGray(const uint8_t* gray, size_t num) {
+    if (gray == nullptr || num == 0)
+        return;
+    // 4 interleaved sub-histograms break the store->load dependency on equal neighbours
+    uint32_t hist[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        hist[0][gray[i]]++;
+        hist[1][gray[i + 1]]++;
+        hist[2][gray[i + 2]]++;
+        hist[3][gray[i + 3]]++;
+    }
+    for (; i < num; i++) {
+        hist[0][gray[i]]++;
+    }
+    for (int b = 0; b < 256; b++) {
+        gray_histogram[b] += static_cast<uint64_t>(hist[0][b]) + hist[1][b] + hist[2][b] + hist[3][b];
+    }
+}
+
+void ScanStatistics::AccumulateEncoder(const int32_t* encoder, size_t num) {
+    if (encoder == nullptr || num == 0)
+        return;
+    auto range = std::minmax_element(encoder, encoder + num);
+    if (!has_encoder) {
+        encoder_first = encoder[0];
+        encoder_min = *range.first;
+        encoder_max = *range.second;
+        has_encoder = true;
+    }
+    else {
+        encoder_min = std::min(encoder_min, *range.first);
+        encoder_max = std::max(encoder_max, *range.second);
+    }
+    encoder_last = encoder[num - 1];
+    line_count += num;
+}
+
+void ScanStatistics::Merge(const ScanStatistics& other) {
+    if (other.valid_points > 0) {
+        if (valid_points == 0) {
+            min_z = other.min_z;
+            max_z = other.max_z;
+        }
+        else {
+            min_z = std::min(min_z, other.min_z);
+            max_z = std::max(max_z, other.max_z);
+        }
+    }
+    total_points += other.total_points;
+    valid_points += other.valid_points;
+    sum_z += other.sum_z;
+    line_count += other.line_count;
+    batch_count += other.batch_count;
+
+    if (other.has_encoder) {
+        if (!has_encoder) {
+            encoder_first = other.encoder_first;
+            encoder_min = other.encoder_min;
+            encoder_max = other.encoder_max;
+            has_encoder = true;
+        }
+        else {
+            encoder_min = std::min(encoder_min, other.encoder_min);
+            encoder_max = std::max(encoder_max, other.encoder_max);
+        }
+        encoder_last = other.encoder_last;
+    }
+
+    for (int b = 0; b < 256; b++) {
+        gray_histogram[b] += other.gray_histogram[b];
+    }
+}
+
+double ScanStatistics::MeanZ() const {
+    return valid_points > 0 ? sum_z / static_cast<double>(valid_points) : 0.0;
+}
+
+double ScanStatistics::ValidRatio() const {
+    return total_points > 0 ? static_cast<double>(valid_points) / static_cast<double>(total_points) : 0.0;
+}
+
+int64_t ScanStatistics::EncoderSpan() const {
+    return has_encoder ? static_cast<int64_t>(encoder_max) - encoder_min : 0;
+}
+
+bool SaveScanStatistics(const std::string& filename, const ScanStatistics& stats) {
+    nlohmann::json data;
+    data["total_points"] = stats.total_points;
+    data["valid_points"] = stats.valid_points;
+    data["valid_ratio"] = stats.ValidRatio();
+    data["min_z"] = stats.min_z;
+    data["max_z"] = stats.max_z;
+    data["mean_z"] = stats.MeanZ();
+    data["line_count"] = stats.line_count;
+    data["batch_count"] = stats.batch_count;
+    data["encoder_first"] = stats.encoder_first;
+    data["encoder_last"] = stats.encoder_last;
+    data["encoder_min"] = stats.encoder_min;
+    data["encoder_max"] = stats.encoder_max;
+    data["encoder_span"] = stats.EncoderSpan();
+    data["finalized"] = stats.finalized;
+    data["gray_histogram"] = std::vector<uint64_t>(stats.gray_histogram.begin(), stats.gray_histogram.end());
+
+    std::ofstream out_file(filename);
+    if (!out_file.is_open()) {
+        LOG(ERROR) << "Failed to open statistics file: " << filename;
+        return false;
+    }
+    out_file << data.dump(4);
+    return true;
+}
+
+void ScanStatisticsAccumulator::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.Reset();
+}
+
+void ScanStatisticsAccumulator::AddBatch(const float* z, size_t num_z,
+                                         const uint8_t* gray, size_t num_gray,
+                                         const int32_t* encoder, size_t num_encoder) {
+    ScanStatistics partial;
+    partial.AccumulateZ(z, num_z);
+    partial.AccumulateGray(gray, num_gray);
+    partial.AccumulateEncoder(encoder, num_encoder);
+    partial.batch_count = 1;
+    Merge(partial);
+}
+
+void ScanStatisticsAccumulator::Merge(const ScanStatistics& partial) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.Merge(partial);
+}
+
+ScanStatistics ScanStatisticsAccumulator::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+ScanStatistics ScanStatisticsAccumulator::Finalize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.finalized = true;
+    return stats_;
+}
@@ -21,6 +21,23 @@ namespace {
     int g_needCallbackCount_ = 30;
     std::atomic<bool> thr_flag = false;
     std::vector<AIeveR_Point3D*> scan_move_vec_;
+    // per-scan statistics, updated once per batch
+    ScanStatisticsAccumulator g_scan_statistics;
+    // coarse levels of the range / gray image, grown once per batch when preview_pyramid_enable is set
+    RangePyramid g_range_pyramid;
+    bool g_range_pyramid_enable = false;
+    // edges / steps of every profile line, extracted per batch
+    ProfileFeatureExtractor g_profile_features;
+    // newest profile and decimated rows for the UI while scanning
+    LivePreview g_live_preview;
+    // acquisition metrics, see metrics.h
+    MetricCounter* g_metric_lines = Metrics().Counter(kMetricScanLines);
+    MetricCounter* g_metric_batches = Metrics().Counter(kMetricScanBatches);
+    MetricCounter* g_metric_dropped_frames = Metrics().Counter(kMetricScanDroppedFrames);
+    MetricHistogram* g_metric_callback_us = Metrics().Histogram(kMetricScanCallbackUs);
+    // frame number of the last stored line, to spot frames the device dropped; callback thread only
+    uint32_t g_last_frame = 0;
+    bool g_has_last_frame = false;
 
     std::vector<double> profile_stitch_dist = { 0.004 };
     int scanner_work_distance = read_work_distance("../ScannerConfig/", SCANNER_CONFIG_FILE_VEC[0], profile_stitch_dist[0]);
@@ -140,6 +157,72 @@ void isConnected_callback() {
 
 }
 
+// per-batch reductions (statistics, preview pyramid, live preview), run while z is still hot
+void reduce_batch(const float* z, size_t num_points, const uint8_t* gray, size_t gray_len,
+    const int32_t* encoder, int data_width, int lines)
+{
+    g_scan_statistics.AddBatch(z, num_points, gray, gray_len, encoder, lines);
+    if (g_range_pyramid_enable)
+        g_range_pyramid.AppendRows(z, gray_len >= num_points ? gray : nullptr, data_width, lines);
+    g_live_preview.AddBatch(z, encoder, data_width, lines);
+}
+
+// profile features and the raw buffers of the scan; the batch is counted once it is stored
+void store_batch(const float* z, size_t num_points, const AIeveR_Point3F* xyz, size_t xyz_len,
+    const uint8_t* gray, size_t gray_len, const int32_t* encoder, const uint32_t* frame, int data_width, int lines)
+{
+    g_profile_features.AddBatch(z, xyz_len == num_points ? reinterpret_cast<const float*>(xyz) : nullptr,
+        encoder, data_width, lines);
+
+    // ｫеװALL_PC_VEC
+    test_147.ALL_PC_VEC_.insert(test_147.ALL_PC_VEC_.end(), xyz, xyz + xyz_len);
+
+    // ÿݶӦıֵװENCODER_VEC
+    test_147.ENCODER_VEC_.insert(test_147.ENCODER_VEC_.end(), encoder, encoder + lines);
+
+    // ÿݶӦֵ֡װFRAME_VEC
+    test_147.FRAME_VEC_.insert(test_147.FRAME_VEC_.end(), frame, frame + lines);
+
+    //Ҷݱ
+    if (gray_len > 0)
+    {
+        test_147.ALL_GRAY_VEC_.insert(test_147.ALL_GRAY_VEC_.end(), gray, gray + gray_len);
+    }
+
+    // one frame number per line; a smaller one means the device restarted counting
+    uint64_t dropped = 0;
+    for (int r = 0; r < lines; r++)
+    {
+        if (g_has_last_frame && frame[r] > g_last_frame)
+            dropped += frame[r] - g_last_frame - 1;
+        g_last_frame = frame[r];
+        g_has_last_frame = true;
+    }
+    if (dropped > 0)
+        g_metric_dropped_frames->Add(dropped);
+    g_metric_lines->Add(static_cast<uint64_t>(lines));
+    g_metric_batches->Add();
+
+    // ͳƻصĴ
+    g_callBackCount_0.fetch_add(1);
+}
+
+// batches of the simulated device arrive already decoded
+void simulated_batch_callback(const SimulatedBatch& batch)
+{
+    static_assert(sizeof(cv::Point3f) == sizeof(AIeveR_Point3F), "cv::Point3f and AIeveR_Point3F must share a layout");
+    if (g_callBackCount_0.load() >= g_needCallbackCount_)
+    {
+        return;
+    }
+    ScopedMetricTimer callback_timer(g_metric_callback_us, 1e6);
+    const size_t num_points = batch.z.size();
+    reduce_batch(batch.z.data(), num_points, batch.gray.data(), batch.gray.size(),
+        batch.encoder.data(), batch.data_width, batch.lines);
+    store_batch(batch.z.data(), num_points, reinterpret_cast<const AIeveR_Point3F*>(batch.xyz.data()), batch.xyz.size(),
+        batch.gray.data(), batch.gray.size(), batch.encoder.data(), batch.frame.data(), batch.data_width, batch.lines);
+}
+
 // ص
 void Encoder_onBatchDataCallCack_147(const void* info, const AIeveR_Data* data)
 {
@@ -148,6 +231,7 @@ void Encoder_onBatchDataCallCack_147(const void* info, const AIeveR_Data* data)
     {
         return;
     }
+    ScopedMetricTimer callback_timer(g_metric_callback_us, 1e6);
     // ÿߵĵ ( L10400 : data_width = 3200)
     int data_width_ = data->data_width;
 
@@ -168,29 +252,17 @@ void Encoder_onBatchDataCallCack_147(const void* info, const AIeveR_Data* data)
     global_postProcessing_.DecodeProfilesZ(data->pc_ptr_, data->pc_ptr_length_,
         z_vec, data->pc_ptr_length_);
 
+    const uint8_t* gray = reinterpret_cast<const uint8_t*>(data->gray_ptr_);
+    const size_t gray_len = data->gray_ptr_length_ > 0 ? data->gray_ptr_length_ : 0;
+    reduce_batch(z_vec.data(), z_vec.size(), gray, gray_len, data->encoder_value_vec.data(), data_width_, lineNums);
+
     // ȡݽΪ (uint z -> float xyz)
     // άݣںƴӲ
     global_postProcessing_.DecodeProfilesXYZ(data->pc_ptr_, data->pc_ptr_length_,
         PC_3200_VEC, data->pc_ptr_length_);
 
-    // ｫеװALL_PC_VEC
-    test_147.ALL_PC_VEC_.insert(test_147.ALL_PC_VEC_.end(), PC_3200_VEC.begin(), PC_3200_VEC.end());
-
-
-    // ÿݶӦıֵװENCODER_VEC
-    test_147.ENCODER_VEC_.insert(test_147.ENCODER_VEC_.end(), data->encoder_value_vec.begin(),
-        data->encoder_value_vec.end());
-
-
-    // ÿݶӦֵ֡װFRAME_VEC
-    test_147.FRAME_VEC_.insert(test_147.FRAME_VEC_.end(), data->frame_cnt_vec.begin(),
-        data->frame_cnt_vec.end());
-
-    //Ҷݱ
-    if (data->gray_ptr_length_ > 0)
-    {
-        test_147.ALL_GRAY_VEC_.insert(test_147.ALL_GRAY_VEC_.end(), data->gray_ptr_, data->gray_ptr_ + data->gray_ptr_length_);
-    }
+    store_batch(z_vec.data(), z_vec.size(), PC_3200_VEC.data(), PC_3200_VEC.size(), gray, gray_len,
+        data->encoder_value_vec.data(), data->frame_cnt_vec.data(), data_width_, lineNums);
 
     //global_postProcessing_.resetProfileStitcher();
     //// ÿ֮ľ
@@ -230,8 +302,6 @@ void Encoder_onBatchDataCallCack_147(const void* info, const AIeveR_Data* data)
     //    test_147.ALL_GRAY_VEC_.insert(test_147.ALL_GRAY_VEC_.end(), data->gray_ptr_, data->gray_ptr_ + data->gray_ptr_length_);
     //}
 
-    // ͳƻصĴ
-    g_callBackCount_0.fetch_add(1);
     // LOG(INFO) << "g_callBackCount_0: " << g_callBackCount_0 << "\n";
     return;
 
@@ -288,6 +358,25 @@ int ScannerLApi::Init() {
             main_scan_index_ = i;
     }
 
+    if (golden_compare_enable_) {
+        golden_compare_.SetParams(golden_compare_params_);
+        std::string golden_dir = golden_reference_dir_;
+        if (std::filesystem::path(golden_dir).is_relative())
+            golden_dir = config_root_path_ + golden_dir;
+        golden_reference_dir_ = golden_dir;
+        int golden_cnt = golden_compare_.LoadReferences(golden_reference_dir_);
+        LOG(INFO) << "golden references loaded: " << golden_cnt << " from " << golden_reference_dir_;
+    }
+
+    if (simulated_device_enable_) {
+        simulated_device_params_.encoder_wrap_bits = encoder_wrap_bits_;
+        simulated_device_params_.y_per_pulse = static_cast<float>(profile_stitch_distances[main_scan_index_]);
+        simulated_device_.SetParams(simulated_device_params_);
+        LOG(INFO) << "Init simulated device - " << g_needCallbackCount_ << " batches of " << simulated_device_params_.lines_per_batch
+            << " lines at " << simulated_device_params_.line_rate_hz << " Hz";
+        return 0;
+    }
+
     AIeveR_HostInfo host_info;
     for(int i = 0; i < scanner_l_ipv4_vec_.size();i++){
         host_info.Host_IP = scanner_l_config_vec_[i]->Host_IP;
@@ -413,6 +502,60 @@ void ScannerLApi::Encoder_Handle_Data(Scanner_All_Data& all_data, const std::str
 {  
     std::vector<uint32_t> frame_cnt_vec;
     std::vector<int32_t> encoder_vec;
+
+    ProfileResamplerParams resampler_params;
+    resampler_params.dist_per_pulse = profile_stitch_distances[0];
+    resampler_params.pitch = resample_pitch_ > 0.0 ? resample_pitch_ : profile_stitch_distances[0];
+    resampler_params.encoder_wrap_bits = encoder_wrap_bits_;
+    resampler_params.move_dir_x = mv_vec.x;
+    resampler_params.move_dir_y = mv_vec.y;
+    resampler_params.move_dir_z = mv_vec.z;
+    ProfileResampler resampler(resampler_params);
+#if validate_profile_resampler
+    {
+        auto sdk_time = std::chrono::system_clock::now();
+        global_postProcessing_.resetProfileStitcher();
+        global_postProcessing_.setDistInterval(profile_stitch_distances[0], true);
+        global_postProcessing_.setMoveDirection(mv_vec);
+        PostProcessing::ProfileStitcherParams sdk_params;
+        sdk_params.PointVec = all_data.ALL_PC_VEC_;
+        sdk_params.FlagValues = all_data.ENCODER_VEC_;
+        global_postProcessing_.ProfileStitch(sdk_params, true);
+        auto sdk_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - sdk_time).count();
+
+        auto stitch_time = std::chrono::system_clock::now();
+        std::vector<AIeveR_Point3F> stitched_pc;
+        resampler.Stitch(all_data.ALL_PC_VEC_, all_data.ENCODER_VEC_, stitched_pc);
+        auto stitch_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - stitch_time).count();
+
+        auto resample_time = std::chrono::system_clock::now();
+        std::vector<AIeveR_Point3F> resampled_pc;
+        std::vector<uint8_t> resampled_gray;
+        std::vector<int32_t> resampled_encoder;
+        std::vector<uint32_t> resampled_frame;
+        resampler.Resample(all_data.ALL_PC_VEC_, all_data.ALL_GRAY_VEC_, all_data.ENCODER_VEC_, all_data.FRAME_VEC_,
+            resampled_pc, resampled_gray, resampled_encoder, resampled_frame);
+        auto resample_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - resample_time).count();
+
+        StitchCompareResult cmp = CompareStitchedClouds(sdk_params.PointVec, stitched_pc);
+        LOG(INFO) << "validate_profile_resampler - scanner " << scanner_num << " size match: " << cmp.size_match
+            << " compared points: " << cmp.compared_points << " max deviation: " << cmp.max_deviation
+            << " mean deviation: " << cmp.mean_deviation;
+        LOG(INFO) << "validate_profile_resampler - ProfileStitch: " << sdk_time_diff << " ms, Stitch: " << stitch_time_diff
+            << " ms, Resample: " << resample_time_diff << " ms (" << resampled_encoder.size() << " lines)";
+    }
+#endif
+    if (use_profile_resampler_) {
+        auto resample_time = std::chrono::system_clock::now();
+        int flag_resample = resampler.Resample(all_data.ALL_PC_VEC_, all_data.ALL_GRAY_VEC_, all_data.ENCODER_VEC_, all_data.FRAME_VEC_,
+            all_data.ALL_PC_VEC_SAVE, all_data.ALL_GRAY_VEC_SAVE, all_data.ENCODER_VEC_SAVE, all_data.FRAME_VEC_SAVE);
+        auto resample_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - resample_time).count();
+        LOG(INFO) << "scanner " << scanner_num << " resample status: " << flag_resample << " lines: " << all_data.ENCODER_VEC_.size()
+            << " -> " << all_data.ENCODER_VEC_SAVE.size() << " in " << resample_time_diff << " ms\n";
+        if (flag_resample == 0)
+            return;
+        LOG(ERROR) << "scanner " << scanner_num << " resample failed, fall back to ProfileStitch";
+    }
     // ú״̬
     global_postProcessing_.resetProfileStitcher();
     // ÿ֮ľ
@@ -464,6 +607,10 @@ void ScannerLApi::Encoder_Handle_Data(Scanner_All_Data& all_data, const std::str
 }
 
 int ScannerLApi::Connect() {
+    if (simulated_device_enable_) {
+        LOG(INFO) << "Connect simulated device";
+        return 0;
+    }
     //
     auto connect_time = std::chrono::system_clock::now();
     AIeveR_ScannerInfo scanner_info;
@@ -561,8 +708,23 @@ int ScannerLApi::Start() {
     std::vector<Scanner_All_Data>().swap(all_PC_data);
 
     g_callBackCount_0.store(0);
+    g_has_last_frame = false;
+    g_scan_statistics.Reset();
+    g_range_pyramid_enable = preview_pyramid_enable_;
+    g_range_pyramid.Reset(preview_pyramid_levels_);
+    g_profile_features.Reset(profile_feature_enable_, profile_feature_params_);
+    g_live_preview.Reset(live_preview_enable_, live_preview_params_, kDefaultDataWidth);
     auto swap_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - swap_time).count();
     LOG(INFO) << "swap_time_diff: " << swap_time_diff << " ms\n";
+    LOG(INFO) << "scan direction: " << (b_backward_ ? "backward" : "forward") << (bidirectional_scan_ ? " (bidirectional)" : "");
+    if (simulated_device_enable_) {
+        // the device stops by itself after the batches the recipe needs, like callback_go on hardware
+        if (simulated_device_.Start(simulated_batch_callback, g_needCallbackCount_) != 0) {
+            LOG(INFO) << "start simulated device failed!";
+            return -1;
+        }
+        return 0;
+    }
     //
     std::vector<ErrorStatus> start_status;
     start_status.resize(scanner_l_ptr_vec_.size());
@@ -611,9 +773,11 @@ int ScannerLApi::Start() {
 
 int ScannerLApi::End() {
     thr_flag.store(false);
+    if (simulated_device_enable_)
+        simulated_device_.Stop();
     AIeveR_ScannerInfo scanner_info;
     //ֹͣɼ
-    for(int i = 0; i < scanner_l_ptr_vec_.size();i++){
+    for(int i = 0; i < scanner_l_ptr_vec_.size() && !simulated_device_enable_;i++){
         scanner_l_ptr_vec_[i]->setParameterValue(Scanner_Setting::BatchDataCallBackSwitch::name, false);
         //رռ
         ErrorStatus set_status = scanner_l_ptr_vec_[i]->setParameterValue(Scanner_Setting::LaserInten::name, 0);
@@ -626,8 +790,13 @@ int ScannerLApi::End() {
     LOG(INFO) << "test_147.ALL_GRAY_VEC_SAVE.size(): " << test_147.ALL_GRAY_VEC_SAVE.size();
     LOG(INFO) << "test_147.ALL_PC_VEC_.size(): " << test_147.ALL_PC_VEC_.size();
     LOG(INFO) << "test_147.ALL_PC_VEC_SAVE.size(): " << test_147.ALL_PC_VEC_SAVE.size();
+    ScanStatistics scan_stats = g_scan_statistics.Finalize();
+    LOG(INFO) << "scan statistics - lines: " << scan_stats.line_count << " valid ratio: " << scan_stats.ValidRatio()
+        << " z(min|max|mean): " << scan_stats.min_z << " | " << scan_stats.max_z << " | " << scan_stats.MeanZ()
+        << " encoder span: " << scan_stats.EncoderSpan();
     // ȡ
     all_PC_data.push_back(test_147);
+    auto stitch_time = std::chrono::steady_clock::now();
     AIeveR_Point3D mv_vec_;
     for(int i = 0; i < scanner_l_ptr_vec_.size();i++){
         std::string scanner_num = std::to_string(i);
@@ -635,21 +804,327 @@ int ScannerLApi::End() {
         mv_vec_.y = scanner_l_move_vec_[i]->y;
         mv_vec_.z = scanner_l_move_vec_[i]->z;
         LOG(INFO) << "call Encoder_Handle_Data - move_vec(x|y|z): " << mv_vec_.x << " | " << mv_vec_.y << " | " << mv_vec_.z << "\n";
+        if (b_backward_) {
+            // return stroke: reverse the line order so the encoder runs the same way as on the outbound stroke
+            ReverseProfileLines(all_PC_data[i].ALL_PC_VEC_, all_PC_data[i].ALL_GRAY_VEC_, all_PC_data[i].ENCODER_VEC_,
+                all_PC_data[i].FRAME_VEC_, kDefaultDataWidth);
+        }
         Encoder_Handle_Data(all_PC_data[i], scanner_num, mv_vec_);
-        scanner_l_ptr_vec_[i]->getCameraInfo(scanner_info);
+        if (b_backward_) {
+            align_backward_pass(all_PC_data[i], i, mv_vec_);
+        }
+        else if (!all_PC_data[i].ENCODER_VEC_.empty()) {
+            if (forward_encoder_values_.size() <= i)
+                forward_encoder_values_.resize(i + 1, 0);
+            forward_encoder_values_[i] = static_cast<unsigned int>(all_PC_data[i].ENCODER_VEC_.front());
+        }
+        if (!simulated_device_enable_)
+            scanner_l_ptr_vec_[i]->getCameraInfo(scanner_info);
         LOG(INFO) << "Get data from scanner: " << scanner_info.Scanner_Ip << "\n";
 
     }
+    last_stitch_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stitch_time).count();
+    LOG(INFO) << "stitch time: " << last_stitch_ms_ << " ms";
+    Metrics().Histogram(kMetricScanStitchMs)->Record(last_stitch_ms_);
     LOG(INFO) << "********all_PC_data[0] size********";
     LOG(INFO) << "all_PC_data[0].ALL_GRAY_VEC_.size(): " << all_PC_data[0].ALL_GRAY_VEC_.size();
     LOG(INFO) << "all_PC_data[0].ALL_GRAY_VEC_SAVE.size(): " << all_PC_data[0].ALL_GRAY_VEC_SAVE.size();
     LOG(INFO) << "all_PC_data[0].ALL_PC_VEC_.size(): " << all_PC_data[0].ALL_PC_VEC_.size();
     LOG(INFO) << "all_PC_data[0].ALL_PC_VEC_SAVE.size(): " << all_PC_data[0].ALL_PC_VEC_SAVE.size();
+    last_scan_backward_ = b_backward_;
+    golden_result_ = GoldenCompareResult();
+    if (golden_compare_enable_ && golden_compare_.HasReference(recipe_id_)) {
+        HeightMap scan_map;
+        bool has_encoder = false;
+        int32_t encoder_first = 0;
+        int flag_golden = build_main_height_map(scan_map, has_encoder, encoder_first);
+        if (flag_golden == 0) {
+            const double pulse = profile_stitch_distances[main_scan_index_];
+            flag_golden = golden_compare_.Compare(recipe_id_, scan_map, has_encoder, encoder_first,
+                pulse * scanner_l_move_vec_[main_scan_index_]->x, pulse * scanner_l_move_vec_[main_scan_index_]->y, golden_result_);
+        }
+        LOG(INFO) << "golden compare of recipe " << recipe_id_ << " status: " << flag_golden << " offset(row|col): "
+            << golden_result_.offset_row << " | " << golden_result_.offset_col << " rms: " << golden_result_.rms_deviation
+            << " warn|fail cells: " << golden_result_.warn_cells << " | " << golden_result_.fail_cells
+            << " in " << golden_result_.elapsed_ms << " ms";
+    }
+    if (bidirectional_scan_) {
+        // an End() without data (never started, aborted right away) leaves the stage where it was
+        const bool stroke_done = g_callBackCount_0.load() >= g_needCallbackCount_ || scan_stats.line_count > 0;
+        if (stroke_done) {
+            b_backward_ = !b_backward_;
+        }
+        else {
+            LOG(WARNING) << "no data in this stroke, scan direction stays " << (b_backward_ ? "backward" : "forward");
+        }
+    }
+    return 0;
+}
+
+void ScannerLApi::SetScanDirection(bool backward) {
+    b_backward_ = backward;
+}
+
+bool ScannerLApi::IsBackwardScan() const {
+    return b_backward_;
+}
+
+bool ScannerLApi::IsBidirectionalScan() const {
+    return bidirectional_scan_;
+}
+
+bool ScannerLApi::IsHeightMapEnabled() const {
+    return height_map_enable_;
+}
+
+int ScannerLApi::GetPreviewLevel(int level, cv::Mat& out_z, cv::Mat& out_gray) {
+    return g_range_pyramid.GetLevel(level, out_z, out_gray);
+}
+
+int ScannerLApi::GetPreviewLevelCount() const {
+    return g_range_pyramid.NumLevels();
+}
+
+bool ScannerLApi::IsPreviewPyramidEnabled() const {
+    return preview_pyramid_enable_;
+}
+
+int ScannerLApi::GetPostProcessResults(std::vector<PostProcessResult>& out_results) {
+    out_results = post_process_results_;
     return 0;
 }
 
+void ScannerLApi::SetRecipeId(int recipe_id) {
+    recipe_id_ = recipe_id;
+}
+
+bool ScannerLApi::IsGoldenCompareEnabled() const {
+    return golden_compare_enable_;
+}
+
+void ScannerLApi::SetProfileFeatureCallback(ProfileFeatureCallback callback) {
+    g_profile_features.SetCallback(std::move(callback));
+}
+
+int ScannerLApi::GetProfileFeatures(std::vector<ProfileFeature>& out_features) {
+    out_features = g_profile_features.Snapshot();
+    return 0;
+}
+
+bool ScannerLApi::IsProfileFeatureEnabled() const {
+    return profile_feature_enable_;
+}
+
+bool ScannerLApi::FetchLiveProfile(LiveProfile& out_profile) {
+    return g_live_preview.FetchProfile(out_profile);
+}
+
+int ScannerLApi::PopLivePreviewRows(std::vector<float>& out_rows, int max_rows) {
+    const int rows = g_live_preview.PopRows(out_rows, max_rows);
+    static MetricGauge* queued_gauge = Metrics().Gauge(kMetricQueuePreviewRows);
+    queued_gauge->Set(static_cast<double>(g_live_preview.QueuedRows()));
+    return rows;
+}
+
+int ScannerLApi::GetLivePreviewWidth() const {
+    return g_live_preview.RowWidth();
+}
+
+uint64_t ScannerLApi::GetLivePreviewDroppedRows() const {
+    return g_live_preview.DroppedRows();
+}
+
+bool ScannerLApi::IsLivePreviewEnabled() const {
+    return live_preview_enable_;
+}
+
+void ScannerLApi::SetMeasurementRois(const std::vector<RoiPolygon>& rois) {
+    measurement_rois_ = rois;
+}
+
+int ScannerLApi::GetMeasurements(std::vector<MeasurementResult>& out_results) {
+    out_results = measurement_results_;
+    return 0;
+}
+
+bool ScannerLApi::IsMeasurementEnabled() const {
+    return measurement_enable_;
+}
+
+int ScannerLApi::MergeAllData(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                              const std::vector<std::vector<uint8_t>>& gray_vec,
+                              const std::vector<std::vector<int32_t>>& encoder_vec,
+                              const std::vector<std::vector<uint32_t>>& framecnt_vec,
+                              MergedScan& out_scan) {
+    // GetAllData already moved every scanner into the common frame when the post process applies the RT
+    std::vector<cv::Mat> rts;
+    if (!post_process_config_.apply_multi_calib_rt)
+        rts = scanner_l_rt_vec_;
+    int flag_merge = MergeScans(pc_vec, gray_vec, encoder_vec, framecnt_vec, rts, cloud_merge_params_, out_scan);
+    LOG(INFO) << "cloud merge (" << CloudMergeModeName(cloud_merge_params_.mode) << ") status: " << flag_merge
+        << " in " << out_scan.elapsed_ms << " ms";
+    for (int i = 0; i < out_scan.kept.size(); i++) {
+        LOG(INFO) << "scanner " << i << " merged points kept: " << out_scan.kept[i] << " dropped: " << out_scan.dropped[i];
+    }
+    return flag_merge;
+}
+
+bool ScannerLApi::IsCloudMergeEnabled() const {
+    return cloud_merge_enable_;
+}
+
+int ScannerLApi::GetPreviewClouds(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                                  const std::vector<std::vector<uint8_t>>& gray_vec,
+                                  std::vector<std::vector<cv::Point3f>>& out_pc_vec,
+                                  std::vector<std::vector<uint8_t>>& out_gray_vec) {
+    out_pc_vec.assign(pc_vec.size(), std::vector<cv::Point3f>());
+    out_gray_vec.assign(pc_vec.size(), std::vector<uint8_t>());
+    for (int i = 0; i < pc_vec.size(); i++) {
+        const uint8_t* gray = i < gray_vec.size() && gray_vec[i].size() == pc_vec[i].size() ? gray_vec[i].data() : nullptr;
+        int flag_voxel = VoxelDownsample(pc_vec[i].data(), gray, pc_vec[i].size(), kDefaultDataWidth,
+                                         preview_downsample_params_, out_pc_vec[i], out_gray_vec[i]);
+        if (flag_voxel != 0) {
+            LOG(ERROR) << "scanner " << i << " preview downsample failed: " << flag_voxel;
+            return flag_voxel;
+        }
+        LOG(INFO) << "scanner " << i << " preview (" << VoxelPolicyName(preview_downsample_params_.policy) << ", "
+            << preview_downsample_params_.voxel_size << " mm): " << pc_vec[i].size() << " -> " << out_pc_vec[i].size();
+    }
+    return 0;
+}
+
+bool ScannerLApi::IsPreviewExportEnabled() const {
+    return preview_export_enable_;
+}
+
+bool ScannerLApi::is_organized_cloud(int index, size_t num_points) const {
+    if (num_points == 0 || num_points % kDefaultDataWidth != 0)
+        return false;
+    return index >= post_process_results_.size() || post_process_results_[index].organized;
+}
+
+int ScannerLApi::GetNormals(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                            std::vector<std::vector<cv::Point3f>>& out_normals_vec) {
+    out_normals_vec.assign(pc_vec.size(), std::vector<cv::Point3f>());
+    for (int i = 0; i < pc_vec.size(); i++) {
+        if (!is_organized_cloud(i, pc_vec[i].size())) {
+            LOG(WARNING) << "scanner " << i << " cloud is not organized, no normals";
+            continue;
+        }
+        const int rows = static_cast<int>(pc_vec[i].size() / kDefaultDataWidth);
+        out_normals_vec[i].resize(pc_vec[i].size());
+        int valid = EstimateOrganizedNormals(pc_vec[i].data(), kDefaultDataWidth, rows, normal_params_, out_normals_vec[i].data());
+        if (valid < 0)
+            return valid;
+        LOG(INFO) << "scanner " << i << " normals: " << valid << " / " << pc_vec[i].size();
+    }
+    return 0;
+}
+
+int ScannerLApi::GetPackedNormals(const std::vector<std::vector<cv::Point3f>>& pc_vec,
+                                  std::vector<std::vector<uint32_t>>& out_packed_vec) {
+    out_packed_vec.assign(pc_vec.size(), std::vector<uint32_t>());
+    for (int i = 0; i < pc_vec.size(); i++) {
+        if (!is_organized_cloud(i, pc_vec[i].size())) {
+            LOG(WARNING) << "scanner " << i << " cloud is not organized, no normals";
+            continue;
+        }
+        const int rows = static_cast<int>(pc_vec[i].size() / kDefaultDataWidth);
+        out_packed_vec[i].resize(pc_vec[i].size());
+        int valid = EstimateOrganizedNormalsPacked(pc_vec[i].data(), kDefaultDataWidth, rows, normal_params_, out_packed_vec[i].data());
+        if (valid < 0)
+            return valid;
+        LOG(INFO) << "scanner " << i << " packed normals: " << valid << " / " << pc_vec[i].size();
+    }
+    return 0;
+}
+
+bool ScannerLApi::IsNormalEstimationEnabled() const {
+    return normal_estimation_enable_;
+}
+
+int ScannerLApi::build_main_height_map(HeightMap& out_map, bool& has_encoder, int32_t& encoder_first) {
+    if (main_scan_index_ >= all_PC_data.size())
+        return -1;
+    const Scanner_All_Data& data = all_PC_data[main_scan_index_];
+    const std::vector<AIeveR_Point3F>& pc = data.ALL_PC_VEC_SAVE;
+    int flag_raster = BuildHeightMap(reinterpret_cast<const float*>(pc.data()), pc.size(), height_map_params_, out_map);
+    if (flag_raster != 0)
+        return flag_raster;
+    // a return stroke has been moved into the frame of its outbound stroke
+    has_encoder = false;
+    if (last_scan_backward_ && main_scan_index_ < forward_encoder_values_.size()) {
+        has_encoder = true;
+        encoder_first = static_cast<int32_t>(forward_encoder_values_[main_scan_index_]);
+    }
+    else if (!last_scan_backward_ && !data.ENCODER_VEC_.empty()) {
+        has_encoder = true;
+        encoder_first = data.ENCODER_VEC_.front();
+    }
+    return 0;
+}
+
+int ScannerLApi::CaptureGoldenReference() {
+    GoldenReference reference;
+    int flag_raster = build_main_height_map(reference.map, reference.has_encoder, reference.encoder_first);
+    if (flag_raster != 0) {
+        LOG(ERROR) << "golden reference of recipe " << recipe_id_ << " - height map failed: " << flag_raster;
+        return flag_raster;
+    }
+    golden_compare_.SetReference(recipe_id_, reference);
+    if (!golden_compare_.SaveReference(golden_reference_dir_, recipe_id_)) {
+        LOG(ERROR) << "golden reference of recipe " << recipe_id_ << " - failed to save to " << golden_reference_dir_;
+        return -2;
+    }
+    LOG(INFO) << "golden reference of recipe " << recipe_id_ << " saved to " << golden_reference_dir_;
+    return 0;
+}
+
+int ScannerLApi::GetGoldenComparison(GoldenCompareResult& out_result) {
+    out_result = golden_result_;
+    return golden_result_.valid ? 0 : -1;
+}
+
+int ScannerLApi::GetHeightMaps(std::vector<HeightMap>& out_maps) {
+    static_assert(sizeof(AIeveR_Point3F) == 3 * sizeof(float), "AIeveR_Point3F must be 3 packed floats");
+    std::vector<HeightMap>(all_PC_data.size()).swap(out_maps);
+    for (int cam = 0; cam < all_PC_data.size(); cam++) {
+        auto raster_time = std::chrono::system_clock::now();
+        const std::vector<AIeveR_Point3F>& pc = all_PC_data[cam].ALL_PC_VEC_SAVE;
+        int flag_raster = BuildHeightMap(reinterpret_cast<const float*>(pc.data()), pc.size(), height_map_params_, out_maps[cam]);
+        auto raster_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - raster_time).count();
+        LOG(INFO) << "scanner " << cam << " height map status: " << flag_raster << " size: " << out_maps[cam].height.cols
+            << " x " << out_maps[cam].height.rows << " in " << raster_time_diff << " ms\n";
+        if (flag_raster != 0)
+            return flag_raster;
+    }
+    return 0;
+}
+
+void ScannerLApi::align_backward_pass(Scanner_All_Data& all_data, int scanner_idx, const AIeveR_Point3D& mv_vec) {
+    // after stitching the first line sits at travel 0; shift it to where that line lies
+    // relative to the start of the outbound stroke, then add the calibrated backward offset
+    double travel = 0.0;
+    if (scanner_idx < forward_encoder_values_.size() && !all_data.ENCODER_VEC_.empty()) {
+        int32_t forward_start = static_cast<int32_t>(forward_encoder_values_[scanner_idx]);
+        travel = EncoderStep(forward_start, all_data.ENCODER_VEC_.front(), encoder_wrap_bits_) * profile_stitch_distances[0];
+    }
+    else {
+        LOG(WARNING) << "scanner " << scanner_idx << " backward stroke without outbound reference, only compensation applied";
+    }
+    float dx = static_cast<float>(travel * mv_vec.x) + backward_compensation_pt_.x;
+    float dy = static_cast<float>(travel * mv_vec.y) + backward_compensation_pt_.y;
+    float dz = static_cast<float>(travel * mv_vec.z) + backward_compensation_pt_.z;
+    LOG(INFO) << "scanner " << scanner_idx << " backward stroke travel: " << travel << " offset(x|y|z): " << dx << " | " << dy << " | " << dz;
+    OffsetValidPoints(all_data.ALL_PC_VEC_SAVE, dx, dy, dz);
+}
+
 
 int ScannerLApi::disconnect(){
+    if (simulated_device_enable_) {
+        simulated_device_.Stop();
+        return 0;
+    }
     //disconnectҪ
     for(int i = 0; i < scanner_l_ptr_vec_.size();i++){
         scanner_l_ptr_vec_[i]->disconnect();
@@ -657,10 +1132,37 @@ int ScannerLApi::disconnect(){
     return 0;
 }
 
+void ScannerLApi::SetSimulatedDevice(bool enable) {
+    simulated_device_enable_ = enable;
+    simulated_device_forced_ = true;
+}
+
+bool ScannerLApi::IsSimulatedDevice() const {
+    return simulated_device_enable_;
+}
+
+bool ScannerLApi::IsAcquisitionComplete() const {
+    return g_callBackCount_0.load() >= g_needCallbackCount_;
+}
+
+int ScannerLApi::GetBatchCount() const {
+    return g_callBackCount_0.load();
+}
+
+double ScannerLApi::GetLastStitchMs() const {
+    return last_stitch_ms_;
+}
+
+int ScannerLApi::GetScanStatistics(ScanStatistics& out_stats) {
+    out_stats = g_scan_statistics.Snapshot();
+    return 0;
+}
+
 int ScannerLApi::GetAllData(std::vector<std::vector<cv::Point3f>>& out_pc_vec, 
                             std::vector<std::vector<uint8_t>>& out_gray_vec,
                             std::vector<std::vector<int32_t>>& out_encoder_vec,
                             std::vector<std::vector<uint32_t>>& out_framecnt_vec) {
+    ScopedMetricTimer get_all_data_timer(Metrics().Histogram(kMetricScanGetAllDataMs));
 
     std::vector<std::vector<cv::Point3f>> (SCANNER_CONFIG_FILE_TXT.size(), std::vector<cv::Point3f>()).swap(out_pc_vec);
     std::vector<std::vector<uint8_t>> (SCANNER_CONFIG_FILE_TXT.size(), std::vector<uint8_t>()).swap(out_gray_vec);
@@ -670,6 +1172,8 @@ int ScannerLApi::GetAllData(std::vector<std::vector<cv::Point3f>>& out_pc_vec,
     out_gray_vec.resize(SCANNER_CONFIG_FILE_TXT.size());
     out_encoder_vec.resize(SCANNER_CONFIG_FILE_TXT.size());
     out_framecnt_vec.resize(SCANNER_CONFIG_FILE_TXT.size());
+    std::vector<PostProcessResult>(SCANNER_CONFIG_FILE_TXT.size()).swap(post_process_results_);
+    std::vector<MeasurementResult>(SCANNER_CONFIG_FILE_TXT.size()).swap(measurement_results_);
     std::vector<uint32_t> frame_cnt_vec;
     std::vector<int32_t> encoder_vec;
     std::vector<cv::Point3f> frame_pc_vec;
@@ -745,6 +1249,54 @@ int ScannerLApi::GetAllData(std::vector<std::vector<cv::Point3f>>& out_pc_vec,
         frame_cnt_vec.clear();
         encoder_vec.clear();
         frame_pc_vec.clear();
+
+        // post-scan pipeline: RT transform first, then the enabled stages
+        auto post_time = std::chrono::system_clock::now();
+        cv::Mat rt = cam < scanner_l_rt_vec_.size() ? scanner_l_rt_vec_[cam] : cv::Mat();
+        int flag_post = RunPostProcess(out_pc_vec[cam], kDefaultDataWidth, rt, post_process_config_, post_process_results_[cam]);
+        auto post_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - post_time).count();
+        LOG(INFO) << "scanner " << cam << " post process status: " << flag_post << " in " << post_time_diff << " ms\n";
+        std::vector<uint8_t>& outlier_mask = post_process_results_[cam].outlier_mask;
+        if (!outlier_mask.empty()) {
+            // compact all per-point vectors or none of them, they must stay index aligned
+            const size_t n = outlier_mask.size();
+            if (out_pc_vec[cam].size() == n && out_gray_vec[cam].size() == n
+                && out_encoder_vec[cam].size() == n && out_framecnt_vec[cam].size() == n) {
+                RemoveMasked(out_pc_vec[cam], outlier_mask);
+                RemoveMasked(out_gray_vec[cam], outlier_mask);
+                RemoveMasked(out_encoder_vec[cam], outlier_mask);
+                RemoveMasked(out_framecnt_vec[cam], outlier_mask);
+                post_process_results_[cam].organized = false;
+            }
+            else {
+                LOG(ERROR) << "scanner " << cam << " outlier mask of " << n << " points does not match pc " << out_pc_vec[cam].size()
+                    << " gray " << out_gray_vec[cam].size() << " encoder " << out_encoder_vec[cam].size()
+                    << " framecnt " << out_framecnt_vec[cam].size() << ", outliers kept";
+            }
+            std::vector<uint8_t>().swap(outlier_mask);
+        }
+
+        if (measurement_enable_) {
+            auto measure_time = std::chrono::system_clock::now();
+            HeightMap measure_map;
+            int flag_measure = BuildHeightMap(out_pc_vec[cam], height_map_params_, measure_map);
+            if (flag_measure == 0) {
+                // with the plane removed in place z already is the height above base
+                const PlaneModel& plane = post_process_results_[cam].plane;
+                PlaneModel flat_base;
+                flat_base.valid = true;
+                const PlaneModel* base_plane = nullptr;
+                if (plane.valid)
+                    base_plane = post_process_config_.plane_fit_output == "in_place" ? &flat_base : &plane;
+                flag_measure = MeasureHeightMap(measure_map, base_plane, measurement_rois_, measurement_params_, measurement_results_[cam]);
+            }
+            auto measure_time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - measure_time).count();
+            LOG(INFO) << "scanner " << cam << " measurement status: " << flag_measure << " in " << measure_time_diff << " ms\n";
+            for (const auto& region : measurement_results_[cam].regions) {
+                LOG(INFO) << "scanner " << cam << " region " << region.name << " volume: " << region.volume
+                    << " area: " << region.area << " max height: " << region.max_height;
+            }
+        }
     }
     LOG(INFO) << "********out vec[0] size********";
     LOG(INFO) << "out_pc_vec[0].size(): " << out_pc_vec[0].size();
@@ -791,6 +1343,66 @@ int ScannerLApi::load_config_file(std::string config_rootpath, std::string confi
     profile_stitch_dist = data["profile_stitch_distance"];
     callback_cnt = data["needCallbackCount"];
 
+    use_profile_resampler_ = data.value("use_profile_resampler", false);
+    resample_pitch_ = data.value("resample_pitch", 0.0);
+    encoder_wrap_bits_ = data.value("encoder_wrap_bits", 16);
+    bidirectional_scan_ = data.value("bidirectional_scan", false);
+
+    height_map_enable_ = data.value("height_map_enable", false);
+    height_map_params_.resolution = data.value("height_map_resolution", 0.05);
+    height_map_params_.reduce = HeightMapReduceFromString(data.value("height_map_reduce", std::string("max")));
+    preview_pyramid_enable_ = data.value("preview_pyramid_enable", false);
+    preview_pyramid_levels_ = data.value("preview_pyramid_levels", 4);
+    post_process_config_.LoadFromJson(data);
+
+    golden_compare_enable_ = data.value("golden_compare_enable", false);
+    golden_reference_dir_ = data.value("golden_reference_dir", std::string("golden/"));
+    golden_compare_params_.search_radius = data.value("golden_search_radius", 10);
+    golden_compare_params_.search_decimation = data.value("golden_search_decimation", 4);
+    golden_compare_params_.min_overlap = data.value("golden_min_overlap", 1000);
+    golden_compare_params_.tolerance_warn = data.value("golden_tolerance_warn", 0.05f);
+    golden_compare_params_.tolerance_fail = data.value("golden_tolerance_fail", 0.1f);
+    golden_compare_params_.encoder_wrap_bits = encoder_wrap_bits_;
+
+    cloud_merge_enable_ = data.value("cloud_merge_enable", false);
+    cloud_merge_params_.mode = CloudMergeModeFromString(data.value("cloud_merge_mode", std::string("voxel")));
+    cloud_merge_params_.voxel_size = data.value("cloud_merge_voxel_size", 0.1f);
+    cloud_merge_params_.height_map = height_map_params_;
+
+    preview_downsample_params_.voxel_size = data.value("preview_voxel_size", 0.5f);
+    preview_downsample_params_.policy = VoxelPolicyFromString(data.value("preview_voxel_policy", std::string("centroid")));
+    preview_export_enable_ = data.value("preview_export_enable", false);
+
+    normal_estimation_enable_ = data.value("normal_estimation_enable", false);
+    normal_params_.step = data.value("normal_step", 1);
+    normal_params_.max_depth_jump = data.value("normal_max_depth_jump", 0.5f);
+    normal_params_.orient_up = data.value("normal_orient_up", true);
+
+    live_preview_enable_ = data.value("live_preview_enable", true);
+    live_preview_params_.column_step = data.value("live_preview_column_step", 8);
+    live_preview_params_.row_step = data.value("live_preview_row_step", 4);
+    live_preview_params_.ring_rows = data.value("live_preview_ring_rows", 1024);
+
+    measurement_enable_ = data.value("measurement_enable", false);
+    measurement_params_.base_z = data.value("measurement_base_z", 0.0);
+    measurement_params_.min_height = data.value("measurement_min_height", 0.05f);
+    measurement_params_.percentiles = data.value("measurement_percentiles", std::vector<double>{ 5.0, 50.0, 95.0 });
+
+    profile_feature_enable_ = data.value("profile_feature_enable", false);
+    profile_feature_params_.gradient_span = data.value("profile_feature_gradient_span", 2);
+    profile_feature_params_.gradient_high = data.value("profile_feature_gradient_high", 0.3f);
+    profile_feature_params_.gradient_low = data.value("profile_feature_gradient_low", 0.1f);
+    profile_feature_params_.plateau_width = data.value("profile_feature_plateau_width", 8);
+    profile_feature_params_.min_step_height = data.value("profile_feature_min_step_height", 0.1f);
+
+    if (!simulated_device_forced_)
+        simulated_device_enable_ = data.value("simulated_device_enable", false);
+    simulated_device_params_.lines_per_batch = data.value("simulated_lines_per_batch", 100);
+    simulated_device_params_.line_rate_hz = data.value("simulated_line_rate", 2000.0);
+    simulated_device_params_.noise_sigma = data.value("simulated_noise_sigma", 0.005f);
+    simulated_device_params_.invalid_ratio = data.value("simulated_invalid_ratio", 0.01f);
+    simulated_device_params_.seed = data.value("simulated_seed", 1u);
+
     main_scan = data["main_scan"];
     int zrange_low = data["zrange_low"];
     int zrange_high = data["zrange_high"];
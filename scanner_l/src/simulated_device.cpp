@@ -0,0 +1,112 @@
+#include "scanner_l/simulated_device.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "glog/logging.h"
+
+SimulatedDevice::~SimulatedDevice() {
+    Stop();
+}
+
+void SimulatedDevice::SetParams(const SimulatedDeviceParams& params) {
+    params_ = params;
+    params_.data_width = std::max(1, params_.data_width);
+    params_.lines_per_batch = std::max(1, params_.lines_per_batch);
+    params_.pulses_per_line = std::max(1, params_.pulses_per_line);
+    params_.encoder_wrap_bits = std::min(31, std::max(1, params_.encoder_wrap_bits));
+    rng_ = cv::RNG(params_.seed);
+}
+
+int SimulatedDevice::Start(SimulatedBatchCallback callback, int max_batches) {
+    if (running_.load()) {
+        LOG(WARNING) << "SimulatedDevice - already running";
+        return -1;
+    }
+    if (thread_.joinable())
+        thread_.join();
+    callback_ = std::move(callback);
+    stop_.store(false);
+    batch_count_.store(0);
+    running_.store(true);
+    thread_ = std::thread(&SimulatedDevice::Run, this, max_batches);
+    return 0;
+}
+
+void SimulatedDevice::Stop() {
+    stop_.store(true);
+    if (thread_.joinable())
+        thread_.join();
+    running_.store(false);
+}
+
+void SimulatedDevice::Run(int max_batches) {
+    SimulatedBatch batch;
+    const double batch_seconds = params_.line_rate_hz > 0.0 ? params_.lines_per_batch / params_.line_rate_hz : 0.0;
+    auto next_batch = std::chrono::steady_clock::now();
+    while (!stop_.load() && (max_batches <= 0 || static_cast<int>(batch_count_.load()) < max_batches)) {
+        // lines are "exposed" at the line rate, the batch is delivered once its last line is in
+        if (batch_seconds > 0.0) {
+            next_batch += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(batch_seconds));
+            std::this_thread::sleep_until(next_batch);
+            if (stop_.load())
+                break;
+        }
+        RenderBatch(batch);
+        if (callback_)
+            callback_(batch);
+        batch_count_.fetch_add(1);
+    }
+    running_.store(false);
+}
+
+void SimulatedDevice::RenderBatch(SimulatedBatch& batch) {
+    const int width = params_.data_width;
+    const int lines = params_.lines_per_batch;
+    const size_t points = size_t(width) * lines;
+    batch.data_width = width;
+    batch.lines = lines;
+    batch.xyz.resize(points);
+    batch.z.resize(points);
+    batch.gray.resize(points);
+    batch.encoder.resize(lines);
+    batch.frame.resize(lines);
+
+    const uint32_t encoder_mask = (1u << params_.encoder_wrap_bits) - 1u;
+    const float half_width = 0.5f * width * params_.x_pitch;
+    const float block_half = 0.2f * half_width;
+    const float dome_radius = 0.25f * half_width;
+
+    for (int r = 0; r < lines; r++) {
+        const uint64_t line = line_ + r;
+        const uint64_t pulses = line * params_.pulses_per_line;
+        batch.encoder[r] = static_cast<int32_t>(pulses & encoder_mask);
+        batch.frame[r] = frame_++;
+
+        // the part repeats every 4 block lengths along the travel direction
+        const float y = static_cast<float>(pulses * params_.y_per_pulse);
+        const float period = 8.0f * block_half;
+        const float y_local = std::fmod(y, period) - 0.5f * period;
+
+        cv::Point3f* xyz = batch.xyz.data() + size_t(r) * width;
+        float* z = batch.z.data() + size_t(r) * width;
+        uint8_t* gray = batch.gray.data() + size_t(r) * width;
+        for (int c = 0; c < width; c++) {
+            const float x = c * params_.x_pitch - half_width;
+            float h = params_.base_z + 0.01f * x;
+            if (std::fabs(x + 0.5f * half_width) < block_half && std::fabs(y_local) < block_half)
+                h += params_.block_height;
+            const float dx = x - 0.5f * half_width;
+            const float d2 = (dx * dx + y_local * y_local) / (dome_radius * dome_radius);
+            if (d2 < 1.0f)
+                h += params_.dome_height * std::sqrt(1.0f - d2);
+            h += params_.ripple_amplitude * std::sin(0.5f * x) * std::cos(0.5f * y);
+            h += static_cast<float>(rng_.gaussian(params_.noise_sigma));
+
+            const bool invalid = params_.invalid_ratio > 0.0f && rng_.uniform(0.0f, 1.0f) < params_.invalid_ratio;
+            z[c] = invalid ? kInvalidZ : h;
+            xyz[c] = cv::Point3f(x, 0.0f, z[c]);
+            gray[c] = invalid ? 0 : static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, 120.0f + 40.0f * h)));
+        }
+    }
+    line_ += lines;
+}
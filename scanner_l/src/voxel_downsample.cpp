@@ -0,0 +1,171 @@
+#include "scanner_l/voxel_downsample.h"
+#include "scanner_l/range_image.h"
+#include <algorithm>
+#include <unordered_map>
+#include "glog/logging.h"
+
+namespace {
+    struct VoxelAcc
+    {
+        uint64_t key = 0;
+        double sum_x = 0.0;
+        double sum_y = 0.0;
+        double sum_z = 0.0;
+        uint32_t sum_gray = 0;
+        uint32_t count = 0;
+        // point kept by First / MaxZ
+        cv::Point3f pick;
+        uint8_t pick_gray = 0;
+    };
+
+    void AddPoint(VoxelAcc& acc, const cv::Point3f& p, uint8_t g, VoxelPolicy policy) {
+        const bool first = acc.count == 0;
+        acc.sum_x += p.x;
+        acc.sum_y += p.y;
+        acc.sum_z += p.z;
+        acc.sum_gray += g;
+        acc.count++;
+        if (first || (policy == VoxelPolicy::MaxZ && p.z > acc.pick.z)) {
+            acc.pick = p;
+            acc.pick_gray = g;
+        }
+    }
+
+    // later holds points that come after the ones in acc
+    void Combine(VoxelAcc& acc, const VoxelAcc& later, VoxelPolicy policy) {
+        acc.sum_x += later.sum_x;
+        acc.sum_y += later.sum_y;
+        acc.sum_z += later.sum_z;
+        acc.sum_gray += later.sum_gray;
+        acc.count += later.count;
+        if (policy == VoxelPolicy::MaxZ && later.pick.z > acc.pick.z) {
+            acc.pick = later.pick;
+            acc.pick_gray = later.pick_gray;
+        }
+    }
+
+    // one point per voxel
+    void EmitVoxel(const VoxelAcc& acc, VoxelPolicy policy, bool with_gray,
+                   std::vector<cv::Point3f>& out_pc, std::vector<uint8_t>& out_gray) {
+        if (policy == VoxelPolicy::Centroid) {
+            out_pc.emplace_back(static_cast<float>(acc.sum_x / acc.count), static_cast<float>(acc.sum_y / acc.count),
+                                static_cast<float>(acc.sum_z / acc.count));
+            if (with_gray)
+                out_gray.push_back(static_cast<uint8_t>((acc.sum_gray + acc.count / 2) / acc.count));
+        }
+        else {
+            out_pc.push_back(acc.pick);
+            if (with_gray)
+                out_gray.push_back(acc.pick_gray);
+        }
+    }
+
+    // voxels of one chunk in order of first appearance
+    void HashChunk(const cv::Point3f* pc, const uint8_t* gray, size_t begin, size_t end, float inv_size,
+                   VoxelPolicy policy, std::vector<VoxelAcc>& out) {
+        std::unordered_map<uint64_t, uint32_t> index;
+        uint64_t last_key = 0;
+        uint32_t last_idx = 0;
+        bool has_last = false;
+        for (size_t i = begin; i < end; i++) {
+            const cv::Point3f& p = pc[i];
+            if (!IsValidZ(p.z))
+                continue;
+            const uint64_t key = VoxelKey(p, inv_size);
+            // neighbours along a profile mostly fall into the same voxel
+            if (!has_last || key != last_key) {
+                auto it = index.find(key);
+                if (it == index.end()) {
+                    it = index.emplace(key, static_cast<uint32_t>(out.size())).first;
+                    out.emplace_back();
+                    out.back().key = key;
+                }
+                last_key = key;
+                last_idx = it->second;
+                has_last = true;
+            }
+            AddPoint(out[last_idx], p, gray ? gray[i] : 0, policy);
+        }
+    }
+}
+
+VoxelPolicy VoxelPolicyFromString(const std::string& name) {
+    if (name == "first")
+        return VoxelPolicy::First;
+    if (name == "max_z")
+        return VoxelPolicy::MaxZ;
+    return VoxelPolicy::Centroid;
+}
+
+const char* VoxelPolicyName(VoxelPolicy policy) {
+    switch (policy) {
+    case VoxelPolicy::First:
+        return "first";
+    case VoxelPolicy::MaxZ:
+        return "max_z";
+    default:
+        return "centroid";
+    }
+}
+
+int VoxelDownsample(const cv::Point3f* pc, const uint8_t* gray, size_t num, int width,
+                    const VoxelDownsampleParams& params,
+                    std::vector<cv::Point3f>& out_pc, std::vector<uint8_t>& out_gray) {
+    out_pc.clear();
+    out_gray.clear();
+    if (params.voxel_size <= 0.0f) {
+        LOG(ERROR) << "VoxelDownsample - bad voxel size: " << params.voxel_size;
+        return -1;
+    }
+    if (pc == nullptr || num == 0)
+        return 0;
+    const float inv_size = 1.0f / params.voxel_size;
+    const size_t chunk_points = size_t(std::max(1, params.chunk_rows)) * size_t(width > 0 ? width : 1);
+    const int num_chunks = static_cast<int>((num + chunk_points - 1) / chunk_points);
+
+    // 1. chunks are hashed in waves of one chunk per thread, 2. stitched in chunk order against
+    // the previous chunk only and 3. emitted; besides the output at most a wave plus one chunk
+    // of voxels is alive
+    const int wave = std::min(num_chunks, std::max(1, cv::getNumThreads()));
+    std::vector<std::vector<VoxelAcc>> chunks(wave);
+    // voxels of the previous chunk, the next one may still add to them
+    std::vector<VoxelAcc> pending;
+    std::unordered_map<uint64_t, uint32_t> pending_index;
+    for (int first = 0; first < num_chunks; first += wave) {
+        const int count = std::min(wave, num_chunks - first);
+        cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+            for (int c = range.start; c < range.end; c++) {
+                const size_t begin = size_t(first + c) * chunk_points;
+                chunks[c].clear();
+                HashChunk(pc, gray, begin, std::min(num, begin + chunk_points), inv_size, params.policy, chunks[c]);
+            }
+        });
+
+        for (int c = 0; c < count; c++) {
+            std::vector<VoxelAcc>& chunk = chunks[c];
+            // voxels cut by the border go into their earlier part, the rest stays in the chunk
+            size_t kept = 0;
+            for (size_t v = 0; v < chunk.size(); v++) {
+                auto it = pending_index.find(chunk[v].key);
+                if (it != pending_index.end())
+                    Combine(pending[it->second], chunk[v], params.policy);
+                else
+                    chunk[kept++] = chunk[v];
+            }
+            chunk.resize(kept);
+            for (const auto& acc : pending) {
+                EmitVoxel(acc, params.policy, gray != nullptr, out_pc, out_gray);
+            }
+            // the emitted buffer is reused by the next wave
+            pending.swap(chunk);
+            pending_index.clear();
+            for (uint32_t v = 0; v < pending.size(); v++) {
+                pending_index.emplace(pending[v].key, v);
+            }
+        }
+    }
+    for (const auto& acc : pending) {
+        EmitVoxel(acc, params.policy, gray != nullptr, out_pc, out_gray);
+    }
+    return 0;
+}